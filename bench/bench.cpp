@@ -0,0 +1,281 @@
+// diedrico_bench: times loading, saving, drawing and the dihedral sheet on a generated scene and prints
+// the results as JSON, so two builds can be compared. With --baseline it compares against an earlier
+// run itself and exits with 1 when a benchmark got slower than the tolerance allows.
+//
+//     diedrico_bench --points 5000 --lines 2000 --planes 300 --out results.json
+//     diedrico_bench --baseline results.json --tolerance 0.15
+
+#include "app.h"
+#include "framestats.h"
+#include "scenegen.h"
+
+#include <imgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+    struct BenchOptions {
+        SceneGenOptions scene;
+        int iterations = 30;
+        int warmup = 3;
+        bool intersections = false;
+        std::string filter;     // only the benchmarks with this in their name
+        std::string outPath;    // stdout when empty
+        std::string baselinePath;
+        float tolerance = 0.10f; // how much slower the median may get before --baseline fails
+    };
+
+    struct BenchResult {
+        std::string name;
+        FrameTimeStats times;
+    };
+
+    // Counts what the sheet would draw, so the sheet math runs without any canvas behind it
+    class CountingCanvas : public SheetCanvas {
+    public:
+        void Line(const ImVec2&, const ImVec2&, ImU32, float) override { lines++; }
+        void Circle(const ImVec2&, float, ImU32) override { circles++; }
+        void Text(const ImVec2&, ImU32, const char*) override { texts++; }
+
+        size_t lines = 0;
+        size_t circles = 0;
+        size_t texts = 0;
+    };
+
+    void PrintUsage() {
+        std::cout << "usage: diedrico_bench [options]\n"
+                     "  --points N --lines N --planes N   scene size (1000, 500, 100)\n"
+                     "  --sharing F                       chance a corner reuses a point, 0-1 (0.5)\n"
+                     "  --quadrants W1,W2,W3,W4           point weights per quadrant (1,1,1,1)\n"
+                     "  --seed N                          scene seed (1)\n"
+                     "  --iterations N --warmup N         timed and untimed runs per benchmark (30, 3)\n"
+                     "  --intersections                   compute line-plane and plane-plane intersections\n"
+                     "  --filter TEXT                     only benchmarks with TEXT in their name\n"
+                     "  --out PATH                        write the JSON there instead of stdout\n"
+                     "  --baseline PATH --tolerance F     fail when a median is F slower than in PATH (0.1)\n";
+    }
+
+    bool ParseArguments(int argc, char** argv, BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (arg == "--help" || arg == "-h") return false;
+            else if (arg == "--intersections") options.intersections = true;
+            else if (!hasValue) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return false;
+            }
+            else if (arg == "--points") options.scene.points = atoi(argv[++i]);
+            else if (arg == "--lines") options.scene.lines = atoi(argv[++i]);
+            else if (arg == "--planes") options.scene.planes = atoi(argv[++i]);
+            else if (arg == "--sharing") options.scene.sharing = static_cast<float>(atof(argv[++i]));
+            else if (arg == "--seed") options.scene.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--iterations") options.iterations = atoi(argv[++i]);
+            else if (arg == "--warmup") options.warmup = atoi(argv[++i]);
+            else if (arg == "--filter") options.filter = argv[++i];
+            else if (arg == "--out") options.outPath = argv[++i];
+            else if (arg == "--baseline") options.baselinePath = argv[++i];
+            else if (arg == "--tolerance") options.tolerance = static_cast<float>(atof(argv[++i]));
+            else if (arg == "--quadrants") {
+                float* weights = options.scene.quadrantWeights;
+                if (sscanf(argv[++i], "%f,%f,%f,%f", &weights[0], &weights[1], &weights[2], &weights[3]) != 4) {
+                    std::cerr << "--quadrants takes four weights: W1,W2,W3,W4" << std::endl;
+                    return false;
+                }
+            }
+            else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        if (options.iterations < 1) options.iterations = 1;
+        return true;
+    }
+
+    // setup runs untimed before every iteration, body is what gets measured
+    void Run(const BenchOptions& options, std::vector<BenchResult>& results, const char* name,
+             const std::function<void()>& body, const std::function<void()>& setup = nullptr) {
+        if (!options.filter.empty() && std::string(name).find(options.filter) == std::string::npos) return;
+
+        BenchResult result{ name, FrameTimeStats(options.iterations) };
+        for (int i = 0; i < options.warmup + options.iterations; ++i) {
+            if (setup) setup();
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (i >= options.warmup) result.times.Add(milliseconds);
+        }
+        std::cerr << name << ": " << result.times.GetPercentile(50.0f) << " ms" << std::endl;
+        results.push_back(std::move(result));
+    }
+
+    nlohmann::json ToJson(const BenchOptions& options, const SceneData& scene, const std::vector<BenchResult>& results) {
+        const SceneGenOptions& gen = options.scene;
+        nlohmann::json content;
+        content["scene"] = {
+            {"points", gen.points}, {"lines", gen.lines}, {"planes", gen.planes},
+            {"sharing", gen.sharing}, {"seed", gen.seed},
+            {"quadrantWeights", {gen.quadrantWeights[0], gen.quadrantWeights[1], gen.quadrantWeights[2], gen.quadrantWeights[3]}},
+            {"totalPoints", scene.points.size()}, // with the corners the lines and planes added
+            {"intersections", options.intersections},
+        };
+        content["iterations"] = options.iterations;
+
+        content["benchmarks"] = nlohmann::json::array();
+        for (const auto& result : results) {
+            content["benchmarks"].push_back({
+                {"name", result.name},
+                {"mean_ms", result.times.GetMean()},
+                {"median_ms", result.times.GetPercentile(50.0f)},
+                {"p95_ms", result.times.GetPercentile(95.0f)},
+                {"min_ms", result.times.GetPercentile(0.0f)},
+                {"max_ms", result.times.GetMax()},
+            });
+        }
+        return content;
+    }
+
+    // medians against the baseline, false when any got slower than the tolerance
+    bool CompareBaseline(const BenchOptions& options, const nlohmann::json& current) {
+        std::ifstream file(options.baselinePath);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open baseline: " << options.baselinePath << std::endl;
+            return false;
+        }
+
+        nlohmann::json baseline;
+        try {
+            file >> baseline;
+        } catch (const nlohmann::json::parse_error& e) {
+            std::cerr << "JSON parse error: " << e.what() << std::endl;
+            return false;
+        }
+
+        if (baseline.value("scene", nlohmann::json()) != current["scene"]) {
+            std::cerr << "Warning: the baseline was run on a different scene, the times aren't comparable" << std::endl;
+        }
+
+        bool passed = true;
+        for (const auto& bench : current["benchmarks"]) {
+            for (const auto& old : baseline.value("benchmarks", nlohmann::json::array())) {
+                if (old.value("name", "") != bench["name"]) continue;
+
+                const float before = old.value("median_ms", 0.0f);
+                const float now = bench["median_ms"].get<float>();
+                if (before > 0.0f && now > before * (1.0f + options.tolerance)) {
+                    std::cerr << "REGRESSION " << bench["name"].get<std::string>() << ": " << before << " ms -> " << now << " ms" << std::endl;
+                    passed = false;
+                }
+            }
+        }
+        return passed;
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!ParseArguments(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    const SceneData scene = GenerateScene(options.scene);
+    const std::string scenePath = "diedrico_bench_scene.json";
+
+    char headless[] = "--headless";
+    char* appArgs[] = { argv[0], headless };
+    App app;
+    if (!app.Initialize(2, appArgs)) return -1;
+
+    std::vector<BenchResult> results;
+
+    // file formats, the save goes to disk so the load has something to read
+    JsonHandler& json = app.GetJsonHandler();
+    std::string path = scenePath;
+    json.Save(scenePath, scene);
+    std::vector<nlohmann::json> loaded;
+
+    Run(options, results, "json_save", [&]() { json.Save(scenePath, scene); });
+    Run(options, results, "json_load", [&]() { loaded = json.Load(path); });
+
+    std::vector<nlohmann::json> data = json.Load(path);
+    std::vector<nlohmann::json> copy;
+    Run(options, results, "load_project", [&]() { app.LoadProject(std::move(copy)); }, [&]() { copy = data; });
+    remove(scenePath.c_str());
+
+    // the rest runs on the generated scene, saving loses which corners are shared
+    app.SetSceneData(scene);
+    SceneData& appScene = app.GetSceneData();
+    appScene.settings.VSync = false;
+    appScene.settings.showIntersections = options.intersections;
+    app.Frame(); // sets up the camera and fills the derived geometry caches
+
+    // dihedral sheet math: traces and visibility from scratch, then the whole sheet with warm caches
+    Run(options, results, "dihedral_traces", [&]() {
+        TraceEngine traces;
+        traces.UpdatePlanes(scene);
+        traces.UpdateLines(scene);
+    });
+    TraceEngine lineTraces;
+    const auto& allLineTraces = lineTraces.UpdateLines(scene);
+    Run(options, results, "dihedral_visibility", [&]() {
+        VisibilitySolver visibility;
+        visibility.SetVolume(scene.settings.worldScale);
+        visibility.Update(scene, allLineTraces);
+    });
+
+    DihedralViewport sheet;
+    CountingCanvas canvas;
+    Run(options, results, "dihedral_sheet", [&]() {
+        sheet.DrawSheet(scene, canvas, ImVec2(0.0f, 0.0f), ImVec2(2384.0f, 1684.0f), IM_COL32(25, 25, 25, 255));
+    });
+
+    // the 3D scene: the packet the worker builds every frame, then drawing it
+    // (the labels it collects are handed over by EndFrame, outside the timing)
+    RenderPacket packet;
+    const IntersectionResults* intersections = options.intersections ? &app.GetIntersections().GetResults() : nullptr;
+    Run(options, results, "build_render_packet", [&]() { BuildRenderPacket(scene, intersections, packet); });
+
+    RenderFrame frame;
+    app.CollectRenderFrame(frame);
+    Renderer& renderer = app.GetRenderer();
+    bool inFrame = false;
+    Run(options, results, "prepare_render_data", [&]() { app.PrepareRenderData(frame); }, [&]() {
+        if (inFrame) renderer.EndFrame();
+        glFinish();
+        inFrame = true;
+        renderer.BeginFrame(frame.view);
+        renderer.Render();
+    });
+    if (inFrame) renderer.EndFrame();
+
+    // whole frames, up to the GPU finishing them (no vsync on a hidden window anyway)
+    Run(options, results, "frame", [&]() {
+        app.Frame();
+        glFinish();
+    });
+
+    const nlohmann::json content = ToJson(options, scene, results);
+    if (options.outPath.empty()) {
+        std::cout << content.dump(4) << std::endl;
+    } else {
+        std::ofstream file(options.outPath);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for writing: " << options.outPath << std::endl;
+        } else {
+            file << content.dump(4) << std::endl;
+        }
+    }
+
+    const bool passed = options.baselinePath.empty() || CompareBaseline(options, content);
+    app.Shutdown();
+    return passed ? 0 : 1;
+}
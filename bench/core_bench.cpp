@@ -0,0 +1,173 @@
+// diedrico_core_bench: nanoseconds per primitive for every kernel in diedrico_core, at several scene sizes.
+// Inputs come from the scene generator, so runs with the same seed measure the same work. Prints JSON.
+//
+//     diedrico_core_bench --sizes 100,10000,1000000 --out core.json
+
+#include "geometry.h"
+#include "pointclass.h"
+#include "scenegen.h"
+#include "traces.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr int REPEATS = 7;                  // the median of these is reported
+    constexpr size_t MIN_PRIMITIVES = 200000;   // every repeat runs the kernel at least this many times
+
+    volatile float g_sink; // results go here so the compiler can't drop the work
+
+    struct KernelResult {
+        const char* name;
+        size_t size;
+        double nsPerPrimitive;
+    };
+
+    // Runs kernel(i) for every primitive, enough rounds to be measurable, median of REPEATS.
+    // A template so the kernel inlines into the loop, a std::function call would cost more than some kernels.
+    template <typename Kernel>
+    double Measure(size_t count, const Kernel& kernel) {
+        const size_t rounds = std::max<size_t>(1, MIN_PRIMITIVES / count);
+        double times[REPEATS];
+        for (int repeat = 0; repeat < REPEATS; ++repeat) {
+            float sum = 0.0f;
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t round = 0; round < rounds; ++round) {
+                for (size_t i = 0; i < count; ++i) sum += kernel(i);
+            }
+            const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            times[repeat] = ns / static_cast<double>(rounds * count);
+            g_sink = sum;
+        }
+        std::nth_element(times, times + REPEATS / 2, times + REPEATS);
+        return times[REPEATS / 2];
+    }
+
+    std::vector<size_t> ParseSizes(const char* text) {
+        std::vector<size_t> sizes;
+        for (const char* p = text; *p;) {
+            char* end = nullptr;
+            unsigned long value = strtoul(p, &end, 10);
+            if (end == p) break;
+            if (value > 0) sizes.push_back(value);
+            p = *end == ',' ? end + 1 : end;
+        }
+        return sizes;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = { 100, 1000, 10000, 100000 };
+    uint32_t seed = 1;
+    std::string outPath;
+
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--sizes") == 0 && hasValue) sizes = ParseSizes(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) outPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: diedrico_core_bench [--sizes N,N,...] [--seed N] [--out PATH]\n");
+            return 2;
+        }
+    }
+
+    std::vector<KernelResult> results;
+    for (size_t size : sizes) {
+        // size points, and the lines and planes through consecutive ones
+        SceneGenOptions options;
+        options.points = static_cast<int>(size) + 2;
+        options.lines = 0;
+        options.planes = 0;
+        options.seed = seed;
+        const SceneData scene = GenerateScene(options);
+
+        std::vector<glm::vec3> world(scene.points.size());
+        std::vector<float> distances(scene.points.size()), heights(scene.points.size());
+        for (size_t i = 0; i < scene.points.size(); ++i) {
+            const float* c = scene.points[i].coords;
+            world[i] = glm::vec3(c[0], c[2], c[1]) / scene.settings.worldScale;
+            distances[i] = c[1];
+            heights[i] = c[2];
+        }
+        auto coords = [&](size_t i) { return scene.points[i].coords; };
+
+        const SheetProjection projection{ glm::vec2(960.0f, 540.0f), 10.0f };
+        const glm::vec2 rectMin(0.0f, 0.0f), rectMax(1920.0f, 1080.0f);
+        const glm::vec3 cameraPos(3.0f, 2.0f, 4.0f);
+
+        auto add = [&](const char* name, const auto& kernel) {
+            results.push_back({ name, size, Measure(size, kernel) });
+            fprintf(stderr, "%-20s %8zu  %8.2f ns\n", name, size, results.back().nsPerPrimitive);
+        };
+
+        add("sheet_projection", [&](size_t i) {
+            const glm::vec2 v = projection.Vertical(coords(i));
+            const glm::vec2 h = projection.Horizontal(coords(i));
+            return v.y + h.y;
+        });
+        add("extend_to_rect", [&](size_t i) {
+            glm::vec2 edge1, edge2;
+            ExtendToRect(projection.Vertical(coords(i)), projection.Vertical(coords(i + 1)), rectMin, rectMax, edge1, edge2);
+            return edge1.x + edge2.y;
+        });
+        add("clip_to_rect", [&](size_t i) {
+            const glm::vec2 p = projection.Horizontal(coords(i));
+            float tMin, tMax;
+            if (!ClipToRect(p, projection.Horizontal(coords(i + 1)) - p, rectMin, rectMax, tMin, tMax)) return 0.0f;
+            return tMax - tMin;
+        });
+        add("line_traces", [&](size_t i) {
+            const LineTraces traces = TraceEngine::ComputeLineTraces(coords(i), coords(i + 1));
+            return traces.horizontal[0] + traces.vertical[2];
+        });
+        add("plane_traces", [&](size_t i) {
+            const PlaneTraces traces = TraceEngine::ComputePlaneTraces(coords(i), coords(i + 1), coords(i + 2),
+                                                                       -100.0f, 100.0f, -100.0f, 100.0f);
+            return traces.horizontal.x1 + traces.vertical.y2;
+        });
+        add("plane_basis", [&](size_t i) {
+            const PlaneBasis basis = ComputePlaneBasis(world[i], world[i + 1], world[i + 2]);
+            return basis.right.x + basis.forward.z + basis.offset;
+        });
+        add("expanded_plane_quad", [&](size_t i) {
+            glm::vec3 quad[4];
+            ExpandedPlaneQuad(world[i], world[i + 1], world[i + 2], 1.1f, 50.0f, quad);
+            return quad[0].x + quad[2].z;
+        });
+        add("thick_line_quad", [&](size_t i) {
+            glm::vec3 quad[6];
+            ThickLineQuad(world[i], world[i + 1], cameraPos, 0.015f, quad);
+            return quad[0].x + quad[4].y;
+        });
+
+        // the classifier works on whole arrays, one call is size primitives
+        std::vector<uint8_t> classes(size);
+        const size_t calls = std::max<size_t>(1, MIN_PRIMITIVES / size);
+        const double perCall = Measure(calls, [&](size_t) {
+            ClassifyPoints(distances.data(), heights.data(), classes.data(), size);
+            return static_cast<float>(classes[size / 2]);
+        });
+        results.push_back({ "classify_points", size, perCall / static_cast<double>(size) });
+        fprintf(stderr, "%-20s %8zu  %8.2f ns\n", "classify_points", size, results.back().nsPerPrimitive);
+    }
+
+    FILE* out = outPath.empty() ? stdout : fopen(outPath.c_str(), "w");
+    if (!out) {
+        fprintf(stderr, "Failed to open file for writing: %s\n", outPath.c_str());
+        return 1;
+    }
+    fprintf(out, "{\n    \"seed\": %u,\n    \"kernels\": [\n", seed);
+    for (size_t i = 0; i < results.size(); ++i) {
+        fprintf(out, "        {\"name\": \"%s\", \"size\": %zu, \"ns_per_primitive\": %.3f}%s\n",
+                results[i].name, results[i].size, results[i].nsPerPrimitive, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "    ]\n}\n");
+    if (out != stdout) fclose(out);
+    return 0;
+}
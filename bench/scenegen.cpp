@@ -0,0 +1,118 @@
+#include "scenegen.h"
+
+#include <random>
+#include <string>
+
+namespace {
+    // mt19937 gives the same numbers everywhere, the std distributions don't, so they're done by hand
+    class Random {
+    public:
+        explicit Random(uint32_t seed) : m_engine(seed) {}
+
+        float Uniform() { return (m_engine() >> 8) * (1.0f / 16777216.0f); } // [0, 1)
+        float Range(float min, float max) { return min + (max - min) * Uniform(); }
+        int Index(int count) { return static_cast<int>(Uniform() * count); }
+
+    private:
+        std::mt19937 m_engine;
+    };
+
+    int PickQuadrant(Random& random, const float weights[4]) {
+        float total = 0.0f;
+        for (int i = 0; i < 4; ++i) total += weights[i] > 0.0f ? weights[i] : 0.0f;
+        if (total <= 0.0f) return 0;
+
+        float pick = random.Uniform() * total;
+        for (int i = 0; i < 4; ++i) {
+            if (weights[i] <= 0.0f) continue;
+            if (pick < weights[i]) return i;
+            pick -= weights[i];
+        }
+        return 3;
+    }
+
+    Point MakePoint(Random& random, const SceneGenOptions& options, const std::string& name, bool userCreated) {
+        // quadrant I: a > 0, c > 0, II: a < 0, c > 0, III: a < 0, c < 0, IV: a > 0, c < 0
+        static const float signs[4][2] = { {1.0f, 1.0f}, {-1.0f, 1.0f}, {-1.0f, -1.0f}, {1.0f, -1.0f} };
+        const int quadrant = PickQuadrant(random, options.quadrantWeights);
+
+        Point point;
+        point.name = name;
+        point.coords[0] = random.Range(-options.extent, options.extent);
+        point.coords[1] = signs[quadrant][0] * random.Range(0.05f, 1.0f) * options.extent;
+        point.coords[2] = signs[quadrant][1] * random.Range(0.05f, 1.0f) * options.extent;
+        point.userCreated = userCreated;
+        return point;
+    }
+
+    bool SameCoords(const Point& a, const Point& b) {
+        return a.coords[0] == b.coords[0] && a.coords[1] == b.coords[1] && a.coords[2] == b.coords[2];
+    }
+
+    bool Collinear(const Point& a, const Point& b, const Point& c) {
+        float u[3], v[3];
+        for (int i = 0; i < 3; ++i) {
+            u[i] = b.coords[i] - a.coords[i];
+            v[i] = c.coords[i] - a.coords[i];
+        }
+        const float cross[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+        return cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2] < 1e-6f;
+    }
+}
+
+SceneData GenerateScene(const SceneGenOptions& options) {
+    Random random(options.seed);
+    SceneData sceneData;
+    sceneData.settings.worldScale = options.extent / 2.0f;
+    sceneData.settings.showWelcomeWindow = false;
+
+    for (int i = 0; i < options.points; ++i) {
+        sceneData.points.push_back(MakePoint(random, options, "P" + std::to_string(i + 1), true));
+    }
+
+    // an existing point with probability sharing (when there is one), a new one otherwise
+    auto corner = [&](const std::string& name) {
+        const int count = static_cast<int>(sceneData.points.size());
+        if (count > 0 && random.Uniform() < options.sharing) return random.Index(count);
+        sceneData.points.push_back(MakePoint(random, options, name, false));
+        return count;
+    };
+
+    for (int i = 0; i < options.lines; ++i) {
+        const std::string name = "r" + std::to_string(i + 1);
+        Line line;
+        line.name = name;
+        line.point1index = corner(name + "1");
+        line.point2index = corner(name + "2");
+        if (line.point2index == line.point1index || SameCoords(sceneData.points[line.point1index], sceneData.points[line.point2index])) {
+            sceneData.points.push_back(MakePoint(random, options, name + "2", false));
+            line.point2index = static_cast<int>(sceneData.points.size()) - 1;
+        }
+        line.showVisibility = (i % 4) == 0;
+        sceneData.lines.push_back(line);
+    }
+
+    for (int i = 0; i < options.planes; ++i) {
+        const std::string name = "a" + std::to_string(i + 1);
+        Plane plane;
+        plane.name = name;
+        plane.point1index = corner(name + "1");
+        plane.point2index = corner(name + "2");
+        plane.point3index = corner(name + "3");
+        // a fresh random corner is collinear with the other two with probability zero, one retry is plenty
+        if (plane.point2index == plane.point1index) {
+            sceneData.points.push_back(MakePoint(random, options, name + "2", false));
+            plane.point2index = static_cast<int>(sceneData.points.size()) - 1;
+        }
+        const auto& points = sceneData.points;
+        if (plane.point3index == plane.point1index || plane.point3index == plane.point2index ||
+            Collinear(points[plane.point1index], points[plane.point2index], points[plane.point3index])) {
+            sceneData.points.push_back(MakePoint(random, options, name + "3", false));
+            plane.point3index = static_cast<int>(sceneData.points.size()) - 1;
+        }
+        plane.expand = (i % 8) == 0;
+        sceneData.planes.push_back(plane);
+    }
+
+    return sceneData;
+}
@@ -0,0 +1,24 @@
+// scenegen.h
+#pragma once
+
+#include <cstdint>
+
+#include "scene.h"
+
+// What GenerateScene builds. The same options always give the same scene, on every platform.
+struct SceneGenOptions {
+    int points = 1000;
+    int lines = 500;
+    int planes = 100;
+
+    // chance that a line or plane corner reuses an existing point instead of getting its own
+    float sharing = 0.5f;
+    // how the points spread over the quadrants I-IV, relative weights
+    float quadrantWeights[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    float extent = 100.0f; // coordinates go from -extent to extent (model units)
+    uint32_t seed = 1;
+};
+
+// Points are P1, P2..., lines r1... and planes a1..., corners made for a line or plane aren't userCreated
+SceneData GenerateScene(const SceneGenOptions& options);
@@ -0,0 +1,195 @@
+#include "alloctrack.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <new>
+
+// Nothing in here may allocate while counting: the counters are plain atomics in fixed arrays and the tag
+// names are the literals the scopes were given.
+namespace {
+    struct AtomicCounters {
+        std::atomic<uint64_t> allocations{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<uint64_t> frees{ 0 };
+    };
+
+    AtomicCounters g_current[AllocTracker::MAX_TAGS];
+    AllocTracker::Counters g_lastFrame[AllocTracker::MAX_TAGS];
+    std::atomic<int64_t> g_liveBytes{ 0 };
+
+    const char* g_tagNames[AllocTracker::MAX_TAGS] = { "other" };
+    std::atomic<int> g_tagCount{ 1 };
+    std::mutex g_tagMutex;
+
+    thread_local int t_tag = 0;
+
+    uint64_t g_frame = 0;
+    uint64_t g_budget = 0;
+    bool g_hasBudget = false;
+    uint64_t g_framesOverBudget = 0;
+    FILE* g_log = nullptr;
+
+    inline void CountAllocation(size_t size) {
+        AtomicCounters& counters = g_current[t_tag];
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.bytes.fetch_add(size, std::memory_order_relaxed);
+        g_liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    }
+
+    inline void CountFree(size_t size) {
+        g_current[t_tag].frees.fetch_add(1, std::memory_order_relaxed);
+        g_liveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+    }
+}
+
+#ifdef DIEDRICO_ALLOC_TRACKING
+// Each block carries its size in a header in front of it, so delete knows how much is freed.
+// The header keeps the alignment malloc gives.
+namespace {
+    constexpr size_t HEADER = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+    void* TrackedAlloc(size_t size) {
+        void* block = std::malloc(size + HEADER);
+        if (!block) return nullptr;
+        *static_cast<size_t*>(block) = size;
+        CountAllocation(size);
+        return static_cast<char*>(block) + HEADER;
+    }
+
+    void TrackedFree(void* pointer) {
+        if (!pointer) return;
+        void* block = static_cast<char*>(pointer) - HEADER;
+        CountFree(*static_cast<size_t*>(block));
+        std::free(block);
+    }
+
+    void* TrackedNew(size_t size) {
+        if (size == 0) size = 1;
+        while (true) {
+            if (void* pointer = TrackedAlloc(size)) return pointer;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc();
+            handler();
+        }
+    }
+}
+
+// over-aligned new and delete keep the standard versions, they never see these blocks
+void* operator new(size_t size) { return TrackedNew(size); }
+void* operator new[](size_t size) { return TrackedNew(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return TrackedAlloc(size ? size : 1); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return TrackedAlloc(size ? size : 1); }
+void operator delete(void* pointer) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+#endif
+
+namespace AllocTracker {
+    bool IsEnabled() {
+#ifdef DIEDRICO_ALLOC_TRACKING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    int RegisterTag(const char* name) {
+        std::lock_guard<std::mutex> lock(g_tagMutex);
+        const int count = g_tagCount.load();
+        for (int tag = 0; tag < count; ++tag) {
+            if (strcmp(g_tagNames[tag], name) == 0) return tag;
+        }
+        if (count == MAX_TAGS) return 0;
+        g_tagNames[count] = name;
+        g_tagCount.store(count + 1);
+        return count;
+    }
+
+    int GetTagCount() { return g_tagCount.load(); }
+    const char* GetTagName(int tag) { return g_tagNames[tag]; }
+
+    int SetThreadTag(int tag) {
+        const int previous = t_tag;
+        t_tag = tag;
+        return previous;
+    }
+
+    void EndFrame() {
+        Counters total;
+        const int count = g_tagCount.load();
+        for (int tag = 0; tag < count; ++tag) {
+            Counters& last = g_lastFrame[tag];
+            last.allocations = g_current[tag].allocations.exchange(0, std::memory_order_relaxed);
+            last.bytes = g_current[tag].bytes.exchange(0, std::memory_order_relaxed);
+            last.frees = g_current[tag].frees.exchange(0, std::memory_order_relaxed);
+            total.allocations += last.allocations;
+            total.bytes += last.bytes;
+            total.frees += last.frees;
+        }
+
+        const bool overBudget = g_hasBudget && total.allocations > g_budget;
+        if (overBudget) g_framesOverBudget++;
+
+        if (g_log) {
+            for (int tag = 0; tag < count; ++tag) {
+                const Counters& last = g_lastFrame[tag];
+                if (last.allocations == 0 && last.frees == 0) continue;
+                fprintf(g_log, "%llu,%s,%llu,%llu,%llu,%d\n", static_cast<unsigned long long>(g_frame), g_tagNames[tag],
+                        static_cast<unsigned long long>(last.allocations), static_cast<unsigned long long>(last.bytes),
+                        static_cast<unsigned long long>(last.frees), overBudget ? 1 : 0);
+            }
+        }
+        g_frame++;
+    }
+
+    uint64_t GetFrameNumber() { return g_frame; }
+    Counters GetFrameCounters(int tag) { return g_lastFrame[tag]; }
+
+    Counters GetFrameTotal() {
+        Counters total;
+        const int count = g_tagCount.load();
+        for (int tag = 0; tag < count; ++tag) {
+            total.allocations += g_lastFrame[tag].allocations;
+            total.bytes += g_lastFrame[tag].bytes;
+            total.frees += g_lastFrame[tag].frees;
+        }
+        return total;
+    }
+
+    int64_t GetLiveBytes() { return g_liveBytes.load(std::memory_order_relaxed); }
+
+    void SetBudget(uint64_t allocations, bool enabled) {
+        g_budget = allocations;
+        g_hasBudget = enabled;
+        g_framesOverBudget = 0;
+    }
+
+    bool HasBudget() { return g_hasBudget; }
+    uint64_t GetBudget() { return g_budget; }
+    uint64_t GetFramesOverBudget() { return g_framesOverBudget; }
+
+    bool StartLog(const std::string& path) {
+        StopLog();
+        g_log = fopen(path.c_str(), "w");
+        if (!g_log) {
+            std::cerr << "Failed to open allocation log for writing: " << path << std::endl;
+            return false;
+        }
+        fprintf(g_log, "frame,tag,allocations,bytes,frees,over_budget\n");
+        return true;
+    }
+
+    void StopLog() {
+        if (g_log) fclose(g_log);
+        g_log = nullptr;
+    }
+
+    bool IsLogging() { return g_log != nullptr; }
+}
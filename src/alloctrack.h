@@ -0,0 +1,69 @@
+// alloctrack.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Counts heap allocations per frame and per subsystem. With DIEDRICO_ALLOC_TRACKING (the ENABLE_ALLOC_TRACKING
+// cmake option) the global operator new/delete are replaced by counting versions, and ALLOC_SCOPE tags what the
+// calling thread allocates until the end of the block. Without it the macro is empty and every count stays zero.
+//
+//     ALLOC_SCOPE("PrepareRenderData");
+//
+// Tags are string literals, allocations outside any scope count as "other". Nested scopes count towards the
+// innermost one. The perf HUD shows the last frame, StartLog writes every frame as CSV rows (frame,tag,...).
+namespace AllocTracker {
+    constexpr int MAX_TAGS = 32; // tags past this count as "other"
+
+    struct Counters {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        uint64_t frees = 0;
+    };
+
+    bool IsEnabled(); // compiled in
+
+    int RegisterTag(const char* name); // same name, same tag
+    int GetTagCount();
+    const char* GetTagName(int tag);
+    int SetThreadTag(int tag); // returns the one it replaces
+
+    void EndFrame(); // once a frame, after the last allocation of it
+    uint64_t GetFrameNumber();
+    Counters GetFrameCounters(int tag); // the last complete frame
+    Counters GetFrameTotal();
+    int64_t GetLiveBytes(); // allocated and not freed yet, since the start
+
+    // Frames that allocate more times than this are counted and flagged in the log.
+    // SetBudget(0) is the allocation free frame goal, enabled false turns the check off.
+    void SetBudget(uint64_t allocations, bool enabled = true);
+    bool HasBudget();
+    uint64_t GetBudget();
+    uint64_t GetFramesOverBudget();
+
+    bool StartLog(const std::string& path);
+    void StopLog();
+    bool IsLogging();
+
+    class Scope {
+    public:
+        explicit Scope(int tag) : m_previous(SetThreadTag(tag)) {}
+        ~Scope() { SetThreadTag(m_previous); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        int m_previous;
+    };
+}
+
+#ifdef DIEDRICO_ALLOC_TRACKING
+    #define ALLOC_CONCAT_INNER(a, b) a##b
+    #define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+    #define ALLOC_SCOPE(name) \
+        static const int ALLOC_CONCAT(allocTag, __LINE__) = AllocTracker::RegisterTag(name); \
+        AllocTracker::Scope ALLOC_CONCAT(allocScope, __LINE__)(ALLOC_CONCAT(allocTag, __LINE__))
+#else
+    #define ALLOC_SCOPE(name) ((void)0)
+#endif
@@ -1,5 +1,7 @@
 #include "app.h"
 #include "ui.h"
+#include "trace.h"
+#include "alloctrack.h"
 
 #include <vector>
 #include <iostream>
@@ -65,12 +67,34 @@ double App::m_scrollY = 0.0;
 
 App* App::s_instance = nullptr;
 
+static const char* AUTOSAVE_PATH = "autosave.journal"; // next to the assets, deleted on a clean exit
+
 App::App() : m_window(nullptr) {
     m_ui = new UI();
     s_instance = this;
 }
 
 bool App::Initialize(int argc, char** argv) {
+    // --headless: hidden window and no autosave, for the benchmarks
+    // --record PATH: saves the input of every frame, --replay PATH plays it back and exits with frame time
+    // stats (to --replay-stats PATH, or stdout)
+    // --render-thread: GL gets a thread of its own, the main thread only handles events and builds the UI
+    std::string recordPath, replayPath;
+    bool renderThread = false;
+    for (int i = 0; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--headless") m_headless = true;
+        else if (arg == "--render-thread") renderThread = true;
+        else if (arg == "--record" && hasValue) recordPath = argv[++i];
+        else if (arg == "--replay" && hasValue) replayPath = argv[++i];
+        else if (arg == "--replay-stats" && hasValue) m_replayStatsPath = argv[++i];
+    }
+
+    m_jobs.Start();
+    m_intersections.SetJobSystem(&m_jobs);
+    GetTraceEngine().SetJobSystem(&m_jobs);
+
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW\n";
         return false;
@@ -80,6 +104,7 @@ bool App::Initialize(int argc, char** argv) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+    if (m_headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     m_window = glfwCreateWindow(DEFAULT_WIDTH, DEFAULT_HEIGHT, "Sistema Diedrico @almartdev", nullptr, nullptr);
     if (!m_window) {
@@ -89,7 +114,7 @@ bool App::Initialize(int argc, char** argv) {
     }
     UpdateWindowTitle();
 
-    glfwMaximizeWindow(m_window); // start maximized on native platforms
+    if (!m_headless && replayPath.empty()) glfwMaximizeWindow(m_window); // start maximized on native platforms
 
     glfwSetWindowUserPointer(m_window, this);
     glfwSetFramebufferSizeCallback(m_window, [](GLFWwindow* window, int width, int height) {
@@ -133,6 +158,14 @@ bool App::Initialize(int argc, char** argv) {
         std::cerr << "Failed to initialize renderer\n";
         return false;
     }
+    m_renderPackets.Start();
+    if (renderThread) {
+        m_renderThread.Start(m_window, [this](RenderFrame& frame) {
+            DrawFrame(frame);
+            TRACE_SCOPE("glfwSwapBuffers"); // waits for vsync and, on most drivers, for the GPU to catch up
+            glfwSwapBuffers(m_window);
+        });
+    }
 
     // parse command line arguments to get language
     for (int i = 0; i < argc; ++i) {
@@ -146,15 +179,64 @@ bool App::Initialize(int argc, char** argv) {
     setInitialLanguageFromURL();
     #endif
 
+    TRACE_THREAD("Main");
+
+    if (!replayPath.empty()) {
+        int width = 0, height = 0;
+        if (!m_inputRecorder.StartReplay(replayPath, m_sceneData, width, height)) return false;
+        glfwSetWindowSize(m_window, width, height); // the recorded layout only lines up in the same size
+        MarkSceneChanged();
+    }
+
+    // a benchmark or a replay must not recover or overwrite the user's journal
+    if (m_headless || m_inputRecorder.IsReplaying()) return true;
+
+    // whatever the last session left in the journal means it didn't exit cleanly
+    m_history.SetChangeHandler([this](const SceneChange& change) { m_autosave.Record(change); });
+    if (Autosave::Recover(AUTOSAVE_PATH, m_sceneData)) {
+        m_sceneData.settings.showWelcomeWindow = false;
+        MarkSceneChanged();
+    }
+    m_autosave.Start(AUTOSAVE_PATH, m_sceneData);
+
+    if (!recordPath.empty()) {
+        int width, height;
+        glfwGetWindowSize(m_window, &width, &height);
+        m_inputRecorder.StartRecording(recordPath, m_sceneData, width, height);
+    }
+
     return true;
 }
 
+void App::PollInput() {
+    glfwGetCursorPos(m_window, &m_input.mouseX, &m_input.mouseY);
+    m_input.scrollY = m_scrollY; // what the scroll callback added up since the last frame
+    m_scrollY = 0.0;
+
+    m_input.buttons = 0;
+    for (int button = 0; button <= GLFW_MOUSE_BUTTON_LAST; ++button) {
+        if (glfwGetMouseButton(m_window, button) == GLFW_PRESS) m_input.buttons |= 1u << button;
+    }
+
+    m_input.keys = 0;
+    auto key = [this](int glfwKey, uint32_t bit) {
+        if (glfwGetKey(m_window, glfwKey) == GLFW_PRESS) m_input.keys |= bit;
+    };
+    key(GLFW_KEY_LEFT_CONTROL, INPUT_KEY_CTRL);
+    key(GLFW_KEY_RIGHT_CONTROL, INPUT_KEY_CTRL);
+    key(GLFW_KEY_LEFT_SHIFT, INPUT_KEY_SHIFT);
+    key(GLFW_KEY_ESCAPE, INPUT_KEY_ESCAPE);
+    key(GLFW_KEY_S, INPUT_KEY_S);
+    key(GLFW_KEY_O, INPUT_KEY_O);
+}
+
 void App::HandleInput() {
-    double mouseX, mouseY;
-    glfwGetCursorPos(m_window, &mouseX, &mouseY);
+    TRACE_SCOPE("App::HandleInput");
+    ALLOC_SCOPE("Input");
+    const double mouseX = m_input.mouseX, mouseY = m_input.mouseY;
 
     // feedback: PEOPLE USE LEFT CLICK TO ROTATE????? 
-    if (glfwGetMouseButton(m_window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+    if (m_input.buttons & (1u << GLFW_MOUSE_BUTTON_RIGHT)) {
         if (!m_isMousePressed) {
             m_isMousePressed = true;
             m_lastMouseX = static_cast<float>(mouseX);
@@ -178,33 +260,28 @@ void App::HandleInput() {
         m_isMousePressed = false;
     }
 
-    if (glfwGetKey(m_window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || 
-        glfwGetKey(m_window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS) {
+    // the dialogs would sit there waiting for someone during a replay
+    if ((m_input.keys & INPUT_KEY_CTRL) && !m_inputRecorder.IsReplaying()) {
 
         #ifdef _WIN32 // this soultion returned "illegal hardware instruction" on linux :(
-        if (glfwGetKey(m_window, GLFW_KEY_S) == GLFW_PRESS) {
+        if (m_input.keys & INPUT_KEY_S) {
             std::string path = m_jsonHandler.SaveFileDialog();
-            m_jsonHandler.Save(path, m_sceneData);
+            SaveProject(path);
         }
-        if (glfwGetKey(m_window, GLFW_KEY_O) == GLFW_PRESS) {
-            std::string path = m_jsonHandler.OpenFileDialog();
-            std::vector<nlohmann::json> data = m_jsonHandler.Load(path);
-            if (!data.empty()) {
-                LoadProject(data);
-            }
+        if (m_input.keys & INPUT_KEY_O) {
+            OpenProject(m_jsonHandler.OpenFileDialog());
         }
         #endif
     }
 
-    if (glfwGetKey(m_window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+    if (m_input.keys & INPUT_KEY_SHIFT)
         m_renderer.SetQuadrantLabelsVisible(!m_sceneData.settings.showQuadrantLabels);
 
-    if (m_scrollY != 0) {
-        m_camera.SetDistance(m_camera.GetDistance() - static_cast<float>(m_scrollY) * .3f);
-        m_scrollY = 0.0;
+    if (m_input.scrollY != 0) {
+        m_camera.SetDistance(m_camera.GetDistance() - static_cast<float>(m_input.scrollY) * .3f);
     }
 
-    if (glfwGetKey(m_window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+    if (m_input.keys & INPUT_KEY_ESCAPE) {
         glfwSetWindowShouldClose(m_window, true);
     }
 }
@@ -215,6 +292,10 @@ void App::LoadProject(std::vector<nlohmann::json> data) {
     m_sceneData.points.clear();
     m_sceneData.lines.clear();
     m_sceneData.planes.clear();
+    m_selection.Clear();
+    m_history.Clear();
+    m_autosave.Reset(); // the journal restarts from the loaded project on the next flush
+    MarkSceneChanged();
 
     auto getFloat = [](const nlohmann::json& j, const std::string& key, float def = 0.0f) {
         return j.contains(key) ? j[key].get<float>() : def;
@@ -347,63 +428,281 @@ void App::LoadProject(std::vector<nlohmann::json> data) {
     }
 }
 
-void App::PrepareRenderData() { // change from float[3] coords to glm::vec3
-    std::vector<char*> pointNames, lineNames, planeNames;
+void App::PrepareRenderData(const RenderFrame& frame, float pointScale) {
+    TRACE_SCOPE("App::PrepareRenderData");
+    ALLOC_SCOPE("PrepareRenderData");
+    if (!frame.packet) return;
+    const RenderPacket& packet = *frame.packet;
+    const float pointSize = frame.pointSize * pointScale;
+
+    m_renderer.DrawPoints(packet.pointLabels, packet.pointPositions, packet.pointColors, pointSize);
+    m_renderer.DrawLines(packet.lineLabels, packet.linePositions, packet.lineColors, frame.lineThickness);
+    m_renderer.DrawPlanes(packet.planeLabels, packet.planePositions, packet.planeColors, packet.planeExpand, frame.planeOpacity);
+    m_renderer.DrawMarkers(packet.markerPositions, packet.markerColors, pointSize);
+
+    if (frame.showIntersections) { // the packet may still have them for a frame after they're hidden
+        m_renderer.DrawMarkers(packet.piercingPositions, packet.piercingColors, pointSize);
+        m_renderer.DrawLines(packet.intersectionLabels, packet.intersectionPositions, packet.intersectionColors, frame.lineThickness);
+    }
+}
 
-    float worldScale = m_sceneData.settings.worldScale;
+void App::RequestRenderPacket() {
+    TRACE_SCOPE("App::RequestRenderPacket");
+    if (m_renderPackets.IsBusy()) return; // still on the last one, the snapshot would be thrown away
 
-    std::vector<glm::vec3> pointPositions, pointColors;
-    for (const auto& point : m_sceneData.points) {
-        if (point.hidden) continue;
-        pointNames.push_back(const_cast<char*>(point.name.c_str()));
-        pointPositions.emplace_back(point.coords[0]/worldScale, point.coords[2]/worldScale, point.coords[1]/worldScale);
-        pointColors.emplace_back(point.color[0], point.color[1], point.color[2]);
+    // the engine only replaces what it shares, the worker can keep this one as long as it likes
+    std::shared_ptr<const IntersectionResults> intersections;
+    if (m_sceneData.settings.showIntersections) intersections = m_intersections.GetSharedResults();
+    m_renderPackets.Request(TakeSnapshot(), std::move(intersections));
+}
+
+void App::CollectRenderFrame(RenderFrame& frame) {
+    TRACE_SCOPE("App::CollectRenderFrame");
+    // only reads, through a const reference: indexing the scene non-const would un-share the chunks the packet
+    // worker (or a save) still holds and copy them
+    const SceneData& scene = m_sceneData;
+    const auto& settings = scene.settings;
+
+    frame.view = m_renderer.GetView();
+    frame.background = glm::vec3(settings.backgroundColor[0], settings.backgroundColor[1], settings.backgroundColor[2]);
+    frame.vsync = settings.VSync && !m_inputRecorder.IsReplaying(); // a replay measures the frames, not the display
+
+    frame.packet = m_renderPackets.GetFront();
+    frame.pointSize = settings.pointSize;
+    frame.lineThickness = settings.lineThickness;
+    frame.planeOpacity = settings.planeOpacity;
+    frame.showIntersections = settings.showIntersections;
+
+    float worldScale = settings.worldScale;
+    if (!m_selection.Empty()) {
+        TRACE_SCOPE("Selection halos");
+        // selected points (and the points of selected lines and planes) get a blue halo
+        std::vector<int> selectedPoints;
+        m_selection.CollectPoints(scene, selectedPoints);
+
+        std::vector<glm::vec3> haloPositions, haloColors, pointColors;
+        for (int index : selectedPoints) {
+            const auto& point = scene.points[index];
+            if (point.hidden) continue;
+            haloPositions.emplace_back(point.coords[0]/worldScale, point.coords[2]/worldScale, point.coords[1]/worldScale);
+            haloColors.emplace_back(0.3f, 0.55f, 1.0f);
+            pointColors.emplace_back(point.color[0], point.color[1], point.color[2]);
+        }
+        frame.overlay.push_back({ haloPositions, std::move(haloColors), settings.pointSize * 1.8f });
+        frame.overlay.push_back({ std::move(haloPositions), std::move(pointColors), settings.pointSize });
     }
 
-    std::vector<std::pair<glm::vec3, glm::vec3>> linePositions;
-    std::vector<glm::vec3> lineColors;
-    for (const auto& line : m_sceneData.lines) {
-        lineNames.push_back(const_cast<char*>(line.name.c_str()));
+    if (m_hoveredPoint >= 0) {
+        // halo first, then the point again on top of it
+        const auto& point = scene.points[m_hoveredPoint];
+        glm::vec3 position(point.coords[0]/worldScale, point.coords[2]/worldScale, point.coords[1]/worldScale);
 
-        const auto& point1 = m_sceneData.points[line.point1index];
-        const auto& point2 = m_sceneData.points[line.point2index];
+        frame.overlay.push_back({ { position }, { glm::vec3(1.0f) }, settings.pointSize * 2.0f });
+        frame.overlay.push_back({ { position }, { glm::vec3(point.color[0], point.color[1], point.color[2]) }, settings.pointSize });
+    }
 
-        linePositions.emplace_back(
-            glm::vec3(point1.coords[0]/worldScale, point1.coords[2]/worldScale, point1.coords[1]/worldScale),
-            glm::vec3(point2.coords[0]/worldScale, point2.coords[2]/worldScale, point2.coords[1]/worldScale)
-        );
-        lineColors.emplace_back(line.color[0], line.color[1], line.color[2]);
+    if (m_imageExportPending) {
+        m_imageExportPending = false;
+        frame.imageExportPath = m_imageExport.path;
+        frame.imageExportWidth = m_imageExport.width;
+        frame.imageExportHeight = m_imageExport.height;
     }
+}
 
-    std::vector<std::vector<glm::vec3>> planePositions;
-    std::vector<glm::vec3> planeColors;
-    std::vector<bool> planeExpand;
+void App::DrawFrame(RenderFrame& frame) {
+    TRACE_SCOPE("App::DrawFrame");
+    glfwSwapInterval(frame.vsync ? 1 : 0);
+    ImGui_ImplOpenGL3_NewFrame(); // creates the backend's GL objects the first time
 
-    for (const auto& plane : m_sceneData.planes) {
-        planeNames.push_back(const_cast<char*>(plane.name.c_str()));
+    m_renderer.BeginFrame(frame.view);
+    glClearColor(frame.background.r, frame.background.g, frame.background.b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    m_renderer.Render(); // DRAWS 3D BASE
+    PrepareRenderData(frame); // DRAWS 3D SCENE
+    for (const auto& markers : frame.overlay) m_renderer.DrawMarkers(markers.positions, markers.colors, markers.size);
 
-        const auto& point1 = m_sceneData.points[plane.point1index];
-        const auto& point2 = m_sceneData.points[plane.point2index];
-        const auto& point3 = m_sceneData.points[plane.point3index];
+    if (!frame.imageExportPath.empty()) {
+        bool exported = m_renderer.ExportTiledImage(frame.imageExportPath, frame.imageExportWidth, frame.imageExportHeight,
+            frame.background, [this, &frame](float pointScale) { PrepareRenderData(frame, pointScale); });
 
-        planePositions.push_back({
-            glm::vec3(point1.coords[0]/worldScale, point1.coords[2]/worldScale, point1.coords[1]/worldScale),
-            glm::vec3(point2.coords[0]/worldScale, point2.coords[2]/worldScale, point2.coords[1]/worldScale),
-            glm::vec3(point3.coords[0]/worldScale, point3.coords[2]/worldScale, point3.coords[1]/worldScale)
-        });
-        planeColors.emplace_back(plane.color[0], plane.color[1], plane.color[2]);
+        if (exported) {
+            OfferDownload(frame.imageExportPath, "image/png");
+        }
+    }
+    m_renderer.EndFrame();
+
+    {
+        TRACE_SCOPE("ImGui_ImplOpenGL3_RenderDrawData");
+        GpuScope gpuScope(m_renderer.GetGpuTimer(), GpuPass::ImGui);
+        ImGui_ImplOpenGL3_RenderDrawData(frame.drawData.get());
+    }
+}
+
+void App::UpdateHoveredPoint() {
+    TRACE_SCOPE("App::UpdateHoveredPoint");
+    ALLOC_SCOPE("Selection");
+    m_hoveredPoint = -1;
+    if (ImGui::GetIO().WantCaptureMouse) return; // over a window, not the 3D view
+
+    glm::vec3 origin, dir;
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    m_renderer.ScreenToRay(glm::vec2(mouse.x, mouse.y), origin, dir);
+
+    // world is (d, c, a) / worldScale, the index is in model units
+    float worldScale = m_sceneData.settings.worldScale;
+    const float rayOrigin[3] = { origin.x * worldScale, origin.z * worldScale, origin.y * worldScale };
+    const float rayDir[3] = { dir.x, dir.z, dir.y };
+    m_hoveredPoint = m_pointIndex.NearestToRay(rayOrigin, rayDir, m_sceneData.settings.snapRadius);
+}
+
+void App::UpdateBoxSelect() {
+    TRACE_SCOPE("App::UpdateBoxSelect");
+    ALLOC_SCOPE("Selection");
+    const ImGuiIO& io = ImGui::GetIO();
+    glm::vec2 mouse(io.MousePos.x, io.MousePos.y);
+    bool additive = io.KeyShift || io.KeyCtrl;
+
+    if (!m_boxSelecting) {
+        // windows and the guizmo get the click first
+        if (!ImGui::IsMouseClicked(ImGuiMouseButton_Left) || io.WantCaptureMouse || ImGuizmo::IsOver() || ImGuizmo::IsUsing()) return;
+        m_boxSelecting = true;
+        m_boxStart = mouse;
+    }
+
+    glm::vec2 boxMin = glm::min(m_boxStart, mouse);
+    glm::vec2 boxMax = glm::max(m_boxStart, mouse);
+    bool dragged = boxMax.x - boxMin.x > 4.0f || boxMax.y - boxMin.y > 4.0f;
+
+    if (ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+        if (dragged) {
+            ImDrawList* drawList = ImGui::GetForegroundDrawList();
+            drawList->AddRectFilled(ImVec2(boxMin.x, boxMin.y), ImVec2(boxMax.x, boxMax.y), IM_COL32(80, 140, 255, 40));
+            drawList->AddRect(ImVec2(boxMin.x, boxMin.y), ImVec2(boxMax.x, boxMax.y), IM_COL32(80, 140, 255, 200));
+        }
+        return;
+    }
+    m_boxSelecting = false;
 
-        planeExpand.push_back(plane.expand);
+    if (!dragged) {
+        // plain click: the hovered point, or nothing
+        if (m_hoveredPoint >= 0) m_selection.Click(EntityKind::Point, m_hoveredPoint, additive);
+        else if (!additive) m_selection.Clear();
+        return;
     }
 
-    m_renderer.DrawPoints(pointNames, pointPositions, pointColors, m_sceneData.settings.pointSize);
-    m_renderer.DrawLines(lineNames, linePositions, lineColors, m_sceneData.settings.lineThickness, m_camera);
-    m_renderer.DrawPlanes(planeNames, planePositions, planeColors, planeExpand, m_sceneData.settings.planeOpacity);
+    if (!additive) m_selection.Clear();
+
+    const SceneData& scene = m_sceneData; // reads only, see CollectRenderFrame
+    float worldScale = scene.settings.worldScale;
+    glm::mat4 view = m_camera.GetViewMatrix();
+    std::vector<uint8_t> inside(scene.points.size(), 0);
+    for (size_t i = 0; i < scene.points.size(); ++i) {
+        const auto& point = scene.points[i];
+        if (point.hidden) continue;
+
+        glm::vec3 position(point.coords[0]/worldScale, point.coords[2]/worldScale, point.coords[1]/worldScale);
+        if ((view * glm::vec4(position, 1.0f)).z >= 0.0f) continue; // behind the camera
+
+        glm::vec2 screen = m_renderer.WorldToScreen(position);
+        if (screen.x < boxMin.x || screen.x > boxMax.x || screen.y < boxMin.y || screen.y > boxMax.y) continue;
+        inside[i] = 1;
+    }
+    m_selection.AddBoxed(scene, inside);
+}
+
+void App::RequestImageExport(const std::string& path, int width, int height) {
+    m_imageExport.path = path;
+    m_imageExport.width = width;
+    m_imageExport.height = height;
+    m_imageExportPending = true;
 }
 
-void App::DeletePoint(Point& point) { // this isnt good
+void App::DeletePoint(int index) { // this isnt good
+    if (index < 0 || index >= static_cast<int>(m_sceneData.points.size())) return;
+    m_history.Begin(m_sceneData);
+    m_history.Touch(m_sceneData, EntityKind::Point, index);
+    auto& point = m_sceneData.points[index];
     point.hidden = true;
     point.name = "deleted";
+    m_history.Commit(m_sceneData);
+    MarkSceneChanged();
+}
+
+void App::DeleteLine(int index) {
+    if (index < 0 || index >= static_cast<int>(m_sceneData.lines.size())) return;
+    const Line line = m_sceneData.lines[index];
+    m_history.Begin(m_sceneData);
+    m_history.Erasing(m_sceneData, EntityKind::Line, index);
+    m_sceneData.lines.erase(m_sceneData.lines.begin() + index);
+    m_selection.OnErased(EntityKind::Line, index);
+
+    for (int p : { line.point1index, line.point2index }) {
+        if (p < 0 || p >= static_cast<int>(m_sceneData.points.size())) continue;
+        m_history.Touch(m_sceneData, EntityKind::Point, p);
+        auto& point = m_sceneData.points[p];
+        if (!point.userCreated) {
+            point.hidden = true;
+            point.name = "deleted";
+        } else {
+            point.hidden = false;
+        }
+    }
+    m_history.Commit(m_sceneData);
+    MarkSceneChanged();
+}
+
+void App::DeletePlane(int index) {
+    if (index < 0 || index >= static_cast<int>(m_sceneData.planes.size())) return;
+    const Plane plane = m_sceneData.planes[index];
+    m_history.Begin(m_sceneData);
+    m_history.Erasing(m_sceneData, EntityKind::Plane, index);
+    m_sceneData.planes.erase(m_sceneData.planes.begin() + index);
+    m_selection.OnErased(EntityKind::Plane, index);
+
+    for (int p : { plane.point1index, plane.point2index, plane.point3index }) {
+        if (p < 0 || p >= static_cast<int>(m_sceneData.points.size())) continue;
+        m_history.Touch(m_sceneData, EntityKind::Point, p);
+        auto& point = m_sceneData.points[p];
+        if (!point.userCreated) {
+            point.hidden = true;
+            point.name = "deleted";
+        } else {
+            point.hidden = false;
+        }
+    }
+    m_history.Commit(m_sceneData);
+    MarkSceneChanged();
+}
+
+void App::DeleteSelection() {
+    // highest index first so the rest don't shift, lines and planes before the points they might bring back
+    std::vector<int> lines = m_selection.Get(EntityKind::Line);
+    std::vector<int> planes = m_selection.Get(EntityKind::Plane);
+    std::vector<int> points = m_selection.Get(EntityKind::Point);
+    std::sort(lines.rbegin(), lines.rend());
+    std::sort(planes.rbegin(), planes.rend());
+
+    m_history.Begin(m_sceneData); // one undo step for the whole selection
+    for (int index : lines) DeleteLine(index);
+    for (int index : planes) DeletePlane(index);
+    for (int index : points) DeletePoint(index);
+    m_history.Commit(m_sceneData);
+    m_selection.Clear();
+}
+
+bool App::Undo() {
+    if (!m_history.Undo(m_sceneData)) return false;
+    m_selection.EndTransform(); // the selection stays, Validate drops what isn't there anymore
+    MarkSceneChanged();
+    return true;
+}
+
+bool App::Redo() {
+    if (!m_history.Redo(m_sceneData)) return false;
+    m_selection.EndTransform();
+    MarkSceneChanged();
+    return true;
 }
 
 void App::Run() {
@@ -413,16 +712,21 @@ void App::Run() {
 }
 
 void App::Frame() {
-    glfwPollEvents();
-        
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
+    TRACE_SCOPE("App::Frame");
+    const auto frameStart = std::chrono::steady_clock::now();
+    if (m_frameStart.time_since_epoch().count() != 0) {
+        m_frameTimes.Add(std::chrono::duration<float, std::milli>(frameStart - m_frameStart).count());
+    }
+    m_frameStart = frameStart;
 
-    if (m_sceneData.settings.VSync) {
-        glfwSwapInterval(1);
-    } else {
-        glfwSwapInterval(0);
+    {
+        TRACE_SCOPE("ImGui::NewFrame");
+        glfwPollEvents();
+        PollInput();
+
+        ImGui_ImplGlfw_NewFrame(); // the GL backend's NewFrame is in DrawFrame, wherever the context is
+        m_inputRecorder.Process(m_input); // the backend has queued this frame's events, ImGui hasn't read them yet
+        ImGui::NewFrame();
     }
 
     // Get the display size first (this is crucial for Emscripten)
@@ -445,36 +749,168 @@ void App::Frame() {
 #endif
 
     HandleInput();
-
-    glClearColor(
-        m_sceneData.settings.backgroundColor[0], 
-        m_sceneData.settings.backgroundColor[1], 
-        m_sceneData.settings.backgroundColor[2], 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     // Get the framebuffer size (should match display size)
     int width, height;
     glfwGetFramebufferSize(m_window, &width, &height);
-    m_renderer.UpdateCamera(m_camera, width, height);
-
-    glViewport(m_sceneData.settings.offset[0], m_sceneData.settings.offset[1], width, height);
+    m_renderer.UpdateCamera(m_camera, static_cast<int>(m_sceneData.settings.offset[0]), static_cast<int>(m_sceneData.settings.offset[1]),
+        width, height);
+
+    if (m_openJob && m_openJob->IsDone()) {
+        if (!m_openData->empty()) {
+            m_sceneData.settings.loadedFileName = m_openPath.substr(m_openPath.find_last_of("\\/") + 1);
+            LoadProject(std::move(*m_openData));
+            std::cout << "Loaded file: " << m_openPath << std::endl;
+        }
+        m_openJob.reset();
+        m_openData.reset();
+    }
 
+    m_selection.Validate(m_sceneData); // before anything reads it, deletes from last frame are gone by now
     m_ui->DrawUI(*this); // DRAWS UI
+
+    // derived geometry, only what depends on something that changed this frame gets recomputed
+    bool showIntersections = m_sceneData.settings.showIntersections;
+    if (m_dependencies.Sync(m_sceneData)) {
+        m_sceneRevision++;
+        TraceEngine& traces = GetTraceEngine();
+        VisibilitySolver& visibility = GetVisibilitySolver();
+        m_dependencies.Evaluate([&](NodeKind kind, int index) {
+            switch (kind) {
+                case NodeKind::Point: m_pointClasses.Invalidate(index); break;
+                case NodeKind::LineTraces: traces.InvalidateLine(index); visibility.InvalidateLine(index); break;
+                case NodeKind::PlaneTraces: traces.InvalidatePlane(index); visibility.InvalidatePlanes(); break;
+                case NodeKind::LineIntersections: if (showIntersections) m_intersections.InvalidateLine(index); break;
+                case NodeKind::PlaneIntersections: if (showIntersections) m_intersections.InvalidatePlane(index); break;
+                default: break; // lines and planes themselves have nothing to compute
+            }
+        });
+    }
+
+    m_pointClasses.Update(m_sceneData);
+
+    if (showIntersections) {
+        m_intersections.SetVolume(m_sceneData.settings.worldScale);
+        m_intersections.Update(m_sceneData);
+        m_dihedralViewport.SetIntersections(&m_intersections.GetResults());
+    } else {
+        m_intersections.InvalidateAll(); // nothing is tracked while hidden, start over when shown again
+        m_dihedralViewport.SetIntersections(nullptr);
+    }
+
+    m_pointIndex.Sync(m_sceneData);
+    m_renderer.SetSnapping(m_sceneData.settings.snapToPoints ? &m_pointIndex : nullptr, m_sceneData.settings.snapRadius);
+    UpdateHoveredPoint();
+    UpdateBoxSelect();
+
     m_dihedralViewport.Draw(*this); // DRAWS DIHEDRAL VIEWPORT (AS A UI WINDOW)
-    m_renderer.Render(); // DRAWS 3D BASE
-    PrepareRenderData(); // DRAWS 3D SCENE
+    m_renderer.DrawLabels(); // of the last frame drawn, the 3D view on screen is that one too
+    m_renderPackets.Acquire(); // whatever the worker finished since last frame
+    RequestRenderPacket(); // next frame's packet gets built while this one is drawn and presented
+
+    if (m_hoveredPoint >= 0) {
+        const SceneData& scene = m_sceneData; // the packet worker holds the scene now, reads go through const
+        const auto& point = scene.points[m_hoveredPoint];
+        ImGui::SetTooltip("%s (%.2f, %.2f, %.2f)", point.name.c_str(), point.coords[0], point.coords[1], point.coords[2]);
+    }
+
+    m_autosave.Flush(m_sceneData); // this frame's edits go to the journal writer
 
     //labels
     m_renderer.SetQuadrantLabelsVisible(m_sceneData.settings.showQuadrantLabels);
     m_renderer.SetLabelsVisible(m_sceneData.settings.showLabels);
 
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        
-    glfwSwapBuffers(m_window);
+    RenderFrame frame;
+    CollectRenderFrame(frame);
+    {
+        TRACE_SCOPE("ImGui::Render");
+        ALLOC_SCOPE("ImGui render");
+        ImGui::Render();
+    }
+
+    if (m_renderThread.IsRunning()) {
+        frame.drawData = RenderThread::CopyDrawData(ImGui::GetDrawData()); // the next NewFrame reuses ImGui's
+        m_renderThread.Submit(std::move(frame));
+    } else {
+        frame.drawData = std::shared_ptr<ImDrawData>(ImGui::GetDrawData(), [](ImDrawData*) {}); // ImGui's own, drawn right away
+        DrawFrame(frame);
+    }
+
+    m_cpuTimes.Add(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+    if (m_inputRecorder.IsReplaying()) {
+        if (m_inputRecorder.IsFinished()) glfwSetWindowShouldClose(m_window, true);
+        else m_inputRecorder.AddFrameTimes(m_frameTimes.GetLatest(), m_cpuTimes.GetLatest());
+    }
+    if (!m_renderThread.IsRunning()) {
+        TRACE_SCOPE("glfwSwapBuffers"); // waits for vsync and, on most drivers, for the GPU to catch up
+        glfwSwapBuffers(m_window);
+    }
+    AllocTracker::EndFrame();
+}
+
+void App::SaveProject(const std::string& path) {
+    if (path.empty()) return;
+
+#ifdef __EMSCRIPTEN__
+    m_jsonHandler.Save(path, m_sceneData); // the download goes through the browser, stays on this thread
+#else
+    m_jobs.Wait(m_saveJob); // two saves to the same file mustn't interleave
+
+    SceneSnapshot snapshot = TakeSnapshot();
+    m_saveJob = m_jobs.Submit([this, path, snapshot]() {
+        TRACE_SCOPE("JsonHandler::Save");
+        m_jsonHandler.Save(path, *snapshot);
+    });
+#endif
+}
+
+void App::OpenProject(const std::string& path) {
+    if (path.empty() || m_openJob) return; // one at a time
+
+    m_openPath = path;
+    m_openData = std::make_shared<std::vector<nlohmann::json>>();
+    auto data = m_openData;
+    m_openJob = m_jobs.Submit([this, path, data]() {
+        TRACE_SCOPE("JsonHandler::Load");
+        std::string file = path;
+        *data = m_jsonHandler.Load(file);
+    });
+}
+
+void App::ExportSheet(const std::string& path, bool pdf) {
+    std::shared_ptr<const IntersectionResults> intersections;
+    if (m_sceneData.settings.showIntersections) intersections = m_intersections.GetSharedResults(); // as in RequestRenderPacket
+    SceneSnapshot snapshot = TakeSnapshot();
+
+    auto exportSheet = [this, path, pdf, snapshot, intersections]() {
+        TRACE_SCOPE("SheetExporter::Export");
+        m_sheetExporter.SetIntersections(intersections.get());
+        bool ok = pdf ? m_sheetExporter.ExportPDF(*snapshot, path) : m_sheetExporter.ExportSVG(*snapshot, path);
+        m_sheetExporter.SetIntersections(nullptr);
+        if (!ok) {
+            std::cerr << m_sheetExporter.GetLastError() << std::endl;
+            return;
+        }
+        std::cout << "Exported sheet: " << path << std::endl;
+        OfferDownload(path, pdf ? "application/pdf" : "image/svg+xml");
+    };
+
+#ifdef __EMSCRIPTEN__
+    exportSheet(); // the download goes through the browser, stays on this thread
+#else
+    m_jobs.Wait(m_exportJob);
+    m_exportJob = m_jobs.Submit(exportSheet);
+#endif
 }
 
 void App::Shutdown() {
+    m_jobs.Stop(); // saves and exports still running get to finish
+    m_autosave.Stop(); // clean exit, nothing to recover next time
+    m_renderThread.Stop(); // the context comes back here, the ImGui backend deletes its GL objects
+    m_renderPackets.Stop();
+    if (m_inputRecorder.IsReplaying()) m_inputRecorder.WriteStats(m_replayStatsPath);
+    m_inputRecorder.Stop();
+
     if (m_ui) {
         m_ui->ShutdownImGui();
     }
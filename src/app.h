@@ -5,8 +5,23 @@
 #include "camera.h"
 #include "json.h"
 #include "dihedral.h"
+#include "exporter.h"
+#include "intersections.h"
+#include "depgraph.h"
+#include "octree.h"
+#include "pointclass.h"
+#include "selection.h"
+#include "history.h"
+#include "autosave.h"
+#include "framestats.h"
+#include "inputrec.h"
+#include "jobs.h"
+#include "renderpacket.h"
+#include "renderthread.h"
 #include "scene.h"
 
+#include <chrono>
+
 class UI;
 
 #ifdef __EMSCRIPTEN__
@@ -30,6 +45,7 @@ public:
 
     GLFWwindow* GetWindow() const { return m_window; }
     SceneData& GetSceneData() { return m_sceneData; }
+    const SceneData& GetSceneData() const { return m_sceneData; } // reads, never un-shares a chunk
     Camera& GetCamera() { return m_camera; }
     Renderer& GetRenderer() { return m_renderer; }
     UI& GetUI() { return *m_ui; }
@@ -42,21 +58,71 @@ public:
 
     void SetSceneData(const SceneData& sceneData) { // in case we open a new project we get rid of the old one
         m_sceneData = sceneData;
+        m_selection.Clear();
+        m_history.Clear();
+        m_autosave.Reset();
+        MarkSceneChanged();
     }
 
+    void PollInput(); // fills this frame's InputState from GLFW, HandleInput reads that instead of GLFW
     void HandleInput();
-    void PrepareRenderData();
+    // Draws the frame's render packet, the scene as it was a frame ago (the worker builds the next one meanwhile)
+    void PrepareRenderData(const RenderFrame& frame, float pointScale = 1.0f);
+    void RequestRenderPacket(); // hands this frame's scene to the packet worker
+    void CollectRenderFrame(RenderFrame& frame); // all of it but the ImGui draw data, once the UI is built
+    void DrawFrame(RenderFrame& frame); // the GL half of a frame, on the render thread with --render-thread
+    void UpdateHoveredPoint();
+    void UpdateBoxSelect(); // click and drag selection in the 3D view
+
+    // Exports are queued and run inside Frame, once the camera for this frame is set up
+    void RequestImageExport(const std::string& path, int width, int height);
 
     int GetWindowWidth() const { return m_windowWidth; }
     int GetWindowHeight() const { return m_windowHeight; }
 
     JsonHandler& GetJsonHandler() { return m_jsonHandler; }
+    SheetExporter& GetSheetExporter() { return m_sheetExporter; }
+    TraceEngine& GetTraceEngine() { return m_dihedralViewport.GetTraceEngine(); }
+    VisibilitySolver& GetVisibilitySolver() { return m_dihedralViewport.GetVisibilitySolver(); }
+    IntersectionEngine& GetIntersections() { return m_intersections; }
+    DependencyGraph& GetDependencies() { return m_dependencies; }
+    // Bumped whenever the scene changes, caches built from the scene compare against it
+    uint64_t GetSceneRevision() const { return m_sceneRevision; }
+    void MarkSceneChanged() { m_sceneRevision++; m_listRevision++; } // for edits the dependency graph doesn't see (hiding, renaming, colors)
+    // Only bumped when names, hidden flags or which points an entity is built on change, or entities are added
+    // or removed, so lists that show names don't rebuild while points are dragged. Both counters only grow.
+    uint64_t GetListRevision() const { return m_listRevision + m_dependencies.GetStructureRevision(); }
+
+    const PointOctree& GetPointIndex() const { return m_pointIndex; }
+    const PointClassifier& GetPointClasses() const { return m_pointClasses; }
+    int GetHoveredPoint() const { return m_hoveredPoint; } // -1 when the mouse isn't over a point in the 3D view
+    Selection& GetSelection() { return m_selection; }
+    History& GetHistory() { return m_history; }
+    bool Undo();
+    bool Redo();
+    Autosave& GetAutosave() { return m_autosave; }
+    JobSystem& GetJobs() { return m_jobs; }
+    bool IsHeadless() const { return m_headless; }
+    InputRecorder& GetInputRecorder() { return m_inputRecorder; }
+    const FrameTimeStats& GetFrameTimes() const { return m_frameTimes; } // start of a frame to the start of the next
+    const FrameTimeStats& GetCpuTimes() const { return m_cpuTimes; }     // CPU work of a frame, without the swap
     
     static double m_scrollY;
 
     void LoadProject(std::vector<nlohmann::json> data);
+    // Reads and parses the file on a job, the project replaces the scene on the first frame after it's done
+    void OpenProject(const std::string& path);
+    // Writes the project from a snapshot on a job, the scene can keep changing meanwhile
+    void SaveProject(const std::string& path);
+    // Same for the SVG or PDF of the sheet
+    void ExportSheet(const std::string& path, bool pdf);
+    // Constant time copy of the scene that later edits don't reach, safe to read from another thread
+    SceneSnapshot TakeSnapshot() const { return std::make_shared<const SceneData>(m_sceneData); }
     
-    void DeletePoint(Point& point);
+    void DeletePoint(int index); // hidden, not erased, lines and planes keep their indices
+    void DeleteLine(int index);  // its points go too, unless the user made them
+    void DeletePlane(int index);
+    void DeleteSelection();
 private:
     // ui class
     UI* m_ui;
@@ -65,9 +131,36 @@ private:
     Renderer m_renderer;
     Camera m_camera;
     JsonHandler m_jsonHandler;
+    SheetExporter m_sheetExporter;
     DihedralViewport m_dihedralViewport;
+    IntersectionEngine m_intersections;
+    DependencyGraph m_dependencies;
+    PointOctree m_pointIndex; // visible points, for snapping, hovering and region queries
+    int m_hoveredPoint = -1;
+    Selection m_selection;
+    History m_history; // undo and redo of scene edits
+    Autosave m_autosave; // follows the history into a journal on disk, for crashes
+    bool m_boxSelecting = false;
+    glm::vec2 m_boxStart = glm::vec2(0.0f);
+    PointClassifier m_pointClasses; // quadrant, projection plane and bisector bits of every point
+    RenderPacketBuilder m_renderPackets; // what PrepareRenderData draws, built on a worker
+    RenderThread m_renderThread; // --render-thread, otherwise frames are drawn inside Frame
+    uint64_t m_sceneRevision = 0;
+    uint64_t m_listRevision = 0;
+
+    FrameTimeStats m_frameTimes;
+    FrameTimeStats m_cpuTimes;
+    InputState m_input;
+    InputRecorder m_inputRecorder; // --record / --replay
+    std::string m_replayStatsPath; // stdout when empty
+    std::chrono::steady_clock::time_point m_frameStart;
 
     SceneData m_sceneData;
+    JobHandle m_saveJob;   // the last background save, waited for before the next one
+    JobHandle m_exportJob; // same for sheet exports, they share m_sheetExporter
+    JobHandle m_openJob;
+    std::string m_openPath;
+    std::shared_ptr<std::vector<nlohmann::json>> m_openData; // what m_openJob parsed
 
     const int DEFAULT_WIDTH = 1920;
     const int DEFAULT_HEIGHT = 1080;
@@ -78,4 +171,16 @@ private:
     float m_lastMouseX = 0;
     float m_lastMouseY = 0;
     bool m_jsonLoaded = false;
+    bool m_headless = false;
+
+    struct ImageExportRequest {
+        std::string path;
+        int width = 0;
+        int height = 0;
+    };
+    bool m_imageExportPending = false;
+    ImageExportRequest m_imageExport;
+
+    // last, so it's destroyed first: the destructor finishes what's queued while everything jobs use still exists
+    JobSystem m_jobs;
 };
\ No newline at end of file
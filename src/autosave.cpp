@@ -0,0 +1,415 @@
+#include "autosave.h"
+#include "trace.h"
+#include "alloctrack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char MAGIC[4] = { 'D', 'J', 'N', 'L' };
+    const uint32_t VERSION = 1;
+    const size_t MIN_COMPACT_BYTES = 256 * 1024; // small scenes aren't worth rewriting on every few edits
+
+    enum Record : uint8_t { RecordSnapshot, RecordSet, RecordInsert, RecordErase };
+
+    uint32_t Checksum(const uint8_t* data, size_t size) { // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= data[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    void Put(std::vector<uint8_t>& out, const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    void PutString(std::vector<uint8_t>& out, const std::string& text) {
+        Put(out, static_cast<uint32_t>(text.size()));
+        out.insert(out.end(), text.begin(), text.end());
+    }
+
+    void PutEntity(std::vector<uint8_t>& out, const Point& point) {
+        PutString(out, point.name);
+        Put(out, point.coords);
+        Put(out, point.color);
+        Put(out, static_cast<uint8_t>((point.hidden ? 1 : 0) | (point.userCreated ? 2 : 0)));
+    }
+
+    void PutEntity(std::vector<uint8_t>& out, const Line& line) {
+        PutString(out, line.name);
+        Put(out, line.point1index);
+        Put(out, line.point2index);
+        Put(out, line.color);
+        Put(out, static_cast<uint8_t>(line.showVisibility ? 1 : 0));
+    }
+
+    void PutEntity(std::vector<uint8_t>& out, const Plane& plane) {
+        PutString(out, plane.name);
+        Put(out, plane.point1index);
+        Put(out, plane.point2index);
+        Put(out, plane.point3index);
+        Put(out, plane.color);
+        Put(out, static_cast<uint8_t>(plane.expand ? 1 : 0));
+    }
+
+    template <typename Entities>
+    void PutEntities(std::vector<uint8_t>& out, const Entities& entities) {
+        Put(out, static_cast<uint32_t>(entities.size()));
+        for (const auto& entity : entities) PutEntity(out, entity);
+    }
+
+    // bounds checked reads, anything past the end leaves ok false and the rest of the reads do nothing
+    struct Reader {
+        const uint8_t* data;
+        size_t size;
+        size_t pos = 0;
+        bool ok = true;
+
+        template <typename T>
+        void Get(T& value) {
+            if (!ok || size - pos < sizeof(T)) { ok = false; return; }
+            memcpy(&value, data + pos, sizeof(T));
+            pos += sizeof(T);
+        }
+
+        void GetString(std::string& text) {
+            uint32_t length = 0;
+            Get(length);
+            if (!ok || size - pos < length) { ok = false; return; }
+            text.assign(reinterpret_cast<const char*>(data + pos), length);
+            pos += length;
+        }
+
+        void GetEntity(Point& point) {
+            uint8_t flags = 0;
+            GetString(point.name);
+            Get(point.coords);
+            Get(point.color);
+            Get(flags);
+            point.hidden = flags & 1;
+            point.userCreated = (flags & 2) != 0;
+        }
+
+        void GetEntity(Line& line) {
+            uint8_t flags = 0;
+            GetString(line.name);
+            Get(line.point1index);
+            Get(line.point2index);
+            Get(line.color);
+            Get(flags);
+            line.showVisibility = flags & 1;
+        }
+
+        void GetEntity(Plane& plane) {
+            uint8_t flags = 0;
+            GetString(plane.name);
+            Get(plane.point1index);
+            Get(plane.point2index);
+            Get(plane.point3index);
+            Get(plane.color);
+            Get(flags);
+            plane.expand = flags & 1;
+        }
+
+        template <typename Entities>
+        void GetEntities(Entities& entities) {
+            uint32_t count = 0;
+            Get(count);
+            entities.clear();
+            for (uint32_t i = 0; i < count && ok; ++i) {
+                typename Entities::value_type entity;
+                GetEntity(entity);
+                entities.push_back(std::move(entity));
+            }
+        }
+    };
+
+    template <typename Entities>
+    bool ApplyRecord(Reader& reader, Entities& entities, uint8_t type, uint32_t index) {
+        if (type == RecordErase) {
+            if (index >= entities.size()) return false;
+            entities.erase(entities.begin() + index);
+            return true;
+        }
+
+        typename Entities::value_type entity;
+        reader.GetEntity(entity);
+        if (!reader.ok) return false;
+        if (type == RecordSet && index < entities.size()) entities[index] = std::move(entity);
+        else if (type == RecordInsert && index <= entities.size()) entities.insert(entities.begin() + index, std::move(entity));
+        else return false;
+        return true;
+    }
+
+    bool ReferencesValid(const SceneData& sceneData) {
+        const uint32_t count = static_cast<uint32_t>(sceneData.points.size());
+        auto valid = [&](int index) { return static_cast<uint32_t>(index) < count; };
+        for (const auto& line : sceneData.lines) {
+            if (!valid(line.point1index) || !valid(line.point2index)) return false;
+        }
+        for (const auto& plane : sceneData.planes) {
+            if (!valid(plane.point1index) || !valid(plane.point2index) || !valid(plane.point3index)) return false;
+        }
+        return true;
+    }
+}
+
+bool Autosave::Recover(const std::string& path, SceneData& sceneData) {
+    // the .tmp is a complete snapshot when the app crashed between dropping the old file and renaming the new one,
+    // or when the rename failed and the journal was started over in place
+    return RecoverFile(path, sceneData) || RecoverFile(path + ".tmp", sceneData);
+}
+
+bool Autosave::RecoverFile(const std::string& path, SceneData& sceneData) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    std::vector<uint8_t> bytes;
+    uint8_t buffer[64 * 1024];
+    size_t read = 0;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + read);
+    fclose(file);
+
+    Reader header{ bytes.data(), bytes.size() };
+    char magic[4] = {};
+    uint32_t version = 0;
+    header.Get(magic);
+    header.Get(version);
+    if (!header.ok || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+        std::cerr << "Autosave journal not recognized: " << path << std::endl;
+        return false;
+    }
+
+    SceneData recovered;
+    float worldScale = sceneData.settings.worldScale;
+    bool hasSnapshot = false;
+    size_t blocks = 0;
+
+    size_t pos = header.pos;
+    while (true) {
+        Reader block{ bytes.data(), bytes.size(), pos };
+        uint32_t size = 0, checksum = 0;
+        block.Get(size);
+        block.Get(checksum);
+        if (!block.ok || bytes.size() - block.pos < size) break; // cut short by the crash
+        if (Checksum(bytes.data() + block.pos, size) != checksum) break;
+
+        // a block is all or nothing, a bad record leaves the scene as the previous block did
+        Reader records{ bytes.data(), block.pos + size, block.pos };
+        SceneData scene = recovered; // shares every chunk, only what the block edits gets copied
+        float scale = worldScale;
+        bool snapshotRead = hasSnapshot;
+        bool valid = true;
+        while (valid && records.pos < records.size) {
+            uint8_t type = 0;
+            records.Get(type);
+            if (type == RecordSnapshot) {
+                records.Get(scale);
+                records.GetEntities(scene.points);
+                records.GetEntities(scene.lines);
+                records.GetEntities(scene.planes);
+                valid = records.ok;
+                snapshotRead = true;
+                continue;
+            }
+
+            uint8_t kind = 0;
+            uint32_t index = 0;
+            records.Get(kind);
+            records.Get(index);
+            if (!records.ok || !snapshotRead || type > RecordErase) { valid = false; break; }
+            switch (static_cast<EntityKind>(kind)) {
+                case EntityKind::Point: valid = ApplyRecord(records, scene.points, type, index); break;
+                case EntityKind::Line: valid = ApplyRecord(records, scene.lines, type, index); break;
+                case EntityKind::Plane: valid = ApplyRecord(records, scene.planes, type, index); break;
+                default: valid = false; break;
+            }
+        }
+        if (!valid) break;
+
+        recovered = scene;
+        worldScale = scale;
+        hasSnapshot = snapshotRead;
+        pos = block.pos + size;
+        blocks++;
+    }
+
+    if (!hasSnapshot || !ReferencesValid(recovered)) {
+        std::cerr << "Autosave journal is damaged, nothing recovered: " << path << std::endl;
+        return false;
+    }
+
+    sceneData.points = recovered.points;
+    sceneData.lines = recovered.lines;
+    sceneData.planes = recovered.planes;
+    sceneData.settings.worldScale = worldScale;
+    std::cout << "Recovered " << sceneData.points.size() << " points, " << sceneData.lines.size() << " lines and "
+              << sceneData.planes.size() << " planes from " << blocks << " autosave blocks" << std::endl;
+    return true;
+}
+
+bool Autosave::Start(const std::string& path, const SceneData& sceneData) {
+#ifdef __EMSCRIPTEN__
+    (void)path;
+    (void)sceneData;
+    return false; // no threads and nowhere lasting to write to in the browser
+#else
+    Stop(true);
+
+    m_path = path;
+    m_pending.clear();
+    m_resetPending = true;
+    m_quit = false;
+    m_thread = std::thread(&Autosave::WriterLoop, this);
+    Flush(sceneData);
+    return true;
+#endif
+}
+
+void Autosave::Stop(bool keepJournal) {
+    if (!m_thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+
+    if (!keepJournal) {
+        remove(m_path.c_str());
+        remove((m_path + ".tmp").c_str()); // left behind when a snapshot couldn't be renamed
+    }
+}
+
+void Autosave::Record(const SceneChange& change) {
+    if (!m_thread.joinable()) return;
+
+    const size_t start = m_pending.size();
+    Put(m_pending, static_cast<uint8_t>(change.type == SceneChange::Set ? RecordSet :
+                                        change.type == SceneChange::Insert ? RecordInsert : RecordErase));
+    Put(m_pending, static_cast<uint8_t>(change.kind));
+    Put(m_pending, static_cast<uint32_t>(change.index));
+    if (change.point) PutEntity(m_pending, *change.point);
+    else if (change.line) PutEntity(m_pending, *change.line);
+    else if (change.plane) PutEntity(m_pending, *change.plane);
+    m_journalBytes += m_pending.size() - start;
+}
+
+void Autosave::Flush(const SceneData& sceneData) {
+    ALLOC_SCOPE("Autosave");
+    if (!m_thread.joinable()) return;
+
+    Job job;
+    if (m_resetPending || m_journalBytes > std::max(m_snapshotBytes, MIN_COMPACT_BYTES)) {
+        // the snapshot already has this frame's edits
+        job.snapshot = std::make_shared<const SceneData>(sceneData);
+        m_pending.clear();
+        m_resetPending = false;
+        m_journalBytes = 0;
+        m_snapshotBytes = sceneData.points.size() * 48 + sceneData.lines.size() * 40 + sceneData.planes.size() * 44;
+    }
+    else if (m_pending.empty()) {
+        return;
+    }
+    else {
+        job.records.swap(m_pending);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+void Autosave::WriterLoop() {
+    TRACE_THREAD("Autosave writer");
+    std::deque<Job> jobs;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+            jobs.swap(m_jobs);
+            if (jobs.empty() && m_quit) break;
+        }
+
+        TRACE_SCOPE("Autosave::Write");
+        // a snapshot makes everything queued before it pointless
+        size_t first = 0;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            if (jobs[i].snapshot) first = i;
+        }
+        for (size_t i = first; i < jobs.size(); ++i) {
+            if (jobs[i].snapshot) {
+                if (WriteSnapshot(*jobs[i].snapshot)) m_compactions++;
+            }
+            else if (m_file) {
+                WriteBlock(m_file, jobs[i].records);
+            }
+        }
+        if (m_file) fflush(m_file); // what's flushed survives the app crashing
+        jobs.clear();
+    }
+
+    if (m_file) fclose(m_file);
+    m_file = nullptr;
+}
+
+bool Autosave::WriteSnapshot(const SceneData& sceneData) {
+    std::vector<uint8_t> payload;
+    Put(payload, static_cast<uint8_t>(RecordSnapshot));
+    Put(payload, sceneData.settings.worldScale);
+    PutEntities(payload, sceneData.points);
+    PutEntities(payload, sceneData.lines);
+    PutEntities(payload, sceneData.planes);
+
+    // written next to the journal and swapped in, the old one stays valid until the new one is complete
+    const std::string tempPath = m_path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to write autosave snapshot: " << tempPath << std::endl;
+        return false;
+    }
+    fwrite(MAGIC, 1, sizeof(MAGIC), file);
+    fwrite(&VERSION, sizeof(VERSION), 1, file);
+    WriteBlock(file, payload);
+    const bool written = fflush(file) == 0 && !ferror(file);
+    fclose(file);
+    if (!written) {
+        std::cerr << "Failed to write autosave snapshot: " << tempPath << std::endl;
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    if (m_file) fclose(m_file);
+    remove(m_path.c_str()); // rename doesn't replace existing files on windows
+    if (rename(tempPath.c_str(), m_path.c_str()) == 0) {
+        m_file = fopen(m_path.c_str(), "ab");
+        return m_file != nullptr;
+    }
+
+    // the old journal is gone already, start it over with its header and the snapshot. The .tmp stays behind
+    // as a complete copy, Recover falls back to it if this one doesn't make it to disk
+    std::cerr << "Failed to replace autosave journal: " << m_path << std::endl;
+    m_file = fopen(m_path.c_str(), "wb");
+    if (!m_file) return false;
+    fwrite(MAGIC, 1, sizeof(MAGIC), m_file);
+    fwrite(&VERSION, sizeof(VERSION), 1, m_file);
+    WriteBlock(m_file, payload);
+    fflush(m_file);
+    return true;
+}
+
+void Autosave::WriteBlock(FILE* file, const std::vector<uint8_t>& payload) {
+    const uint32_t size = static_cast<uint32_t>(payload.size());
+    const uint32_t checksum = Checksum(payload.data(), payload.size());
+    fwrite(&size, sizeof(size), 1, file);
+    fwrite(&checksum, sizeof(checksum), 1, file);
+    fwrite(payload.data(), 1, payload.size(), file);
+}
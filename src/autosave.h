@@ -0,0 +1,72 @@
+// autosave.h
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "history.h"
+#include "scene.h"
+
+// Crash recovery journal. Every scene edit is appended to a binary file as the few bytes that describe it,
+// a background thread does the writing. Once the edits add up to more than the scene itself the file is
+// compacted: rewritten as a full snapshot of the scene, with the edits that follow appended after it.
+// A clean exit deletes the file, so finding one on startup means the last session crashed.
+//
+// File: "DJNL", version, then blocks of { payload size, checksum, records }. A block holds whole edits,
+// so a crash halfway through a write loses that block and nothing before it.
+class Autosave {
+public:
+    ~Autosave() { Stop(false); }
+
+    // Rebuilds the scene a crashed session left behind, false when there is nothing (or nothing valid) to recover.
+    // Settings other than the world scale are not journaled and keep their current values.
+    static bool Recover(const std::string& path, SceneData& sceneData);
+
+    // Starts journaling on top of a snapshot of the scene as it is now, overwriting whatever the file had
+    bool Start(const std::string& path, const SceneData& sceneData);
+    // Joins the writer, the journal is deleted unless keepJournal
+    void Stop(bool keepJournal = false);
+    bool IsRunning() const { return m_thread.joinable(); }
+
+    void Record(const SceneChange& change); // only encodes it, nothing is written until Flush
+    void Reset() { m_resetPending = true; } // the whole scene was replaced (a project was loaded)
+    // Once a frame: hands this frame's edits to the writer, with a snapshot first when the journal got too big
+    void Flush(const SceneData& sceneData);
+
+    size_t GetJournalBytes() const { return m_journalBytes; } // written since the last snapshot
+    size_t GetCompactions() const { return m_compactions; }
+
+private:
+    struct Job {
+        SceneSnapshot snapshot; // rewrite the file from this first, when set
+        std::vector<uint8_t> records;
+    };
+
+    static bool RecoverFile(const std::string& path, SceneData& sceneData);
+    void WriterLoop();
+    bool WriteSnapshot(const SceneData& sceneData);
+    void WriteBlock(FILE* file, const std::vector<uint8_t>& payload);
+
+    std::string m_path;
+    std::vector<uint8_t> m_pending; // records of this frame
+    bool m_resetPending = false;
+    size_t m_journalBytes = 0;
+    size_t m_snapshotBytes = 0; // rough size of the last snapshot, the journal is compacted past it
+    std::atomic<size_t> m_compactions{ 0 }; // counted by the writer
+
+    // writer thread side
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Job> m_jobs;
+    bool m_quit = false;
+    FILE* m_file = nullptr;
+};
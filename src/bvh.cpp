@@ -0,0 +1,134 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr int LEAF_SIZE = 4;
+}
+
+void BVH::Build(const std::vector<AABB>& boxes) {
+    m_nodes.clear();
+    m_indices.clear();
+    m_boxes = boxes;
+
+    // empty boxes (primitives outside the volume) never overlap anything, leave them out
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (!boxes[i].IsEmpty()) m_indices.push_back(static_cast<int>(i));
+    }
+    if (m_indices.empty()) return;
+
+    m_nodes.reserve(m_indices.size() * 2 / LEAF_SIZE + 1);
+    BuildNode(m_boxes, 0, static_cast<int>(m_indices.size()));
+}
+
+int BVH::BuildNode(const std::vector<AABB>& boxes, int first, int count) {
+    int nodeIndex = static_cast<int>(m_nodes.size());
+    m_nodes.emplace_back();
+
+    AABB bounds, centers;
+    for (int i = first; i < first + count; ++i) {
+        const AABB& box = boxes[m_indices[i]];
+        bounds.Grow(box);
+
+        float center[3] = {
+            (box.min[0] + box.max[0]) * 0.5f,
+            (box.min[1] + box.max[1]) * 0.5f,
+            (box.min[2] + box.max[2]) * 0.5f
+        };
+        centers.Grow(center);
+    }
+    m_nodes[nodeIndex].bounds = bounds;
+
+    if (count <= LEAF_SIZE) {
+        m_nodes[nodeIndex].first = first;
+        m_nodes[nodeIndex].count = count;
+        return nodeIndex;
+    }
+
+    // median split along the axis where the centers spread the most
+    int axis = 0;
+    float extent = centers.max[0] - centers.min[0];
+    for (int i = 1; i < 3; ++i) {
+        if (centers.max[i] - centers.min[i] > extent) {
+            extent = centers.max[i] - centers.min[i];
+            axis = i;
+        }
+    }
+
+    int half = count / 2;
+    std::nth_element(m_indices.begin() + first, m_indices.begin() + first + half, m_indices.begin() + first + count,
+        [&](int a, int b) {
+            return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis];
+        });
+
+    int left = BuildNode(boxes, first, half);
+    int right = BuildNode(boxes, first + half, count - half);
+    m_nodes[nodeIndex].left = left;
+    m_nodes[nodeIndex].right = right;
+    return nodeIndex;
+}
+
+template <typename Test>
+void BVH::Traverse(const Test& test, std::vector<int>& results) const {
+    if (m_nodes.empty()) return;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = m_nodes[stack[--top]];
+        if (!test(node.bounds)) continue;
+
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                if (test(m_boxes[m_indices[i]])) results.push_back(m_indices[i]);
+            }
+            continue;
+        }
+
+        // median splits keep the tree balanced, so 64 levels is far more than enough
+        stack[top++] = node.left;
+        stack[top++] = node.right;
+    }
+}
+
+void BVH::Query(const AABB& box, std::vector<int>& results) const {
+    if (box.IsEmpty()) return;
+    Traverse([&](const AABB& bounds) { return bounds.Overlaps(box); }, results);
+}
+
+void BVH::QueryLine(const float origin[3], const float dir[3], std::vector<int>& results) const {
+    // slab test, the line has no ends
+    Traverse([&](const AABB& bounds) {
+        float tMin = -FLT_MAX, tMax = FLT_MAX;
+        for (int k = 0; k < 3; ++k) {
+            if (dir[k] == 0.0f) {
+                if (origin[k] < bounds.min[k] || origin[k] > bounds.max[k]) return false;
+                continue;
+            }
+            float t0 = (bounds.min[k] - origin[k]) / dir[k];
+            float t1 = (bounds.max[k] - origin[k]) / dir[k];
+            if (t0 > t1) std::swap(t0, t1);
+            tMin = std::max(tMin, t0);
+            tMax = std::min(tMax, t1);
+            if (tMin > tMax) return false;
+        }
+        return true;
+    }, results);
+}
+
+void BVH::QueryPlane(const float normal[3], float offset, std::vector<int>& results) const {
+    // the box straddles the plane when its center is closer than its projected half size
+    Traverse([&](const AABB& bounds) {
+        float distance = offset, radius = 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            float center = (bounds.min[k] + bounds.max[k]) * 0.5f;
+            float extent = (bounds.max[k] - bounds.min[k]) * 0.5f;
+            distance += normal[k] * center;
+            radius += extent * std::fabs(normal[k]);
+        }
+        return std::fabs(distance) <= radius * 1.0001f + 1e-6f;
+    }, results);
+}
@@ -0,0 +1,62 @@
+// bvh.h
+#pragma once
+
+#include <cfloat>
+#include <vector>
+
+struct AABB {
+    float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    bool IsEmpty() const { return min[0] > max[0] || min[1] > max[1] || min[2] > max[2]; }
+
+    void Grow(const float p[3]) {
+        for (int i = 0; i < 3; ++i) {
+            if (p[i] < min[i]) min[i] = p[i];
+            if (p[i] > max[i]) max[i] = p[i];
+        }
+    }
+
+    void Grow(const AABB& other) {
+        Grow(other.min);
+        Grow(other.max);
+    }
+
+    bool Overlaps(const AABB& other) const {
+        for (int i = 0; i < 3; ++i) {
+            if (max[i] < other.min[i] || min[i] > other.max[i]) return false;
+        }
+        return true;
+    }
+};
+
+// Static bounding volume hierarchy over a list of boxes, rebuilt whenever the boxes change.
+// Queries append the indices of the boxes (as given to Build) that touch the query shape.
+class BVH {
+public:
+    void Build(const std::vector<AABB>& boxes);
+
+    void Query(const AABB& box, std::vector<int>& results) const;
+    void QueryLine(const float origin[3], const float dir[3], std::vector<int>& results) const;  // infinite line
+    void QueryPlane(const float normal[3], float offset, std::vector<int>& results) const;       // normal . x + offset = 0
+
+    bool IsEmpty() const { return m_nodes.empty(); }
+
+private:
+    struct Node {
+        AABB bounds;
+        int left = -1;  // children, -1 on leaves
+        int right = -1;
+        int first = 0;  // range in m_indices, only used by leaves
+        int count = 0;
+    };
+
+    int BuildNode(const std::vector<AABB>& boxes, int first, int count);
+
+    template <typename Test>
+    void Traverse(const Test& test, std::vector<int>& results) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_indices;
+    std::vector<AABB> m_boxes;
+};
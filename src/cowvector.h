@@ -0,0 +1,162 @@
+// cowvector.h
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Vector split in fixed size chunks that copies share. Copying the whole vector copies one pointer, the first
+// write after that clones the chunk table and then only the chunk being written to. A copy taken as a snapshot
+// never sees later edits, so another thread can read it without locks while this one keeps editing.
+// Anything that can write goes through the non-const accessors and un-shares a chunk, read through
+// const references where a snapshot may be alive so reads don't copy chunks for nothing.
+template <typename T>
+class CowVector {
+    using Chunk = std::vector<T>;
+    using Table = std::vector<std::shared_ptr<Chunk>>;
+
+    template <bool Const>
+    class Iterator {
+        using Owner = typename std::conditional<Const, const CowVector, CowVector>::type;
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = typename std::conditional<Const, const T&, T&>::type;
+        using pointer = typename std::conditional<Const, const T*, T*>::type;
+
+        Iterator() = default;
+        Iterator(Owner* owner, size_t index) : m_owner(owner), m_index(index) {}
+        operator Iterator<true>() const { return Iterator<true>(m_owner, m_index); }
+
+        reference operator*() const { return (*m_owner)[m_index]; }
+        pointer operator->() const { return &(*m_owner)[m_index]; }
+        reference operator[](difference_type n) const { return (*m_owner)[m_index + n]; }
+
+        Iterator& operator++() { ++m_index; return *this; }
+        Iterator operator++(int) { Iterator it = *this; ++m_index; return it; }
+        Iterator& operator--() { --m_index; return *this; }
+        Iterator operator--(int) { Iterator it = *this; --m_index; return it; }
+        Iterator& operator+=(difference_type n) { m_index += n; return *this; }
+        Iterator& operator-=(difference_type n) { m_index -= n; return *this; }
+        Iterator operator+(difference_type n) const { return Iterator(m_owner, m_index + n); }
+        Iterator operator-(difference_type n) const { return Iterator(m_owner, m_index - n); }
+        difference_type operator-(const Iterator& other) const { return static_cast<difference_type>(m_index) - static_cast<difference_type>(other.m_index); }
+
+        bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const Iterator& other) const { return m_index != other.m_index; }
+        bool operator<(const Iterator& other) const { return m_index < other.m_index; }
+        bool operator>(const Iterator& other) const { return m_index > other.m_index; }
+        bool operator<=(const Iterator& other) const { return m_index <= other.m_index; }
+        bool operator>=(const Iterator& other) const { return m_index >= other.m_index; }
+
+        size_t Index() const { return m_index; }
+
+    private:
+        Owner* m_owner = nullptr;
+        size_t m_index = 0;
+    };
+
+public:
+    static constexpr size_t CHUNK_SHIFT = 8; // 256 entities, a point chunk is ~16 KB
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_SHIFT;
+    static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+    using value_type = T;
+    using size_type = size_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    CowVector() = default;
+    CowVector(std::initializer_list<T> items) { for (const T& item : items) push_back(item); }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const T& operator[](size_t i) const { return (*(*m_table)[i >> CHUNK_SHIFT])[i & CHUNK_MASK]; }
+    T& operator[](size_t i) { return MutableChunk(i >> CHUNK_SHIFT)[i & CHUNK_MASK]; }
+    const T& front() const { return (*this)[0]; }
+    T& front() { return (*this)[0]; }
+    const T& back() const { return (*this)[m_size - 1]; }
+    T& back() { return (*this)[m_size - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_size); }
+
+    void push_back(const T& item) { emplace_back(item); }
+    void push_back(T&& item) { emplace_back(std::move(item)); }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if ((m_size & CHUNK_MASK) == 0) {
+            auto chunk = std::make_shared<Chunk>();
+            chunk->reserve(CHUNK_SIZE);
+            MutableTable().push_back(std::move(chunk));
+        }
+        Chunk& chunk = MutableChunk(m_size >> CHUNK_SHIFT);
+        chunk.emplace_back(std::forward<Args>(args)...);
+        m_size++;
+        return chunk.back();
+    }
+
+    void pop_back() {
+        const size_t last = (m_size - 1) >> CHUNK_SHIFT;
+        if (((m_size - 1) & CHUNK_MASK) == 0) MutableTable().pop_back(); // its only item, drop the chunk
+        else MutableChunk(last).pop_back();
+        m_size--;
+    }
+
+    void clear() {
+        m_table.reset();
+        m_size = 0;
+    }
+
+    // both shift everything after pos by one, only the chunks from pos on get un-shared
+    iterator insert(const_iterator pos, T item) {
+        const size_t index = pos.Index();
+        push_back(std::move(item));
+        for (size_t i = m_size - 1; i > index; --i) std::swap((*this)[i], (*this)[i - 1]);
+        return iterator(this, index);
+    }
+
+    iterator erase(const_iterator pos) {
+        const size_t index = pos.Index();
+        for (size_t i = index; i + 1 < m_size; ++i) (*this)[i] = std::move((*this)[i + 1]);
+        pop_back();
+        return iterator(this, index);
+    }
+
+    // true when both still read the same chunk table, nothing was written since one was copied from the other
+    bool SharesStorage(const CowVector& other) const { return m_table && m_table == other.m_table; }
+
+private:
+    Table& MutableTable() {
+        if (!m_table) m_table = std::make_shared<Table>();
+        else if (m_table.use_count() > 1) m_table = std::make_shared<Table>(*m_table); // only pointers are copied
+        return *m_table;
+    }
+
+    Chunk& MutableChunk(size_t chunk) {
+        Table& table = MutableTable();
+        std::shared_ptr<Chunk>& slot = table[chunk];
+        if (slot.use_count() > 1) {
+            auto copy = std::make_shared<Chunk>();
+            copy->reserve(CHUNK_SIZE);
+            copy->insert(copy->end(), slot->begin(), slot->end());
+            slot = std::move(copy);
+        }
+        return *slot;
+    }
+
+    std::shared_ptr<Table> m_table;
+    size_t m_size = 0;
+};
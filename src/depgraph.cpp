@@ -0,0 +1,225 @@
+#include "depgraph.h"
+#include "trace.h"
+#include "alloctrack.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool DependencyGraph::Sync(const SceneData& sceneData) {
+    TRACE_SCOPE("DependencyGraph::Sync");
+    ALLOC_SCOPE("Derived geometry");
+    const size_t pointCount = sceneData.points.size();
+    const size_t lineCount = sceneData.lines.size();
+    const size_t planeCount = sceneData.planes.size();
+    const size_t oldPointCount = m_pointCoords.size() / 3;
+    const size_t oldLineCount = m_lineReferences.size() / 2;
+    const size_t oldPlaneCount = m_planeReferences.size() / 3;
+
+    // an erase shifts every index after it, nothing from before lines up anymore
+    if (pointCount < oldPointCount || lineCount < oldLineCount || planeCount < oldPlaneCount) {
+        Rebuild(sceneData);
+        m_structureRevision++;
+        MarkAllDirty();
+        return true;
+    }
+
+    // appends leave the existing indices alone: the new entities and whatever got rewired get marked,
+    // the rest of the graph keeps its results
+    std::vector<int> rewiredLines, rewiredPlanes;
+    for (size_t i = 0; i < oldLineCount; ++i) {
+        const auto& line = sceneData.lines[i];
+        if (m_lineReferences[i * 2] != line.point1index || m_lineReferences[i * 2 + 1] != line.point2index) {
+            rewiredLines.push_back(static_cast<int>(i));
+        }
+    }
+    for (size_t i = 0; i < oldPlaneCount; ++i) {
+        const auto& plane = sceneData.planes[i];
+        if (m_planeReferences[i * 3] != plane.point1index ||
+            m_planeReferences[i * 3 + 1] != plane.point2index ||
+            m_planeReferences[i * 3 + 2] != plane.point3index) {
+            rewiredPlanes.push_back(static_cast<int>(i));
+        }
+    }
+
+    // points that moved and planes that got expanded, compared against what the last Sync saw
+    std::vector<int> movedPoints, expandedPlanes;
+    for (size_t i = 0; i < oldPointCount; ++i) {
+        if (memcmp(&m_pointCoords[i * 3], sceneData.points[i].coords, sizeof(float) * 3) != 0) movedPoints.push_back(static_cast<int>(i));
+    }
+    for (size_t i = 0; i < oldPlaneCount; ++i) {
+        if (m_planeExpand[i] != (sceneData.planes[i].expand ? 1 : 0)) expandedPlanes.push_back(static_cast<int>(i));
+    }
+
+    const bool appended = pointCount > oldPointCount || lineCount > oldLineCount || planeCount > oldPlaneCount;
+    if (appended || !rewiredLines.empty() || !rewiredPlanes.empty()) {
+        Rebuild(sceneData); // takes the new snapshot as well
+        m_structureRevision++;
+        for (size_t i = oldPointCount; i < pointCount; ++i) MarkDirty(NodeKind::Point, static_cast<int>(i));
+        for (size_t i = oldLineCount; i < lineCount; ++i) MarkDirty(NodeKind::Line, static_cast<int>(i));
+        for (size_t i = oldPlaneCount; i < planeCount; ++i) MarkDirty(NodeKind::Plane, static_cast<int>(i));
+        for (int line : rewiredLines) MarkDirty(NodeKind::Line, line);
+        for (int plane : rewiredPlanes) MarkDirty(NodeKind::Plane, plane);
+    } else {
+        for (int point : movedPoints) memcpy(&m_pointCoords[point * 3], sceneData.points[point].coords, sizeof(float) * 3);
+        for (int plane : expandedPlanes) m_planeExpand[plane] ^= 1;
+    }
+
+    for (int point : movedPoints) MarkDirty(NodeKind::Point, point);
+    // expanding a plane changes what it intersects
+    for (int plane : expandedPlanes) MarkDirty(NodeKind::Plane, plane);
+
+    return !m_dirtyList.empty();
+}
+
+void DependencyGraph::Rebuild(const SceneData& sceneData) {
+    const int pointCount = static_cast<int>(sceneData.points.size());
+    const int lineCount = static_cast<int>(sceneData.lines.size());
+    const int planeCount = static_cast<int>(sceneData.planes.size());
+
+    const int counts[static_cast<int>(NodeKind::Count)] = {
+        pointCount, lineCount, planeCount, lineCount, planeCount, lineCount, planeCount
+    };
+
+    m_kindOffsets[0] = 0;
+    for (int k = 0; k < static_cast<int>(NodeKind::Count); ++k) {
+        m_kindOffsets[k + 1] = m_kindOffsets[k] + counts[k];
+    }
+    const int nodeCount = m_kindOffsets[static_cast<int>(NodeKind::Count)];
+
+    m_kinds.resize(nodeCount);
+    m_indices.resize(nodeCount);
+    for (int k = 0; k < static_cast<int>(NodeKind::Count); ++k) {
+        for (int i = 0; i < counts[k]; ++i) {
+            m_kinds[m_kindOffsets[k] + i] = static_cast<NodeKind>(k);
+            m_indices[m_kindOffsets[k] + i] = i;
+        }
+    }
+
+    // edges, parent -> child
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(lineCount * 4 + planeCount * 5);
+
+    auto addPointEdge = [&](int pointIndex, int child) {
+        if (pointIndex >= 0 && pointIndex < pointCount) edges.emplace_back(GetNode(NodeKind::Point, pointIndex), child);
+    };
+
+    for (int i = 0; i < lineCount; ++i) {
+        const auto& line = sceneData.lines[i];
+        int node = GetNode(NodeKind::Line, i);
+        addPointEdge(line.point1index, node);
+        addPointEdge(line.point2index, node);
+        edges.emplace_back(node, GetNode(NodeKind::LineTraces, i));
+        edges.emplace_back(node, GetNode(NodeKind::LineIntersections, i));
+    }
+    for (int i = 0; i < planeCount; ++i) {
+        const auto& plane = sceneData.planes[i];
+        int node = GetNode(NodeKind::Plane, i);
+        addPointEdge(plane.point1index, node);
+        addPointEdge(plane.point2index, node);
+        addPointEdge(plane.point3index, node);
+        edges.emplace_back(node, GetNode(NodeKind::PlaneTraces, i));
+        edges.emplace_back(node, GetNode(NodeKind::PlaneIntersections, i));
+    }
+
+    // compressed adjacency lists
+    m_childOffsets.assign(nodeCount + 1, 0);
+    for (const auto& edge : edges) ++m_childOffsets[edge.first + 1];
+    for (int n = 0; n < nodeCount; ++n) m_childOffsets[n + 1] += m_childOffsets[n];
+
+    m_children.resize(edges.size());
+    std::vector<int> fill(m_childOffsets.begin(), m_childOffsets.end() - 1);
+    for (const auto& edge : edges) m_children[fill[edge.first]++] = edge.second;
+
+    // topological order (Kahn), the rank is what Evaluate sorts by
+    std::vector<int> inDegree(nodeCount, 0);
+    for (int child : m_children) ++inDegree[child];
+
+    std::vector<int> queue;
+    queue.reserve(nodeCount);
+    for (int n = 0; n < nodeCount; ++n) {
+        if (inDegree[n] == 0) queue.push_back(n);
+    }
+
+    m_rank.assign(nodeCount, 0);
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int node = queue[head];
+        m_rank[node] = static_cast<int>(head);
+        for (int c = m_childOffsets[node]; c < m_childOffsets[node + 1]; ++c) {
+            if (--inDegree[m_children[c]] == 0) queue.push_back(m_children[c]);
+        }
+    }
+
+    m_dirty.assign(nodeCount, 0);
+    m_dirtyList.clear();
+
+    // snapshot for the next Sync
+    m_pointCoords.resize(pointCount * 3);
+    for (int i = 0; i < pointCount; ++i) {
+        memcpy(&m_pointCoords[i * 3], sceneData.points[i].coords, sizeof(float) * 3);
+    }
+
+    m_lineReferences.resize(lineCount * 2);
+    for (int i = 0; i < lineCount; ++i) {
+        m_lineReferences[i * 2] = sceneData.lines[i].point1index;
+        m_lineReferences[i * 2 + 1] = sceneData.lines[i].point2index;
+    }
+
+    m_planeReferences.resize(planeCount * 3);
+    m_planeExpand.resize(planeCount);
+    for (int i = 0; i < planeCount; ++i) {
+        m_planeReferences[i * 3] = sceneData.planes[i].point1index;
+        m_planeReferences[i * 3 + 1] = sceneData.planes[i].point2index;
+        m_planeReferences[i * 3 + 2] = sceneData.planes[i].point3index;
+        m_planeExpand[i] = sceneData.planes[i].expand ? 1 : 0;
+    }
+}
+
+void DependencyGraph::MarkDirty(NodeKind kind, int index) {
+    int node = GetNode(kind, index);
+    if (node < 0 || node >= static_cast<int>(m_dirty.size())) return;
+    MarkNode(node);
+}
+
+void DependencyGraph::MarkNode(int node) {
+    if (m_dirty[node]) return;
+
+    // iterative, so long chains of derived geometry can't blow the stack
+    std::vector<int> stack;
+    stack.push_back(node);
+    m_dirty[node] = 1;
+
+    while (!stack.empty()) {
+        int current = stack.back();
+        stack.pop_back();
+        m_dirtyList.push_back(current);
+
+        for (int c = m_childOffsets[current]; c < m_childOffsets[current + 1]; ++c) {
+            int child = m_children[c];
+            if (m_dirty[child]) continue;
+            m_dirty[child] = 1;
+            stack.push_back(child);
+        }
+    }
+}
+
+void DependencyGraph::MarkAllDirty() {
+    m_dirtyList.clear();
+    for (size_t n = 0; n < m_dirty.size(); ++n) {
+        m_dirty[n] = 1;
+        m_dirtyList.push_back(static_cast<int>(n));
+    }
+}
+
+void DependencyGraph::Evaluate(const std::function<void(NodeKind, int)>& evaluate) {
+    TRACE_SCOPE("DependencyGraph::Evaluate");
+    ALLOC_SCOPE("Derived geometry");
+    std::sort(m_dirtyList.begin(), m_dirtyList.end(), [&](int a, int b) { return m_rank[a] < m_rank[b]; });
+
+    for (int node : m_dirtyList) {
+        evaluate(m_kinds[node], m_indices[node]);
+        m_dirty[node] = 0;
+    }
+
+    m_lastEvaluated = m_dirtyList.size();
+    m_dirtyList.clear();
+}
@@ -0,0 +1,66 @@
+// depgraph.h
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "scene.h"
+
+// What a node in the dependency graph stands for, index is the position in the matching SceneData vector
+enum class NodeKind : uint8_t {
+    Point,
+    Line,
+    Plane,
+    LineTraces,
+    PlaneTraces,
+    LineIntersections,
+    PlaneIntersections,
+    Count
+};
+
+// Scene entities and everything derived from them, with edges from inputs to what depends on them.
+// Editing a point only marks its downstream nodes, so derived geometry is recomputed for those alone.
+class DependencyGraph {
+public:
+    // Compares the scene against the previous call. Adding, removing or rewiring entities rebuilds the graph.
+    // Removing marks everything (indices shift), adding and rewiring only mark the entities that are new or
+    // rewired, and the points that moved get marked either way. Returns true if anything is dirty.
+    bool Sync(const SceneData& sceneData);
+
+    void MarkDirty(NodeKind kind, int index); // the node and everything downstream of it
+    void MarkAllDirty();
+
+    // Calls evaluate once per dirty node, parents always before their children, then clears them
+    void Evaluate(const std::function<void(NodeKind, int)>& evaluate);
+
+    size_t GetNodeCount() const { return m_kinds.size(); }
+    size_t GetLastEvaluatedCount() const { return m_lastEvaluated; }
+    uint64_t GetStructureRevision() const { return m_structureRevision; } // bumped every time Sync rebuilds
+
+private:
+    void Rebuild(const SceneData& sceneData);
+    int GetNode(NodeKind kind, int index) const { return m_kindOffsets[static_cast<int>(kind)] + index; }
+    void MarkNode(int node);
+
+    // nodes are laid out kind after kind, m_kindOffsets[kind] is where each kind starts
+    int m_kindOffsets[static_cast<int>(NodeKind::Count) + 1] = {};
+    std::vector<NodeKind> m_kinds;
+    std::vector<int> m_indices;
+
+    // children of node n are m_children[m_childOffsets[n] .. m_childOffsets[n + 1]]
+    std::vector<int> m_childOffsets;
+    std::vector<int> m_children;
+    std::vector<int> m_rank; // position in a topological order
+
+    std::vector<char> m_dirty;
+    std::vector<int> m_dirtyList;
+    size_t m_lastEvaluated = 0;
+    uint64_t m_structureRevision = 0;
+
+    // what the scene looked like on the last Sync
+    std::vector<float> m_pointCoords;
+    std::vector<int> m_lineReferences;  // 2 point indices per line
+    std::vector<int> m_planeReferences; // 3 point indices per plane
+    std::vector<char> m_planeExpand;
+};
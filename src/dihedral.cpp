@@ -1,8 +1,21 @@
 #include "dihedral.h"
+#include "geometry.h"
+#include "trace.h"
+#include "alloctrack.h"
 #include "app.h"
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+    ImVec2 ToImVec2(const glm::vec2& p) { return ImVec2(p.x, p.y); }
+}
+
 void DihedralViewport::Draw(App& app) {
+    TRACE_SCOPE("DihedralViewport::Draw");
+    ALLOC_SCOPE("Dihedral view");
     auto& sceneData = app.GetSceneData();
 
     float scale = sceneData.settings.worldScale;
@@ -36,310 +49,333 @@ void DihedralViewport::Draw(App& app) {
     ImDrawList* drawList = ImGui::GetWindowDrawList();
     ImVec2 cursorPos = ImGui::GetCursorScreenPos();
 
-    DrawGroundLine(drawList, cursorPos, viewportSize, lineColor);
-    DrawPoints(app, drawList, cursorPos, viewportSize, lineColor);
-    DrawLines(app, drawList, cursorPos, viewportSize, lineColor);
-    DrawPlanes(app, drawList, cursorPos, viewportSize, lineColor);
+    ImGuiSheetCanvas canvas(drawList);
+    DrawSheet(sceneData, canvas, cursorPos, viewportSize, lineColor);
+    UpdateSelection(app, cursorPos, viewportSize);
 
     ImGui::End();
     ImGui::PopStyleColor(2);
     ImGui::PopStyleVar(2);
 }
 
-void DihedralViewport::DrawGroundLine(ImDrawList* drawList, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
+void DihedralViewport::DrawSheet(const SceneData& sceneData, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
+    DrawGroundLine(canvas, cursorPos, viewportSize, lineColor);
+    DrawPoints(sceneData, canvas, cursorPos, viewportSize, lineColor);
+    DrawLines(sceneData, canvas, cursorPos, viewportSize, lineColor);
+    DrawPlanes(sceneData, canvas, cursorPos, viewportSize, lineColor);
+    if (m_intersections) DrawIntersections(*m_intersections, canvas, cursorPos, viewportSize);
+}
+
+void DihedralViewport::UpdateSelection(App& app, const ImVec2& cursorPos, const ImVec2& viewportSize) {
+    const auto& sceneData = app.GetSceneData();
+    auto& selection = app.GetSelection();
+    const ImGuiIO& io = ImGui::GetIO();
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+    // same placement as DrawPoints, first the vertical projection then the horizontal one
+    const SheetProjection projection = GetProjection(cursorPos, viewportSize);
+    auto project = [&](const Point& point, ImVec2& vertical, ImVec2& horizontal) {
+        vertical = ToImVec2(projection.Vertical(point.coords));
+        horizontal = ToImVec2(projection.Horizontal(point.coords));
+    };
+
+    float radius = sceneData.settings.pointSize * zoom;
+    if (!selection.Empty()) {
+        std::vector<int> selectedPoints;
+        selection.CollectPoints(sceneData, selectedPoints);
+        for (int index : selectedPoints) {
+            const auto& point = sceneData.points[index];
+            if (point.hidden) continue;
+            ImVec2 vertical, horizontal;
+            project(point, vertical, horizontal);
+            drawList->AddCircle(vertical, radius, IM_COL32(80, 140, 255, 255), 0, 2.0f);
+            drawList->AddCircle(horizontal, radius, IM_COL32(80, 140, 255, 255), 0, 2.0f);
+        }
+    }
+
+    // a plain drag still moves the window, the button only goes over the sheet while a modifier is down
+    if (!m_boxSelecting && !io.KeyShift && !io.KeyCtrl) return;
+    if (viewportSize.x <= 0.0f || viewportSize.y <= 0.0f) return;
+
+    ImGui::SetCursorScreenPos(cursorPos);
+    ImGui::InvisibleButton("##SheetSelect", viewportSize);
+    if (ImGui::IsItemActivated()) {
+        m_boxSelecting = true;
+        m_boxStart = io.MousePos;
+    }
+    if (!m_boxSelecting) return;
+
+    ImVec2 boxMin(std::min(m_boxStart.x, io.MousePos.x), std::min(m_boxStart.y, io.MousePos.y));
+    ImVec2 boxMax(std::max(m_boxStart.x, io.MousePos.x), std::max(m_boxStart.y, io.MousePos.y));
+    bool dragged = boxMax.x - boxMin.x > 4.0f || boxMax.y - boxMin.y > 4.0f;
+
+    if (ImGui::IsItemActive()) {
+        if (dragged) {
+            drawList->AddRectFilled(boxMin, boxMax, IM_COL32(80, 140, 255, 40));
+            drawList->AddRect(boxMin, boxMax, IM_COL32(80, 140, 255, 200));
+        }
+        return;
+    }
+    m_boxSelecting = false;
+
+    auto inBox = [&](const ImVec2& p) { return p.x >= boxMin.x && p.x <= boxMax.x && p.y >= boxMin.y && p.y <= boxMax.y; };
+
+    if (!dragged) {
+        // click on either projection of a point, shift toggles it, ctrl replaces
+        int clicked = -1;
+        float best = radius * radius;
+        for (size_t i = 0; i < sceneData.points.size(); ++i) {
+            if (sceneData.points[i].hidden) continue;
+            ImVec2 vertical, horizontal;
+            project(sceneData.points[i], vertical, horizontal);
+            for (const ImVec2& p : { vertical, horizontal }) {
+                float dx = p.x - m_boxStart.x, dy = p.y - m_boxStart.y;
+                if (dx * dx + dy * dy <= best) {
+                    best = dx * dx + dy * dy;
+                    clicked = static_cast<int>(i);
+                }
+            }
+        }
+        if (clicked >= 0) selection.Click(EntityKind::Point, clicked, io.KeyShift);
+        else if (!io.KeyShift) selection.Clear();
+        return;
+    }
+
+    if (!io.KeyShift) selection.Clear();
+
+    std::vector<uint8_t> inside(sceneData.points.size(), 0);
+    for (size_t i = 0; i < sceneData.points.size(); ++i) {
+        if (sceneData.points[i].hidden) continue;
+        ImVec2 vertical, horizontal;
+        project(sceneData.points[i], vertical, horizontal);
+        inside[i] = inBox(vertical) || inBox(horizontal);
+    }
+    selection.AddBoxed(sceneData, inside);
+}
+
+void DihedralViewport::DrawGroundLine(SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
     // Ground line (L.T.)
     ImVec2 p0(cursorPos.x, cursorPos.y + viewportSize.y / 2);
     ImVec2 p1(cursorPos.x + viewportSize.x, cursorPos.y + viewportSize.y / 2);
-    drawList->AddLine(p0, p1, lineColor, 2.5f); 
+    canvas.Line(p0, p1, lineColor, 2.5f); 
 
     // Small indicator lines
-    drawList->AddLine(ImVec2(p0.x + 4, p0.y + 5), ImVec2(p0.x + 30, p0.y + 5), lineColor, 2.0f);
-    drawList->AddLine(ImVec2(p1.x - 4, p1.y + 5), ImVec2(p1.x - 30, p1.y + 5), lineColor, 2.0f);
+    canvas.Line(ImVec2(p0.x + 4, p0.y + 5), ImVec2(p0.x + 30, p0.y + 5), lineColor, 2.0f);
+    canvas.Line(ImVec2(p1.x - 4, p1.y + 5), ImVec2(p1.x - 30, p1.y + 5), lineColor, 2.0f);
 }
 
-void DihedralViewport::DrawPoints(App& app, ImDrawList* drawList, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
-    auto& sceneData = app.GetSceneData();
-    ImVec2 viewportCenter(cursorPos.x + viewportSize.x / 2, cursorPos.y + viewportSize.y / 2);
+void DihedralViewport::DrawPoints(const SceneData& sceneData, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
+    const SheetProjection projection = GetProjection(cursorPos, viewportSize);
 
     for (const auto& point : sceneData.points) {
         if (point.hidden) continue;
 
-        float x = point.coords[0] / 2.0f;
-        float y1 = point.coords[2] / 3.0f;
-        float y2 = -point.coords[1] / 3.0f;
+        ImVec2 pos1 = ToImVec2(projection.Vertical(point.coords));
+        ImVec2 pos2 = ToImVec2(projection.Horizontal(point.coords));
 
-        ImVec2 pos1(viewportCenter.x + x * 10 * zoom, viewportCenter.y - y1 * 10 * zoom);
-        ImVec2 pos2(viewportCenter.x + x * 10 * zoom, viewportCenter.y - y2 * 10 * zoom);
-
-        drawList->AddCircleFilled(pos1, sceneData.settings.pointSize * zoom / 2,
-                                IM_COL32(point.color[0] * 255, point.color[1] * 255, point.color[2] * 255, 255));
-        drawList->AddCircleFilled(pos2, sceneData.settings.pointSize * zoom / 2,
-                                IM_COL32(point.color[0] * 255, point.color[1] * 255, point.color[2] * 255, 255));
+        ImU32 pointColor = IM_COL32(point.color[0] * 255, point.color[1] * 255, point.color[2] * 255, 255);
+        canvas.Circle(pos1, sceneData.settings.pointSize * zoom / 2, pointColor);
+        canvas.Circle(pos2, sceneData.settings.pointSize * zoom / 2, pointColor);
         
         // Draw labels
+        char label[16];
         if (pos2.x - 20 * zoom == pos1.x - 20 * zoom && pos2.y - 20 * zoom == pos1.y - 20 * zoom) {
-            ImGui::SetCursorScreenPos(ImVec2(pos2.x - 20 * zoom, pos2.y - 20 * zoom));
-            ImGui::TextColored(ImVec4(point.color[0], point.color[1], point.color[2], 1.0f), "%c1 = %c2", point.name[0], point.name[0]);
+            snprintf(label, sizeof(label), "%c1 = %c2", point.name[0], point.name[0]);
+            canvas.Text(ImVec2(pos2.x - 20 * zoom, pos2.y - 20 * zoom), pointColor, label);
         }
         else {
-            ImGui::SetCursorScreenPos(ImVec2(pos2.x - 20 * zoom, pos2.y - 20 * zoom));
-            ImGui::TextColored(ImVec4(point.color[0], point.color[1], point.color[2], 1.0f), "%c1", point.name[0]);
-            ImGui::SetCursorScreenPos(ImVec2(pos1.x - 20 * zoom, pos1.y - 20 * zoom));
-            ImGui::TextColored(ImVec4(point.color[0], point.color[1], point.color[2], 1.0f), "%c2", point.name[0]);
+            snprintf(label, sizeof(label), "%c1", point.name[0]);
+            canvas.Text(ImVec2(pos2.x - 20 * zoom, pos2.y - 20 * zoom), pointColor, label);
+            snprintf(label, sizeof(label), "%c2", point.name[0]);
+            canvas.Text(ImVec2(pos1.x - 20 * zoom, pos1.y - 20 * zoom), pointColor, label);
         }
 
-        ImVec2 ltPos(viewportCenter.x + x * 10 * zoom, viewportCenter.y);
-        drawList->AddLine(pos1, ltPos, lineColor, 0.75f * zoom);
-        drawList->AddLine(pos2, ltPos, lineColor, 0.75f * zoom);
+        ImVec2 ltPos = ToImVec2(projection.Ground(point.coords[0]));
+        canvas.Line(pos1, ltPos, lineColor, 0.75f * zoom);
+        canvas.Line(pos2, ltPos, lineColor, 0.75f * zoom);
     }
 }
 
-void DihedralViewport::CalculateEdgePoints(const ImVec2& p1, const ImVec2& p2, 
-                         float minX, float maxX, float minY, float maxY,
-                         ImVec2& edge1, ImVec2& edge2) {
-    // Handle vertical lines (x1 == x2)
-    if (abs(p2.x - p1.x) < 0.0001f) {
-        edge1 = ImVec2(p1.x, minY);
-        edge2 = ImVec2(p1.x, maxY);
-    }
-    // Handle horizontal lines (y1 == y2)
-    else if (abs(p2.y - p1.y) < 0.0001f) {
-        edge1 = ImVec2(minX, p1.y);
-        edge2 = ImVec2(maxX, p1.y);
-    }
-    else {
-        float m = (p2.y - p1.y) / (p2.x - p1.x);
-        float b = p1.y - m * p1.x;
-
-        if (abs(p2.x - p1.x) > abs(p2.y - p1.y)) {
-            edge1 = ImVec2(minX, m * minX + b);
-            edge2 = ImVec2(maxX, m * maxX + b);
-        }
-        else {
-            edge1 = ImVec2((minY - b) / m, minY);
-            edge2 = ImVec2((maxY - b) / m, maxY);
+void DihedralViewport::DrawLineWithLabels(SheetCanvas& canvas, const ImVec2& p1, const ImVec2& p2,
+                        float minX, float maxX, float minY, float maxY,
+                        ImU32 color, char lineName, bool is2, bool dashed,
+                        const std::vector<VisibilityInterval>* intervals) {
+    const glm::vec2 rectMin(minX, minY), rectMax(maxX, maxY);
+    glm::vec2 edge1, edge2;
+    ExtendToRect(glm::vec2(p1.x, p1.y), glm::vec2(p2.x, p2.y), rectMin, rectMax, edge1, edge2);
+
+    const float dashLength = 10.0f;
+    const float gapLength = 5.0f;
+
+    if (intervals) {
+        // p1 + t * (p2 - p1) is the projection of the same parameter t the intervals use
+        ImVec2 dir(p2.x - p1.x, p2.y - p1.y);
+        if (fabs(dir.x) < 0.0001f && fabs(dir.y) < 0.0001f) return; // projects to a point
+
+        // range of t that lands inside the viewport
+        float tMin, tMax;
+        if (!ClipToRect(glm::vec2(p1.x, p1.y), glm::vec2(dir.x, dir.y), rectMin, rectMax, tMin, tMax)) return;
+
+        for (const auto& interval : *intervals) {
+            float t0 = std::max(interval.t0, tMin);
+            float t1 = std::min(interval.t1, tMax);
+            if (t0 >= t1) continue;
+
+            ImVec2 a(p1.x + dir.x * t0, p1.y + dir.y * t0);
+            ImVec2 b(p1.x + dir.x * t1, p1.y + dir.y * t1);
+            if (interval.visible) canvas.Line(a, b, color, 1.0f);
+            else canvas.DashedLine(a, b, color, 1.0f, dashLength, gapLength);
         }
-    }
-}
 
-void DihedralViewport::DrawLineWithLabels(ImDrawList* drawList, const ImVec2& p1, const ImVec2& p2,
-                        float minX, float maxX, float minY, float maxY,
-                        ImU32 color, char lineName, bool is2, bool dashed) {
-    ImVec2 edge1, edge2;
-    CalculateEdgePoints(p1, p2, minX, maxX, minY, maxY, edge1, edge2);
-    
-    if (dashed) {
+        edge1 = glm::vec2(p1.x + dir.x * tMin, p1.y + dir.y * tMin);
+        edge2 = glm::vec2(p1.x + dir.x * tMax, p1.y + dir.y * tMax);
+    }
+    else if (dashed) {
         // Draw dashed line
-        const float dashLength = 10.0f;
-        const float gapLength = 5.0f;
-        ImVec2 dir = ImVec2(edge2.x - edge1.x, edge2.y - edge1.y);
-        float length = sqrtf(dir.x * dir.x + dir.y * dir.y);
-        float dirLength = sqrtf(dir.x * dir.x + dir.y * dir.y);
-        if (dirLength > 0.0001f) {
-            dir.x /= dirLength;
-            dir.y /= dirLength;
-        }
-        
-        for (float i = 0; i < length; i += dashLength + gapLength) {
-            ImVec2 start = ImVec2(edge1.x + dir.x * i, edge1.y + dir.y * i);
-            ImVec2 end = ImVec2(start.x + dir.x * dashLength, start.y + dir.y * dashLength);
-            drawList->AddLine(start, end, color, 1.0f);
-        }
+        canvas.DashedLine(ToImVec2(edge1), ToImVec2(edge2), color, 1.0f, dashLength, gapLength);
     } else {
         // Draw solid line
-        drawList->AddLine(edge1, edge2, color, 1.0f);
+        canvas.Line(ToImVec2(edge1), ToImVec2(edge2), color, 1.0f);
     }    
     // Draw labels
     float labelX = (edge1.x + edge2.x) / 2 + (is2 ? 15 : -15);
     float labelY = (edge1.y + edge2.y) / 2 - 20;
-    ImGui::SetCursorScreenPos(ImVec2(labelX, labelY));
 
-    ImVec4 colorVec = ImGui::ColorConvertU32ToFloat4(color);
-    ImGui::TextColored(colorVec, "%c%d", lineName, is2 ? 2 : 1);
+    char label[16];
+    snprintf(label, sizeof(label), "%c%d", lineName, is2 ? 2 : 1);
+    canvas.Text(ImVec2(labelX, labelY), color, label);
 }
 
 
-void DihedralViewport::DrawLines(App& app, ImDrawList* drawList, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
-    auto& sceneData = app.GetSceneData();
-    ImVec2 viewportCenter(cursorPos.x + viewportSize.x / 2, cursorPos.y + viewportSize.y / 2);
+void DihedralViewport::DrawLines(const SceneData& sceneData, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
+    const SheetProjection projection = GetProjection(cursorPos, viewportSize);
+
+    const auto& allTraces = m_traces.UpdateLines(sceneData);
+    m_visibility.SetVolume(sceneData.settings.worldScale);
+    const auto& allVisibility = m_visibility.Update(sceneData, allTraces);
 
-    for (const auto& line : sceneData.lines) {
+    for (size_t i = 0; i < sceneData.lines.size(); ++i) {
+        const auto& line = sceneData.lines[i];
         const auto& p1 = sceneData.points[line.point1index];
         const auto& p2 = sceneData.points[line.point2index];
 
-        // Calculate transformed coordinates
-        float x1 = p1.coords[0] / 2.0f;
-        float y1_r2 = p1.coords[2] / 3.0f;
-        float y1_r1 = -p1.coords[1] / 3.0f;
-
-        float x2 = p2.coords[0] / 2.0f;
-        float y2_r2 = p2.coords[2] / 3.0f;
-        float y2_r1 = -p2.coords[1] / 3.0f;
+        ImVec2 p1_r2 = ToImVec2(projection.Vertical(p1.coords));
+        ImVec2 p2_r2 = ToImVec2(projection.Vertical(p2.coords));
+        ImVec2 p1_r1 = ToImVec2(projection.Horizontal(p1.coords));
+        ImVec2 p2_r1 = ToImVec2(projection.Horizontal(p2.coords));
+
+        if (!line.showVisibility) {
+            // R2 line (vertical plane)
+            DrawLineWithLabels(canvas, p1_r2, p2_r2, 
+                            cursorPos.x, cursorPos.x + viewportSize.x,
+                            cursorPos.y, cursorPos.y + viewportSize.y,
+                            lineColor, line.name[0], true, false);
+
+            // R1 line (horizontal plane)
+            DrawLineWithLabels(canvas, p1_r1, p2_r1,
+                            cursorPos.x, cursorPos.x + viewportSize.x,
+                            cursorPos.y, cursorPos.y + viewportSize.y,
+                            lineColor, line.name[0], false, false);
+            continue;
+        }
 
-        float scale = 10.0f * zoom;
+        const auto& traces = allTraces[i];
+        if (traces.degenerate) continue;
 
-        // R2 line (vertical plane)
-        ImVec2 p1_r2(viewportCenter.x + x1 * scale, viewportCenter.y - y1_r2 * scale);
-        ImVec2 p2_r2(viewportCenter.x + x2 * scale, viewportCenter.y - y2_r2 * scale);
-        DrawLineWithLabels(drawList, p1_r2, p2_r2, 
+        // seen parts solid, hidden parts (other quadrants or behind a plane) dashed
+        const auto& visibility = allVisibility[i];
+        DrawLineWithLabels(canvas, p1_r2, p2_r2,
                         cursorPos.x, cursorPos.x + viewportSize.x,
                         cursorPos.y, cursorPos.y + viewportSize.y,
-                        lineColor, line.name[0], true, false);
-
-        // R1 line (horizontal plane)
-        ImVec2 p1_r1(viewportCenter.x + x1 * scale, viewportCenter.y - y1_r1 * scale);
-        ImVec2 p2_r1(viewportCenter.x + x2 * scale, viewportCenter.y - y2_r1 * scale);
-        DrawLineWithLabels(drawList, p1_r1, p2_r1,
+                        lineColor, line.name[0], true, false, &visibility.vertical);
+        DrawLineWithLabels(canvas, p1_r1, p2_r1,
                         cursorPos.x, cursorPos.x + viewportSize.x,
                         cursorPos.y, cursorPos.y + viewportSize.y,
-                        lineColor, line.name[0], false, false);
-        
-        if (line.showVisibility) {
-            if (y1_r2 * y2_r2 <= 0) {
-                float t = -y1_r2 / (y2_r2 - y1_r2);
-                float x_ground = x1 + t * (x2 - x1);
-                float y_r1_ground = y1_r1 + t * (y2_r1 - y1_r1);
-                
-                ImVec2 groundPoint(
-                    viewportCenter.x + x_ground * scale,
-                    viewportCenter.y - y_r1_ground * scale
-                );
-
-                ImVec2 r2_groundPoint(
-                    viewportCenter.x + x_ground * scale,
-                    viewportCenter.y 
-                );
-
-                drawList->AddCircleFilled(groundPoint, 3.0f * zoom, IM_COL32(0, 0, 255, 255));
-                drawList->AddLine(r2_groundPoint, groundPoint, IM_COL32(100, 100, 100, 128), 1.0f * zoom);
-            }
-            
-            if ((y1_r1 * y2_r1) <= 0 && (y2_r1 - y1_r1) != 0.0f) {
-                float t = -y1_r1 / (y2_r1 - y1_r1);
-                float x_ground = x1 + t * (x2 - x1);
-                float y_r2_ground = y1_r2 + t * (y2_r2 - y1_r2);
-
-                ImVec2 groundPoint(
-                    viewportCenter.x + x_ground * scale,
-                    viewportCenter.y - y_r2_ground * scale
-                );
-                ImVec2 r1_groundPoint(
-                    viewportCenter.x + x_ground * scale,
-                    viewportCenter.y 
-                );
-
-                drawList->AddCircleFilled(groundPoint, 3.0f * zoom, IM_COL32(255, 0, 0, 255));
-                drawList->AddLine(r1_groundPoint, groundPoint, IM_COL32(100, 100, 100, 128), 1.0f * zoom);
-            }
+                        lineColor, line.name[0], false, false, &visibility.horizontal);
 
-            if ((y1_r2 * y2_r2) <= 0 && (y2_r2 - y1_r2) != 0.0f) {
-                float t = -y1_r2 / (y2_r2 - y1_r2);
-                float x_ground = x1 + t * (x2 - x1);
-                float y_r1_ground = y1_r1 + t * (y2_r1 - y1_r1);
-
-                ImVec2 groundPoint(
-                    viewportCenter.x + x_ground * scale,
-                    viewportCenter.y - y_r1_ground * scale
-                );
-                ImVec2 r2_groundPoint(
-                    viewportCenter.x + x_ground * scale,
-                    viewportCenter.y
-                );
-
-                drawList->AddCircleFilled(groundPoint, 3.0f * zoom, IM_COL32(255, 0, 0, 255));
-                drawList->AddLine(r2_groundPoint, groundPoint, IM_COL32(100, 100, 100, 128), 1.0f * zoom);
-            }
+        // H trace: on the horizontal plane, so its vertical projection sits on the ground line
+        if (traces.hasHorizontal) {
+            ImVec2 tracePoint = ToImVec2(projection.Horizontal(traces.horizontal));
+            ImVec2 groundPoint = ToImVec2(projection.Ground(traces.horizontal[0]));
+
+            canvas.Circle(tracePoint, 3.0f * zoom, IM_COL32(0, 0, 255, 255));
+            canvas.Line(groundPoint, tracePoint, IM_COL32(100, 100, 100, 128), 1.0f * zoom);
+        }
+
+        // V trace: on the vertical plane, its horizontal projection sits on the ground line
+        if (traces.hasVertical) {
+            ImVec2 tracePoint = ToImVec2(projection.Vertical(traces.vertical));
+            ImVec2 groundPoint = ToImVec2(projection.Ground(traces.vertical[0]));
+
+            canvas.Circle(tracePoint, 3.0f * zoom, IM_COL32(255, 0, 0, 255));
+            canvas.Line(groundPoint, tracePoint, IM_COL32(100, 100, 100, 128), 1.0f * zoom);
         }
     }
 }
 
-void DihedralViewport::DrawPlanes(App& app, ImDrawList* drawList, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
-    auto& sceneData = app.GetSceneData();
-    ImVec2 viewportCenter(cursorPos.x + viewportSize.x / 2, cursorPos.y + viewportSize.y / 2);
+void DihedralViewport::DrawPlanes(const SceneData& sceneData, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor) {
+    const SheetProjection projection = GetProjection(cursorPos, viewportSize);
+    const float scale = projection.scale;
 
-    for (const auto& plane : sceneData.planes) {
-        const auto& p1 = sceneData.points[plane.point1index];
-        const auto& p2 = sceneData.points[plane.point2index];
-        const auto& p3 = sceneData.points[plane.point3index];
+    // visible area in model units (x = d/2, y = c/3 or a/3 on the sheet)
+    float halfD = viewportSize.x / 2 / scale * 2.0f;
+    float halfHeight = viewportSize.y / 2 / scale * 3.0f;
+    m_traces.SetBounds(-halfD, halfD, -halfHeight, halfHeight);
 
-        // Calculate plane equation: Ax + By + Cz + D = 0
-        glm::vec3 v1(p2.coords[0] - p1.coords[0], p2.coords[1] - p1.coords[1], p2.coords[2] - p1.coords[2]);
-        glm::vec3 v2(p3.coords[0] - p1.coords[0], p3.coords[1] - p1.coords[1], p3.coords[2] - p1.coords[2]);
-        glm::vec3 normal = glm::cross(v1, v2);
-        
-        float A = normal.x;
-        float B = normal.y;
-        float C = normal.z;
-        float D = -(A * p1.coords[0] + B * p1.coords[1] + C * p1.coords[2]);
-        
-        float z1_vert = (-D) / C;
-        glm::vec3 vert_point1(0.0f, 0.0f, z1_vert / 3);
-
-        float x1_vert = (-D) / A;
-        glm::vec3 vert_point2(x1_vert / 2, 0.0f, 0.0f);
-
-        float y1_horiz = (-D) / B;
-        glm::vec3 horiz_point1(0.0f, -y1_horiz / 3, 0.0f);
-
-        float x2_horiz = (-D) / A;
-        glm::vec3 horiz_point2(x2_horiz / 2, 0.0f, 0.0f);
-
-        ImVec2 p1_vert(cursorPos.x + viewportSize.x / 2 + vert_point1.x * 10 * zoom,
-                   (cursorPos.y + viewportSize.y / 2) - vert_point1.z * 10 * zoom);
-        ImVec2 p2_vert(cursorPos.x + viewportSize.x / 2 + vert_point2.x * 10 * zoom,
-                   (cursorPos.y + viewportSize.y / 2) - vert_point2.z * 10 * zoom);
-
-        ImVec2 p1_horiz(cursorPos.x + viewportSize.x / 2 + horiz_point1.x * 10 * zoom,
-                (cursorPos.y + viewportSize.y / 2) - horiz_point1.y * 10 * zoom);
-        ImVec2 p2_horiz(cursorPos.x + viewportSize.x / 2 + horiz_point2.x * 10 * zoom,
-                (cursorPos.y + viewportSize.y / 2) + horiz_point2.y * 10 * zoom);
-
-        ImVec2 vert_dir = ImVec2(p2_vert.x - p1_vert.x, p2_vert.y - p1_vert.y);
-        if (fabs(vert_dir.x) < 1e-5) { // vertical line
-            p1_vert = ImVec2(p1_vert.x, cursorPos.y);
-            p2_vert = ImVec2(p1_vert.x, cursorPos.y + viewportSize.y);
-        } else {
-            float m = vert_dir.y / vert_dir.x;
-            float b = p1_vert.y - m * p1_vert.x;
-
-            float x_top = (cursorPos.y - b) / m;
-            float x_bottom = (cursorPos.y + viewportSize.y - b) / m;
-            p1_vert = ImVec2(x_top, cursorPos.y);
-        }
+    const auto& allTraces = m_traces.UpdatePlanes(sceneData);
+
+    for (size_t i = 0; i < sceneData.planes.size(); ++i) {
+        const auto& plane = sceneData.planes[i];
+        const auto& traces = allTraces[i];
 
-        ImVec2 horiz_dir = ImVec2(p2_horiz.x - p1_horiz.x, p2_horiz.y - p1_horiz.y);
-        if (fabs(horiz_dir.y) < 1e-5) { // horizontal line
-            p1_horiz = ImVec2(cursorPos.x, p1_horiz.y);
-            p2_horiz = ImVec2(cursorPos.x + viewportSize.x, p1_horiz.y);
-        } else {
-            float m = horiz_dir.y / horiz_dir.x;
-            float b = p1_horiz.y - m * p1_horiz.x;
-            // Intersect with left and right borders
-            float y_left = m * cursorPos.x + b;
-            float y_right = m * (cursorPos.x + viewportSize.x) + b;
-            p1_horiz = ImVec2(cursorPos.x, y_left);
+        if (traces.position == PlanePosition::Degenerate) continue;
+
+        char label[16];
+
+        // both traces are the ground line, which is already drawn
+        if (traces.position == PlanePosition::ThroughGroundLine) {
+            snprintf(label, sizeof(label), "%c1 = %c2", plane.name[0], plane.name[0]);
+            canvas.Text(ImVec2(cursorPos.x + 40, projection.center.y - 20), lineColor, label);
+            continue;
         }
 
-        // handle vertical lines (x1 == x2)
-        if (abs(p2_vert.x - p1_vert.x) < 0.0001f) {
-            p1_vert = ImVec2(p1_vert.x, cursorPos.y);
-            p2_vert = ImVec2(p1_vert.x, cursorPos.y + viewportSize.y);
+        if (traces.hasHorizontal) {
+            const auto& h = traces.horizontal;
+            ImVec2 p1 = ToImVec2(projection.Horizontal(h.x1, h.y1));
+            ImVec2 p2 = ToImVec2(projection.Horizontal(h.x2, h.y2));
+            canvas.Line(p1, p2, lineColor, 3.0f * zoom);
+
+            snprintf(label, sizeof(label), "%c1", plane.name[0]);
+            canvas.Text(ImVec2((p1.x + p2.x) / 2 - 15, (p1.y + p2.y) / 2 - 20), lineColor, label);
         }
-        // handle horizontal lines (y1 == y2)
-        else if (abs(p2_horiz.y - p1_horiz.y) < 0.0001f) {
-            p1_horiz = ImVec2(cursorPos.x, p1_horiz.y);
-            p2_horiz = ImVec2(cursorPos.x + viewportSize.x, p1_horiz.y);
+
+        if (traces.hasVertical) {
+            const auto& v = traces.vertical;
+            ImVec2 p1 = ToImVec2(projection.Vertical(v.x1, v.y1));
+            ImVec2 p2 = ToImVec2(projection.Vertical(v.x2, v.y2));
+            canvas.Line(p1, p2, lineColor, 3.0f * zoom);
+
+            snprintf(label, sizeof(label), "%c2", plane.name[0]);
+            canvas.Text(ImVec2((p1.x + p2.x) / 2 - 15, (p1.y + p2.y) / 2 - 20), lineColor, label);
         }
+    }
+}
 
-        // Draw the plane lines
-        drawList->AddLine(p1_horiz, p2_horiz, lineColor, 3.0f * zoom);
-        drawList->AddLine(p1_vert, p2_vert, lineColor, 3.0f * zoom);
-        
-        // add labels
-        ImGui::SetCursorScreenPos(ImVec2(((p1_horiz.x + p2_horiz.x) / 2 - 15) * zoom, ((p1_horiz.y + p2_horiz.y) / 2 - 20) * zoom));
-        ImVec4 lineColorVec = ImGui::ColorConvertU32ToFloat4(lineColor);
-        ImGui::TextColored(lineColorVec, "%c1", plane.name[0]);
-        ImGui::SetCursorScreenPos(ImVec2(((p1_vert.x + p2_vert.x) / 2 - 15) * zoom, ((p1_vert.y + p2_vert.y) / 2 - 20) * zoom));
-        ImGui::TextColored(lineColorVec, "%c2", plane.name[0]);
+void DihedralViewport::DrawIntersections(const IntersectionResults& results, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize) {
+    const SheetProjection projection = GetProjection(cursorPos, viewportSize);
+    const ImU32 color = IM_COL32(0, 160, 0, 255);
+
+    // vertical projection uses (d, c), horizontal projection uses (d, a)
+    auto toVertical = [&](const float coords[3]) { return ToImVec2(projection.Vertical(coords)); };
+    auto toHorizontal = [&](const float coords[3]) { return ToImVec2(projection.Horizontal(coords)); };
+
+    for (const auto& line : results.lines) {
+        canvas.Line(toVertical(line.p1), toVertical(line.p2), color, 1.5f);
+        canvas.Line(toHorizontal(line.p1), toHorizontal(line.p2), color, 1.5f);
+    }
+
+    for (const auto& point : results.points) {
+        canvas.Circle(toVertical(point.coords), 3.0f * zoom, color);
+        canvas.Circle(toHorizontal(point.coords), 3.0f * zoom, color);
     }
 }
@@ -3,24 +3,56 @@
 #include <imgui.h>
 #include <imgui_internal.h>
 
+#include "geometry.h"
+#include "scene.h"
+#include "sheet.h"
+#include "traces.h"
+#include "intersections.h"
+#include "visibility.h"
+
 class App; // Forward declaration
 
 class DihedralViewport {
 public:
     void Draw(App& app);
 
+    // Walks the whole projected sheet (ground line, points, lines, planes) into any canvas
+    void DrawSheet(const SceneData& sceneData, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
+
+    void SetZoom(float value) { zoom = value; }
+    float GetZoom() const { return zoom; }
+
+    TraceEngine& GetTraceEngine() { return m_traces; }
+    VisibilitySolver& GetVisibilitySolver() { return m_visibility; }
+
+    // drawn on top of the sheet when set, nullptr to hide them
+    void SetIntersections(const IntersectionResults* results) { m_intersections = results; }
+
 private:
-    void DrawGroundLine(ImDrawList* drawList, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
-    void DrawPoints(App& app, ImDrawList* drawList, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
-    void DrawLines(App& app, ImDrawList* drawList, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
-    void DrawPlanes(App& app, ImDrawList* drawList, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
-    
-    void CalculateEdgePoints(const ImVec2& p1, const ImVec2& p2, 
-                           float minX, float maxX, float minY, float maxY,
-                           ImVec2& edge1, ImVec2& edge2);
-    void DrawLineWithLabels(ImDrawList* drawList, const ImVec2& p1, const ImVec2& p2,
+    void DrawGroundLine(SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
+    void DrawPoints(const SceneData& sceneData, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
+    void DrawLines(const SceneData& sceneData, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
+    void DrawPlanes(const SceneData& sceneData, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize, ImU32 lineColor);
+    void DrawIntersections(const IntersectionResults& results, SheetCanvas& canvas, const ImVec2& cursorPos, const ImVec2& viewportSize);
+    // rings on the selected points and shift/ctrl + drag box select, only on screen (exports don't go through it)
+    void UpdateSelection(App& app, const ImVec2& cursorPos, const ImVec2& viewportSize);
+
+    // model to sheet for a viewport, the center of the ground line is the middle of it
+    SheetProjection GetProjection(const ImVec2& cursorPos, const ImVec2& viewportSize) const {
+        return { glm::vec2(cursorPos.x + viewportSize.x / 2, cursorPos.y + viewportSize.y / 2), 10.0f * zoom };
+    }
+
+    void DrawLineWithLabels(SheetCanvas& canvas, const ImVec2& p1, const ImVec2& p2,
                            float minX, float maxX, float minY, float maxY,
-                           ImU32 color, char lineName, bool is2, bool dashed);
+                           ImU32 color, char lineName, bool is2, bool dashed,
+                           const std::vector<VisibilityInterval>* intervals = nullptr); // seen parts solid, the rest dashed
 
     float zoom = 1.0f; //works as the scale factor for the viewport
+
+    TraceEngine m_traces; // plane traces, only recomputed when a plane changes
+    VisibilitySolver m_visibility; // hidden parts of the lines with showVisibility
+    const IntersectionResults* m_intersections = nullptr;
+
+    bool m_boxSelecting = false;
+    ImVec2 m_boxStart;
 };
\ No newline at end of file
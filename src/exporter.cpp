@@ -0,0 +1,384 @@
+#include "exporter.h"
+#include "dihedral.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstring>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+// BUFFERED WRITER ----------------------------------------------------
+
+BufferedWriter::BufferedWriter(size_t capacity) : m_buffer(capacity) {}
+
+BufferedWriter::~BufferedWriter() {
+    Close();
+}
+
+bool BufferedWriter::Open(const std::string& path) {
+    Close();
+    m_file = fopen(path.c_str(), "wb");
+    m_used = 0;
+    m_written = 0;
+    m_failed = (m_file == nullptr);
+    return m_file != nullptr;
+}
+
+bool BufferedWriter::Close() {
+    if (!m_file) return !m_failed;
+    Flush();
+    if (fclose(m_file) != 0) m_failed = true;
+    m_file = nullptr;
+    return !m_failed;
+}
+
+void BufferedWriter::Flush() {
+    if (!m_file || m_used == 0) return;
+    if (fwrite(m_buffer.data(), 1, m_used, m_file) != m_used) m_failed = true;
+    m_written += m_used;
+    m_used = 0;
+}
+
+void BufferedWriter::Write(const char* data, size_t size) {
+    if (!m_file) return;
+    if (m_used + size > m_buffer.size()) {
+        Flush();
+        if (size > m_buffer.size()) { // too big to be worth buffering
+            if (fwrite(data, 1, size, m_file) != size) m_failed = true;
+            m_written += size;
+            return;
+        }
+    }
+    memcpy(m_buffer.data() + m_used, data, size);
+    m_used += size;
+}
+
+void BufferedWriter::Printf(const char* format, ...) {
+    if (!m_file) return;
+
+    va_list args;
+    va_start(args, format);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+
+    size_t space = m_buffer.size() - m_used;
+    int length = vsnprintf(m_buffer.data() + m_used, space, format, args);
+    va_end(args);
+
+    if (length >= 0 && static_cast<size_t>(length) < space) {
+        m_used += length;
+    } else if (length >= 0) {
+        // didn't fit, make room and format again
+        Flush();
+        if (static_cast<size_t>(length) < m_buffer.size()) {
+            vsnprintf(m_buffer.data(), m_buffer.size(), format, argsCopy);
+            m_used = length;
+        } else {
+            std::vector<char> big(length + 1);
+            vsnprintf(big.data(), big.size(), format, argsCopy);
+            Write(big.data(), length);
+        }
+    } else {
+        m_failed = true;
+    }
+    va_end(argsCopy);
+}
+
+// CANVASES -----------------------------------------------------------
+
+namespace {
+    struct RGBA {
+        int r, g, b;
+        float a;
+    };
+
+    RGBA Unpack(ImU32 color) {
+        return { static_cast<int>(color & 0xFF), static_cast<int>((color >> 8) & 0xFF),
+                 static_cast<int>((color >> 16) & 0xFF), ((color >> 24) & 0xFF) / 255.0f };
+    }
+
+    class SVGCanvas : public SheetCanvas {
+    public:
+        SVGCanvas(BufferedWriter& out, float fontSize) : m_out(out), m_fontSize(fontSize) {}
+
+        void Line(const ImVec2& p1, const ImVec2& p2, ImU32 color, float thickness) override {
+            RGBA c = Unpack(color);
+            m_out.Printf("<line x1=\"%.2f\" y1=\"%.2f\" x2=\"%.2f\" y2=\"%.2f\" stroke=\"#%02x%02x%02x\" stroke-width=\"%.2f\"%s/>\n",
+                         p1.x, p1.y, p2.x, p2.y, c.r, c.g, c.b, thickness, Opacity("stroke-opacity", c.a).c_str());
+        }
+
+        void DashedLine(const ImVec2& p1, const ImVec2& p2, ImU32 color, float thickness,
+                        float dashLength, float gapLength) override {
+            RGBA c = Unpack(color);
+            m_out.Printf("<line x1=\"%.2f\" y1=\"%.2f\" x2=\"%.2f\" y2=\"%.2f\" stroke=\"#%02x%02x%02x\" stroke-width=\"%.2f\" stroke-dasharray=\"%.2f %.2f\"%s/>\n",
+                         p1.x, p1.y, p2.x, p2.y, c.r, c.g, c.b, thickness, dashLength, gapLength, Opacity("stroke-opacity", c.a).c_str());
+        }
+
+        void Circle(const ImVec2& center, float radius, ImU32 color) override {
+            RGBA c = Unpack(color);
+            m_out.Printf("<circle cx=\"%.2f\" cy=\"%.2f\" r=\"%.2f\" fill=\"#%02x%02x%02x\"%s/>\n",
+                         center.x, center.y, radius, c.r, c.g, c.b, Opacity("fill-opacity", c.a).c_str());
+        }
+
+        void Text(const ImVec2& pos, ImU32 color, const char* text) override {
+            RGBA c = Unpack(color);
+            m_out.Printf("<text x=\"%.2f\" y=\"%.2f\" fill=\"#%02x%02x%02x\" font-size=\"%.1f\" dominant-baseline=\"hanging\">",
+                         pos.x, pos.y, c.r, c.g, c.b, m_fontSize);
+            for (const char* ch = text; *ch; ++ch) {
+                switch (*ch) {
+                    case '&': m_out.Write("&amp;", 5); break;
+                    case '<': m_out.Write("&lt;", 4); break;
+                    case '>': m_out.Write("&gt;", 4); break;
+                    case '"': m_out.Write("&quot;", 6); break;
+                    default: m_out.Write(ch, 1); break;
+                }
+            }
+            m_out.Write("</text>\n", 8);
+        }
+
+    private:
+        static std::string Opacity(const char* attribute, float alpha) {
+            if (alpha >= 1.0f) return "";
+            char buffer[48];
+            snprintf(buffer, sizeof(buffer), " %s=\"%.2f\"", attribute, alpha);
+            return buffer;
+        }
+
+        BufferedWriter& m_out;
+        float m_fontSize;
+    };
+
+    // Writes PDF content stream operators, the page is flipped so y goes down like on screen
+    class PDFCanvas : public SheetCanvas {
+    public:
+        PDFCanvas(BufferedWriter& out, float fontSize) : m_out(out), m_fontSize(fontSize) {}
+
+        void Line(const ImVec2& p1, const ImVec2& p2, ImU32 color, float thickness) override {
+            SetStroke(color, thickness, false, 0.0f, 0.0f);
+            m_out.Printf("%.2f %.2f m %.2f %.2f l S\n", p1.x, p1.y, p2.x, p2.y);
+        }
+
+        void DashedLine(const ImVec2& p1, const ImVec2& p2, ImU32 color, float thickness,
+                        float dashLength, float gapLength) override {
+            SetStroke(color, thickness, true, dashLength, gapLength);
+            m_out.Printf("%.2f %.2f m %.2f %.2f l S\n", p1.x, p1.y, p2.x, p2.y);
+        }
+
+        void Circle(const ImVec2& center, float radius, ImU32 color) override {
+            SetFill(color);
+            const float k = 0.5523f * radius; // bezier approximation of a quarter circle
+            float x = center.x, y = center.y;
+            m_out.Printf("%.2f %.2f m %.2f %.2f %.2f %.2f %.2f %.2f c %.2f %.2f %.2f %.2f %.2f %.2f c "
+                         "%.2f %.2f %.2f %.2f %.2f %.2f c %.2f %.2f %.2f %.2f %.2f %.2f c f\n",
+                         x + radius, y,
+                         x + radius, y + k, x + k, y + radius, x, y + radius,
+                         x - k, y + radius, x - radius, y + k, x - radius, y,
+                         x - radius, y - k, x - k, y - radius, x, y - radius,
+                         x + k, y - radius, x + radius, y - k, x + radius, y);
+        }
+
+        void Text(const ImVec2& pos, ImU32 color, const char* text) override {
+            SetFill(color);
+            // un-flip the text matrix, and move from the top left corner to the baseline
+            m_out.Printf("BT /F1 %.1f Tf 1 0 0 -1 %.2f %.2f Tm (", m_fontSize, pos.x, pos.y + m_fontSize * 0.8f);
+            for (const char* ch = text; *ch; ++ch) {
+                if (*ch == '(' || *ch == ')' || *ch == '\\') m_out.Write("\\", 1);
+                m_out.Write(ch, 1);
+            }
+            m_out.Write(") Tj ET\n", 8);
+        }
+
+    private:
+        // only emit state operators when something actually changes
+        void SetStroke(ImU32 color, float thickness, bool dashed, float dashLength, float gapLength) {
+            if (color != m_strokeColor) {
+                RGBA c = Unpack(color);
+                m_out.Printf("%.3f %.3f %.3f RG\n", c.r / 255.0f, c.g / 255.0f, c.b / 255.0f);
+                m_strokeColor = color;
+            }
+            if (thickness != m_thickness) {
+                m_out.Printf("%.2f w\n", thickness);
+                m_thickness = thickness;
+            }
+            if (dashed != m_dashed || (dashed && (dashLength != m_dashLength || gapLength != m_gapLength))) {
+                if (dashed) m_out.Printf("[%.2f %.2f] 0 d\n", dashLength, gapLength);
+                else m_out.Write("[] 0 d\n", 7);
+                m_dashed = dashed;
+                m_dashLength = dashLength;
+                m_gapLength = gapLength;
+            }
+        }
+
+        void SetFill(ImU32 color) {
+            if (color == m_fillColor) return;
+            RGBA c = Unpack(color);
+            m_out.Printf("%.3f %.3f %.3f rg\n", c.r / 255.0f, c.g / 255.0f, c.b / 255.0f);
+            m_fillColor = color;
+        }
+
+        BufferedWriter& m_out;
+        float m_fontSize;
+
+        ImU32 m_strokeColor = IM_COL32(0, 0, 0, 255); // pdf defaults
+        ImU32 m_fillColor = IM_COL32(0, 0, 0, 255);
+        float m_thickness = 1.0f;
+        bool m_dashed = false;
+        float m_dashLength = 0.0f;
+        float m_gapLength = 0.0f;
+    };
+
+    ImU32 ToColor(const float color[3]) {
+        return IM_COL32(color[0] * 255, color[1] * 255, color[2] * 255, 255);
+    }
+}
+
+// EXPORTER -----------------------------------------------------------
+
+float SheetExporter::ComputeZoom(const SceneData& sceneData, const SheetExportOptions& options) const {
+    if (!options.fitToPage) return options.zoom;
+
+    // same transform as DihedralViewport: x = d/2, y = c/3 above and a/3 below the ground line (times 10 * zoom)
+    float maxX = 0.0f, maxY = 0.0f;
+    for (const auto& point : sceneData.points) {
+        if (point.hidden) continue;
+        maxX = std::max(maxX, fabsf(point.coords[0]) / 2.0f * 10.0f);
+        maxY = std::max(maxY, std::max(fabsf(point.coords[1]), fabsf(point.coords[2])) / 3.0f * 10.0f);
+    }
+
+    float defaultZoom = 50.0f / sceneData.settings.worldScale;
+    if (maxX <= 0.0f && maxY <= 0.0f) return defaultZoom;
+
+    float halfWidth = options.pageWidth / 2.0f - options.margin;
+    float halfHeight = options.pageHeight / 2.0f - options.margin;
+    float zoomX = maxX > 0.0f ? halfWidth / maxX : 1e6f;
+    float zoomY = maxY > 0.0f ? halfHeight / maxY : 1e6f;
+
+    return std::clamp(std::min(zoomX, zoomY), 0.05f, 50.0f);
+}
+
+void SheetExporter::DrawSheet(const SceneData& sceneData, SheetCanvas& canvas, const SheetExportOptions& options) {
+    DihedralViewport sheet;
+    sheet.SetZoom(ComputeZoom(sceneData, options));
+    sheet.SetIntersections(m_intersections);
+    sheet.DrawSheet(sceneData, canvas, ImVec2(0.0f, 0.0f), ImVec2(options.pageWidth, options.pageHeight),
+                    ToColor(sceneData.settings.dihedralLineColor));
+}
+
+bool SheetExporter::ExportSVG(const SceneData& sceneData, const std::string& path, const SheetExportOptions& options) {
+    BufferedWriter out;
+    if (!out.Open(path)) {
+        m_lastError = "Failed to open file for writing: " + path;
+        return false;
+    }
+
+    const float* bg = sceneData.settings.dihedralBackgroundColor;
+    out.Printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0fpt\" height=\"%.0fpt\" viewBox=\"0 0 %.2f %.2f\" "
+               "font-family=\"Helvetica, Arial, sans-serif\">\n",
+               options.pageWidth, options.pageHeight, options.pageWidth, options.pageHeight);
+    out.Printf("<rect width=\"100%%\" height=\"100%%\" fill=\"#%02x%02x%02x\"/>\n",
+               static_cast<int>(bg[0] * 255), static_cast<int>(bg[1] * 255), static_cast<int>(bg[2] * 255));
+
+    SVGCanvas canvas(out, options.fontSize);
+    DrawSheet(sceneData, canvas, options);
+
+    out.Write("</svg>\n");
+
+    if (!out.Close()) {
+        m_lastError = "Failed while writing: " + path;
+        return false;
+    }
+    return true;
+}
+
+bool SheetExporter::ExportPDF(const SceneData& sceneData, const std::string& path, const SheetExportOptions& options) {
+    BufferedWriter out;
+    if (!out.Open(path)) {
+        m_lastError = "Failed to open file for writing: " + path;
+        return false;
+    }
+
+    // objects: 1 catalog, 2 pages, 3 page, 4 content stream, 5 font, 6 stream length
+    // the stream length goes in its own object so the content can be streamed without knowing its size
+    uint64_t offsets[7] = {};
+
+    out.Write("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+
+    offsets[1] = out.BytesWritten();
+    out.Write("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+    offsets[2] = out.BytesWritten();
+    out.Write("2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+
+    offsets[3] = out.BytesWritten();
+    out.Printf("3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %.2f %.2f] /Contents 4 0 R "
+               "/Resources << /Font << /F1 5 0 R >> >> >>\nendobj\n",
+               options.pageWidth, options.pageHeight);
+
+    offsets[4] = out.BytesWritten();
+    out.Write("4 0 obj\n<< /Length 6 0 R >>\nstream\n");
+    uint64_t streamStart = out.BytesWritten();
+
+    // flip to y-down and paint the background
+    const float* bg = sceneData.settings.dihedralBackgroundColor;
+    out.Printf("1 0 0 -1 0 %.2f cm\n", options.pageHeight);
+    out.Printf("%.3f %.3f %.3f rg 0 0 %.2f %.2f re f\n", bg[0], bg[1], bg[2], options.pageWidth, options.pageHeight);
+    out.Write("0 0 0 rg\n");
+    out.Write("1 J\n"); // round caps, closer to what ImGui draws
+
+    PDFCanvas canvas(out, options.fontSize);
+    DrawSheet(sceneData, canvas, options);
+
+    uint64_t streamLength = out.BytesWritten() - streamStart;
+    out.Write("endstream\nendobj\n");
+
+    offsets[5] = out.BytesWritten();
+    out.Write("5 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>\nendobj\n");
+
+    offsets[6] = out.BytesWritten();
+    out.Printf("6 0 obj\n%llu\nendobj\n", static_cast<unsigned long long>(streamLength));
+
+    uint64_t xrefOffset = out.BytesWritten();
+    out.Write("xref\n0 7\n0000000000 65535 f \n");
+    for (int i = 1; i <= 6; ++i) {
+        out.Printf("%010llu 00000 n \n", static_cast<unsigned long long>(offsets[i]));
+    }
+    out.Printf("trailer\n<< /Size 7 /Root 1 0 R >>\nstartxref\n%llu\n%%%%EOF\n", static_cast<unsigned long long>(xrefOffset));
+
+    if (!out.Close()) {
+        m_lastError = "Failed while writing: " + path;
+        return false;
+    }
+    return true;
+}
+
+// DOWNLOADS ----------------------------------------------------------
+
+void OfferDownload(const std::string& path, const char* mimeType) {
+#ifdef __EMSCRIPTEN__
+    EM_ASM_({
+        const path = UTF8ToString($0);
+        const mime = UTF8ToString($1);
+        const data = FS.readFile(path);
+        const blob = new Blob([data], {type: mime});
+        const url = URL.createObjectURL(blob);
+
+        const a = document.createElement('a');
+        a.href = url;
+        a.download = path.substring(path.lastIndexOf('/') + 1);
+        document.body.appendChild(a);
+        a.click();
+
+        setTimeout(() => {
+            document.body.removeChild(a);
+            URL.revokeObjectURL(url);
+        }, 100);
+    }, path.c_str(), mimeType);
+#else
+    (void)path;
+    (void)mimeType;
+#endif
+}
@@ -0,0 +1,69 @@
+// exporter.h
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+#include "sheet.h"
+#include "intersections.h"
+
+// Small fixed-size write buffer on top of FILE*, so exports never hold the whole document in memory
+class BufferedWriter {
+public:
+    explicit BufferedWriter(size_t capacity = 64 * 1024);
+    ~BufferedWriter();
+
+    bool Open(const std::string& path);
+    bool Close();
+    bool IsOpen() const { return m_file != nullptr; }
+    bool Failed() const { return m_failed; }
+
+    void Write(const char* data, size_t size);
+    void Write(const std::string& text) { Write(text.data(), text.size()); }
+    void Printf(const char* format, ...);
+    void Flush();
+
+    uint64_t BytesWritten() const { return m_written + m_used; } // includes what is still buffered
+
+private:
+    FILE* m_file = nullptr;
+    std::vector<char> m_buffer;
+    size_t m_used = 0;
+    uint64_t m_written = 0;
+    bool m_failed = false;
+};
+
+struct SheetExportOptions {
+    // A1 landscape in points (841 x 594 mm)
+    float pageWidth = 2384.0f;
+    float pageHeight = 1684.0f;
+    float margin = 40.0f;
+    bool fitToPage = true;    // pick the zoom so every visible point lands on the page
+    float zoom = 1.0f;        // used when fitToPage is off
+    float fontSize = 12.0f;
+};
+
+class SheetExporter {
+public:
+    bool ExportSVG(const SceneData& sceneData, const std::string& path, const SheetExportOptions& options = SheetExportOptions());
+    bool ExportPDF(const SceneData& sceneData, const std::string& path, const SheetExportOptions& options = SheetExportOptions());
+
+    const std::string& GetLastError() const { return m_lastError; }
+
+    // intersections to draw on the sheet, nullptr for none
+    void SetIntersections(const IntersectionResults* results) { m_intersections = results; }
+
+private:
+    float ComputeZoom(const SceneData& sceneData, const SheetExportOptions& options) const;
+    void DrawSheet(const SceneData& sceneData, SheetCanvas& canvas, const SheetExportOptions& options);
+
+    std::string m_lastError;
+    const IntersectionResults* m_intersections = nullptr;
+};
+
+// On the web build files only exist in the virtual filesystem, so hand them to the browser as a download.
+// Does nothing on desktop, where the file is already where the user asked for it.
+void OfferDownload(const std::string& path, const char* mimeType);
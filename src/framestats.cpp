@@ -0,0 +1,39 @@
+#include "framestats.h"
+
+#include <algorithm>
+#include <cmath>
+
+void FrameTimeStats::Add(float milliseconds) {
+    m_times[m_next] = milliseconds;
+    m_next = (m_next + 1) % m_times.size();
+    m_count = std::min(m_count + 1, m_times.size());
+}
+
+float FrameTimeStats::GetMean() const {
+    if (m_count == 0) return 0.0f;
+    double sum = 0.0;
+    for (size_t i = 0; i < m_count; ++i) sum += m_times[i];
+    return static_cast<float>(sum / m_count);
+}
+
+float FrameTimeStats::GetPercentile(float percentile) const {
+    if (m_count == 0) return 0.0f;
+
+    // nearest rank, nth_element is linear and the window is a few hundred frames
+    m_sorted.assign(m_times.begin(), m_times.begin() + m_count);
+    size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0f * m_count));
+    rank = std::min(std::max(rank, size_t(1)), m_count) - 1;
+    std::nth_element(m_sorted.begin(), m_sorted.begin() + rank, m_sorted.end());
+    return m_sorted[rank];
+}
+
+float FrameTimeStats::GetMax() const {
+    if (m_count == 0) return 0.0f;
+    return *std::max_element(m_times.begin(), m_times.begin() + m_count);
+}
+
+void FrameTimeStats::CopyOrdered(std::vector<float>& out) const {
+    out.clear();
+    const size_t first = m_count < m_times.size() ? 0 : m_next;
+    for (size_t i = 0; i < m_count; ++i) out.push_back(m_times[(first + i) % m_times.size()]);
+}
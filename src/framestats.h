@@ -0,0 +1,30 @@
+// framestats.h
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// The last few seconds of frame times, for percentiles. A mean hides the stutters that matter,
+// p95/p99 and the worst frame show them.
+class FrameTimeStats {
+public:
+    explicit FrameTimeStats(size_t capacity = 300) : m_times(capacity, 0.0f) {}
+
+    void Add(float milliseconds);
+    void Clear() { m_count = 0; m_next = 0; }
+
+    size_t GetCount() const { return m_count; }
+    float GetLatest() const { return m_count ? m_times[(m_next + m_times.size() - 1) % m_times.size()] : 0.0f; }
+    float GetMean() const;
+    float GetPercentile(float percentile) const; // 0-100, over what's in the window
+    float GetMax() const;
+
+    // oldest first, for plotting
+    void CopyOrdered(std::vector<float>& out) const;
+
+private:
+    std::vector<float> m_times; // ring buffer
+    size_t m_count = 0;
+    size_t m_next = 0;
+    mutable std::vector<float> m_sorted; // scratch for the percentiles
+};
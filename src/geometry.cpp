@@ -0,0 +1,92 @@
+#include "geometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ExtendToRect(const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& min, const glm::vec2& max,
+                  glm::vec2& edge1, glm::vec2& edge2) {
+    // vertical lines (x1 == x2)
+    if (std::fabs(p2.x - p1.x) < 0.0001f) {
+        edge1 = glm::vec2(p1.x, min.y);
+        edge2 = glm::vec2(p1.x, max.y);
+        return;
+    }
+    // horizontal lines (y1 == y2)
+    if (std::fabs(p2.y - p1.y) < 0.0001f) {
+        edge1 = glm::vec2(min.x, p1.y);
+        edge2 = glm::vec2(max.x, p1.y);
+        return;
+    }
+
+    float m = (p2.y - p1.y) / (p2.x - p1.x);
+    float b = p1.y - m * p1.x;
+
+    if (std::fabs(p2.x - p1.x) > std::fabs(p2.y - p1.y)) {
+        edge1 = glm::vec2(min.x, m * min.x + b);
+        edge2 = glm::vec2(max.x, m * max.x + b);
+    } else {
+        edge1 = glm::vec2((min.y - b) / m, min.y);
+        edge2 = glm::vec2((max.y - b) / m, max.y);
+    }
+}
+
+bool ClipToRect(const glm::vec2& p, const glm::vec2& dir, const glm::vec2& min, const glm::vec2& max,
+                float& tMin, float& tMax) {
+    tMin = -HUGE_VALF;
+    tMax = HUGE_VALF;
+    const float d[4] = { -dir.x, dir.x, -dir.y, dir.y };
+    const float q[4] = { p.x - min.x, max.x - p.x, p.y - min.y, max.y - p.y };
+    for (int i = 0; i < 4; ++i) {
+        if (d[i] == 0.0f) {
+            if (q[i] < 0.0f) return false; // parallel and outside
+            continue;
+        }
+        float t = q[i] / d[i];
+        if (d[i] < 0.0f) tMin = std::max(tMin, t);
+        else tMax = std::min(tMax, t);
+    }
+    return tMin <= tMax;
+}
+
+void ThickLineQuad(const glm::vec3& start, const glm::vec3& end, const glm::vec3& cameraPos, float thickness,
+                   glm::vec3 out[6]) {
+    glm::vec3 lineDir = glm::normalize(end - start);
+    glm::vec3 cameraToLine = glm::normalize((start + end) * 0.5f - cameraPos);
+    glm::vec3 right = glm::normalize(glm::cross(cameraToLine, lineDir)) * thickness * 0.5f;
+    glm::vec3 up = glm::normalize(glm::cross(lineDir, right)) * thickness * 0.5f;
+
+    out[0] = start - right - up;
+    out[1] = start + right - up;
+    out[2] = end - right + up;
+    out[3] = start + right - up;
+    out[4] = end + right + up;
+    out[5] = end - right + up;
+}
+
+PlaneBasis ComputePlaneBasis(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+    PlaneBasis basis;
+    basis.normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+    basis.offset = -glm::dot(basis.normal, p0);
+
+    // any direction on the plane will do, the world up one unless the plane is (almost) horizontal
+    if (std::fabs(basis.normal.y) > 0.999f) {
+        basis.right = glm::vec3(1, 0, 0);
+        basis.forward = glm::vec3(0, 0, 1);
+    } else {
+        basis.right = glm::normalize(glm::cross(basis.normal, glm::vec3(0, 1, 0)));
+        basis.forward = glm::normalize(glm::cross(basis.normal, basis.right));
+    }
+    return basis;
+}
+
+void ExpandedPlaneQuad(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float size, float limit,
+                       glm::vec3 out[4]) {
+    const PlaneBasis basis = ComputePlaneBasis(p0, p1, p2);
+    const glm::vec3 center = -basis.normal * basis.offset;
+
+    out[0] = center + (basis.right + basis.forward) * size;
+    out[1] = center + (basis.right - basis.forward) * size;
+    out[2] = center + (-basis.right - basis.forward) * size;
+    out[3] = center + (-basis.right + basis.forward) * size;
+    for (int i = 0; i < 4; ++i) out[i] = glm::clamp(out[i], -limit, limit);
+}
@@ -0,0 +1,47 @@
+// geometry.h
+#pragma once
+
+#include <glm/glm.hpp>
+
+// The projection, clipping and plane math the sheet and the 3D view draw with. No GL or ImGui in here,
+// so it builds into diedrico_core and runs headless (bench/core_bench.cpp measures every function).
+
+// Where the dihedral sheet puts model coordinates (d, a, c): d/2 across, c/3 up for the vertical projection
+// and a/3 down for the horizontal one, times scale (10 * zoom on screen), around the middle of the ground line
+struct SheetProjection {
+    glm::vec2 center;
+    float scale;
+
+    glm::vec2 Vertical(float d, float c) const { return glm::vec2(center.x + d / 2.0f * scale, center.y - c / 3.0f * scale); }
+    glm::vec2 Horizontal(float d, float a) const { return glm::vec2(center.x + d / 2.0f * scale, center.y + a / 3.0f * scale); }
+    glm::vec2 Vertical(const float coords[3]) const { return Vertical(coords[0], coords[2]); }
+    glm::vec2 Horizontal(const float coords[3]) const { return Horizontal(coords[0], coords[1]); }
+    glm::vec2 Ground(float d) const { return glm::vec2(center.x + d / 2.0f * scale, center.y); } // on the ground line
+};
+
+// Where the line through p1 and p2 meets the edges of the rectangle, along its longer axis
+void ExtendToRect(const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& min, const glm::vec2& max,
+                  glm::vec2& edge1, glm::vec2& edge2);
+
+// Range of t where p + t * dir is inside the rectangle (Liang-Barsky), false when no part of the line is
+bool ClipToRect(const glm::vec2& p, const glm::vec2& dir, const glm::vec2& min, const glm::vec2& max,
+                float& tMin, float& tMax);
+
+// Two triangles along start-end facing the camera, thickness wide
+void ThickLineQuad(const glm::vec3& start, const glm::vec3& end, const glm::vec3& cameraPos, float thickness,
+                   glm::vec3 out[6]);
+
+// Unit normal of the plane through three points and two unit directions along it, normal . x + offset = 0
+struct PlaneBasis {
+    glm::vec3 normal;
+    glm::vec3 right;
+    glm::vec3 forward;
+    float offset;
+};
+
+PlaneBasis ComputePlaneBasis(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2);
+
+// The square an expanded plane is drawn as, size to every side of the plane point closest to the origin,
+// corners clamped to [-limit, limit]
+void ExpandedPlaneQuad(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float size, float limit,
+                       glm::vec3 out[4]);
@@ -0,0 +1,108 @@
+#include "glstate.h"
+
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+
+void GlState::Invalidate() {
+    m_program = UNKNOWN;
+    m_vao = UNKNOWN;
+    m_arrayBuffer = UNKNOWN;
+    m_blendSource = m_blendDestination = UNKNOWN;
+    for (int& enabled : m_enabled) enabled = -1;
+    m_depthMask = -1;
+}
+
+bool GlState::Apply(bool changed) {
+    if (changed) m_applied++;
+    else m_skipped++;
+    return changed;
+}
+
+void GlState::UseProgram(GLuint program) {
+    if (!Apply(m_program != program)) return;
+    glUseProgram(program);
+    m_program = program;
+}
+
+void GlState::BindVertexArray(GLuint vao) {
+    if (!Apply(m_vao != vao)) return;
+    glBindVertexArray(vao);
+    m_vao = vao;
+}
+
+void GlState::BindArrayBuffer(GLuint buffer) {
+    if (!Apply(m_arrayBuffer != buffer)) return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    m_arrayBuffer = buffer;
+}
+
+void GlState::SetEnabled(GLenum capability, bool enabled) {
+    int index = CapabilityCount;
+    switch (capability) {
+        case GL_DEPTH_TEST: index = DepthTest; break;
+        case GL_BLEND: index = Blend; break;
+        case GL_PROGRAM_POINT_SIZE: index = ProgramPointSize; break;
+        default: break;
+    }
+
+    if (index == CapabilityCount) {
+        m_applied++; // untracked, always goes through
+    } else {
+        if (!Apply(m_enabled[index] != static_cast<int>(enabled))) return;
+        m_enabled[index] = enabled;
+    }
+    if (enabled) glEnable(capability);
+    else glDisable(capability);
+}
+
+void GlState::BlendFunc(GLenum source, GLenum destination) {
+    if (!Apply(m_blendSource != source || m_blendDestination != destination)) return;
+    glBlendFunc(source, destination);
+    m_blendSource = source;
+    m_blendDestination = destination;
+}
+
+void GlState::DepthMask(bool write) {
+    if (!Apply(m_depthMask != static_cast<int>(write))) return;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+    m_depthMask = write;
+}
+
+GlState::Uniform& GlState::FindUniform(GLuint program, const char* name) {
+    // glUniform writes to the bound program, make sure that's the one this cache entry is for
+    if (m_program != program) UseProgram(program);
+    for (Uniform& uniform : m_uniforms) {
+        if (uniform.program == program && std::strcmp(uniform.name, name) == 0) return uniform;
+    }
+    m_uniforms.push_back({ program, name, glGetUniformLocation(program, name), false, glm::vec3(0.0f) });
+    return m_uniforms.back();
+}
+
+bool GlState::SetUniform(GLuint program, const char* name, float value) {
+    Uniform& uniform = FindUniform(program, name);
+    if (uniform.known && uniform.value.x == value) {
+        m_skipped++;
+        return false;
+    }
+    glUniform1f(uniform.location, value);
+    uniform.known = true;
+    uniform.value.x = value;
+    return true;
+}
+
+bool GlState::SetUniform(GLuint program, const char* name, const glm::vec3& value) {
+    Uniform& uniform = FindUniform(program, name);
+    if (uniform.known && uniform.value == value) {
+        m_skipped++;
+        return false;
+    }
+    glUniform3f(uniform.location, value.x, value.y, value.z);
+    uniform.known = true;
+    uniform.value = value;
+    return true;
+}
+
+bool GlState::SetUniform(GLuint program, const char* name, const glm::mat4& value) {
+    glUniformMatrix4fv(FindUniform(program, name).location, 1, GL_FALSE, glm::value_ptr(value));
+    return true;
+}
@@ -0,0 +1,69 @@
+// glstate.h
+#pragma once
+
+#ifdef __EMSCRIPTEN__
+#include <GLES3/gl3.h>
+#else
+#include <glad/glad.h>
+#endif
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#ifndef GL_PROGRAM_POINT_SIZE
+#define GL_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+// What the renderer last set on the context, so setting it again never reaches the driver. Between
+// Invalidate calls only the renderer may change this state (the ImGui backend puts back whatever it changes),
+// anything unknown after Invalidate goes to GL the next time it's set.
+class GlState {
+public:
+    void Invalidate();
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vao);
+    void BindArrayBuffer(GLuint buffer);
+    void SetEnabled(GLenum capability, bool enabled); // depth test, blending and program point size are tracked
+    void BlendFunc(GLenum source, GLenum destination);
+    void DepthMask(bool write);
+
+    // Uniforms of program, which gets bound first if it isn't. Locations are looked up once, values go to GL only
+    // when they changed (matrices always do). False when the call was filtered out.
+    bool SetUniform(GLuint program, const char* name, float value);
+    bool SetUniform(GLuint program, const char* name, const glm::vec3& value);
+    bool SetUniform(GLuint program, const char* name, const glm::mat4& value);
+
+    unsigned GetApplied() const { return m_applied; } // binds and enables that reached GL since ResetCounters
+    unsigned GetSkipped() const { return m_skipped; } // state and uniform calls that didn't
+    void ResetCounters() { m_applied = 0; m_skipped = 0; }
+
+private:
+    enum Capability { DepthTest, Blend, ProgramPointSize, CapabilityCount };
+
+    struct Uniform {
+        GLuint program;
+        const char* name; // the renderer only passes literals
+        GLint location;
+        bool known; // value has been set at least once
+        glm::vec3 value;
+    };
+
+    bool Apply(bool changed); // counts the call, true when it has to reach GL
+    Uniform& FindUniform(GLuint program, const char* name);
+
+    static constexpr GLuint UNKNOWN = 0xFFFFFFFFu; // no GL name or enum is ever this
+
+    GLuint m_program = UNKNOWN;
+    GLuint m_vao = UNKNOWN;
+    GLuint m_arrayBuffer = UNKNOWN;
+    GLenum m_blendSource = UNKNOWN, m_blendDestination = UNKNOWN;
+    int m_enabled[CapabilityCount] = { -1, -1, -1 }; // -1 is unknown
+    int m_depthMask = -1;
+
+    // program objects keep their uniforms, these survive Invalidate
+    std::vector<Uniform> m_uniforms;
+
+    unsigned m_applied = 0;
+    unsigned m_skipped = 0;
+};
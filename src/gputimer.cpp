@@ -0,0 +1,84 @@
+#include "gputimer.h"
+
+#include <cstring>
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+namespace {
+    constexpr float SMOOTHING = 0.1f; // weight of the newest result, the HUD would flicker otherwise
+
+    bool HasExtension(const char* name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && strcmp(extension, name) == 0) return true;
+        }
+        return false;
+    }
+}
+
+void GpuTimer::Initialize() {
+    m_disjointCheck = HasExtension("GL_EXT_disjoint_timer_query") || HasExtension("GL_EXT_disjoint_timer_query_webgl2");
+    m_available = m_disjointCheck || HasExtension("GL_ARB_timer_query");
+    while (glGetError() != GL_NO_ERROR) {} // drivers without GL_NUM_EXTENSIONS leave an error behind
+}
+
+void GpuTimer::BeginFrame() {
+    if (!m_available) return;
+
+    m_frame = (m_frame + 1) % LATENCY;
+    Frame& frame = m_frames[m_frame];
+    if (frame.passes.empty()) return;
+
+    // the last query finishing means all of them did, otherwise this frame is skipped rather than waited for
+    GLuint available = 0;
+    glGetQueryObjectuiv(frame.queries[frame.passes.size() - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    GLint disjoint = 0;
+    if (m_disjointCheck) glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    if (available && !disjoint) {
+        double nanoseconds[static_cast<int>(GpuPass::Count)] = {};
+        for (size_t i = 0; i < frame.passes.size(); ++i) {
+            GLuint elapsed = 0; // 32 bits of nanoseconds is 4 seconds, plenty for a pass
+            glGetQueryObjectuiv(frame.queries[i], GL_QUERY_RESULT, &elapsed);
+            nanoseconds[frame.passes[i]] += elapsed;
+        }
+        for (int pass = 0; pass < static_cast<int>(GpuPass::Count); ++pass) {
+            const float milliseconds = static_cast<float>(nanoseconds[pass] / 1e6);
+            const float smoothed = m_milliseconds[pass].load(std::memory_order_relaxed);
+            m_milliseconds[pass].store(smoothed + (milliseconds - smoothed) * SMOOTHING, std::memory_order_relaxed);
+        }
+    }
+    frame.passes.clear();
+}
+
+void GpuTimer::Begin(GpuPass pass) {
+    if (!m_available || m_depth++ > 0) return; // nested passes count towards the outer one
+
+    Frame& frame = m_frames[m_frame];
+    if (frame.passes.size() == frame.queries.size()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    glBeginQuery(GL_TIME_ELAPSED_EXT, frame.queries[frame.passes.size()]);
+    frame.passes.push_back(static_cast<int>(pass));
+}
+
+void GpuTimer::End() {
+    if (m_depth == 0 || --m_depth > 0) return;
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+}
+
+float GpuTimer::GetTotalMilliseconds() const {
+    float total = 0.0f;
+    for (const auto& milliseconds : m_milliseconds) total += milliseconds.load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,69 @@
+// gputimer.h
+#pragma once
+
+#ifdef __EMSCRIPTEN__
+#include <GLES3/gl3.h>
+#else
+#include <glad/glad.h>
+#endif
+
+#include <atomic>
+#include <vector>
+
+// What the GPU time of a frame is split into, in the order they're drawn
+enum class GpuPass {
+    Axes,
+    DihedralPlanes,
+    Points,
+    Lines,
+    Planes,
+    Markers,
+    ImGui,
+    Count
+};
+
+// GPU time per pass with timer queries (GL_EXT_disjoint_timer_query, its webgl2 version or GL_ARB_timer_query).
+// Results are read a few frames late so the CPU never waits for the GPU. Drivers without timer queries make
+// every call a no-op and IsAvailable false.
+class GpuTimer {
+public:
+    void Initialize();
+    bool IsAvailable() const { return m_available; }
+
+    void BeginFrame(); // reads the frame that went out LATENCY frames ago
+    // GL times one query at a time, a pass started inside another counts as the outer one.
+    // A pass can be timed several times a frame and the times add up.
+    void Begin(GpuPass pass);
+    void End();
+
+    // safe to read from another thread than the one drawing (the render thread)
+    float GetMilliseconds(GpuPass pass) const { return m_milliseconds[static_cast<int>(pass)].load(std::memory_order_relaxed); }
+    float GetTotalMilliseconds() const;
+
+private:
+    static constexpr int LATENCY = 4;
+
+    struct Frame {
+        std::vector<GLuint> queries; // grows to the most queries a frame ever used
+        std::vector<int> passes;     // pass of each query issued this frame
+    };
+
+    bool m_available = false;
+    bool m_disjointCheck = false; // only the EXT versions report disjoint operations (GPU clock changes)
+    int m_depth = 0;
+    int m_frame = 0;
+    Frame m_frames[LATENCY];
+    std::atomic<float> m_milliseconds[static_cast<int>(GpuPass::Count)] = {};
+};
+
+// Times the enclosing block as one pass
+class GpuScope {
+public:
+    GpuScope(GpuTimer& timer, GpuPass pass) : m_timer(timer) { m_timer.Begin(pass); }
+    ~GpuScope() { m_timer.End(); }
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+
+private:
+    GpuTimer& m_timer;
+};
@@ -0,0 +1,272 @@
+#include "history.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+    uint64_t TouchKey(EntityKind kind, int index) {
+        return (static_cast<uint64_t>(kind) << 32) | static_cast<uint32_t>(index);
+    }
+
+    bool SameState(const Point& a, const Point& b) {
+        return a.name == b.name && a.hidden == b.hidden && a.userCreated == b.userCreated &&
+               memcmp(a.coords, b.coords, sizeof(a.coords)) == 0 && memcmp(a.color, b.color, sizeof(a.color)) == 0;
+    }
+    bool SameState(const Line& a, const Line& b) {
+        return a.name == b.name && a.point1index == b.point1index && a.point2index == b.point2index &&
+               a.showVisibility == b.showVisibility && memcmp(a.color, b.color, sizeof(a.color)) == 0;
+    }
+    bool SameState(const Plane& a, const Plane& b) {
+        return a.name == b.name && a.point1index == b.point1index && a.point2index == b.point2index &&
+               a.point3index == b.point3index && a.expand == b.expand && memcmp(a.color, b.color, sizeof(a.color)) == 0;
+    }
+
+    size_t EntityCount(const SceneData& sceneData, int kind) {
+        if (kind == static_cast<int>(EntityKind::Point)) return sceneData.points.size();
+        if (kind == static_cast<int>(EntityKind::Line)) return sceneData.lines.size();
+        return sceneData.planes.size();
+    }
+
+    // one op on one entity list, forwards (redo) or backwards (undo)
+    template <typename Entities, typename Entity>
+    void ApplyOp(Entities& entities, const std::vector<Entity>& pool, int type, int index, int before, int after, bool undo) {
+        enum { Modify, Append, Erase };
+        if (type == Modify) {
+            entities[index] = pool[undo ? before : after];
+        }
+        else if (type == Append) {
+            if (undo) entities.pop_back();
+            else entities.push_back(pool[after]);
+        }
+        else {
+            if (undo) entities.insert(entities.begin() + index, pool[before]);
+            else entities.erase(entities.begin() + index);
+        }
+    }
+}
+
+void History::Begin(const SceneData& sceneData, uint32_t mergeKey) {
+    if (m_depth++ > 0) return;
+
+    m_open = Step();
+    m_open.mergeKey = mergeKey;
+    m_touched.clear();
+    for (int k = 0; k < 3; ++k) m_baseSize[k] = m_beginSize[k] = EntityCount(sceneData, k);
+}
+
+template <typename Entity>
+void History::TouchState(EntityKind kind, int index, const Entity& before) {
+    if (m_depth == 0 || index < 0) return;
+    // entities added in this step come back through their Append op
+    if (static_cast<size_t>(index) >= m_baseSize[static_cast<int>(kind)]) return;
+    if (!m_touched.insert(TouchKey(kind, index)).second) return;
+
+    Op op;
+    op.type = OpType::Modify;
+    op.kind = kind;
+    op.index = index;
+    op.before = Store(before);
+    m_open.ops.push_back(op);
+}
+
+void History::Touch(int index, const Point& before) { TouchState(EntityKind::Point, index, before); }
+void History::Touch(int index, const Line& before) { TouchState(EntityKind::Line, index, before); }
+void History::Touch(int index, const Plane& before) { TouchState(EntityKind::Plane, index, before); }
+
+void History::Touch(const SceneData& sceneData, EntityKind kind, int index) {
+    if (index < 0 || static_cast<size_t>(index) >= EntityCount(sceneData, static_cast<int>(kind))) return;
+    switch (kind) {
+        case EntityKind::Point: Touch(index, sceneData.points[index]); break;
+        case EntityKind::Line: Touch(index, sceneData.lines[index]); break;
+        case EntityKind::Plane: Touch(index, sceneData.planes[index]); break;
+    }
+}
+
+void History::Erasing(const SceneData& sceneData, EntityKind kind, int index) {
+    const int k = static_cast<int>(kind);
+    if (m_depth == 0 || index < 0 || static_cast<size_t>(index) >= EntityCount(sceneData, k)) return;
+
+    // appended in this same step: it just never gets an Append op, undo has nothing to put back
+    if (static_cast<size_t>(index) >= m_baseSize[k]) return;
+
+    // indices of this kind shift after the erase, take the after states of what was touched while they still match
+    CaptureAfter(sceneData, k);
+    m_touched.clear();
+
+    Op op;
+    op.type = OpType::Erase;
+    op.kind = kind;
+    op.index = index;
+    switch (kind) {
+        case EntityKind::Point: op.before = Store(sceneData.points[index]); break;
+        case EntityKind::Line: op.before = Store(sceneData.lines[index]); break;
+        case EntityKind::Plane: op.before = Store(sceneData.planes[index]); break;
+    }
+    m_open.ops.push_back(op);
+    m_baseSize[k]--;
+}
+
+void History::CaptureAfter(const SceneData& sceneData, int kind) {
+    for (auto& op : m_open.ops) {
+        if (op.type != OpType::Modify || op.after >= 0) continue;
+        if (kind >= 0 && static_cast<int>(op.kind) != kind) continue;
+
+        switch (op.kind) {
+            case EntityKind::Point: op.after = Store(sceneData.points[op.index]); break;
+            case EntityKind::Line: op.after = Store(sceneData.lines[op.index]); break;
+            case EntityKind::Plane: op.after = Store(sceneData.planes[op.index]); break;
+        }
+    }
+}
+
+bool History::IsNoOp(const Step& step, const Op& op) const {
+    if (op.type != OpType::Modify) return false;
+    switch (op.kind) {
+        case EntityKind::Point: return SameState(step.points[op.before], step.points[op.after]);
+        case EntityKind::Line: return SameState(step.lines[op.before], step.lines[op.after]);
+        case EntityKind::Plane: return SameState(step.planes[op.before], step.planes[op.after]);
+    }
+    return false;
+}
+
+void History::Commit(const SceneData& sceneData) {
+    if (m_depth == 0 || --m_depth > 0) return;
+
+    CaptureAfter(sceneData, -1);
+
+#ifndef NDEBUG
+    // every Erase op has to be of something that was there when the step began, or undo would bring back
+    // an entity that never existed (appending and erasing it again in one step did that once)
+    size_t erased[3] = { 0, 0, 0 };
+    for (const Op& op : m_open.ops) {
+        if (op.type == OpType::Erase) erased[static_cast<int>(op.kind)]++;
+    }
+    for (int k = 0; k < 3; ++k) assert(m_beginSize[k] - erased[k] == m_baseSize[k]);
+#endif
+
+    // whatever is past the starting counts was appended during the step
+    for (int k = 0; k < 3; ++k) {
+        const size_t count = EntityCount(sceneData, k);
+        for (size_t i = m_baseSize[k]; i < count; ++i) {
+            Op op;
+            op.type = OpType::Append;
+            op.kind = static_cast<EntityKind>(k);
+            op.index = static_cast<int>(i);
+            if (k == 0) op.after = Store(sceneData.points[i]);
+            else if (k == 1) op.after = Store(sceneData.lines[i]);
+            else op.after = Store(sceneData.planes[i]);
+            m_open.ops.push_back(op);
+        }
+    }
+
+    // widgets report edits that end up changing nothing (clicking a checkbox twice in a step, a zero drag)
+    m_open.ops.erase(std::remove_if(m_open.ops.begin(), m_open.ops.end(),
+        [&](const Op& op) { return IsNoOp(m_open, op); }), m_open.ops.end());
+    m_touched.clear();
+    if (m_open.ops.empty()) return;
+
+    if (m_onChange) {
+        for (const Op& op : m_open.ops) Report(m_open, op, false);
+    }
+
+    if (m_open.mergeKey != 0 && m_redo.empty() && !m_undo.empty()) {
+        Step& last = m_undo.back();
+        if (!last.sealed && last.mergeKey == m_open.mergeKey && SameOps(last, m_open)) {
+            // same widget still going: keep the first before states, take the newest after states
+            for (size_t i = 0; i < last.ops.size(); ++i) {
+                const Op& op = m_open.ops[i];
+                if (op.after < 0) continue;
+                switch (op.kind) {
+                    case EntityKind::Point: last.points[last.ops[i].after] = m_open.points[op.after]; break;
+                    case EntityKind::Line: last.lines[last.ops[i].after] = m_open.lines[op.after]; break;
+                    case EntityKind::Plane: last.planes[last.ops[i].after] = m_open.planes[op.after]; break;
+                }
+            }
+            return;
+        }
+    }
+
+    if (!m_undo.empty()) m_undo.back().sealed = true;
+    m_undo.push_back(std::move(m_open));
+    m_redo.clear();
+    while (m_undo.size() > m_limit) m_undo.pop_front();
+}
+
+bool History::SameOps(const Step& a, const Step& b) const {
+    if (a.ops.size() != b.ops.size()) return false;
+    for (size_t i = 0; i < a.ops.size(); ++i) {
+        if (a.ops[i].type != b.ops[i].type || a.ops[i].kind != b.ops[i].kind || a.ops[i].index != b.ops[i].index) return false;
+        if (a.ops[i].type != OpType::Modify) return false; // only edits in place merge
+    }
+    return true;
+}
+
+void History::Apply(SceneData& sceneData, const Step& step, bool undo) const {
+    const size_t count = step.ops.size();
+    for (size_t n = 0; n < count; ++n) {
+        const Op& op = step.ops[undo ? count - 1 - n : n];
+        const int type = static_cast<int>(op.type);
+        switch (op.kind) {
+            case EntityKind::Point: ApplyOp(sceneData.points, step.points, type, op.index, op.before, op.after, undo); break;
+            case EntityKind::Line: ApplyOp(sceneData.lines, step.lines, type, op.index, op.before, op.after, undo); break;
+            case EntityKind::Plane: ApplyOp(sceneData.planes, step.planes, type, op.index, op.before, op.after, undo); break;
+        }
+        if (m_onChange) Report(step, op, undo);
+    }
+}
+
+void History::Report(const Step& step, const Op& op, bool undo) const {
+    SceneChange change;
+    change.kind = op.kind;
+    change.index = op.index;
+
+    int state = -1;
+    if (op.type == OpType::Modify) {
+        change.type = SceneChange::Set;
+        state = undo ? op.before : op.after;
+    }
+    else if ((op.type == OpType::Append) != undo) { // an append, or an erase being undone
+        change.type = SceneChange::Insert;
+        state = undo ? op.before : op.after;
+    }
+    else {
+        change.type = SceneChange::Erase;
+    }
+
+    if (state >= 0) {
+        switch (op.kind) {
+            case EntityKind::Point: change.point = &step.points[state]; break;
+            case EntityKind::Line: change.line = &step.lines[state]; break;
+            case EntityKind::Plane: change.plane = &step.planes[state]; break;
+        }
+    }
+    m_onChange(change);
+}
+
+bool History::Undo(SceneData& sceneData) {
+    if (!CanUndo()) return false;
+
+    Apply(sceneData, m_undo.back(), true);
+    m_undo.back().sealed = true; // redoing and editing again shouldn't fold into it
+    m_redo.push_back(std::move(m_undo.back()));
+    m_undo.pop_back();
+    return true;
+}
+
+bool History::Redo(SceneData& sceneData) {
+    if (!CanRedo()) return false;
+
+    Apply(sceneData, m_redo.back(), false);
+    m_undo.push_back(std::move(m_redo.back()));
+    m_redo.pop_back();
+    return true;
+}
+
+void History::Clear() {
+    m_undo.clear();
+    m_redo.clear();
+    m_open = Step();
+    m_depth = 0;
+    m_touched.clear();
+}
@@ -0,0 +1,102 @@
+// history.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+#include "scene.h"
+
+// One entity level change in the order it reaches the scene, what something mirroring the scene (the autosave journal)
+// needs to follow along. The entity is the state afterwards, null for an erase.
+struct SceneChange {
+    enum Type : uint8_t { Set, Insert, Erase };
+    Type type;
+    EntityKind kind;
+    int index;
+    const Point* point = nullptr;
+    const Line* line = nullptr;
+    const Plane* plane = nullptr;
+};
+
+// Undo/redo as a journal of small steps. A step only keeps the entities it touched (before and after),
+// never the whole scene, so memory grows with the edits and undoing costs as much as the edit did.
+class History {
+public:
+    // Everything between Begin and Commit is one step, nested pairs fold into the outer one.
+    // A step with a non zero mergeKey folds into the previous one with the same key until Seal,
+    // that's how a drag or a color picker that edits every frame ends up as a single step.
+    void Begin(const SceneData& sceneData, uint32_t mergeKey = 0);
+    void Commit(const SceneData& sceneData);
+    bool IsOpen() const { return m_depth > 0; }
+    void Seal() { if (!m_undo.empty()) m_undo.back().sealed = true; }
+
+    // Call before changing an existing entity, the first state seen in a step is the one undo goes back to
+    void Touch(const SceneData& sceneData, EntityKind kind, int index);
+    // for widgets that change the entity themselves: the copy taken before the widget ran
+    void Touch(int index, const Point& before);
+    void Touch(int index, const Line& before);
+    void Touch(int index, const Plane& before);
+    // before erasing an entity, several erases in one step go from the highest index down.
+    // Entities appended earlier in the same step aren't recorded, they simply never get an Append op.
+    void Erasing(const SceneData& sceneData, EntityKind kind, int index);
+    // entities pushed to the back during a step need nothing, Commit picks them up
+
+    bool Undo(SceneData& sceneData);
+    bool Redo(SceneData& sceneData);
+    bool CanUndo() const { return !m_undo.empty() && !IsOpen(); }
+    bool CanRedo() const { return !m_redo.empty() && !IsOpen(); }
+
+    // Called for every change of a committed step, an undo or a redo. Commits that fold into the previous step
+    // are reported too, a drag reports the same entities every frame.
+    void SetChangeHandler(std::function<void(const SceneChange&)> handler) { m_onChange = std::move(handler); }
+
+    void Clear(); // a different scene was loaded
+    void SetLimit(size_t steps) { m_limit = steps; }
+    size_t GetUndoCount() const { return m_undo.size(); }
+    size_t GetRedoCount() const { return m_redo.size(); }
+
+private:
+    enum class OpType : uint8_t { Modify, Append, Erase };
+    struct Op {
+        OpType type;
+        EntityKind kind;
+        int index;
+        int before = -1; // slots in the step's pools, -1 when the op has no such state
+        int after = -1;
+    };
+    struct Step {
+        std::vector<Op> ops;
+        std::vector<Point> points;
+        std::vector<Line> lines;
+        std::vector<Plane> planes;
+        uint32_t mergeKey = 0;
+        bool sealed = false;
+    };
+
+    int Store(const Point& point) { m_open.points.push_back(point); return static_cast<int>(m_open.points.size() - 1); }
+    int Store(const Line& line) { m_open.lines.push_back(line); return static_cast<int>(m_open.lines.size() - 1); }
+    int Store(const Plane& plane) { m_open.planes.push_back(plane); return static_cast<int>(m_open.planes.size() - 1); }
+    template <typename Entity> void TouchState(EntityKind kind, int index, const Entity& before);
+
+    void CaptureAfter(const SceneData& sceneData, int kind); // pending Modify ops of a kind, -1 for all
+    bool SameOps(const Step& a, const Step& b) const;
+    bool IsNoOp(const Step& step, const Op& op) const;
+    void Apply(SceneData& sceneData, const Step& step, bool undo) const;
+    void Report(const Step& step, const Op& op, bool undo) const;
+
+    std::deque<Step> m_undo; // oldest steps fall off the front past the limit
+    std::vector<Step> m_redo;
+    size_t m_limit = 500;
+
+    Step m_open;
+    int m_depth = 0;
+    size_t m_baseSize[3] = { 0, 0, 0 };     // entity counts when the step began, minus erased ones
+    size_t m_beginSize[3] = { 0, 0, 0 };    // without the minus, only for the check in Commit
+    std::unordered_set<uint64_t> m_touched; // kind and index of the entities the open step already keeps
+
+    std::function<void(const SceneChange&)> m_onChange;
+};
@@ -0,0 +1,231 @@
+#include "inputrec.h"
+#include "autosave.h"
+
+#include <imgui.h>
+#include <imgui_internal.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char MAGIC[4] = { 'D', 'R', 'E', 'C' };
+    const uint32_t VERSION = 1;
+    const long FRAME_COUNT_OFFSET = 8; // after the magic and the version, patched when the recording stops
+
+    // our own numbers in the file, ImGui's enum changes between versions
+    enum EventType : uint8_t { EventMousePos, EventMouseWheel, EventMouseButton, EventKey, EventText, EventFocus };
+
+    template <typename T>
+    void Put(std::vector<uint8_t>& out, const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    bool Get(FILE* file, T& value) {
+        return fread(&value, sizeof(T), 1, file) == 1;
+    }
+
+    std::string ScenePath(const std::string& path) { return path + ".scene"; }
+}
+
+bool InputRecorder::StartRecording(const std::string& path, const SceneData& sceneData, int width, int height) {
+    Stop();
+
+    // the scene it starts from, in the autosave format so it doesn't need a second serializer
+    Autosave scene;
+    if (!scene.Start(ScenePath(path), sceneData)) {
+        std::cerr << "Failed to save the starting scene of the recording: " << ScenePath(path) << std::endl;
+        return false;
+    }
+    scene.Stop(true);
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file) {
+        std::cerr << "Failed to open file for writing: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<uint8_t> header;
+    header.insert(header.end(), MAGIC, MAGIC + sizeof(MAGIC));
+    Put(header, VERSION);
+    Put(header, uint32_t(0)); // frame count
+    Put(header, FIXED_STEP);
+    Put(header, int32_t(width));
+    Put(header, int32_t(height));
+    Put(header, uint8_t(sceneData.settings.showWelcomeWindow));
+    fwrite(header.data(), 1, header.size(), m_file);
+
+    m_path = path;
+    m_mode = Mode::Recording;
+    m_frameCount = 0;
+    m_frame = 0;
+    m_finished = false;
+    ImGui::GetIO().IniFilename = nullptr;
+    return true;
+}
+
+bool InputRecorder::StartReplay(const std::string& path, SceneData& sceneData, int& width, int& height) {
+    Stop();
+
+    m_file = fopen(path.c_str(), "rb");
+    if (!m_file) {
+        std::cerr << "Failed to open recording: " << path << std::endl;
+        return false;
+    }
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    float step = 0.0f;
+    int32_t recordedWidth = 0, recordedHeight = 0;
+    uint8_t showWelcomeWindow = 0;
+    const bool valid = fread(magic, 1, sizeof(magic), m_file) == sizeof(magic) && Get(m_file, version) &&
+                       Get(m_file, m_frameCount) && Get(m_file, step) && Get(m_file, recordedWidth) &&
+                       Get(m_file, recordedHeight) && Get(m_file, showWelcomeWindow);
+    if (!valid || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+        std::cerr << "Recording not recognized: " << path << std::endl;
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+
+    SceneData recorded;
+    recorded.settings = sceneData.settings;
+    if (!Autosave::Recover(ScenePath(path), recorded)) {
+        std::cerr << "Missing the starting scene of the recording: " << ScenePath(path) << std::endl;
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    recorded.settings.showWelcomeWindow = showWelcomeWindow != 0;
+    sceneData = recorded;
+
+    width = recordedWidth;
+    height = recordedHeight;
+
+    m_path = path;
+    m_mode = Mode::Replaying;
+    m_frame = 0;
+    m_finished = false;
+    m_frameTimes = FrameTimeStats(std::max<uint32_t>(m_frameCount, 1));
+    m_cpuTimes = FrameTimeStats(std::max<uint32_t>(m_frameCount, 1));
+    ImGui::GetIO().IniFilename = nullptr;
+    return true;
+}
+
+void InputRecorder::Stop() {
+    if (!m_file) return;
+
+    if (m_mode == Mode::Recording) {
+        fseek(m_file, FRAME_COUNT_OFFSET, SEEK_SET);
+        fwrite(&m_frameCount, sizeof(m_frameCount), 1, m_file);
+        std::cout << "Recorded " << m_frameCount << " frames to " << m_path << std::endl;
+    }
+    fclose(m_file);
+    m_file = nullptr;
+    m_mode = Mode::Off;
+}
+
+void InputRecorder::Process(InputState& state) {
+    if (m_mode == Mode::Off) return;
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.DeltaTime = FIXED_STEP; // in both, so double clicks and animations time out on the same frame
+
+    if (m_mode == Mode::Recording) {
+        // what the backend queued for ImGui this frame, from the GLFW callbacks and its own NewFrame
+        m_events.clear();
+        for (const ImGuiInputEvent& event : ImGui::GetCurrentContext()->InputEventsQueue) {
+            Event e = {};
+            switch (event.Type) {
+                case ImGuiInputEventType_MousePos: e = { EventMousePos, 0, event.MousePos.PosX, event.MousePos.PosY, 0 }; break;
+                case ImGuiInputEventType_MouseWheel: e = { EventMouseWheel, 0, event.MouseWheel.WheelX, event.MouseWheel.WheelY, 0 }; break;
+                case ImGuiInputEventType_MouseButton: e = { EventMouseButton, event.MouseButton.Button, 0.0f, 0.0f, event.MouseButton.Down }; break;
+                case ImGuiInputEventType_Key: e = { EventKey, event.Key.Key, event.Key.AnalogValue, 0.0f, event.Key.Down }; break;
+                case ImGuiInputEventType_Text: e = { EventText, static_cast<int32_t>(event.Text.Char), 0.0f, 0.0f, 0 }; break;
+                case ImGuiInputEventType_Focus: e = { EventFocus, 0, 0.0f, 0.0f, event.AppFocused.Focused }; break;
+                default: continue; // viewports aren't enabled
+            }
+            m_events.push_back(e);
+        }
+
+        std::vector<uint8_t> frame;
+        Put(frame, state.mouseX);
+        Put(frame, state.mouseY);
+        Put(frame, state.scrollY);
+        Put(frame, state.buttons);
+        Put(frame, state.keys);
+        Put(frame, static_cast<uint32_t>(m_events.size()));
+        for (const Event& e : m_events) {
+            Put(frame, e.type);
+            Put(frame, e.code);
+            Put(frame, e.x);
+            Put(frame, e.y);
+            Put(frame, e.down);
+        }
+        fwrite(frame.data(), 1, frame.size(), m_file);
+        m_frameCount++;
+        return;
+    }
+
+    // replaying: nothing of the real mouse and keyboard gets through, not even to ImGui
+    io.ClearEventsQueue();
+    state = InputState();
+    if (m_finished || m_frame >= m_frameCount || !ReadFrame(state, m_events)) {
+        if (!m_finished && m_frame < m_frameCount) std::cerr << "Recording ends early at frame " << m_frame << ": " << m_path << std::endl;
+        m_finished = true;
+        state = InputState();
+        return;
+    }
+    m_frame++;
+
+    for (const Event& e : m_events) {
+        switch (e.type) {
+            case EventMousePos: io.AddMousePosEvent(e.x, e.y); break;
+            case EventMouseWheel: io.AddMouseWheelEvent(e.x, e.y); break;
+            case EventMouseButton: io.AddMouseButtonEvent(e.code, e.down != 0); break;
+            case EventKey: io.AddKeyAnalogEvent(static_cast<ImGuiKey>(e.code), e.down != 0, e.x); break;
+            case EventText: io.AddInputCharacter(static_cast<unsigned int>(e.code)); break;
+            case EventFocus: io.AddFocusEvent(e.down != 0); break;
+        }
+    }
+}
+
+bool InputRecorder::ReadFrame(InputState& state, std::vector<Event>& events) {
+    uint32_t count = 0;
+    if (!Get(m_file, state.mouseX) || !Get(m_file, state.mouseY) || !Get(m_file, state.scrollY) ||
+        !Get(m_file, state.buttons) || !Get(m_file, state.keys) || !Get(m_file, count)) return false;
+
+    events.resize(count);
+    for (Event& e : events) {
+        if (!Get(m_file, e.type) || !Get(m_file, e.code) || !Get(m_file, e.x) || !Get(m_file, e.y) || !Get(m_file, e.down)) return false;
+    }
+    return true;
+}
+
+void InputRecorder::AddFrameTimes(float frameMilliseconds, float cpuMilliseconds) {
+    if (frameMilliseconds > 0.0f) m_frameTimes.Add(frameMilliseconds); // the first frame has nothing before it
+    m_cpuTimes.Add(cpuMilliseconds);
+}
+
+bool InputRecorder::WriteStats(const std::string& path) const {
+    FILE* out = path.empty() ? stdout : fopen(path.c_str(), "w");
+    if (!out) {
+        std::cerr << "Failed to open file for writing: " << path << std::endl;
+        return false;
+    }
+
+    auto writeStats = [out](const char* name, const FrameTimeStats& stats, const char* separator) {
+        fprintf(out, "    \"%s\": {\"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+                name, stats.GetMean(), stats.GetPercentile(50.0f), stats.GetPercentile(95.0f),
+                stats.GetPercentile(99.0f), stats.GetMax(), separator);
+    };
+    fprintf(out, "{\n    \"frames\": %u,\n    \"replayed\": %u,\n    \"fixed_step\": %.6f,\n", m_frameCount, m_frame, FIXED_STEP);
+    writeStats("frame", m_frameTimes, ",");
+    writeStats("cpu", m_cpuTimes, "");
+    fprintf(out, "}\n");
+
+    if (out != stdout) fclose(out);
+    return true;
+}
@@ -0,0 +1,80 @@
+// inputrec.h
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "framestats.h"
+#include "scene.h"
+
+// What App::HandleInput reads from GLFW, polled once a frame
+struct InputState {
+    double mouseX = 0.0, mouseY = 0.0;
+    double scrollY = 0.0;     // scrolled since the last frame
+    uint32_t buttons = 0;     // bit per GLFW mouse button
+    uint32_t keys = 0;        // InputKey bits
+};
+
+enum InputKey : uint32_t {
+    INPUT_KEY_CTRL   = 1 << 0, // either control key
+    INPUT_KEY_SHIFT  = 1 << 1, // left shift
+    INPUT_KEY_ESCAPE = 1 << 2,
+    INPUT_KEY_S      = 1 << 3,
+    INPUT_KEY_O      = 1 << 4
+};
+
+// Records the input of every frame (the polled state above and the events ImGui gets) and plays it back,
+// so two builds can be timed on exactly the same interaction. A replay runs at a fixed timestep: ImGui sees
+// FIXED_STEP seconds per frame whatever the real frame took, and the real frame times are collected for stats.
+//
+// File: "DREC", version, frame count, window size, then per frame the state and the ImGui events.
+// The scene at the start goes next to it as an autosave journal (<path>.scene), which replay starts from.
+class InputRecorder {
+public:
+    static constexpr float FIXED_STEP = 1.0f / 60.0f;
+
+    ~InputRecorder() { Stop(); }
+
+    // ImGui layout isn't read from or saved to imgui.ini while either runs, so both start from the same one
+    bool StartRecording(const std::string& path, const SceneData& sceneData, int width, int height);
+    // Replaces the scene with the recorded one, width and height are the window size to use
+    bool StartReplay(const std::string& path, SceneData& sceneData, int& width, int& height);
+    void Stop();
+
+    bool IsRecording() const { return m_mode == Mode::Recording; }
+    bool IsReplaying() const { return m_mode == Mode::Replaying; }
+    bool IsFinished() const { return m_finished; } // the replay ran out of frames
+
+    // Once a frame, after the platform backend's NewFrame and before ImGui::NewFrame:
+    // saves this frame's input, or swaps it for the recorded one
+    void Process(InputState& state);
+
+    // Real times of the replayed frames, and their stats as JSON (to stdout when path is empty)
+    void AddFrameTimes(float frameMilliseconds, float cpuMilliseconds);
+    bool WriteStats(const std::string& path) const;
+
+private:
+    enum class Mode { Off, Recording, Replaying };
+
+    struct Event {
+        uint8_t type;
+        int32_t code;   // button, key or character
+        float x, y;     // position, wheel or analog value
+        uint8_t down;
+    };
+
+    bool ReadFrame(InputState& state, std::vector<Event>& events);
+
+    Mode m_mode = Mode::Off;
+    FILE* m_file = nullptr;
+    std::string m_path;
+    uint32_t m_frameCount = 0; // written so far, or in the file being replayed
+    uint32_t m_frame = 0;
+    bool m_finished = false;
+    std::vector<Event> m_events; // scratch for the frame being processed
+
+    FrameTimeStats m_frameTimes;
+    FrameTimeStats m_cpuTimes;
+};
@@ -0,0 +1,376 @@
+#include "intersections.h"
+#include "jobs.h"
+#include "trace.h"
+#include "alloctrack.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr double RELATIVE_EPSILON = 1e-6;
+
+    // below this many candidate pairs handing them out as jobs costs more than it saves
+    constexpr size_t PARALLEL_THRESHOLD = 4096;
+    constexpr size_t MIN_GRAIN = 1024; // pairs per job
+
+    double Dot(const double a[3], const double b[3]) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    void Cross(const double a[3], const double b[3], double out[3]) {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    void GrowBox(AABB& box, const double p[3]) {
+        float point[3] = { (float)p[0], (float)p[1], (float)p[2] };
+        box.Grow(point);
+    }
+}
+
+void IntersectionEngine::SetVolume(float halfSize) {
+    if (halfSize == m_halfSize) return;
+    m_halfSize = halfSize;
+    m_fullRebuild = true;
+}
+
+bool IntersectionEngine::Update(const SceneData& sceneData) {
+    TRACE_SCOPE("IntersectionEngine::Update");
+    ALLOC_SCOPE("Derived geometry");
+    const int lineCount = static_cast<int>(sceneData.lines.size());
+    const int planeCount = static_cast<int>(sceneData.planes.size());
+
+    // new lines and planes at the end are just more dirty ones, fewer means indices after an erased one moved
+    const int oldLineCount = static_cast<int>(m_linePrimitives.size());
+    const int oldPlaneCount = static_cast<int>(m_planePrimitives.size());
+    bool full = m_fullRebuild || lineCount < oldLineCount || planeCount < oldPlaneCount;
+    bool grown = lineCount > oldLineCount || planeCount > oldPlaneCount;
+    if (!full && !grown && m_pendingLines.empty() && m_pendingPlanes.empty()) return false;
+
+    std::vector<char> lineDirty(lineCount, full ? 1 : 0);
+    std::vector<char> planeDirty(planeCount, full ? 1 : 0);
+    if (!full) {
+        for (int line = oldLineCount; line < lineCount; ++line) lineDirty[line] = 1;
+        for (int plane = oldPlaneCount; plane < planeCount; ++plane) planeDirty[plane] = 1;
+        for (int line : m_pendingLines) {
+            if (line >= 0 && line < lineCount) lineDirty[line] = 1;
+        }
+        for (int plane : m_pendingPlanes) {
+            if (plane >= 0 && plane < planeCount) planeDirty[plane] = 1;
+        }
+    }
+    m_pendingLines.clear();
+    m_pendingPlanes.clear();
+    m_fullRebuild = false;
+
+    m_linePrimitives.resize(lineCount);
+    m_lineBoxes.resize(lineCount);
+    m_planePrimitives.resize(planeCount);
+    m_planeBoxes.resize(planeCount);
+
+    bool linesChanged = false, planesChanged = false;
+    for (int i = 0; i < lineCount; ++i) {
+        if (!lineDirty[i]) continue;
+        BuildLine(sceneData, i);
+        linesChanged = true;
+    }
+    for (int i = 0; i < planeCount; ++i) {
+        if (!planeDirty[i]) continue;
+        BuildPlane(sceneData, i);
+        planesChanged = true;
+    }
+    if (linesChanged) m_lineTree.Build(m_lineBoxes);
+    if (planesChanged) m_planeTree.Build(m_planeBoxes);
+
+    // drop whatever came from something that changed
+    auto& points = m_results.points;
+    points.erase(std::remove_if(points.begin(), points.end(), [&](const PiercingPoint& point) {
+        return lineDirty[point.line] || planeDirty[point.plane];
+    }), points.end());
+
+    auto& lines = m_results.lines;
+    lines.erase(std::remove_if(lines.begin(), lines.end(), [&](const IntersectionLine& line) {
+        return planeDirty[line.plane1] || planeDirty[line.plane2];
+    }), lines.end());
+
+    // broad phase, only pairs with at least one changed side
+    // (lines and expanded planes walk the tree with their exact shape, a box around them would be the whole volume)
+    m_pairs.clear();
+    std::vector<int> hits;
+    for (int i = 0; i < lineCount; ++i) {
+        const LinePrimitive& line = m_linePrimitives[i];
+        if (!lineDirty[i] || !line.valid) continue;
+
+        float origin[3] = { (float)line.point[0], (float)line.point[1], (float)line.point[2] };
+        float dir[3] = { (float)line.dir[0], (float)line.dir[1], (float)line.dir[2] };
+        hits.clear();
+        m_planeTree.QueryLine(origin, dir, hits);
+        for (int plane : hits) m_pairs.push_back({ i, plane, false });
+    }
+
+    for (int i = 0; i < planeCount; ++i) {
+        const PlanePrimitive& plane = m_planePrimitives[i];
+        if (!planeDirty[i] || !plane.valid) continue;
+
+        // lines that didn't change weren't paired above, they come from the line tree (a box around the
+        // part of each line inside the volume)
+        float normal[3] = { (float)plane.normal[0], (float)plane.normal[1], (float)plane.normal[2] };
+        hits.clear();
+        if (plane.bounded) m_lineTree.Query(m_planeBoxes[i], hits);
+        else m_lineTree.QueryPlane(normal, (float)plane.offset, hits);
+        for (int line : hits) {
+            if (!lineDirty[line]) m_pairs.push_back({ line, i, false });
+        }
+
+        hits.clear();
+        if (plane.bounded) m_planeTree.Query(m_planeBoxes[i], hits);
+        else m_planeTree.QueryPlane(normal, (float)plane.offset, hits);
+        for (int other : hits) {
+            if (other == i || (planeDirty[other] && other < i)) continue; // each pair once
+            m_pairs.push_back({ std::min(i, other), std::max(i, other), true });
+        }
+    }
+    m_candidatePairs = m_pairs.size();
+
+    RunNarrowPhase();
+    m_shared = std::make_shared<const IntersectionResults>(m_results);
+    return true;
+}
+
+void IntersectionEngine::RunNarrowPhase() {
+    if (!m_jobs || m_jobs->GetWorkerCount() == 0 || m_pairs.size() < PARALLEL_THRESHOLD) {
+        Intersect(m_pairs.data(), m_pairs.size(), m_results);
+        return;
+    }
+
+    // a few chunks per thread so the stealing can even them out, merging them in order keeps the results deterministic
+    const size_t grain = std::max(MIN_GRAIN, m_pairs.size() / (4 * (m_jobs->GetWorkerCount() + 1)) + 1);
+    std::vector<IntersectionResults> partial((m_pairs.size() + grain - 1) / grain);
+    m_jobs->ParallelFor(m_pairs.size(), grain, [&](size_t begin, size_t end) {
+        TRACE_SCOPE("IntersectionEngine chunk");
+        ALLOC_SCOPE("Derived geometry");
+        Intersect(m_pairs.data() + begin, end - begin, partial[begin / grain]);
+    });
+
+    for (auto& part : partial) {
+        m_results.points.insert(m_results.points.end(), part.points.begin(), part.points.end());
+        m_results.lines.insert(m_results.lines.end(), part.lines.begin(), part.lines.end());
+    }
+}
+
+void IntersectionEngine::BuildLine(const SceneData& sceneData, int index) {
+    const float* p1 = sceneData.points[sceneData.lines[index].point1index].coords;
+    const float* p2 = sceneData.points[sceneData.lines[index].point2index].coords;
+
+    LinePrimitive& line = m_linePrimitives[index];
+    AABB& box = m_lineBoxes[index];
+    line = LinePrimitive();
+    box = AABB();
+    for (int k = 0; k < 3; ++k) {
+        line.point[k] = p1[k];
+        line.dir[k] = (double)p2[k] - p1[k];
+    }
+    if (Dot(line.dir, line.dir) == 0.0) return;
+
+    double tMin, tMax;
+    line.valid = ClipToVolume(line.point, line.dir, tMin, tMax);
+    if (!line.valid) return;
+
+    // the segment inside the volume, padded so float rounding can't drop a hit right at its ends
+    double ends[2][3];
+    for (int k = 0; k < 3; ++k) {
+        ends[0][k] = line.point[k] + tMin * line.dir[k];
+        ends[1][k] = line.point[k] + tMax * line.dir[k];
+    }
+    GrowBox(box, ends[0]);
+    GrowBox(box, ends[1]);
+    const float pad = m_halfSize * 1e-4f;
+    for (int k = 0; k < 3; ++k) {
+        box.min[k] -= pad;
+        box.max[k] += pad;
+    }
+}
+
+void IntersectionEngine::BuildPlane(const SceneData& sceneData, int index) {
+    const double h = m_halfSize;
+    const auto& scenePlane = sceneData.planes[index];
+    const float* p1 = sceneData.points[scenePlane.point1index].coords;
+    const float* p2 = sceneData.points[scenePlane.point2index].coords;
+    const float* p3 = sceneData.points[scenePlane.point3index].coords;
+
+    double v1[3] = { (double)p2[0] - p1[0], (double)p2[1] - p1[1], (double)p2[2] - p1[2] };
+    double v2[3] = { (double)p3[0] - p1[0], (double)p3[1] - p1[1], (double)p3[2] - p1[2] };
+
+    PlanePrimitive& plane = m_planePrimitives[index];
+    AABB& box = m_planeBoxes[index];
+    plane = PlanePrimitive();
+    box = AABB();
+
+    Cross(v1, v2, plane.normal);
+    double length = std::sqrt(Dot(plane.normal, plane.normal));
+    if (length == 0.0 || length <= RELATIVE_EPSILON * std::sqrt(Dot(v1, v1) * Dot(v2, v2))) return; // collinear
+
+    for (int k = 0; k < 3; ++k) plane.normal[k] /= length;
+    double origin[3] = { p1[0], p1[1], p1[2] };
+    plane.offset = -Dot(plane.normal, origin);
+
+    if (!scenePlane.expand) {
+        // the triangle, edge normals point inwards since the normal comes from the same winding
+        const float* corners[3] = { p1, p2, p3 };
+        plane.bounded = true;
+        for (int e = 0; e < 3; ++e) {
+            const float* a = corners[e];
+            const float* b = corners[(e + 1) % 3];
+            double edge[3] = { (double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2] };
+            double start[3] = { a[0], a[1], a[2] };
+            Cross(plane.normal, edge, plane.edgeNormals[e]);
+            plane.edgeOffsets[e] = -Dot(plane.edgeNormals[e], start);
+            box.Grow(a);
+        }
+
+        // only the part inside the volume matters
+        for (int k = 0; k < 3; ++k) {
+            box.min[k] = std::max(box.min[k], -m_halfSize);
+            box.max[k] = std::min(box.max[k], m_halfSize);
+        }
+        plane.valid = !box.IsEmpty();
+        return;
+    }
+
+    // the part of the plane inside the volume is a polygon whose corners lie on the cube edges
+    for (int axis = 0; axis < 3; ++axis) {
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for (int corner = 0; corner < 4; ++corner) {
+            double e0[3], e1[3];
+            e0[u] = e1[u] = (corner & 1) ? h : -h;
+            e0[v] = e1[v] = (corner & 2) ? h : -h;
+            e0[axis] = -h;
+            e1[axis] = h;
+
+            double s0 = Dot(plane.normal, e0) + plane.offset;
+            double s1 = Dot(plane.normal, e1) + plane.offset;
+            if (s0 == 0.0 && s1 == 0.0) {
+                GrowBox(box, e0);
+                GrowBox(box, e1);
+            } else if (s0 * s1 <= 0.0) {
+                double t = s0 / (s0 - s1);
+                double hit[3];
+                for (int k = 0; k < 3; ++k) hit[k] = e0[k] + t * (e1[k] - e0[k]);
+                GrowBox(box, hit);
+            }
+        }
+    }
+    plane.valid = !box.IsEmpty();
+}
+
+void IntersectionEngine::Intersect(const Pair* pairs, size_t count, IntersectionResults& out) const {
+    for (size_t i = 0; i < count; ++i) {
+        const Pair& pair = pairs[i];
+
+        if (pair.planePlane) {
+            IntersectionLine result;
+            if (IntersectPlanes(m_planePrimitives[pair.a], m_planePrimitives[pair.b], result.p1, result.p2)) {
+                result.plane1 = pair.a;
+                result.plane2 = pair.b;
+                out.lines.push_back(result);
+            }
+        } else {
+            PiercingPoint result;
+            if (IntersectLinePlane(m_linePrimitives[pair.a], m_planePrimitives[pair.b], result.coords)) {
+                result.line = pair.a;
+                result.plane = pair.b;
+                out.points.push_back(result);
+            }
+        }
+    }
+}
+
+bool IntersectionEngine::IntersectLinePlane(const LinePrimitive& line, const PlanePrimitive& plane, float out[3]) const {
+    if (!line.valid || !plane.valid) return false;
+
+    // parallel (or contained) lines have no single piercing point
+    double denominator = Dot(plane.normal, line.dir);
+    if (std::fabs(denominator) <= RELATIVE_EPSILON * std::sqrt(Dot(line.dir, line.dir))) return false;
+
+    double t = -(Dot(plane.normal, line.point) + plane.offset) / denominator;
+    double hit[3];
+    for (int k = 0; k < 3; ++k) {
+        hit[k] = line.point[k] + t * line.dir[k];
+        if (std::fabs(hit[k]) > m_halfSize * (1.0 + RELATIVE_EPSILON)) return false;
+    }
+
+    if (plane.bounded) {
+        for (int e = 0; e < 3; ++e) {
+            double side = Dot(plane.edgeNormals[e], hit) + plane.edgeOffsets[e];
+            if (side < -RELATIVE_EPSILON * Dot(plane.edgeNormals[e], plane.edgeNormals[e])) return false;
+        }
+    }
+
+    for (int k = 0; k < 3; ++k) out[k] = static_cast<float>(hit[k]);
+    return true;
+}
+
+bool IntersectionEngine::IntersectPlanes(const PlanePrimitive& plane1, const PlanePrimitive& plane2, float p1[3], float p2[3]) const {
+    if (!plane1.valid || !plane2.valid) return false;
+
+    // normals are unit length, so this is sin(angle)
+    double dir[3];
+    Cross(plane1.normal, plane2.normal, dir);
+    double lengthSq = Dot(dir, dir);
+    if (lengthSq <= RELATIVE_EPSILON * RELATIVE_EPSILON) return false;
+
+    // point on both planes closest to the origin
+    double h1 = -plane1.offset, h2 = -plane2.offset;
+    double n1n2 = Dot(plane1.normal, plane2.normal);
+    double c1 = (h1 - h2 * n1n2) / lengthSq;
+    double c2 = (h2 - h1 * n1n2) / lengthSq;
+    double point[3];
+    for (int k = 0; k < 3; ++k) point[k] = c1 * plane1.normal[k] + c2 * plane2.normal[k];
+
+    double tMin, tMax;
+    if (!ClipToVolume(point, dir, tMin, tMax)) return false;
+    if (plane1.bounded && !ClipToTriangle(plane1, point, dir, tMin, tMax)) return false;
+    if (plane2.bounded && !ClipToTriangle(plane2, point, dir, tMin, tMax)) return false;
+
+    for (int k = 0; k < 3; ++k) {
+        p1[k] = static_cast<float>(point[k] + tMin * dir[k]);
+        p2[k] = static_cast<float>(point[k] + tMax * dir[k]);
+    }
+    return true;
+}
+
+bool IntersectionEngine::ClipToVolume(const double point[3], const double dir[3], double& tMin, double& tMax) const {
+    tMin = -HUGE_VAL;
+    tMax = HUGE_VAL;
+
+    for (int k = 0; k < 3; ++k) {
+        if (dir[k] == 0.0) {
+            if (std::fabs(point[k]) > m_halfSize) return false;
+            continue;
+        }
+        double t0 = (-m_halfSize - point[k]) / dir[k];
+        double t1 = (m_halfSize - point[k]) / dir[k];
+        if (t0 > t1) std::swap(t0, t1);
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+    }
+    return tMin <= tMax;
+}
+
+bool IntersectionEngine::ClipToTriangle(const PlanePrimitive& plane, const double point[3], const double dir[3], double& tMin, double& tMax) const {
+    // each edge keeps the side where edgeNormal . (point + t * dir) + edgeOffset >= 0
+    for (int e = 0; e < 3; ++e) {
+        double base = Dot(plane.edgeNormals[e], point) + plane.edgeOffsets[e];
+        double slope = Dot(plane.edgeNormals[e], dir);
+
+        if (slope == 0.0) {
+            if (base < 0.0) return false;
+            continue;
+        }
+        double t = -base / slope;
+        if (slope > 0.0) tMin = std::max(tMin, t);
+        else tMax = std::min(tMax, t);
+    }
+    return tMin <= tMax;
+}
@@ -0,0 +1,111 @@
+// intersections.h
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "bvh.h"
+#include "scene.h"
+
+class JobSystem;
+
+// Where a line pierces a plane
+struct PiercingPoint {
+    int line;
+    int plane;
+    float coords[3]; // (d, a, c)
+};
+
+// Where two planes meet, clipped to the drawing volume
+struct IntersectionLine {
+    int plane1;
+    int plane2;
+    float p1[3];
+    float p2[3];
+};
+
+struct IntersectionResults {
+    std::vector<PiercingPoint> points;
+    std::vector<IntersectionLine> lines;
+};
+
+// Computes every line-plane and plane-plane intersection inside the drawing volume.
+// Lines are infinite, planes cover what the 3D view shows: the triangle of their points, or the whole
+// volume when expanded. Planes and lines (the part inside the volume) go into BVHs and only pairs that the
+// trees can't rule out get intersected.
+class IntersectionEngine {
+public:
+    void SetVolume(float halfSize); // drawing volume is the cube [-halfSize, halfSize] in model units
+    void SetJobSystem(JobSystem* jobs) { m_jobs = jobs; } // big narrow phases are split into jobs, nullptr runs them here
+
+    // Lines and planes whose results must be recomputed on the next Update (the dependency graph knows which)
+    void InvalidateLine(int index) { m_pendingLines.push_back(index); }
+    void InvalidatePlane(int index) { m_pendingPlanes.push_back(index); }
+    void InvalidateAll() {
+        m_fullRebuild = true;
+        m_pendingLines.clear();
+        m_pendingPlanes.clear();
+    }
+
+    // Recomputes the pairs that involve an invalidated line or plane (everything when lines or planes
+    // were erased or the volume changed), returns true when the results changed
+    bool Update(const SceneData& sceneData);
+
+    const IntersectionResults& GetResults() const { return m_results; }
+    // A copy of the results for other threads, replaced (never changed) by an Update that changes them.
+    // Null before the first Update.
+    std::shared_ptr<const IntersectionResults> GetSharedResults() const { return m_shared; }
+    size_t GetCandidatePairs() const { return m_candidatePairs; } // pairs that got past the broad phase
+
+private:
+    struct LinePrimitive {
+        double point[3];
+        double dir[3];
+        bool valid = false;
+    };
+
+    struct PlanePrimitive {
+        double normal[3];
+        double offset;
+        bool valid = false;
+
+        // not expanded: inside the triangle means edgeNormals[i] . x + edgeOffsets[i] >= 0 for every edge
+        bool bounded = false;
+        double edgeNormals[3][3];
+        double edgeOffsets[3];
+    };
+
+    struct Pair {
+        int a;
+        int b;
+        bool planePlane; // otherwise a is a line and b a plane
+    };
+
+    void BuildLine(const SceneData& sceneData, int index);
+    void BuildPlane(const SceneData& sceneData, int index);
+    void RunNarrowPhase();
+    void Intersect(const Pair* pairs, size_t count, IntersectionResults& out) const;
+    bool IntersectLinePlane(const LinePrimitive& line, const PlanePrimitive& plane, float out[3]) const;
+    bool IntersectPlanes(const PlanePrimitive& plane1, const PlanePrimitive& plane2, float p1[3], float p2[3]) const;
+    bool ClipToVolume(const double point[3], const double dir[3], double& tMin, double& tMax) const;
+    bool ClipToTriangle(const PlanePrimitive& plane, const double point[3], const double dir[3], double& tMin, double& tMax) const;
+
+    float m_halfSize = 50.0f;
+    bool m_fullRebuild = true;
+    JobSystem* m_jobs = nullptr;
+
+    std::vector<int> m_pendingLines;
+    std::vector<int> m_pendingPlanes;
+    std::vector<LinePrimitive> m_linePrimitives;
+    std::vector<AABB> m_lineBoxes;
+    BVH m_lineTree;
+    std::vector<PlanePrimitive> m_planePrimitives;
+    std::vector<AABB> m_planeBoxes;
+    BVH m_planeTree;
+
+    std::vector<Pair> m_pairs;
+    size_t m_candidatePairs = 0;
+    IntersectionResults m_results;
+    std::shared_ptr<const IntersectionResults> m_shared;
+};
@@ -0,0 +1,175 @@
+#include "jobs.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+    constexpr unsigned MAX_WORKERS = 16;
+
+    // which pool (and which of its deques) the current thread works for
+    thread_local const JobSystem* t_system = nullptr;
+    thread_local size_t t_queue = 0;
+}
+
+void JobSystem::Start(unsigned workers) {
+    if (!m_threads.empty()) return;
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    if (workers == 0) workers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    workers = std::min(workers, MAX_WORKERS);
+#else
+    workers = 0;
+#endif
+
+    m_queues.clear();
+    for (unsigned i = 0; i <= workers; ++i) m_queues.push_back(std::make_unique<WorkQueue>());
+    m_quit = false;
+    for (unsigned i = 0; i < workers; ++i) m_threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+void JobSystem::Stop() {
+    if (m_threads.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) thread.join();
+    m_threads.clear();
+
+    while (RunOne()) {} // continuations the last workers queued on their way out
+}
+
+JobHandle JobSystem::Submit(std::function<void()> work, const std::vector<JobHandle>& dependencies) {
+    JobHandle job = std::make_shared<Job>();
+    job->m_work = std::move(work);
+
+    if (m_threads.empty()) {
+        // everything submitted before already ran, dependencies included
+        job->m_work();
+        job->m_done.store(true, std::memory_order_release);
+        return job;
+    }
+
+    job->m_pending.store(static_cast<int>(dependencies.size()) + 1, std::memory_order_relaxed);
+    for (const JobHandle& dependency : dependencies) {
+        bool registered = false;
+        if (dependency) {
+            std::lock_guard<std::mutex> lock(dependency->m_mutex);
+            if (!dependency->IsDone()) {
+                dependency->m_continuations.push_back(job);
+                registered = true;
+            }
+        }
+        if (!registered) job->m_pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    if (job->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) Push(job);
+    return job;
+}
+
+void JobSystem::Wait(const JobHandle& job) {
+    if (!job) return;
+    TRACE_SCOPE("JobSystem::Wait");
+    while (!job->IsDone()) {
+        if (!RunOne()) std::this_thread::yield(); // it's running somewhere else, or waiting on something that is
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    grain = std::max<size_t>(grain, 1);
+    if (m_threads.empty() || count <= grain) {
+        for (size_t begin = 0; begin < count; begin += grain) body(begin, std::min(count, begin + grain));
+        return;
+    }
+
+    // the calling thread takes the first chunk itself instead of waiting with nothing to do
+    std::vector<JobHandle> chunks;
+    chunks.reserve(count / grain);
+    for (size_t begin = grain; begin < count; begin += grain) {
+        const size_t end = std::min(count, begin + grain);
+        chunks.push_back(Submit([&body, begin, end]() { body(begin, end); }));
+    }
+    body(0, grain);
+    for (const JobHandle& chunk : chunks) Wait(chunk);
+}
+
+void JobSystem::WorkerLoop(size_t index) {
+    t_system = this;
+    t_queue = index;
+    TRACE_THREAD(("Job worker " + std::to_string(index)).c_str());
+
+    while (true) {
+        if (RunOne()) continue;
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_quit || m_queued.load(std::memory_order_acquire) > 0; });
+        if (m_quit && m_queued.load(std::memory_order_acquire) == 0) break;
+    }
+}
+
+size_t JobSystem::GetQueueIndex() const {
+    return t_system == this ? t_queue : m_queues.size() - 1;
+}
+
+void JobSystem::Push(JobHandle job) {
+    WorkQueue& queue = *m_queues[GetQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    m_queued.fetch_add(1, std::memory_order_release);
+    {
+        // empty, but without it a worker could see nothing queued, miss the add and sleep through the notify
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_one();
+}
+
+bool JobSystem::RunOne() {
+    JobHandle job;
+    const size_t own = GetQueueIndex();
+    const size_t queueCount = m_queues.size();
+
+    // newest of our own first, then the oldest of everyone else's, starting with the neighbour
+    {
+        WorkQueue& queue = *m_queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+    }
+    for (size_t i = 1; !job && i < queueCount; ++i) {
+        WorkQueue& queue = *m_queues[(own + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+    }
+    if (!job) return false;
+
+    m_queued.fetch_sub(1, std::memory_order_acq_rel);
+    {
+        TRACE_SCOPE("Job");
+        job->m_work();
+    }
+    Finish(job);
+    return true;
+}
+
+void JobSystem::Finish(const JobHandle& job) {
+    job->m_work = nullptr; // whatever it captured goes now, not when the last handle does
+
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(job->m_mutex);
+        job->m_done.store(true, std::memory_order_release);
+        continuations.swap(job->m_continuations);
+    }
+    for (JobHandle& next : continuations) {
+        if (next->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) Push(std::move(next));
+    }
+}
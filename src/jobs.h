@@ -0,0 +1,72 @@
+// jobs.h
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Something handed to the JobSystem, other jobs can depend on it and any thread can wait for it
+class Job {
+public:
+    bool IsDone() const { return m_done.load(std::memory_order_acquire); }
+
+private:
+    friend class JobSystem;
+
+    std::function<void()> m_work;
+    std::atomic<int> m_pending{ 1 }; // unfinished dependencies, plus one while Submit is still registering them
+    std::atomic<bool> m_done{ false };
+    std::mutex m_mutex; // between registering as a continuation and the job finishing
+    std::vector<std::shared_ptr<Job>> m_continuations; // queued once this one is done
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+// Fixed pool of workers, each with its own deque. A worker pushes and pops its own jobs at the back (the newest,
+// still in cache) and when it runs dry steals the oldest job of another worker. Jobs submitted from outside the
+// pool (the main thread) go to one more deque every worker takes from.
+// Waiting runs other jobs meanwhile instead of blocking, so the main thread helps and jobs can wait on jobs.
+// Without workers (web builds without pthreads, a single core) every job runs right away inside Submit.
+class JobSystem {
+public:
+    ~JobSystem() { Stop(); }
+
+    void Start(unsigned workers = 0); // 0 is one per core besides the calling thread's
+    void Stop(); // runs whatever is queued first
+    unsigned GetWorkerCount() const { return static_cast<unsigned>(m_threads.size()); }
+
+    // Runs work once every job in dependencies is done (nullptr ones count as done)
+    JobHandle Submit(std::function<void()> work, const std::vector<JobHandle>& dependencies = {});
+    void Wait(const JobHandle& job);
+
+    // body(begin, end) for every grain sized chunk of [0, count), back when they're all done.
+    // The chunks don't depend on the worker count, chunk begin / grain can index per-chunk results.
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    void WorkerLoop(size_t index);
+    void Push(JobHandle job);
+    bool RunOne(); // one job from the calling thread's deque or stolen, false when there was none
+    void Finish(const JobHandle& job);
+    size_t GetQueueIndex() const; // the calling worker's deque, or the shared one
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues; // one per worker, then the shared one
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_queued{ 0 }; // jobs sitting in any deque
+
+    // workers sleep here while every deque is empty
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    bool m_quit = false;
+};
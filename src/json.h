@@ -127,7 +127,7 @@ public:
 
     // SAVE --------------------------------------------------------------
 
-    void Save(const std::string& filename, SceneData& sceneData) {
+    void Save(const std::string& filename, const SceneData& sceneData) {
         nlohmann::json content;
 
         #ifdef _WIN32
@@ -0,0 +1,366 @@
+#include "octree.h"
+#include "trace.h"
+#include "alloctrack.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    constexpr int LEAF_CAPACITY = 8;
+    constexpr int COLLAPSE_COUNT = LEAF_CAPACITY / 2;
+    constexpr float INITIAL_HALF_SIZE = 64.0f; // a bit more than the default drawing volume
+    constexpr float MIN_HALF_SIZE = 1e-3f;     // repeated points stop splitting here
+
+    float DistanceSquared(const float a[3], const float b[3]) {
+        float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+}
+
+void PointOctree::Clear() {
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_root = -1;
+    m_positions.clear();
+    m_itemNodes.clear();
+}
+
+int PointOctree::AllocateNode(const float center[3], float halfSize, int parent) {
+    int index;
+    if (!m_freeNodes.empty()) {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+        m_nodes[index] = Node();
+    }
+    else {
+        index = static_cast<int>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+
+    Node& node = m_nodes[index];
+    for (int k = 0; k < 3; ++k) node.center[k] = center[k];
+    node.halfSize = halfSize;
+    node.parent = parent;
+    return index;
+}
+
+void PointOctree::FreeNode(int node) {
+    for (int child : m_nodes[node].children) {
+        if (child >= 0) FreeNode(child);
+    }
+    m_nodes[node].items.clear();
+    m_freeNodes.push_back(node);
+}
+
+bool PointOctree::InsideNode(int node, const float position[3]) const {
+    const Node& n = m_nodes[node];
+    for (int k = 0; k < 3; ++k) {
+        if (position[k] < n.center[k] - n.halfSize || position[k] > n.center[k] + n.halfSize) return false;
+    }
+    return true;
+}
+
+int PointOctree::ChildFor(int node, const float position[3]) const {
+    const Node& n = m_nodes[node];
+    return (position[0] >= n.center[0] ? 1 : 0) | (position[1] >= n.center[1] ? 2 : 0) | (position[2] >= n.center[2] ? 4 : 0);
+}
+
+void PointOctree::GrowRoot(const float position[3]) {
+    // double the root towards the point until it fits, the old root becomes one of the new root's children
+    while (!InsideNode(m_root, position)) {
+        const Node old = m_nodes[m_root];
+        float center[3];
+        for (int k = 0; k < 3; ++k) center[k] = old.center[k] + (position[k] >= old.center[k] ? old.halfSize : -old.halfSize);
+
+        int oldRoot = m_root;
+        int root = AllocateNode(center, old.halfSize * 2.0f, -1);
+        m_nodes[root].count = old.count;
+
+        for (int octant = 0; octant < 8; ++octant) {
+            float childCenter[3];
+            for (int k = 0; k < 3; ++k) {
+                float sign = (octant >> k) & 1 ? 1.0f : -1.0f;
+                childCenter[k] = center[k] + sign * old.halfSize;
+            }
+            if (ChildFor(root, old.center) == octant) {
+                m_nodes[root].children[octant] = oldRoot;
+                m_nodes[oldRoot].parent = root;
+            }
+            else {
+                int child = AllocateNode(childCenter, old.halfSize, root);
+                m_nodes[root].children[octant] = child;
+            }
+        }
+        m_root = root;
+    }
+}
+
+void PointOctree::Split(int node) {
+    const float half = m_nodes[node].halfSize * 0.5f;
+    for (int octant = 0; octant < 8; ++octant) {
+        float center[3];
+        for (int k = 0; k < 3; ++k) {
+            float sign = (octant >> k) & 1 ? 1.0f : -1.0f;
+            center[k] = m_nodes[node].center[k] + sign * half;
+        }
+        int child = AllocateNode(center, half, node); // may reallocate m_nodes, index again below
+        m_nodes[node].children[octant] = child;
+    }
+
+    std::vector<int> items;
+    items.swap(m_nodes[node].items);
+    for (int item : items) {
+        int child = m_nodes[node].children[ChildFor(node, GetPosition(item))];
+        m_nodes[child].items.push_back(item);
+        m_nodes[child].count++;
+        m_itemNodes[item] = child;
+    }
+}
+
+void PointOctree::CollectItems(int node, std::vector<int>& items) const {
+    const Node& n = m_nodes[node];
+    items.insert(items.end(), n.items.begin(), n.items.end());
+    for (int child : n.children) {
+        if (child >= 0) CollectItems(child, items);
+    }
+}
+
+void PointOctree::Collapse(int node) {
+    std::vector<int> items;
+    CollectItems(node, items);
+    for (int& child : m_nodes[node].children) {
+        if (child >= 0) FreeNode(child);
+        child = -1;
+    }
+    m_nodes[node].items = items;
+    for (int item : items) m_itemNodes[item] = node;
+}
+
+void PointOctree::Insert(int index, const float position[3]) {
+    if (index < 0) return;
+    if (!std::isfinite(position[0]) || !std::isfinite(position[1]) || !std::isfinite(position[2])) return;
+    if (Contains(index)) Remove(index);
+
+    if (index >= static_cast<int>(m_itemNodes.size())) {
+        m_itemNodes.resize(index + 1, -1);
+        m_positions.resize((index + 1) * 3, 0.0f);
+    }
+    for (int k = 0; k < 3; ++k) m_positions[index * 3 + k] = position[k];
+
+    if (m_root < 0) {
+        const float origin[3] = {0.0f, 0.0f, 0.0f};
+        m_root = AllocateNode(origin, INITIAL_HALF_SIZE, -1);
+    }
+    GrowRoot(position);
+
+    int node = m_root;
+    while (true) {
+        m_nodes[node].count++;
+        if (IsLeaf(node)) break;
+        node = m_nodes[node].children[ChildFor(node, position)];
+    }
+
+    m_nodes[node].items.push_back(index);
+    m_itemNodes[index] = node;
+
+    if (static_cast<int>(m_nodes[node].items.size()) > LEAF_CAPACITY && m_nodes[node].halfSize * 0.5f >= MIN_HALF_SIZE) {
+        Split(node);
+    }
+}
+
+void PointOctree::Remove(int index) {
+    if (!Contains(index)) return;
+
+    int node = m_itemNodes[index];
+    auto& items = m_nodes[node].items;
+    items.erase(std::find(items.begin(), items.end(), index));
+    m_itemNodes[index] = -1;
+
+    // walk up to the highest parent that got small enough to be a leaf again
+    int collapse = -1;
+    for (int n = node; n >= 0; n = m_nodes[n].parent) {
+        m_nodes[n].count--;
+        if (!IsLeaf(n) && m_nodes[n].count <= COLLAPSE_COUNT) collapse = n;
+    }
+    if (collapse >= 0) Collapse(collapse);
+}
+
+void PointOctree::Move(int index, const float position[3]) {
+    if (!Contains(index)) {
+        Insert(index, position);
+        return;
+    }
+
+    // still in the same leaf, nothing in the tree changes
+    if (InsideNode(m_itemNodes[index], position)) {
+        for (int k = 0; k < 3; ++k) m_positions[index * 3 + k] = position[k];
+        return;
+    }
+
+    Remove(index);
+    Insert(index, position);
+}
+
+void PointOctree::Sync(const SceneData& sceneData) {
+    TRACE_SCOPE("PointOctree::Sync");
+    ALLOC_SCOPE("Derived geometry");
+    const int count = static_cast<int>(sceneData.points.size());
+    if (count < static_cast<int>(m_itemNodes.size())) Clear();
+
+    for (int i = 0; i < count; ++i) {
+        const auto& point = sceneData.points[i];
+        if (point.hidden) {
+            Remove(i);
+            continue;
+        }
+
+        if (!Contains(i)) Insert(i, point.coords);
+        else if (std::memcmp(GetPosition(i), point.coords, sizeof(point.coords)) != 0) Move(i, point.coords);
+    }
+}
+
+float PointOctree::BoxDistanceSquared(int node, const float position[3]) const {
+    const Node& n = m_nodes[node];
+    float distance = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        float d = std::fabs(position[k] - n.center[k]) - n.halfSize;
+        if (d > 0.0f) distance += d * d;
+    }
+    return distance;
+}
+
+void PointOctree::NearestRecursive(int node, const float position[3], int ignore, float& bestSquared, int& best) const {
+    const Node& n = m_nodes[node];
+    if (n.count == 0 || BoxDistanceSquared(node, position) > bestSquared) return;
+
+    for (int item : n.items) {
+        if (item == ignore) continue;
+        float distance = DistanceSquared(GetPosition(item), position);
+        if (distance <= bestSquared) {
+            bestSquared = distance;
+            best = item;
+        }
+    }
+    if (IsLeaf(node)) return;
+
+    // closest octant first so the rest get pruned sooner
+    std::pair<float, int> order[8];
+    for (int i = 0; i < 8; ++i) order[i] = { BoxDistanceSquared(n.children[i], position), n.children[i] };
+    std::sort(order, order + 8);
+    for (const auto& child : order) {
+        if (child.first > bestSquared) break;
+        NearestRecursive(child.second, position, ignore, bestSquared, best);
+    }
+}
+
+int PointOctree::Nearest(const float position[3], float maxDistance, int ignore) const {
+    if (m_root < 0) return -1;
+    float bestSquared = maxDistance * maxDistance;
+    int best = -1;
+    NearestRecursive(m_root, position, ignore, bestSquared, best);
+    return best;
+}
+
+void PointOctree::NearestToRayRecursive(int node, const float origin[3], const float dir[3], float maxDistance,
+                                        float& bestSquared, float& bestT, int& best) const {
+    const Node& n = m_nodes[node];
+    if (n.count == 0) return;
+
+    // slab test against the node grown by the search radius
+    float tMin = 0.0f, tMax = HUGE_VALF;
+    for (int k = 0; k < 3; ++k) {
+        float lo = n.center[k] - n.halfSize - maxDistance;
+        float hi = n.center[k] + n.halfSize + maxDistance;
+        if (dir[k] == 0.0f) {
+            if (origin[k] < lo || origin[k] > hi) return;
+            continue;
+        }
+        float t0 = (lo - origin[k]) / dir[k];
+        float t1 = (hi - origin[k]) / dir[k];
+        if (t0 > t1) std::swap(t0, t1);
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMin > tMax) return;
+    }
+
+    for (int item : n.items) {
+        const float* p = GetPosition(item);
+        float v[3] = { p[0] - origin[0], p[1] - origin[1], p[2] - origin[2] };
+        float t = std::max(0.0f, v[0] * dir[0] + v[1] * dir[1] + v[2] * dir[2]);
+        float closest[3] = { origin[0] + dir[0] * t, origin[1] + dir[1] * t, origin[2] + dir[2] * t };
+        float distance = DistanceSquared(p, closest);
+
+        if (distance < bestSquared || (distance == bestSquared && t < bestT)) {
+            bestSquared = distance;
+            bestT = t;
+            best = item;
+        }
+    }
+    if (IsLeaf(node)) return;
+
+    for (int child : n.children) {
+        NearestToRayRecursive(child, origin, dir, maxDistance, bestSquared, bestT, best);
+    }
+}
+
+int PointOctree::NearestToRay(const float origin[3], const float dir[3], float maxDistance) const {
+    if (m_root < 0) return -1;
+
+    float length = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+    if (length == 0.0f) return -1;
+    const float unit[3] = { dir[0] / length, dir[1] / length, dir[2] / length };
+
+    float bestSquared = maxDistance * maxDistance;
+    float bestT = HUGE_VALF;
+    int best = -1;
+    NearestToRayRecursive(m_root, origin, unit, maxDistance, bestSquared, bestT, best);
+    return best;
+}
+
+void PointOctree::QueryBox(const float min[3], const float max[3], std::vector<int>& results) const {
+    if (m_root < 0) return;
+
+    std::vector<int> stack = { m_root };
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+        const Node& n = m_nodes[node];
+        if (n.count == 0) continue;
+
+        bool overlaps = true, contained = true;
+        for (int k = 0; k < 3; ++k) {
+            float lo = n.center[k] - n.halfSize, hi = n.center[k] + n.halfSize;
+            if (hi < min[k] || lo > max[k]) overlaps = false;
+            if (lo < min[k] || hi > max[k]) contained = false;
+        }
+        if (!overlaps) continue;
+
+        // whole node inside the box, no need to test its points one by one
+        if (contained) {
+            CollectItems(node, results);
+            continue;
+        }
+
+        for (int item : n.items) {
+            const float* p = GetPosition(item);
+            if (p[0] >= min[0] && p[0] <= max[0] && p[1] >= min[1] && p[1] <= max[1] && p[2] >= min[2] && p[2] <= max[2]) {
+                results.push_back(item);
+            }
+        }
+        for (int child : n.children) {
+            if (child >= 0) stack.push_back(child);
+        }
+    }
+}
+
+void PointOctree::QuerySphere(const float center[3], float radius, std::vector<int>& results) const {
+    const float min[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+    const float max[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+
+    std::vector<int> candidates;
+    QueryBox(min, max, candidates);
+    for (int item : candidates) {
+        if (DistanceSquared(GetPosition(item), center) <= radius * radius) results.push_back(item);
+    }
+}
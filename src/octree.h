@@ -0,0 +1,67 @@
+// octree.h
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "scene.h"
+
+// Dynamic octree over point positions (model units), items are point indices.
+// Inserting, moving and removing only touch the leaf the point is in (and its parents),
+// the root grows on its own when something lands outside it.
+class PointOctree {
+public:
+    void Clear();
+
+    void Insert(int index, const float position[3]);
+    void Remove(int index);
+    void Move(int index, const float position[3]);
+    bool Contains(int index) const { return index >= 0 && index < static_cast<int>(m_itemNodes.size()) && m_itemNodes[index] >= 0; }
+
+    // Inserts new points, moves the ones that changed and drops hidden (deleted) ones.
+    // A scene with fewer points than before is a different scene, so that starts over.
+    void Sync(const SceneData& sceneData);
+
+    // -1 when nothing is within maxDistance, ignore is left out (the point being dragged)
+    int Nearest(const float position[3], float maxDistance, int ignore = -1) const;
+    // point closest to the ray origin + t * dir (t >= 0) within maxDistance of it, closer along the ray wins ties
+    int NearestToRay(const float origin[3], const float dir[3], float maxDistance) const;
+
+    void QueryBox(const float min[3], const float max[3], std::vector<int>& results) const;
+    void QuerySphere(const float center[3], float radius, std::vector<int>& results) const;
+
+    const float* GetPosition(int index) const { return &m_positions[index * 3]; }
+    size_t GetCount() const { return m_nodes.empty() ? 0 : m_nodes[m_root].count; }
+
+private:
+    struct Node {
+        float center[3] = {0.0f, 0.0f, 0.0f};
+        float halfSize = 0.0f;
+        int parent = -1;
+        int children[8] = {-1, -1, -1, -1, -1, -1, -1, -1}; // all -1 on leaves
+        int count = 0;          // items in the whole subtree
+        std::vector<int> items; // leaves only
+    };
+
+    int AllocateNode(const float center[3], float halfSize, int parent);
+    void FreeNode(int node);
+    bool IsLeaf(int node) const { return m_nodes[node].children[0] < 0; }
+    bool InsideNode(int node, const float position[3]) const;
+    int ChildFor(int node, const float position[3]) const;
+    void GrowRoot(const float position[3]);
+    void Split(int node);
+    void Collapse(int node);
+    void CollectItems(int node, std::vector<int>& items) const;
+    float BoxDistanceSquared(int node, const float position[3]) const;
+
+    void NearestRecursive(int node, const float position[3], int ignore, float& bestSquared, int& best) const;
+    void NearestToRayRecursive(int node, const float origin[3], const float dir[3], float maxDistance,
+                               float& bestSquared, float& bestT, int& best) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_freeNodes;
+    int m_root = -1;
+
+    std::vector<float> m_positions; // 3 per point index
+    std::vector<int> m_itemNodes;   // leaf holding each point, -1 when it isn't in the tree
+};
@@ -0,0 +1,253 @@
+#include "pngstream.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    constexpr size_t CHUNK_SIZE = 64 * 1024;
+    constexpr int MAX_MATCH = 258;
+
+    const uint16_t LENGTH_BASE[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    const uint8_t LENGTH_EXTRA[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+
+    uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size) {
+        static uint32_t table[256];
+        static bool initialized = false;
+        if (!initialized) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[i] = c;
+            }
+            initialized = true;
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void PutU32(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+}
+
+PngStreamWriter::~PngStreamWriter() {
+    if (m_file) fclose(m_file);
+}
+
+bool PngStreamWriter::Open(const std::string& path, int width, int height, int channels) {
+    if (width <= 0 || height <= 0 || (channels != 3 && channels != 4)) return false;
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file) return false;
+
+    m_width = width;
+    m_height = height;
+    m_channels = channels;
+    m_rowsWritten = 0;
+    m_failed = false;
+    m_adlerA = 1;
+    m_adlerB = 0;
+    m_bitBuffer = 0;
+    m_bitCount = 0;
+
+    size_t stride = static_cast<size_t>(width) * channels;
+    m_previousRow.assign(stride, 0);
+    m_filtered.resize(stride + 1);
+    m_candidate.resize(stride + 1);
+    m_chunk.clear();
+    m_chunk.reserve(CHUNK_SIZE);
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (fwrite(signature, 1, sizeof(signature), m_file) != sizeof(signature)) m_failed = true;
+
+    uint8_t header[13];
+    PutU32(header, static_cast<uint32_t>(width));
+    PutU32(header + 4, static_cast<uint32_t>(height));
+    header[8] = 8;                       // bit depth
+    header[9] = channels == 4 ? 6 : 2;   // RGBA or RGB
+    header[10] = 0;                      // deflate
+    header[11] = 0;                      // adaptive filtering
+    header[12] = 0;                      // no interlace
+    WriteChunk("IHDR", header, sizeof(header));
+
+    // zlib header, then a single fixed huffman block that lasts for the whole image
+    PutByte(0x78);
+    PutByte(0x01);
+    PutBits(1, 1); // BFINAL
+    PutBits(1, 2); // BTYPE = fixed huffman
+
+    return !m_failed;
+}
+
+void PngStreamWriter::FilterRow(const uint8_t* row) {
+    const size_t stride = m_previousRow.size();
+    const int bpp = m_channels;
+
+    // "sub" turns flat colors into zeros, "up" does the same for rows that repeat the previous one;
+    // keep whichever looks smaller (usual minimum sum of absolute differences heuristic)
+    uint64_t subCost = 0, upCost = 0;
+    m_filtered[0] = 1;
+    m_candidate[0] = 2;
+    for (size_t i = 0; i < stride; ++i) {
+        uint8_t left = i >= static_cast<size_t>(bpp) ? row[i - bpp] : 0;
+        uint8_t sub = static_cast<uint8_t>(row[i] - left);
+        uint8_t up = static_cast<uint8_t>(row[i] - m_previousRow[i]);
+        m_filtered[i + 1] = sub;
+        m_candidate[i + 1] = up;
+        subCost += sub < 128 ? sub : 256 - sub;
+        upCost += up < 128 ? up : 256 - up;
+    }
+    if (upCost < subCost) m_filtered.swap(m_candidate);
+
+    memcpy(m_previousRow.data(), row, stride);
+}
+
+bool PngStreamWriter::WriteRows(const uint8_t* rows, int count) {
+    if (!m_file || m_failed) return false;
+
+    const size_t stride = m_previousRow.size();
+    for (int r = 0; r < count && m_rowsWritten < m_height; ++r) {
+        FilterRow(rows + r * stride);
+        Deflate(m_filtered.data(), m_filtered.size());
+        ++m_rowsWritten;
+    }
+    return !m_failed;
+}
+
+void PngStreamWriter::Deflate(const uint8_t* data, size_t size) {
+    // adler32 of the uncompressed stream, reduced often enough to never overflow
+    for (size_t i = 0; i < size; ) {
+        size_t block = size - i < 5552 ? size - i : 5552;
+        for (size_t k = 0; k < block; ++k) {
+            m_adlerA += data[i + k];
+            m_adlerB += m_adlerA;
+        }
+        m_adlerA %= 65521;
+        m_adlerB %= 65521;
+        i += block;
+    }
+
+    // runs of the same byte become distance 1 matches, everything else is a literal
+    size_t i = 0;
+    while (i < size) {
+        uint8_t value = data[i];
+        size_t run = 1;
+        while (i + run < size && run < MAX_MATCH + 1 && data[i + run] == value) ++run;
+
+        PutLiteral(value);
+        ++i;
+        --run;
+
+        while (run >= 3) {
+            int length = static_cast<int>(run < MAX_MATCH ? run : MAX_MATCH);
+            PutMatch(length, 1);
+            i += length;
+            run -= length;
+        }
+        while (run > 0) {
+            PutLiteral(value);
+            ++i;
+            --run;
+        }
+    }
+}
+
+void PngStreamWriter::PutBits(uint32_t bits, int count) {
+    m_bitBuffer |= bits << m_bitCount;
+    m_bitCount += count;
+    while (m_bitCount >= 8) {
+        PutByte(static_cast<uint8_t>(m_bitBuffer & 0xFF));
+        m_bitBuffer >>= 8;
+        m_bitCount -= 8;
+    }
+}
+
+void PngStreamWriter::PutHuffman(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    PutBits(reversed, length);
+}
+
+void PngStreamWriter::PutLiteral(int value) {
+    // fixed huffman table from RFC 1951, section 3.2.6
+    if (value <= 143) PutHuffman(0x30 + value, 8);
+    else if (value <= 255) PutHuffman(0x190 + (value - 144), 9);
+    else if (value <= 279) PutHuffman(value - 256, 7);
+    else PutHuffman(0xC0 + (value - 280), 8);
+}
+
+void PngStreamWriter::PutMatch(int length, int distance) {
+    int index = 28;
+    while (LENGTH_BASE[index] > length) --index;
+
+    PutLiteral(257 + index);
+    if (LENGTH_EXTRA[index]) PutBits(length - LENGTH_BASE[index], LENGTH_EXTRA[index]);
+
+    // only distance 1 is ever used (distance code 0, no extra bits)
+    (void)distance;
+    PutHuffman(0, 5);
+}
+
+void PngStreamWriter::PutByte(uint8_t value) {
+    m_chunk.push_back(value);
+    if (m_chunk.size() >= CHUNK_SIZE) FlushChunk();
+}
+
+void PngStreamWriter::FlushChunk() {
+    if (m_chunk.empty()) return;
+    WriteChunk("IDAT", m_chunk.data(), m_chunk.size());
+    m_chunk.clear();
+}
+
+void PngStreamWriter::WriteChunk(const char type[4], const uint8_t* data, size_t size) {
+    uint8_t header[8];
+    PutU32(header, static_cast<uint32_t>(size));
+    memcpy(header + 4, type, 4);
+
+    uint32_t crc = Crc32(0, header + 4, 4);
+    crc = Crc32(crc, data, size);
+    uint8_t footer[4];
+    PutU32(footer, crc);
+
+    if (fwrite(header, 1, 8, m_file) != 8 ||
+        (size > 0 && fwrite(data, 1, size, m_file) != size) ||
+        fwrite(footer, 1, 4, m_file) != 4) {
+        m_failed = true;
+    }
+}
+
+bool PngStreamWriter::Close() {
+    if (!m_file) return false;
+
+    // pad missing rows so the file is still a valid image
+    if (m_rowsWritten < m_height && !m_failed) {
+        std::vector<uint8_t> blank(m_previousRow.size(), 0);
+        while (m_rowsWritten < m_height) WriteRows(blank.data(), 1);
+    }
+
+    PutLiteral(256); // end of block
+    if (m_bitCount > 0) PutBits(0, 8 - m_bitCount);
+
+    uint8_t adler[4];
+    PutU32(adler, (m_adlerB << 16) | m_adlerA);
+    for (uint8_t b : adler) PutByte(b);
+    FlushChunk();
+
+    WriteChunk("IEND", nullptr, 0);
+
+    if (fclose(m_file) != 0) m_failed = true;
+    m_file = nullptr;
+    return !m_failed;
+}
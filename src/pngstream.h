@@ -0,0 +1,52 @@
+// pngstream.h
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writes a PNG a few rows at a time, so huge images never have to exist in memory.
+// stb_image_write only encodes complete images, so this keeps its own tiny deflate encoder
+// (fixed huffman codes + run length matches), which is plenty for rendered scenes with flat backgrounds.
+class PngStreamWriter {
+public:
+    ~PngStreamWriter();
+
+    bool Open(const std::string& path, int width, int height, int channels); // channels: 3 (RGB) or 4 (RGBA)
+    bool WriteRows(const uint8_t* rows, int count);                          // tightly packed, top row first
+    bool Close();
+
+    int GetRowsWritten() const { return m_rowsWritten; }
+
+private:
+    void FilterRow(const uint8_t* row);
+    void Deflate(const uint8_t* data, size_t size);
+
+    void PutBits(uint32_t bits, int count);
+    void PutHuffman(uint32_t code, int length); // huffman codes go most significant bit first
+    void PutLiteral(int value);
+    void PutMatch(int length, int distance);
+
+    void PutByte(uint8_t value);
+    void FlushChunk();
+    void WriteChunk(const char type[4], const uint8_t* data, size_t size);
+
+    FILE* m_file = nullptr;
+    bool m_failed = false;
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_channels = 0;
+    int m_rowsWritten = 0;
+
+    std::vector<uint8_t> m_previousRow;
+    std::vector<uint8_t> m_filtered;  // filter byte + filtered row
+    std::vector<uint8_t> m_candidate;
+
+    uint32_t m_adlerA = 1, m_adlerB = 0;
+    uint32_t m_bitBuffer = 0;
+    int m_bitCount = 0;
+
+    std::vector<uint8_t> m_chunk; // pending IDAT payload
+};
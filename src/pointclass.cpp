@@ -0,0 +1,79 @@
+#include "pointclass.h"
+#include "trace.h"
+#include "alloctrack.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // coordinates are typed with a couple of decimals, anything closer than this is on the plane
+    constexpr float CLASS_EPSILON = 1e-4f;
+}
+
+void ClassifyPoints(const float* distances, const float* heights, uint8_t* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const float a = distances[i];
+        const float c = heights[i];
+
+        const int front = a > CLASS_EPSILON;
+        const int behind = a < -CLASS_EPSILON;
+        const int above = c > CLASS_EPSILON;
+        const int below = c < -CLASS_EPSILON;
+
+        out[i] = static_cast<uint8_t>(
+            ((front & above) << 0) |
+            ((behind & above) << 1) |
+            ((behind & below) << 2) |
+            ((front & below) << 3) |
+            ((!(above | below)) << 4) |
+            ((!(front | behind)) << 5) |
+            ((std::fabs(a - c) <= CLASS_EPSILON) << 6) |
+            ((std::fabs(a + c) <= CLASS_EPSILON) << 7));
+    }
+}
+
+void PointClassifier::Update(const SceneData& sceneData) {
+    TRACE_SCOPE("PointClassifier::Update");
+    ALLOC_SCOPE("Derived geometry");
+    const size_t count = sceneData.points.size();
+
+    if (m_classes.size() > count) m_classes.clear(); // points were erased and the indices moved, start over
+    if (m_classes.size() < count) {
+        // points were added (all of them when a project was loaded), classify the new ones in one go
+        const size_t known = m_classes.size();
+        m_distances.resize(count - known);
+        m_heights.resize(count - known);
+        for (size_t i = known; i < count; ++i) {
+            m_distances[i - known] = sceneData.points[i].coords[1];
+            m_heights[i - known] = sceneData.points[i].coords[2];
+        }
+
+        m_classes.resize(count);
+        ClassifyPoints(m_distances.data(), m_heights.data(), m_classes.data() + known, count - known);
+        if (known == 0) {
+            m_pending.clear();
+            return;
+        }
+    }
+
+    if (m_pending.empty()) return;
+
+    // gather the moved points, classify them together and scatter the results back
+    std::sort(m_pending.begin(), m_pending.end());
+    m_pending.erase(std::unique(m_pending.begin(), m_pending.end()), m_pending.end());
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(),
+        [&](int index) { return index < 0 || index >= static_cast<int>(count); }), m_pending.end());
+
+    const size_t pending = m_pending.size();
+    m_distances.resize(pending);
+    m_heights.resize(pending);
+    m_results.resize(pending);
+    for (size_t i = 0; i < pending; ++i) {
+        m_distances[i] = sceneData.points[m_pending[i]].coords[1];
+        m_heights[i] = sceneData.points[m_pending[i]].coords[2];
+    }
+
+    ClassifyPoints(m_distances.data(), m_heights.data(), m_results.data(), pending);
+    for (size_t i = 0; i < pending; ++i) m_classes[m_pending[i]] = m_results[i];
+    m_pending.clear();
+}
@@ -0,0 +1,46 @@
+// pointclass.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "scene.h"
+
+// Where a point sits relative to the projection planes, as bits so filters can ask for several at once.
+// Quadrant bits are only set off the projection planes, the ground line sets both plane bits (and both bisectors).
+enum PointClass : uint8_t {
+    POINT_QUADRANT_1     = 1 << 0, // a > 0, c > 0
+    POINT_QUADRANT_2     = 1 << 1, // a < 0, c > 0
+    POINT_QUADRANT_3     = 1 << 2, // a < 0, c < 0
+    POINT_QUADRANT_4     = 1 << 3, // a > 0, c < 0
+    POINT_ON_HORIZONTAL  = 1 << 4, // c = 0
+    POINT_ON_VERTICAL    = 1 << 5, // a = 0
+    POINT_FIRST_BISECTOR = 1 << 6, // a = c
+    POINT_SECOND_BISECTOR = 1 << 7 // a = -c
+};
+
+// Classifies count points from their a (distance) and c (height) arrays. Plain loop with no branches
+// over contiguous floats, so the compiler turns it into SIMD.
+void ClassifyPoints(const float* distances, const float* heights, uint8_t* out, size_t count);
+
+// Cached class of every point, only the points that moved get classified again
+class PointClassifier {
+public:
+    void Invalidate(int index) { m_pending.push_back(index); } // the dependency graph knows which points moved
+    void InvalidateAll() { m_classes.clear(); }
+
+    void Update(const SceneData& sceneData);
+
+    uint8_t Get(int index) const { return m_classes[index]; }
+    const std::vector<uint8_t>& GetClasses() const { return m_classes; }
+
+private:
+    std::vector<uint8_t> m_classes;
+    std::vector<int> m_pending;
+
+    // gathered coordinates for the kernel
+    std::vector<float> m_distances;
+    std::vector<float> m_heights;
+    std::vector<uint8_t> m_results;
+};
@@ -1,20 +1,31 @@
 #include "renderer.h"
+#include "geometry.h"
+#include "pngstream.h"
+#include "trace.h"
+#include "alloctrack.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 #include <numeric>
 
-#ifndef GL_PROGRAM_POINT_SIZE
-#define GL_PROGRAM_POINT_SIZE 0x8642
-#endif
-
 namespace {
     // Constants
     constexpr float DEFAULT_PLANE_SIZE = 1.1f;
     constexpr float CLAMP_VALUE = 50.0f;
     constexpr float POINT_SIZE_SCALE = 100.0f;
     constexpr float DEFAULT_OPACITY = 0.6f;
+
+    // Camera projection
+    constexpr float FIELD_OF_VIEW = 55.0f;
+    constexpr float NEAR_PLANE = 0.1f;
+    constexpr float FAR_PLANE = 100.0f;
+
+    // Offscreen export
+    constexpr int EXPORT_TILE_SIZE = 1024;
     
     // Shader sources
     const char* VERTEX_SHADER_SRC = 
@@ -66,22 +77,6 @@ namespace {
         // Vertical plane (XY)
         -1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 0.0f, 1.0f, 1.0f, 0.0f, -1.0f, 1.0f, 0.0f
     };
-
-    void CreateThickLineGeometry(std::vector<glm::vec3>& vertices, 
-                                const glm::vec3& start, 
-                                const glm::vec3& end, 
-                                const glm::vec3& cameraPos,
-                                float thickness) {
-        glm::vec3 lineDir = glm::normalize(end - start);
-        glm::vec3 cameraToLine = glm::normalize((start + end) * 0.5f - cameraPos);
-        glm::vec3 right = glm::normalize(glm::cross(cameraToLine, lineDir)) * thickness * 0.5f;
-        glm::vec3 up = glm::normalize(glm::cross(lineDir, right)) * thickness * 0.5f;
-
-        vertices = {
-            start - right - up, start + right - up, end - right + up,
-            start + right - up, end + right + up, end - right + up
-        };
-    }
 }
 
 bool Renderer::Initialize() {
@@ -97,16 +92,17 @@ bool Renderer::Initialize() {
     SetupBuffer(m_axesVAO, m_axesVBO, AXES_VERTICES, sizeof(AXES_VERTICES));
     SetupBuffer(m_dihedralVAO, m_dihedralVBO, PLANE_VERTICES, sizeof(PLANE_VERTICES));
     
-    // Setup point buffer
-    glGenVertexArrays(1, &m_pointVAO);
-    glGenBuffers(1, &m_pointVBO);
-    glBindVertexArray(m_pointVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_pointVBO);
+    // Setup the buffer points, lines and planes stream through
+    glGenVertexArrays(1, &m_streamVAO);
+    glGenBuffers(1, &m_streamVBO);
+    glBindVertexArray(m_streamVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_streamVBO);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
     glEnableVertexAttribArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
+    m_gpuTimer.Initialize();
     return true;
 }
 
@@ -133,348 +129,556 @@ void Renderer::SetupBuffer(GLuint& vao, GLuint& vbo, const void* data, size_t si
     glGenBuffers(1, &vbo);
     glBindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    UploadBuffer(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
     glEnableVertexAttribArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
 
+void Renderer::BeginFrame(const RenderView& view) {
+    m_drawView = view;
+    m_stats = RenderStats();
+    m_gpuTimer.BeginFrame();
+
+    // the ImGui backend puts back what it changes, still, once a frame is cheap next to finding out it didn't
+    m_state.Invalidate();
+    m_state.ResetCounters();
+
+    glViewport(view.viewport[0], view.viewport[1], view.viewport[2], view.viewport[3]);
+    m_state.UseProgram(m_mainShader);
+    SetUniform(m_mainShader, "view", view.view);
+    SetUniform(m_mainShader, "projection", view.projection);
+}
+
+void Renderer::EndFrame() {
+    m_stats.stateChanges = m_state.GetApplied();
+    m_stats.skippedCalls = m_state.GetSkipped();
+    {
+        std::lock_guard<std::mutex> lock(m_finishedMutex);
+        m_finishedLabels.swap(m_labels);
+        m_hasFinishedLabels = true;
+        m_finishedStats = m_stats;
+    }
+    m_labels.clear(); // whatever the main thread didn't get to, a newer frame replaces it
+}
+
+RenderStats Renderer::GetFrameStats() const {
+    std::lock_guard<std::mutex> lock(m_finishedMutex);
+    return m_finishedStats;
+}
+
+void Renderer::DrawArrays(GLenum mode, GLint first, GLsizei count) {
+    glDrawArrays(mode, first, count);
+    m_stats.drawCalls++;
+}
+
+void Renderer::UploadBuffer(GLenum target, size_t size, const void* data, GLenum usage) {
+    glBufferData(target, static_cast<GLsizeiptr>(size), data, usage);
+    m_stats.bufferUploads++;
+    m_stats.uploadBytes += size;
+}
+
+void Renderer::SetUniform(GLuint program, const char* name, float x, float y, float z) {
+    if (m_state.SetUniform(program, name, glm::vec3(x, y, z))) m_stats.uniformUpdates++;
+}
+
+void Renderer::SetUniform(GLuint program, const char* name, float value) {
+    if (m_state.SetUniform(program, name, value)) m_stats.uniformUpdates++;
+}
+
+void Renderer::SetUniform(GLuint program, const char* name, const glm::mat4& value) {
+    if (m_state.SetUniform(program, name, value)) m_stats.uniformUpdates++;
+}
+
+void Renderer::DrawGrouped(GLuint program, GLenum mode, const glm::vec3* vertices, GLsizei verticesPerPrimitive,
+                           const std::vector<glm::vec3>& colors, bool sort) {
+    const size_t count = colors.size();
+    m_drawOrder.resize(count);
+    std::iota(m_drawOrder.begin(), m_drawOrder.end(), 0u);
+    if (sort) {
+        std::stable_sort(m_drawOrder.begin(), m_drawOrder.end(), [&colors](uint32_t a, uint32_t b) {
+            const glm::vec3& first = colors[a];
+            const glm::vec3& second = colors[b];
+            if (first.r != second.r) return first.r < second.r;
+            if (first.g != second.g) return first.g < second.g;
+            return first.b < second.b;
+        });
+    }
+
+    m_sortedVertices.clear();
+    for (uint32_t index : m_drawOrder) {
+        const glm::vec3* primitive = vertices + static_cast<size_t>(index) * verticesPerPrimitive;
+        m_sortedVertices.insert(m_sortedVertices.end(), primitive, primitive + verticesPerPrimitive);
+    }
+
+    m_state.BindVertexArray(m_streamVAO);
+    m_state.BindArrayBuffer(m_streamVBO);
+    UploadBuffer(GL_ARRAY_BUFFER, m_sortedVertices.size() * sizeof(glm::vec3), m_sortedVertices.data(), GL_STREAM_DRAW);
+
+    for (size_t begin = 0; begin < count;) {
+        const glm::vec3& color = colors[m_drawOrder[begin]];
+        size_t end = begin + 1;
+        while (end < count && colors[m_drawOrder[end]] == color) end++;
+
+        SetUniform(program, "color", color.r, color.g, color.b);
+        DrawArrays(mode, static_cast<GLint>(begin) * verticesPerPrimitive, static_cast<GLsizei>(end - begin) * verticesPerPrimitive);
+        begin = end;
+    }
+}
+
 void Renderer::Render() {
+    TRACE_SCOPE("Renderer::Render");
+    ALLOC_SCOPE("Renderer");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     DrawAxes();
 
-    if (m_showDihedral) {
-        glUseProgram(m_mainShader);
-        glBindVertexArray(m_dihedralVAO);
-        
-        glUniform3f(glGetUniformLocation(m_mainShader, "color"), 0.2f, 0.2f, 0.8f);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-        
-        glUniform3f(glGetUniformLocation(m_mainShader, "color"), 0.8f, 0.2f, 0.2f);
-        glDrawArrays(GL_TRIANGLE_FAN, 4, 4);
-
-        // show quadrant labels
-        // Coords are in dihedral space, so no x,y,z, but d,a,c (which would be like x,z,y)
-        if (m_showQuadrantLabels) {
-            DrawLabel("I", glm::vec3(0.0f, 0.7f, 0.7f), glm::vec3(1.0f, 1.0f, 1.0f), true);
-            DrawLabel("II", glm::vec3(0.0f, 0.7f, -0.7f), glm::vec3(1.0f, 1.0f, 1.0f), true);
-            DrawLabel("III", glm::vec3(0.0f, -0.7f, -0.7f), glm::vec3(1.0f, 1.0f, 1.0f), true);
-            DrawLabel("IV", glm::vec3(0.0f, -0.7f, 0.7f), glm::vec3(1.0f, 1.0f, 1.0f), true);
-        }
-        
-        if (m_showScale) {
-            float scale = m_scale / 50.0f;
-            DrawLabel("0", glm::vec3(-1.05f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), true);
-            for (int i = -5; i <= 5; ++i) {
-                if (i == 0) continue; // Skip zero
-                glm::vec3 pos(-1.05f, i * 0.2f, 0.0f);
-                DrawLabel(std::to_string(static_cast<int>(i * scale * 10)).c_str(), pos, glm::vec3(1.0f, 1.0f, 1.0f), false);
-            }
-            for (int i = -5; i <= 5; ++i) {
-                if (i == 0) continue; // Skip zero
-                glm::vec3 pos(-1.05f, 0.0f, i * 0.2f);
-                DrawLabel(std::to_string(static_cast<int>(i * scale * 10)).c_str(), pos, glm::vec3(1.0f, 1.0f, 1.0f), false);
-            }
-        }
+    DrawDihedralPlanes();
 
-        glBindVertexArray(0);
-    }
+    glFlush();
+}
 
-    // Draw all accumulated labels
-    if (!m_labels.empty()) {
-        ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
-        ImGui::PushStyleColor(ImGuiCol_WindowBg, ImVec4(0.0f, 0.0f, 0.0f, 0.0f));
-        
-        ImGui::Begin("Labels", nullptr, 
-            ImGuiWindowFlags_NoTitleBar | 
-            ImGuiWindowFlags_NoInputs | 
-            ImGuiWindowFlags_NoMove | 
-            ImGuiWindowFlags_NoScrollbar | 
-            ImGuiWindowFlags_NoSavedSettings | 
-            ImGuiWindowFlags_NoFocusOnAppearing | 
-            ImGuiWindowFlags_NoBringToFrontOnFocus);
-        
-        // Get the current window size to set as the overlay size
-        GLint viewport[4];
-        glGetIntegerv(GL_VIEWPORT, viewport);
-        ImGui::SetWindowSize(ImVec2((float)viewport[2], (float)viewport[3]));
-        ImGui::SetWindowPos(ImVec2(0, 0));
-        
-        ImDrawList* drawList = ImGui::GetWindowDrawList();
-        
-        for (const auto& label : m_labels) {
-            ImVec2 pos(std::get<1>(label).x, std::get<1>(label).y);
-            const char* text = std::get<0>(label).c_str();
-            ImVec2 text_size = ImGui::CalcTextSize(text);
-            if (std::get<3>(label)) {
-                ImVec2 padding(4.0f, 2.0f);
-                ImVec2 rect_min = ImVec2(pos.x - padding.x, pos.y - padding.y);
-                ImVec2 rect_max = ImVec2(pos.x + text_size.x + padding.x, pos.y + text_size.y + padding.y);
-                drawList->AddRectFilled(rect_min, rect_max, ImGui::GetColorU32(ImVec4(0.0f, 0.0f, 0.0f, 0.4f)), 4.0f);
-            }
-            const glm::vec3& col = std::get<2>(label);
-            drawList->AddText(pos, ImGui::GetColorU32(ImVec4(col.r, col.g, col.b, 1.0f)), text);
+void Renderer::DrawLabels() {
+    {
+        std::lock_guard<std::mutex> lock(m_finishedMutex);
+        if (m_hasFinishedLabels) {
+            m_shownLabels.swap(m_finishedLabels);
+            m_hasFinishedLabels = false;
         }
+    }
+    if (m_shownLabels.empty()) return;
 
-        ImGui::End();
-        ImGui::PopStyleColor();
-        ImGui::PopStyleVar();
-        
-        m_labels.clear();
+    ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
+    ImGui::PushStyleColor(ImGuiCol_WindowBg, ImVec4(0.0f, 0.0f, 0.0f, 0.0f));
+    
+    ImGui::Begin("Labels", nullptr, 
+        ImGuiWindowFlags_NoTitleBar | 
+        ImGuiWindowFlags_NoInputs | 
+        ImGuiWindowFlags_NoMove | 
+        ImGuiWindowFlags_NoScrollbar | 
+        ImGuiWindowFlags_NoSavedSettings | 
+        ImGuiWindowFlags_NoFocusOnAppearing | 
+        ImGuiWindowFlags_NoBringToFrontOnFocus);
+    
+    // the overlay covers the 3D view
+    ImGui::SetWindowSize(ImVec2((float)m_view.viewport[2], (float)m_view.viewport[3]));
+    ImGui::SetWindowPos(ImVec2(0, 0));
+    
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    
+    for (const auto& label : m_shownLabels) {
+        ImVec2 pos(std::get<1>(label).x, std::get<1>(label).y);
+        const char* text = std::get<0>(label).c_str();
+        ImVec2 text_size = ImGui::CalcTextSize(text);
+        if (std::get<3>(label)) {
+            ImVec2 padding(4.0f, 2.0f);
+            ImVec2 rect_min = ImVec2(pos.x - padding.x, pos.y - padding.y);
+            ImVec2 rect_max = ImVec2(pos.x + text_size.x + padding.x, pos.y + text_size.y + padding.y);
+            drawList->AddRectFilled(rect_min, rect_max, ImGui::GetColorU32(ImVec4(0.0f, 0.0f, 0.0f, 0.4f)), 4.0f);
+        }
+        const glm::vec3& col = std::get<2>(label);
+        drawList->AddText(pos, ImGui::GetColorU32(ImVec4(col.r, col.g, col.b, 1.0f)), text);
     }
 
-    glFlush();
+    ImGui::End();
+    ImGui::PopStyleColor();
+    ImGui::PopStyleVar();
+}
+
+void Renderer::DrawDihedralPlanes() {
+    TRACE_SCOPE("Renderer::DrawDihedralPlanes");
+    ALLOC_SCOPE("Renderer");
+    if (!m_drawView.showDihedral) return;
+    GpuScope gpuScope(m_gpuTimer, GpuPass::DihedralPlanes);
+
+    m_state.UseProgram(m_mainShader);
+    m_state.SetEnabled(GL_DEPTH_TEST, true);
+    m_state.BindVertexArray(m_dihedralVAO);
+    
+    SetUniform(m_mainShader, "color", 0.2f, 0.2f, 0.8f);
+    DrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    
+    SetUniform(m_mainShader, "color", 0.8f, 0.2f, 0.2f);
+    DrawArrays(GL_TRIANGLE_FAN, 4, 4);
+
+    // show quadrant labels
+    // Coords are in dihedral space, so no x,y,z, but d,a,c (which would be like x,z,y)
+    if (m_drawView.showQuadrantLabels) {
+        DrawLabel("I", glm::vec3(0.0f, 0.7f, 0.7f), glm::vec3(1.0f, 1.0f, 1.0f), true);
+        DrawLabel("II", glm::vec3(0.0f, 0.7f, -0.7f), glm::vec3(1.0f, 1.0f, 1.0f), true);
+        DrawLabel("III", glm::vec3(0.0f, -0.7f, -0.7f), glm::vec3(1.0f, 1.0f, 1.0f), true);
+        DrawLabel("IV", glm::vec3(0.0f, -0.7f, 0.7f), glm::vec3(1.0f, 1.0f, 1.0f), true);
+    }
+    
+    if (m_drawView.showScale) {
+        float scale = m_drawView.scale / 50.0f;
+        DrawLabel("0", glm::vec3(-1.05f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), true);
+        for (int i = -5; i <= 5; ++i) {
+            if (i == 0) continue; // Skip zero
+            glm::vec3 pos(-1.05f, i * 0.2f, 0.0f);
+            DrawLabel(std::to_string(static_cast<int>(i * scale * 10)).c_str(), pos, glm::vec3(1.0f, 1.0f, 1.0f), false);
+        }
+        for (int i = -5; i <= 5; ++i) {
+            if (i == 0) continue; // Skip zero
+            glm::vec3 pos(-1.05f, 0.0f, i * 0.2f);
+            DrawLabel(std::to_string(static_cast<int>(i * scale * 10)).c_str(), pos, glm::vec3(1.0f, 1.0f, 1.0f), false);
+        }
+    }
 }
 
 void Renderer::DrawLabel(const char* text, const glm::vec3& position, const glm::vec3& color, bool showBackground = false) {
-    glm::vec2 screenPos = WorldToScreen(position);
+    if (m_suppressLabels) return;
+    glm::vec2 screenPos = WorldToScreen(m_drawView, position);
     m_labels.emplace_back(text, screenPos, color, showBackground);
+    m_stats.labels++;
 }
 
-glm::vec2 Renderer::WorldToScreen(const glm::vec3& worldPos) {
-    glm::vec4 clipSpacePos = m_projectionMatrix * m_viewMatrix * glm::vec4(worldPos, 1.0f);
+glm::vec2 Renderer::WorldToScreen(const RenderView& view, const glm::vec3& worldPos) {
+    glm::vec4 clipSpacePos = view.projection * view.view * glm::vec4(worldPos, 1.0f);
 
     if (clipSpacePos.w == 0.0f)
         return glm::vec2(0.0f);
 
     glm::vec3 ndc = glm::vec3(clipSpacePos) / clipSpacePos.w;
 
-    // Get viewport
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-
+    const int* viewport = view.viewport;
     float x = viewport[0] + (ndc.x + 1.0f) * 0.5f * viewport[2];
     float y = viewport[1] + (1.0f - (ndc.y + 1.0f) * 0.5f) * viewport[3];
 
     return glm::vec2(x, y);
 }
 
+void Renderer::ScreenToRay(const glm::vec2& screenPos, glm::vec3& origin, glm::vec3& dir) {
+    // inverse of WorldToScreen
+    const int* viewport = m_view.viewport;
+
+    float x = (screenPos.x - viewport[0]) / viewport[2] * 2.0f - 1.0f;
+    float y = 1.0f - (screenPos.y - viewport[1]) / viewport[3] * 2.0f;
+
+    glm::mat4 inverse = glm::inverse(m_view.projection * m_view.view);
+    glm::vec4 nearPoint = inverse * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(x, y, 1.0f, 1.0f);
+
+    origin = glm::vec3(nearPoint) / nearPoint.w;
+    dir = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+}
+
 void Renderer::DrawPoints(const std::vector<char*>& names,
                          const std::vector<glm::vec3>& points, 
                          const std::vector<glm::vec3>& colors, 
                          float size) {
+    TRACE_SCOPE("Renderer::DrawPoints");
+    ALLOC_SCOPE("Renderer");
     if (points.empty() || points.size() != colors.size()) return;
+    GpuScope gpuScope(m_gpuTimer, GpuPass::Points);
 
-    glUseProgram(m_mainShader);
-    glUniform1f(glGetUniformLocation(m_mainShader, "pointSize"), size);
-    glEnable(GL_PROGRAM_POINT_SIZE);
+    m_state.UseProgram(m_mainShader);
+    m_state.SetEnabled(GL_DEPTH_TEST, true);
+    m_state.SetEnabled(GL_PROGRAM_POINT_SIZE, true);
+    SetUniform(m_mainShader, "pointSize", size);
 
-    glBindVertexArray(m_pointVAO);
-    for (size_t i = 0; i < points.size(); i++) {
-        glBindBuffer(GL_ARRAY_BUFFER, m_pointVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3), &points[i], GL_STATIC_DRAW);
-        glUniform3f(glGetUniformLocation(m_mainShader, "color"), colors[i].r, colors[i].g, colors[i].b);
-        glDrawArrays(GL_POINTS, 0, 1);
-    }
+    // blended as well as depth tested, so whichever of two overlapping points comes first decides what shows:
+    // keep the scene order, only neighbours of one color share a draw
+    DrawGrouped(m_mainShader, GL_POINTS, points.data(), 1, colors, false);
 
-    if (m_showPointLabels) {
+    if (m_drawView.showPointLabels) {
         for (size_t i = 0; i < points.size(); i++) {
             DrawLabel(names[i], points[i], colors[i]);
         }
     }
 
-    if (m_showCutPoints) {
-        std::vector<glm::vec3> cutPoints;
-        cutPoints.reserve(points.size() * 2);
-        
+    if (m_drawView.showCutPoints) {
+        m_primitives.clear();
         for (const auto& point : points) {
-            cutPoints.emplace_back(point.x, 0.0f, point.z);
-            cutPoints.emplace_back(point.x, point.y, 0.0f);
+            m_primitives.emplace_back(point.x, 0.0f, point.z);
+            m_primitives.emplace_back(point.x, point.y, 0.0f);
         }
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_pointVBO);
-        glBufferData(GL_ARRAY_BUFFER, cutPoints.size() * sizeof(glm::vec3), cutPoints.data(), GL_STATIC_DRAW);
-        glUniform3f(glGetUniformLocation(m_mainShader, "color"), 0.0f, 1.0f, 0.0f);
-        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(cutPoints.size()));
+        UploadBuffer(GL_ARRAY_BUFFER, m_primitives.size() * sizeof(glm::vec3), m_primitives.data(), GL_STREAM_DRAW);
+        SetUniform(m_mainShader, "color", 0.0f, 1.0f, 0.0f);
+        DrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_primitives.size()));
     }
+}
 
-    glBindVertexArray(0);
+void Renderer::DrawMarkers(const std::vector<glm::vec3>& positions,
+                          const std::vector<glm::vec3>& colors,
+                          float size) {
+    TRACE_SCOPE("Renderer::DrawMarkers");
+    ALLOC_SCOPE("Renderer");
+    if (positions.empty() || positions.size() != colors.size()) return;
+    GpuScope gpuScope(m_gpuTimer, GpuPass::Markers);
+
+    m_state.UseProgram(m_mainShader);
+    m_state.SetEnabled(GL_DEPTH_TEST, false);
+    m_state.SetEnabled(GL_PROGRAM_POINT_SIZE, true);
+    SetUniform(m_mainShader, "pointSize", size);
+
+    // always on top, so the order shows where they overlap: only neighbours of one color share a draw
+    DrawGrouped(m_mainShader, GL_POINTS, positions.data(), 1, colors, false);
 }
 
 void Renderer::DrawLines(const std::vector<char*>& names,
                          const std::vector<std::pair<glm::vec3, glm::vec3>>& lines, 
                          const std::vector<glm::vec3>& colors, 
-                         float thickness, const Camera& camera) {
+                         float thickness) {
+    TRACE_SCOPE("Renderer::DrawLines");
+    ALLOC_SCOPE("Renderer");
     if (lines.empty() || lines.size() != colors.size()) return;
+    GpuScope gpuScope(m_gpuTimer, GpuPass::Lines);
 
-    glUseProgram(m_mainShader);
-    glm::vec3 cameraPos = camera.GetPosition();
+    m_state.UseProgram(m_mainShader);
+    m_state.SetEnabled(GL_DEPTH_TEST, true);
+    glm::vec3 cameraPos = m_drawView.cameraPosition;
     thickness /= POINT_SIZE_SCALE;
 
-    GLuint VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
+    m_primitives.resize(lines.size() * 6);
     for (size_t i = 0; i < lines.size(); i++) {
-        const auto& line = lines[i];
-        std::vector<glm::vec3> vertices;
-
-        CreateThickLineGeometry(vertices, line.first, line.second, cameraPos, thickness);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
-        glUniform3f(glGetUniformLocation(m_mainShader, "color"), colors[i].r, colors[i].g, colors[i].b);
-        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+        ThickLineQuad(lines[i].first, lines[i].second, cameraPos, thickness, &m_primitives[i * 6]);
+    }
+    DrawGrouped(m_mainShader, GL_TRIANGLES, m_primitives.data(), 6, colors, false); // scene order, like the points
 
-        if (m_showLineLabels) {
-            glm::vec3 midPoint = (line.first + line.second) * 0.5f;
+    if (m_drawView.showLineLabels) {
+        for (size_t i = 0; i < lines.size(); i++) {
+            glm::vec3 midPoint = (lines[i].first + lines[i].second) * 0.5f;
             DrawLabel(names[i], midPoint, colors[i], true);
         }
+    }
 
-        if (m_showCutLines) {
-            // Disable depth test to draw cut lines over dihedrals
-            glDisable(GL_DEPTH_TEST);
-
-            CreateThickLineGeometry(vertices, 
-                glm::vec3(line.first.x, line.first.y, 0.0f), 
-                glm::vec3(line.second.x, line.second.y, 0.0f), 
-                cameraPos, thickness);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
-            glUniform3f(glGetUniformLocation(m_mainShader, "color"), 0.0f, 1.0f, 0.0f);
-            glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
-
-            CreateThickLineGeometry(vertices, 
-                glm::vec3(line.first.x, 0.0f, line.first.z), 
-                glm::vec3(line.second.x, 0.0f, line.second.z), 
-                cameraPos, thickness);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
-            glUniform3f(glGetUniformLocation(m_mainShader, "color"), 0.0f, 1.0f, 0.0f);
-            glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
-
-            // Restore depth test
-            glEnable(GL_DEPTH_TEST);
+    if (m_drawView.showCutLines) {
+        // all of them at once without depth test, so they're drawn over the dihedrals
+        m_primitives.resize(lines.size() * 12);
+        for (size_t i = 0; i < lines.size(); i++) {
+            const auto& line = lines[i];
+            ThickLineQuad(glm::vec3(line.first.x, line.first.y, 0.0f), glm::vec3(line.second.x, line.second.y, 0.0f), cameraPos, thickness, &m_primitives[i * 12]);
+            ThickLineQuad(glm::vec3(line.first.x, 0.0f, line.first.z), glm::vec3(line.second.x, 0.0f, line.second.z), cameraPos, thickness, &m_primitives[i * 12 + 6]);
         }
-    }
 
-    glBindVertexArray(0);
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+        m_state.SetEnabled(GL_DEPTH_TEST, false);
+        UploadBuffer(GL_ARRAY_BUFFER, m_primitives.size() * sizeof(glm::vec3), m_primitives.data(), GL_STREAM_DRAW);
+        SetUniform(m_mainShader, "color", 0.0f, 1.0f, 0.0f);
+        DrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(m_primitives.size()));
+    }
 }
 
 void Renderer::DrawPlanes(const std::vector<char*>& names,
                          const std::vector<std::vector<glm::vec3>>& planes, 
                          const std::vector<glm::vec3>& colors,
-                         std::vector<bool>& expand,
+                         const std::vector<bool>& expand,
                          float opacity) {
+    TRACE_SCOPE("Renderer::DrawPlanes");
+    ALLOC_SCOPE("Renderer");
     if (planes.empty() || planes.size() != colors.size() || planes.size() != expand.size()) return;
+    GpuScope gpuScope(m_gpuTimer, GpuPass::Planes);
 
-    glUseProgram(m_planeShader);
-    glUniformMatrix4fv(glGetUniformLocation(m_planeShader, "view"), 1, GL_FALSE, glm::value_ptr(m_viewMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(m_planeShader, "projection"), 1, GL_FALSE, glm::value_ptr(m_projectionMatrix));
-
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    m_state.UseProgram(m_planeShader);
+    SetUniform(m_planeShader, "view", m_drawView.view);
+    SetUniform(m_planeShader, "projection", m_drawView.projection);
+    SetUniform(m_planeShader, "opacity", opacity);
 
-    GLuint planeVAO, planeVBO;
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
+    m_state.SetEnabled(GL_DEPTH_TEST, true);
+    m_state.DepthMask(true);
+    m_state.SetEnabled(GL_BLEND, true);
+    m_state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    // every corner in one upload. They're blended, so they keep their order and get a draw each
+    m_primitives.clear();
+    m_planeRanges.clear();
     for (size_t i = 0; i < planes.size(); i++) {
         const auto& plane = planes[i];
         if (plane.size() < 3) continue;
 
-        std::vector<glm::vec3> vertices;
-        
+        // the triangle itself, or a big square on its plane when expanded
+        const glm::vec3* vertices = plane.data();
+        size_t count = plane.size();
+        glm::vec3 quad[4];
         if (expand[i]) {
-            glm::vec3 normal = glm::normalize(glm::cross(plane[1] - plane[0], plane[2] - plane[0]));
-            float planeConstant = -glm::dot(normal, plane[0]);
-            
-            glm::vec3 right, forward;
-            
-            if (fabs(normal.y) > 0.999f) {
-                right = glm::vec3(1, 0, 0);
-                forward = glm::vec3(0, 0, 1);
-            } else {
-                right = glm::normalize(glm::cross(normal, glm::vec3(0, 1, 0)));
-                forward = glm::normalize(glm::cross(normal, right));
-            }
-
-            glm::vec3 planeCenter = -normal * planeConstant;
-            
-            vertices = {
-                planeCenter + (right + forward) * DEFAULT_PLANE_SIZE,
-                planeCenter + (right - forward) * DEFAULT_PLANE_SIZE,
-                planeCenter + (-right - forward) * DEFAULT_PLANE_SIZE,
-                planeCenter + (-right + forward) * DEFAULT_PLANE_SIZE
-            };
-            
-            for (auto& v : vertices) {
-                v.x = glm::clamp(v.x, -CLAMP_VALUE, CLAMP_VALUE);
-                v.y = glm::clamp(v.y, -CLAMP_VALUE, CLAMP_VALUE);
-                v.z = glm::clamp(v.z, -CLAMP_VALUE, CLAMP_VALUE);
-            }
-        } else {
-            vertices = plane;
+            ExpandedPlaneQuad(plane[0], plane[1], plane[2], DEFAULT_PLANE_SIZE, CLAMP_VALUE, quad);
+            vertices = quad;
+            count = 4;
         }
 
-        if (m_showPlaneLabels) {
-            glm::vec3 center = std::accumulate(vertices.begin(), vertices.end(), glm::vec3(0.0f)) / static_cast<float>(vertices.size());
+        if (m_drawView.showPlaneLabels) {
+            glm::vec3 center = std::accumulate(vertices, vertices + count, glm::vec3(0.0f)) / static_cast<float>(count);
             DrawLabel(names[i], center, colors[i], true);
         }
 
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
-        glUniform3f(glGetUniformLocation(m_planeShader, "color"), colors[i].r, colors[i].g, colors[i].b);
-        glUniform1f(glGetUniformLocation(m_planeShader, "opacity"), opacity);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, static_cast<GLsizei>(vertices.size()));
+        m_planeRanges.emplace_back(i, static_cast<GLint>(m_primitives.size()), static_cast<GLsizei>(count));
+        m_primitives.insert(m_primitives.end(), vertices, vertices + count);
+    }
+    if (m_planeRanges.empty()) return;
+
+    m_state.BindVertexArray(m_streamVAO);
+    m_state.BindArrayBuffer(m_streamVBO);
+    UploadBuffer(GL_ARRAY_BUFFER, m_primitives.size() * sizeof(glm::vec3), m_primitives.data(), GL_STREAM_DRAW);
+    for (const auto& range : m_planeRanges) {
+        const glm::vec3& color = colors[std::get<0>(range)];
+        SetUniform(m_planeShader, "color", color.r, color.g, color.b);
+        DrawArrays(GL_TRIANGLE_FAN, std::get<1>(range), std::get<2>(range));
     }
-
-    glBindVertexArray(0);
-    glDeleteVertexArrays(1, &planeVAO);
-    glDeleteBuffers(1, &planeVBO);
 }
 
 void Renderer::DrawAxes() {
-    glUseProgram(m_mainShader);
-    glBindVertexArray(m_axesVAO);
-
-    switch (m_axesType) {
+    TRACE_SCOPE("Renderer::DrawAxes");
+    ALLOC_SCOPE("Renderer");
+    GpuScope gpuScope(m_gpuTimer, GpuPass::Axes);
+    m_state.UseProgram(m_mainShader);
+    m_state.SetEnabled(GL_DEPTH_TEST, true);
+    m_state.BindVertexArray(m_axesVAO);
+
+    switch (m_drawView.axesType) {
         case 0: // 3D axes
-            glUniform3f(glGetUniformLocation(m_mainShader, "color"), 1.0f, 0.0f, 0.0f);
-            glDrawArrays(GL_LINES, 0, 2);
-            glUniform3f(glGetUniformLocation(m_mainShader, "color"), 0.0f, 1.0f, 0.0f);
-            glDrawArrays(GL_LINES, 2, 2);
-            glUniform3f(glGetUniformLocation(m_mainShader, "color"), 0.0f, 0.0f, 1.0f);
-            glDrawArrays(GL_LINES, 4, 2);
+            SetUniform(m_mainShader, "color", 1.0f, 0.0f, 0.0f);
+            DrawArrays(GL_LINES, 0, 2);
+            SetUniform(m_mainShader, "color", 0.0f, 1.0f, 0.0f);
+            DrawArrays(GL_LINES, 2, 2);
+            SetUniform(m_mainShader, "color", 0.0f, 0.0f, 1.0f);
+            DrawArrays(GL_LINES, 4, 2);
             break;
         case 1: // Cartesian axes
-            glUniform3f(glGetUniformLocation(m_mainShader, "color"), 1.0f, 1.0f, 1.0f);
-            glDrawArrays(GL_LINES, 6, 2);
-            glDrawArrays(GL_LINES, 8, 2);
-            glDrawArrays(GL_LINES, 10, 2);
+            SetUniform(m_mainShader, "color", 1.0f, 1.0f, 1.0f);
+            DrawArrays(GL_LINES, 6, 2);
+            DrawArrays(GL_LINES, 8, 2);
+            DrawArrays(GL_LINES, 10, 2);
             break;
         case 2: // Dihedral system
-            m_showDihedral = true;
+            m_drawView.showDihedral = true;
             break;
         default:
-            m_showDihedral = false;
+            m_drawView.showDihedral = false;
             break;
     }
-
-    glBindVertexArray(0);
 }
 
-void Renderer::UpdateCamera(const Camera& camera, int width, int height) {
-    m_viewMatrix = camera.GetViewMatrix();
+void Renderer::UpdateCamera(const Camera& camera, int x, int y, int width, int height) {
+    m_view.view = camera.GetViewMatrix();
+    m_view.cameraPosition = camera.GetPosition();
+    m_view.viewport[0] = x;
+    m_view.viewport[1] = y;
+    m_view.viewport[2] = width;
+    m_view.viewport[3] = height;
     if (height == 0) height = 1;
     
     float aspectRatio = static_cast<float>(width) / static_cast<float>(height);
-    m_projectionMatrix = glm::perspective(glm::radians(55.0f), aspectRatio, 0.1f, 100.0f);
-    
-    glUseProgram(m_mainShader);
-    glUniformMatrix4fv(glGetUniformLocation(m_mainShader, "view"), 1, GL_FALSE, glm::value_ptr(m_viewMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(m_mainShader, "projection"), 1, GL_FALSE, glm::value_ptr(m_projectionMatrix));
+    m_view.projection = glm::perspective(glm::radians(FIELD_OF_VIEW), aspectRatio, NEAR_PLANE, FAR_PLANE);
+}
+
+void Renderer::SetProjection(const glm::mat4& projection) {
+    m_drawView.projection = projection;
+    m_state.UseProgram(m_mainShader);
+    SetUniform(m_mainShader, "projection", projection);
+}
+
+bool Renderer::ExportTiledImage(const std::string& path, int width, int height, const glm::vec3& background,
+                                const std::function<void(float)>& drawScene) {
+    TRACE_SCOPE("Renderer::ExportTiledImage");
+    if (width <= 0 || height <= 0) return false;
+
+    GLint maxRenderbufferSize = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbufferSize);
+    const int tileSize = std::max(1, std::min(EXPORT_TILE_SIZE, static_cast<int>(maxRenderbufferSize)));
+
+    PngStreamWriter png;
+    if (!png.Open(path, width, height, 3)) {
+        std::cerr << "Failed to open file for writing: " << path << std::endl;
+        return false;
+    }
+
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glm::mat4 previousProjection = m_drawView.projection;
+
+    GLuint framebuffer, colorBuffer, depthBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, tileSize, tileSize);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, tileSize, tileSize);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    bool ok = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!ok) {
+        std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+    }
+
+    // Only one row of tiles is ever kept on the CPU
+    std::vector<unsigned char> tilePixels(static_cast<size_t>(tileSize) * tileSize * 4);
+    std::vector<unsigned char> strip(static_cast<size_t>(width) * tileSize * 3);
+
+    // Each tile gets the matching slice of the full frustum
+    const float top = NEAR_PLANE * tanf(glm::radians(FIELD_OF_VIEW) * 0.5f);
+    const float right = top * static_cast<float>(width) / static_cast<float>(height);
+
+    // Point sizes are in pixels, scale them so points look the same relative to the image
+    const float pointScale = previousViewport[3] > 0 ? static_cast<float>(height) / previousViewport[3] : 1.0f;
+
+    m_suppressLabels = true;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    for (int y0 = 0; ok && y0 < height; y0 += tileSize) {
+        const int tileHeight = std::min(tileSize, height - y0);
+
+        for (int x0 = 0; x0 < width; x0 += tileSize) {
+            const int tileWidth = std::min(tileSize, width - x0);
+
+            float l = -right + 2.0f * right * x0 / width;
+            float r = -right + 2.0f * right * (x0 + tileWidth) / width;
+            float t = top - 2.0f * top * y0 / height;
+            float b = top - 2.0f * top * (y0 + tileHeight) / height;
+            SetProjection(glm::frustum(l, r, b, t, NEAR_PLANE, FAR_PLANE));
+
+            glViewport(0, 0, tileWidth, tileHeight);
+            glClearColor(background.r, background.g, background.b, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            DrawAxes();
+            DrawDihedralPlanes();
+            drawScene(pointScale);
+
+            glReadPixels(0, 0, tileWidth, tileHeight, GL_RGBA, GL_UNSIGNED_BYTE, tilePixels.data());
+
+            // GL rows go bottom up, the PNG goes top down
+            for (int row = 0; row < tileHeight; ++row) {
+                const unsigned char* src = &tilePixels[static_cast<size_t>(tileHeight - 1 - row) * tileWidth * 4];
+                unsigned char* dst = &strip[(static_cast<size_t>(row) * width + x0) * 3];
+                for (int x = 0; x < tileWidth; ++x) {
+                    dst[x * 3 + 0] = src[x * 4 + 0];
+                    dst[x * 3 + 1] = src[x * 4 + 1];
+                    dst[x * 3 + 2] = src[x * 4 + 2];
+                }
+            }
+        }
+
+        ok = png.WriteRows(strip.data(), tileHeight);
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    m_suppressLabels = false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    SetProjection(previousProjection);
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+
+    ok = png.Close() && ok;
+    if (!ok) {
+        std::cerr << "Failed to export image: " << path << std::endl;
+    }
+    return ok;
 }
 
-glm::vec3 Renderer::SetPositionWithGuizmo(Camera& camera) {
+glm::vec3 Renderer::SetPositionWithGuizmo(Camera& camera, int draggedPoint) {
     ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
     ImGui::SetNextWindowSize(ImVec2(ImGui::GetIO().DisplaySize.x, ImGui::GetIO().DisplaySize.y), ImGuiCond_Always);
     ImGui::PushStyleColor(ImGuiCol_WindowBg, ImVec4(0.0f, 0.0f, 0.0f, 0.0f));
@@ -503,13 +707,23 @@ glm::vec3 Renderer::SetPositionWithGuizmo(Camera& camera) {
     ImGui::PopStyleColor();
 
     // Extract the new position from the transform matrix
-    glm::vec3 newPosition(m_guizmoTransform[3].x * m_scale, 
-                         m_guizmoTransform[3].z * m_scale, 
-                         m_guizmoTransform[3].y * m_scale);
+    glm::vec3 newPosition(m_guizmoTransform[3].x * m_view.scale, 
+                         m_guizmoTransform[3].z * m_view.scale, 
+                         m_guizmoTransform[3].y * m_view.scale);
+
+    // snap to the closest other point, the guizmo itself stays free so the drag can pull it away again
+    if (m_snapPoints && draggedPoint >= 0 && ImGuizmo::IsUsing()) {
+        const float position[3] = { newPosition.x, newPosition.y, newPosition.z };
+        int nearest = m_snapPoints->Nearest(position, m_snapRadius, draggedPoint);
+        if (nearest >= 0) {
+            const float* target = m_snapPoints->GetPosition(nearest);
+            newPosition = glm::vec3(target[0], target[1], target[2]);
+        }
+    }
     return newPosition;
 }
 
     void Renderer::SetInitialGuizmoPosition(const glm::vec3& position) {
     m_initialGuizmoPosition = position;
-    m_guizmoTransform = glm::translate(glm::mat4(1.0f), position / m_scale);
+    m_guizmoTransform = glm::translate(glm::mat4(1.0f), position / m_view.scale);
 }
\ No newline at end of file
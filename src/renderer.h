@@ -12,15 +12,65 @@
 #include <ImGuizmo.h>
 
 #include <vector>
+#include <functional>
+#include <cstdint>
+#include <mutex>
+#include <tuple>
 #include <glm/glm.hpp>
 
 #include "camera.h"
+#include "octree.h"
+#include "gputimer.h"
+#include "glstate.h"
+
+// What the renderer asked GL for during one frame
+struct RenderStats {
+    unsigned drawCalls = 0;
+    unsigned bufferUploads = 0;
+    size_t uploadBytes = 0;
+    unsigned uniformUpdates = 0;
+    unsigned labels = 0;
+    unsigned stateChanges = 0; // binds and enables that reached GL
+    unsigned skippedCalls = 0; // state and uniform calls the GlState filtered out
+};
+
+// What drawing reads besides its arguments: the camera, the viewport and the toggles the UI sets. The main thread
+// keeps one up to date (UpdateCamera and the setters) and every frame is drawn with its own copy (BeginFrame),
+// so with a render thread the UI can already change the next frame while the last one is still being drawn.
+struct RenderView {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    int viewport[4] = { 0, 0, 1, 1 };
+
+    int axesType = 0;
+    bool showDihedral = false;
+    bool showCutPoints = false;
+    bool showCutLines = false;
+
+    bool showQuadrantLabels = false;
+    bool showPointLabels = true;
+    bool showLineLabels = true;
+    bool showPlaneLabels = true;
+
+    bool showScale = false;
+    float scale = 1.0f;
+};
 
 class Renderer {
 public:
     bool Initialize();
-    void Render();
-    void UpdateCamera(const Camera& camera, int width, int height);
+
+    // Main thread: the view the next frame gets drawn with, the viewport is where it goes in the window
+    void UpdateCamera(const Camera& camera, int x, int y, int width, int height);
+    const RenderView& GetView() const { return m_view; }
+    // Main thread, inside the ImGui frame: the labels of the last frame that finished drawing
+    void DrawLabels();
+
+    // Whichever thread has the GL context, BeginFrame and EndFrame around everything else that's drawn
+    void BeginFrame(const RenderView& view); // the counters start over
+    void Render(); // 3D base: axes and dihedral planes
+    void EndFrame(); // hands the labels and counters over to the main thread
 
     void DrawPoints(const std::vector<char*>& names,
                    const std::vector<glm::vec3>& points, 
@@ -29,62 +79,105 @@ public:
     void DrawLines(const std::vector<char*>& names,
                    const std::vector<std::pair<glm::vec3, glm::vec3>>& lines,
                    const std::vector<glm::vec3>& colors, 
-                   float thickness, const Camera& camera);
+                   float thickness);
+    void DrawMarkers(const std::vector<glm::vec3>& positions,
+                   const std::vector<glm::vec3>& colors,
+                   float size); // unlabeled points, always on top (trace points)
     void DrawPlanes(const std::vector<char*>& names,
                    const std::vector<std::vector<glm::vec3>>& planes, 
                    const std::vector<glm::vec3>& colors,
-                   std::vector<bool>& expand,
+                   const std::vector<bool>& expand,
                    float opacity);
 
-    void SetAxesType(int type) { m_axesType = type; }
-    void SetDihedralsVisible(bool visible) { m_showDihedral = visible; }
-    void SetCutPointVisible(bool visible) { m_showCutPoints = visible; }
-    void SetCutLineVisible(bool visible) { m_showCutLines = visible; }
+    void SetAxesType(int type) { m_view.axesType = type; }
+    void SetDihedralsVisible(bool visible) { m_view.showDihedral = visible; }
+    void SetCutPointVisible(bool visible) { m_view.showCutPoints = visible; }
+    void SetCutLineVisible(bool visible) { m_view.showCutLines = visible; }
 
     void SetLabelsVisible(bool labels[3]) {
-        m_showPointLabels = labels[0];
-        m_showLineLabels = labels[1];
-        m_showPlaneLabels = labels[2];
+        m_view.showPointLabels = labels[0];
+        m_view.showLineLabels = labels[1];
+        m_view.showPlaneLabels = labels[2];
     }
 
     void SetInitialGuizmoPosition(const glm::vec3& position);
-    glm::vec3 SetPositionWithGuizmo(Camera& camera);
+    glm::vec3 SetPositionWithGuizmo(Camera& camera, int draggedPoint = -1); // dragged points snap to others when snapping is on
+
+    // nullptr turns snapping off, radius is in model units
+    void SetSnapping(const PointOctree* points, float radius) { m_snapPoints = points; m_snapRadius = radius; }
+
+    // ray under a screen position (same space as the labels), in world units, with the main thread's view
+    void ScreenToRay(const glm::vec2& screenPos, glm::vec3& origin, glm::vec3& dir);
+    glm::vec2 WorldToScreen(const glm::vec3& worldPos) { return WorldToScreen(m_view, worldPos); }
 
-    void SetQuadrantLabelsVisible(bool visible) { m_showQuadrantLabels = visible; }
+    void SetQuadrantLabelsVisible(bool visible) { m_view.showQuadrantLabels = visible; }
 
     void DrawLabel(const char* text, const glm::vec3& position, const glm::vec3& color, bool showBackground);
-    void SetShowScale(bool show, float scale) { m_showScale = show; m_scale = scale; }
+    void SetShowScale(bool show, float scale) { m_view.showScale = show; m_view.scale = scale; }
+
+    // Renders the scene tile by tile into an offscreen framebuffer and streams it into a PNG,
+    // so the output can be far bigger than the window (or even the GPU's max texture size).
+    // drawScene is called once per tile with the point size scale to use.
+    bool ExportTiledImage(const std::string& path, int width, int height, const glm::vec3& background,
+                          const std::function<void(float)>& drawScene);
+    RenderStats GetFrameStats() const; // the last complete frame
+    GpuTimer& GetGpuTimer() { return m_gpuTimer; }
 private:
+    using Label = std::tuple<std::string, glm::vec2, glm::vec3, bool>;
+
+    static glm::vec2 WorldToScreen(const RenderView& view, const glm::vec3& worldPos);
+
     void DrawAxes();
+    void DrawDihedralPlanes();
+    void SetProjection(const glm::mat4& projection);
     void SetupShaderProgram(GLuint& program, const char* vertexSrc, const char* fragmentSrc);
     void SetupBuffer(GLuint& vao, GLuint& vbo, const void* data, size_t size);
 
-    glm::vec2 WorldToScreen(const glm::vec3& worldPos);
-    std::vector<std::tuple<std::string, glm::vec2, glm::vec3, bool>> m_labels;
+    // the GL calls the performance HUD counts all go through these
+    void DrawArrays(GLenum mode, GLint first, GLsizei count);
+    void UploadBuffer(GLenum target, size_t size, const void* data, GLenum usage);
+    void SetUniform(GLuint program, const char* name, float x, float y, float z);
+    void SetUniform(GLuint program, const char* name, float value);
+    void SetUniform(GLuint program, const char* name, const glm::mat4& value);
 
-    int m_axesType = 0;
-    bool m_showDihedral = false;
-    bool m_showCutPoints = false;
-    bool m_showCutLines = false;
+    // One upload for all the primitives (verticesPerPrimitive each), one draw per run of the same color.
+    // sort groups the colors first, only for opaque passes: with blending on, the order overlapping primitives
+    // are drawn in shows even through the depth test.
+    void DrawGrouped(GLuint program, GLenum mode, const glm::vec3* vertices, GLsizei verticesPerPrimitive,
+                     const std::vector<glm::vec3>& colors, bool sort);
 
-    bool m_showQuadrantLabels = false;
-    bool m_showPointLabels = true;
-    bool m_showLineLabels = true;
-    bool m_showPlaneLabels = true;
+    RenderView m_view;     // main thread, for the next frame
+    RenderView m_drawView; // the frame being drawn
 
-    bool m_showScale = false;
-    float m_scale = 1.0f;
-
-    glm::mat4 m_viewMatrix;
-    glm::mat4 m_projectionMatrix;
+    std::vector<Label> m_labels; // the frame being drawn
+    std::vector<Label> m_shownLabels; // main thread, drawn again every frame until a newer frame finishes
+    bool m_suppressLabels = false; // offscreen exports have no ImGui overlay
 
     glm::mat4 m_guizmoTransform;
     glm::vec3 m_initialGuizmoPosition;
 
+    const PointOctree* m_snapPoints = nullptr;
+    float m_snapRadius = 0.0f;
+
     GLuint m_mainShader = 0;
     GLuint m_planeShader = 0;
 
     GLuint m_axesVAO = 0, m_axesVBO = 0;
     GLuint m_dihedralVAO = 0, m_dihedralVBO = 0;
-    GLuint m_pointVAO = 0, m_pointVBO = 0;
+    GLuint m_streamVAO = 0, m_streamVBO = 0; // what's drawn from the scene, uploaded every frame
+
+    GlState m_state;
+    // scratch, kept so drawing doesn't allocate every frame
+    std::vector<uint32_t> m_drawOrder;
+    std::vector<glm::vec3> m_primitives, m_sortedVertices;
+    std::vector<std::tuple<size_t, GLint, GLsizei>> m_planeRanges; // plane, first vertex, vertex count
+
+    RenderStats m_stats;
+    GpuTimer m_gpuTimer;
+
+    // what EndFrame hands over, until the main thread picks it up
+    mutable std::mutex m_finishedMutex;
+    std::vector<Label> m_finishedLabels;
+    bool m_hasFinishedLabels = false;
+    RenderStats m_finishedStats;
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "renderpacket.h"
+#include "trace.h"
+#include "traces.h"
+
+namespace {
+    glm::vec3 ToWorld(const float coords[3], float worldScale) { // (d, a, c) to the 3D view's axes
+        return glm::vec3(coords[0] / worldScale, coords[2] / worldScale, coords[1] / worldScale);
+    }
+
+    // names first, then the pointers into them, a name growing past the small string buffer would move it
+    void SetLabels(std::vector<std::string>& names, std::vector<char*>& labels) {
+        labels.clear();
+        for (auto& name : names) labels.push_back(&name[0]);
+    }
+}
+
+void BuildRenderPacket(const SceneData& sceneData, const IntersectionResults* intersections, RenderPacket& packet) {
+    TRACE_SCOPE("BuildRenderPacket");
+    const float worldScale = sceneData.settings.worldScale;
+
+    packet.pointNames.clear();
+    packet.pointPositions.clear();
+    packet.pointColors.clear();
+    for (const auto& point : sceneData.points) {
+        if (point.hidden) continue;
+        packet.pointNames.push_back(point.name);
+        packet.pointPositions.push_back(ToWorld(point.coords, worldScale));
+        packet.pointColors.emplace_back(point.color[0], point.color[1], point.color[2]);
+    }
+    SetLabels(packet.pointNames, packet.pointLabels);
+
+    packet.lineNames.clear();
+    packet.linePositions.clear();
+    packet.lineColors.clear();
+    packet.markerPositions.clear();
+    packet.markerColors.clear();
+    for (const auto& line : sceneData.lines) {
+        const auto& point1 = sceneData.points[line.point1index];
+        const auto& point2 = sceneData.points[line.point2index];
+
+        packet.lineNames.push_back(line.name);
+        packet.linePositions.emplace_back(ToWorld(point1.coords, worldScale), ToWorld(point2.coords, worldScale));
+        packet.lineColors.emplace_back(line.color[0], line.color[1], line.color[2]);
+
+        // same colors as on the sheet (H blue, V red)
+        if (!line.showVisibility) continue;
+        const LineTraces traces = TraceEngine::ComputeLineTraces(point1.coords, point2.coords);
+        if (traces.hasHorizontal) {
+            packet.markerPositions.emplace_back(traces.horizontal[0] / worldScale, 0.0f, traces.horizontal[1] / worldScale);
+            packet.markerColors.emplace_back(0.0f, 0.0f, 1.0f);
+        }
+        if (traces.hasVertical) {
+            packet.markerPositions.emplace_back(traces.vertical[0] / worldScale, traces.vertical[2] / worldScale, 0.0f);
+            packet.markerColors.emplace_back(1.0f, 0.0f, 0.0f);
+        }
+    }
+    SetLabels(packet.lineNames, packet.lineLabels);
+
+    packet.planeNames.clear();
+    packet.planePositions.resize(sceneData.planes.size()); // the inner vectors keep their memory
+    packet.planeColors.clear();
+    packet.planeExpand.clear();
+    for (size_t i = 0; i < sceneData.planes.size(); ++i) {
+        const auto& plane = sceneData.planes[i];
+        packet.planeNames.push_back(plane.name);
+
+        auto& corners = packet.planePositions[i];
+        corners.clear();
+        corners.push_back(ToWorld(sceneData.points[plane.point1index].coords, worldScale));
+        corners.push_back(ToWorld(sceneData.points[plane.point2index].coords, worldScale));
+        corners.push_back(ToWorld(sceneData.points[plane.point3index].coords, worldScale));
+
+        packet.planeColors.emplace_back(plane.color[0], plane.color[1], plane.color[2]);
+        packet.planeExpand.push_back(plane.expand);
+    }
+    SetLabels(packet.planeNames, packet.planeLabels);
+
+    packet.piercingPositions.clear();
+    packet.piercingColors.clear();
+    packet.intersectionNames.clear();
+    packet.intersectionPositions.clear();
+    packet.intersectionColors.clear();
+    if (intersections) {
+        for (const auto& point : intersections->points) {
+            packet.piercingPositions.push_back(ToWorld(point.coords, worldScale));
+            packet.piercingColors.emplace_back(1.0f, 1.0f, 0.0f);
+        }
+        for (const auto& line : intersections->lines) {
+            packet.intersectionNames.push_back(sceneData.planes[line.plane1].name + "-" + sceneData.planes[line.plane2].name);
+            packet.intersectionPositions.emplace_back(ToWorld(line.p1, worldScale), ToWorld(line.p2, worldScale));
+            packet.intersectionColors.emplace_back(1.0f, 1.0f, 0.0f);
+        }
+    }
+    SetLabels(packet.intersectionNames, packet.intersectionLabels);
+}
+
+void RenderPacketBuilder::Start() {
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    if (m_thread.joinable()) return;
+    m_quit = false;
+    m_thread = std::thread(&RenderPacketBuilder::WorkerLoop, this);
+#endif
+}
+
+void RenderPacketBuilder::Stop() {
+    if (!m_thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+
+    Acquire(); // whatever it finished is still good
+}
+
+bool RenderPacketBuilder::Acquire() {
+    if (m_state.load(std::memory_order_acquire) != Ready) return false;
+
+    m_front = 1 - m_front;
+    m_hasFront = true;
+    m_state.store(Idle, std::memory_order_release);
+    return true;
+}
+
+bool RenderPacketBuilder::Request(SceneSnapshot scene, std::shared_ptr<const IntersectionResults> intersections) {
+    if (m_state.load(std::memory_order_acquire) != Idle) return false;
+
+    m_scene = std::move(scene);
+    m_intersections = std::move(intersections);
+
+    // a frame still being drawn somewhere holds on to it, that one stays as it is.
+    // Only other threads letting go can change the count meanwhile, the fence pairs with their release.
+    std::shared_ptr<RenderPacket>& back = m_packets[1 - m_front];
+    if (back.use_count() > 1) back = std::make_shared<RenderPacket>();
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (!m_thread.joinable() || !m_hasFront) {
+        BuildBack();
+        m_front = 1 - m_front;
+        m_hasFront = true;
+        return true;
+    }
+
+    m_state.store(Requested, std::memory_order_release);
+    {
+        // empty, but without it the worker could check the state, miss the store and sleep through the notify
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+void RenderPacketBuilder::BuildBack() {
+    BuildRenderPacket(*m_scene, m_intersections.get(), *m_packets[1 - m_front]);
+    m_scene.reset(); // let go right away, an edit on the main thread would copy whatever this still shares
+    m_intersections.reset();
+}
+
+void RenderPacketBuilder::WorkerLoop() {
+    TRACE_THREAD("Render packets");
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_quit || m_state.load(std::memory_order_acquire) == Requested; });
+            if (m_state.load(std::memory_order_acquire) != Requested) break; // quitting with nothing to do
+        }
+
+        BuildBack();
+        m_state.store(Ready, std::memory_order_release);
+    }
+}
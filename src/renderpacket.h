@@ -0,0 +1,87 @@
+// renderpacket.h
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "intersections.h"
+#include "scene.h"
+
+// Everything the 3D view draws of the scene, already in world units. Sizes (point size, line thickness,
+// plane opacity) aren't in it, those are read when it's drawn.
+struct RenderPacket {
+    std::vector<std::string> pointNames, lineNames, planeNames, intersectionNames;
+    std::vector<char*> pointLabels, lineLabels, planeLabels, intersectionLabels; // into the names, what the renderer takes
+
+    std::vector<glm::vec3> pointPositions, pointColors; // visible points only
+    std::vector<std::pair<glm::vec3, glm::vec3>> linePositions;
+    std::vector<glm::vec3> lineColors;
+    std::vector<std::vector<glm::vec3>> planePositions;
+    std::vector<glm::vec3> planeColors;
+    std::vector<bool> planeExpand;
+
+    std::vector<glm::vec3> markerPositions, markerColors; // trace points of the lines showing visibility
+    std::vector<glm::vec3> piercingPositions, piercingColors;
+    std::vector<std::pair<glm::vec3, glm::vec3>> intersectionPositions;
+    std::vector<glm::vec3> intersectionColors;
+};
+
+// Scene to packet, intersections is nullptr when they're hidden. Reuses what the packet already allocated.
+void BuildRenderPacket(const SceneData& sceneData, const IntersectionResults* intersections, RenderPacket& packet);
+
+// Two packets: the front one is drawn on the main thread while a worker builds the back one from a snapshot
+// of the scene, so the extraction for the next frame overlaps drawing and presenting this one.
+// The handoff is a single atomic state, neither side ever waits for the other: a frame that finds the worker
+// still busy draws the old packet again and asks again next frame. A finished packet is only swapped in by
+// Acquire, so what's drawn is a frame behind the scene (two when the worker falls behind).
+// Packets are shared: a frame still queued for the render thread keeps its packet, the worker then builds into
+// a new one instead of the one being drawn.
+// Without threads (web builds without pthreads) Request builds right away and swaps it in, no delay.
+class RenderPacketBuilder {
+public:
+    ~RenderPacketBuilder() { Stop(); }
+
+    void Start();
+    void Stop();
+
+    // Main thread, once a frame: swaps in the packet the worker finished since the last call, if any
+    bool Acquire();
+    // Main thread: has the worker build a packet from this scene, false when it's still busy with the last one.
+    // The very first packet is built right away, there's nothing to draw meanwhile.
+    bool Request(SceneSnapshot scene, std::shared_ptr<const IntersectionResults> intersections);
+
+    std::shared_ptr<const RenderPacket> GetFront() const { return m_packets[m_front]; }
+    bool IsBusy() const { return m_state.load(std::memory_order_acquire) != Idle; }
+
+private:
+    enum State : int {
+        Idle,      // main thread owns the request and both packets
+        Requested, // worker owns the request and the back packet
+        Ready      // back packet is done, main thread swaps it in
+    };
+
+    void WorkerLoop();
+    void BuildBack();
+
+    std::shared_ptr<RenderPacket> m_packets[2] = { std::make_shared<RenderPacket>(), std::make_shared<RenderPacket>() };
+    int m_front = 0;
+    bool m_hasFront = false;
+
+    SceneSnapshot m_scene;
+    std::shared_ptr<const IntersectionResults> m_intersections;
+    std::atomic<int> m_state{ Idle };
+
+    // only for the worker to sleep on while there's nothing to build, never held while building
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_quit = false;
+};
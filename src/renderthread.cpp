@@ -0,0 +1,121 @@
+#include "renderthread.h"
+#include "trace.h"
+
+#include <GLFW/glfw3.h>
+
+bool RenderThread::Start(GLFWwindow* window, std::function<void(RenderFrame&)> draw) {
+#ifdef __EMSCRIPTEN__
+    (void)window;
+    (void)draw;
+    return false;
+#else
+    if (m_thread.joinable()) return true;
+
+    m_window = window;
+    m_draw = std::move(draw);
+    m_quit = false;
+    glfwMakeContextCurrent(nullptr); // current on one thread at a time
+    m_thread = std::thread(&RenderThread::Loop, this);
+    return true;
+#endif
+}
+
+void RenderThread::Stop() {
+    if (!m_thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_queued.notify_one();
+    m_thread.join();
+
+    DestroyDrawn();
+    glfwMakeContextCurrent(m_window);
+}
+
+void RenderThread::Submit(RenderFrame frame) {
+    TRACE_SCOPE("RenderThread::Submit"); // waiting here is the render thread falling behind
+    const bool texturesChanged = frame.drawData && frame.drawData->Textures;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_drawn.wait(lock, [this] { return m_queue.size() < QUEUE_DEPTH; });
+        m_queue.push_back(std::move(frame));
+    }
+    m_queued.notify_one();
+    DestroyDrawn();
+
+    // the next ImGui::NewFrame reads what the backend writes into the textures
+    if (texturesChanged) Flush();
+}
+
+void RenderThread::Flush() {
+    TRACE_SCOPE("RenderThread::Flush");
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_drawn.wait(lock, [this] { return m_queue.empty() && !m_drawing; });
+    }
+    DestroyDrawn();
+}
+
+void RenderThread::DestroyDrawn() {
+    std::vector<RenderFrame> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finished.swap(m_finished);
+    }
+    // and out of scope here, not under the lock
+}
+
+void RenderThread::Loop() {
+    TRACE_THREAD("Render");
+    glfwMakeContextCurrent(m_window);
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_queued.wait(lock, [this] { return m_quit || !m_queue.empty(); });
+        if (m_queue.empty()) break; // quitting with nothing left to draw
+
+        RenderFrame frame = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_drawing = true;
+        lock.unlock();
+        m_drawn.notify_all(); // room for one more
+
+        m_draw(frame);
+
+        lock.lock();
+        m_finished.push_back(std::move(frame));
+        m_drawing = false;
+        lock.unlock();
+        m_drawn.notify_all();
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+std::shared_ptr<ImDrawData> RenderThread::CopyDrawData(const ImDrawData* drawData) {
+    TRACE_SCOPE("RenderThread::CopyDrawData");
+    auto destroy = [](ImDrawData* data) {
+        for (ImDrawList* list : data->CmdLists) IM_DELETE(list);
+        IM_DELETE(data);
+    };
+    std::shared_ptr<ImDrawData> copy(IM_NEW(ImDrawData)(*drawData), destroy);
+
+    // only the output, CloneOutput would also register the copy with ImGui's shared data
+    for (ImDrawList*& list : copy->CmdLists) {
+        ImDrawList* source = list;
+        list = IM_NEW(ImDrawList)(nullptr);
+        list->CmdBuffer = source->CmdBuffer;
+        list->IdxBuffer = source->IdxBuffer;
+        list->VtxBuffer = source->VtxBuffer;
+        list->Flags = source->Flags;
+    }
+
+    bool texturesChanged = false;
+    if (drawData->Textures) {
+        for (const ImTextureData* texture : *drawData->Textures) texturesChanged |= texture->Status != ImTextureStatus_OK;
+    }
+    if (!texturesChanged) copy->Textures = nullptr; // the backend has nothing to do with them
+    return copy;
+}
@@ -0,0 +1,88 @@
+// renderthread.h
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <imgui.h>
+#include <glm/glm.hpp>
+
+#include "renderer.h"
+#include "renderpacket.h"
+
+struct GLFWwindow;
+
+// Everything the GL half of a frame draws, taken on the main thread once the UI is built. Nothing in it points
+// back at what the main thread keeps changing, so it can be drawn while the next frame is already being built.
+struct RenderFrame {
+    struct Markers {
+        std::vector<glm::vec3> positions, colors;
+        float size = 1.0f;
+    };
+
+    RenderView view;
+    glm::vec3 background = glm::vec3(0.0f);
+    bool vsync = false;
+
+    std::shared_ptr<const RenderPacket> packet;
+    float pointSize = 1.0f;
+    float lineThickness = 1.0f;
+    float planeOpacity = 1.0f;
+    bool showIntersections = false;
+    std::vector<Markers> overlay; // selection and hover halos, on top of the scene in this order
+
+    std::string imageExportPath; // empty when there's no image export this frame
+    int imageExportWidth = 0;
+    int imageExportHeight = 0;
+
+    std::shared_ptr<ImDrawData> drawData; // ImGui's own when it's drawn right away, a copy for the render thread
+};
+
+// Draws frames on a thread of its own that owns the GL context, the main thread keeps the window events and
+// builds the UI. The queue between them holds QUEUE_DEPTH frames: the main thread waits when it's that far
+// ahead, the render thread when there's nothing to draw. A slow UI frame then only delays the frames after it
+// instead of the one being presented, and a slow GPU frame doesn't hold up input.
+// Drawn frames go back to the main thread to be destroyed there, ImGui's allocator counts into its context.
+// Not available on the web, WebGL belongs to the browser's main thread.
+class RenderThread {
+public:
+    static constexpr size_t QUEUE_DEPTH = 2;
+
+    ~RenderThread() { Stop(); }
+
+    // Takes the window's context off the calling thread, false when there's no thread to give it to
+    bool Start(GLFWwindow* window, std::function<void(RenderFrame&)> draw);
+    void Stop(); // draws what's still queued, then the context is current on the calling thread again
+    bool IsRunning() const { return m_thread.joinable(); }
+
+    // Main thread: queues a frame, waits while QUEUE_DEPTH frames are already queued.
+    // A frame with ImGui texture updates is waited for, the atlas is ImGui's and ImGui isn't thread safe.
+    void Submit(RenderFrame frame);
+    void Flush(); // waits until everything submitted has been drawn
+
+    // Copy of the draw data that stays valid after the next ImGui::NewFrame. It only keeps the texture list
+    // when a texture needs updating.
+    static std::shared_ptr<ImDrawData> CopyDrawData(const ImDrawData* drawData);
+
+private:
+    void Loop();
+    void DestroyDrawn(); // main thread
+
+    GLFWwindow* m_window = nullptr;
+    std::function<void(RenderFrame&)> m_draw;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_queued; // render thread waits for a frame
+    std::condition_variable m_drawn;  // main thread waits for room, or for the queue to drain
+    std::deque<RenderFrame> m_queue;
+    std::vector<RenderFrame> m_finished; // drawn, waiting to be destroyed on the main thread
+    bool m_drawing = false;
+    bool m_quit = false;
+};
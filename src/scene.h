@@ -3,9 +3,12 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "cowvector.h"
+
 struct Point {
     std::string name;
     float coords[3];
@@ -31,10 +34,15 @@ struct Plane {
     bool expand = false;
 };
 
+// what an index refers to, for code that handles points, lines and planes alike (selection, undo)
+enum class EntityKind { Point = 0, Line, Plane };
+
+// The entities live in copy-on-write chunks: copying a SceneData only copies pointers, and the copy keeps
+// the scene as it was while the original keeps changing. That copy is the snapshot background work reads.
 struct SceneData {
-    std::vector<Point> points;
-    std::vector<Line> lines;
-    std::vector<Plane> planes;
+    CowVector<Point> points;
+    CowVector<Line> lines;
+    CowVector<Plane> planes;
 
     struct Settings {
         float backgroundColor[3] = {0.13f, 0.13f, 0.13f};
@@ -48,6 +56,7 @@ struct SceneData {
         bool showCutPoints = false;
         bool showCutLines = false;
         bool showCutPlanes = false; // doesnt do anything yet
+        bool showIntersections = false; // line-plane and plane-plane intersections
         bool expandPlanes = false;
 
         float mouseSensitivity = 0.2f;
@@ -58,6 +67,8 @@ struct SceneData {
         float worldScale = 50.0f; // scale for coordinates
 
         float pointSize = 6.0f;
+        bool snapToPoints = false; // guizmo drags snap to other points
+        float snapRadius = 1.5f;   // model units, also how close the mouse has to pass to hover a point
         float lineThickness = 1.5f;
         float planeOpacity = 0.6f;
 
@@ -76,4 +87,6 @@ struct SceneData {
     } settings;
 };
 
+using SceneSnapshot = std::shared_ptr<const SceneData>;
+
 #endif // SCENE_H
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "selection.h"
+
+#include <algorithm>
+
+void Selection::Clear() {
+    for (int k = 0; k < 3; ++k) {
+        for (int index : m_items[k]) m_flags[k][index] = 0;
+        m_items[k].clear();
+    }
+    m_transforming = false;
+}
+
+void Selection::Click(EntityKind kind, int index, bool additive) {
+    if (additive) {
+        if (IsSelected(kind, index)) Remove(kind, index);
+        else Add(kind, index);
+        return;
+    }
+
+    // clicking the only selected entity unselects it, like the tables always did
+    bool onlyThis = Count() == 1 && IsSelected(kind, index);
+    Clear();
+    if (!onlyThis) Add(kind, index);
+}
+
+void Selection::Add(EntityKind kind, int index) {
+    if (index < 0) return;
+    const int k = static_cast<int>(kind);
+    if (index >= static_cast<int>(m_flags[k].size())) m_flags[k].resize(index + 1, 0);
+    if (m_flags[k][index]) return;
+
+    m_flags[k][index] = 1;
+    m_items[k].push_back(index);
+    m_transforming = false; // a different set of points, the drag starts over
+}
+
+void Selection::Remove(EntityKind kind, int index) {
+    if (!IsSelected(kind, index)) return;
+    const int k = static_cast<int>(kind);
+    m_flags[k][index] = 0;
+    m_items[k].erase(std::find(m_items[k].begin(), m_items[k].end(), index));
+    m_transforming = false;
+}
+
+bool Selection::IsSelected(EntityKind kind, int index) const {
+    const int k = static_cast<int>(kind);
+    return index >= 0 && index < static_cast<int>(m_flags[k].size()) && m_flags[k][index];
+}
+
+void Selection::Validate(const SceneData& sceneData) {
+    const int pointCount = static_cast<int>(sceneData.points.size());
+    auto validPoint = [&](int index) { return index >= 0 && index < pointCount; };
+
+    std::vector<int> stale;
+    for (int index : m_items[0]) {
+        if (!validPoint(index) || sceneData.points[index].hidden) stale.push_back(index);
+    }
+    for (int index : stale) Remove(EntityKind::Point, index);
+
+    stale.clear();
+    for (int index : m_items[1]) {
+        if (index >= static_cast<int>(sceneData.lines.size())) { stale.push_back(index); continue; }
+        const auto& line = sceneData.lines[index];
+        if (!validPoint(line.point1index) || !validPoint(line.point2index)) stale.push_back(index);
+    }
+    for (int index : stale) Remove(EntityKind::Line, index);
+
+    stale.clear();
+    for (int index : m_items[2]) {
+        if (index >= static_cast<int>(sceneData.planes.size())) { stale.push_back(index); continue; }
+        const auto& plane = sceneData.planes[index];
+        if (!validPoint(plane.point1index) || !validPoint(plane.point2index) || !validPoint(plane.point3index)) stale.push_back(index);
+    }
+    for (int index : stale) Remove(EntityKind::Plane, index);
+}
+
+void Selection::AddBoxed(const SceneData& sceneData, const std::vector<uint8_t>& inside) {
+    auto isInside = [&](int index) { return index >= 0 && index < static_cast<int>(inside.size()) && inside[index]; };
+
+    for (size_t i = 0; i < inside.size(); ++i) {
+        if (inside[i]) Add(EntityKind::Point, static_cast<int>(i));
+    }
+    for (size_t i = 0; i < sceneData.lines.size(); ++i) {
+        const auto& line = sceneData.lines[i];
+        if (isInside(line.point1index) && isInside(line.point2index)) Add(EntityKind::Line, static_cast<int>(i));
+    }
+    for (size_t i = 0; i < sceneData.planes.size(); ++i) {
+        const auto& plane = sceneData.planes[i];
+        if (isInside(plane.point1index) && isInside(plane.point2index) && isInside(plane.point3index))
+            Add(EntityKind::Plane, static_cast<int>(i));
+    }
+}
+
+void Selection::OnErased(EntityKind kind, int index) {
+    const int k = static_cast<int>(kind);
+    Remove(kind, index);
+
+    auto& items = m_items[k];
+    auto& flags = m_flags[k];
+    for (int& item : items) {
+        if (item > index) {
+            flags[item] = 0;
+            item--;
+        }
+    }
+    for (int item : items) flags[item] = 1;
+    m_transforming = false;
+}
+
+void Selection::CollectPoints(const SceneData& sceneData, std::vector<int>& points) const {
+    points.clear();
+    points.insert(points.end(), m_items[0].begin(), m_items[0].end());
+    for (int index : m_items[1]) {
+        const auto& line = sceneData.lines[index];
+        points.push_back(line.point1index);
+        points.push_back(line.point2index);
+    }
+    for (int index : m_items[2]) {
+        const auto& plane = sceneData.planes[index];
+        points.push_back(plane.point1index);
+        points.push_back(plane.point2index);
+        points.push_back(plane.point3index);
+    }
+
+    // lines and planes often share points, each one moves once
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+}
+
+bool Selection::GetCentroid(const SceneData& sceneData, float centroid[3]) const {
+    std::vector<int> points;
+    CollectPoints(sceneData, points);
+    if (points.empty()) return false;
+
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    for (int index : points) {
+        for (int k = 0; k < 3; ++k) sum[k] += sceneData.points[index].coords[k];
+    }
+    for (int k = 0; k < 3; ++k) centroid[k] = static_cast<float>(sum[k] / points.size());
+    return true;
+}
+
+void Selection::BeginTransform(const SceneData& sceneData) {
+    CollectPoints(sceneData, m_transformPoints);
+
+    const size_t count = m_transformPoints.size();
+    m_startX.resize(count);
+    m_startY.resize(count);
+    m_startZ.resize(count);
+    m_x.resize(count);
+    m_y.resize(count);
+    m_z.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const float* coords = sceneData.points[m_transformPoints[i]].coords;
+        m_startX[i] = coords[0];
+        m_startY[i] = coords[1];
+        m_startZ[i] = coords[2];
+    }
+    m_transforming = true;
+}
+
+void Selection::ApplyTranslation(SceneData& sceneData, const float delta[3]) {
+    if (!m_transforming) return;
+
+    const size_t count = m_transformPoints.size();
+    const float dx = delta[0], dy = delta[1], dz = delta[2];
+    for (size_t i = 0; i < count; ++i) {
+        m_x[i] = m_startX[i] + dx;
+        m_y[i] = m_startY[i] + dy;
+        m_z[i] = m_startZ[i] + dz;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        float* coords = sceneData.points[m_transformPoints[i]].coords;
+        coords[0] = m_x[i];
+        coords[1] = m_y[i];
+        coords[2] = m_z[i];
+    }
+}
+
+void Selection::Recolor(SceneData& sceneData, const float color[3]) const {
+    for (int index : m_items[0]) std::copy(color, color + 3, sceneData.points[index].color);
+    for (int index : m_items[1]) std::copy(color, color + 3, sceneData.lines[index].color);
+    for (int index : m_items[2]) std::copy(color, color + 3, sceneData.planes[index].color);
+}
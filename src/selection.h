@@ -0,0 +1,55 @@
+// selection.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "scene.h"
+
+// Points, lines and planes picked in the tables or boxed in the 3D and 2D views.
+// Every index keeps a flag next to the list so IsSelected is a lookup, the lists stay in pick order.
+class Selection {
+public:
+    void Clear();
+
+    // plain click replaces the selection, shift-click (additive) toggles the one entity
+    void Click(EntityKind kind, int index, bool additive);
+    void Add(EntityKind kind, int index);
+    void Remove(EntityKind kind, int index);
+    bool IsSelected(EntityKind kind, int index) const;
+
+    const std::vector<int>& Get(EntityKind kind) const { return m_items[static_cast<int>(kind)]; }
+    bool Empty() const { return Count() == 0; }
+    size_t Count() const { return m_items[0].size() + m_items[1].size() + m_items[2].size(); }
+
+    // Drops whatever went away: deleted (hidden) points, indices past the end, lines and planes with bad point indices
+    void Validate(const SceneData& sceneData);
+    // Box select: adds the points flagged in inside (one flag per point), then the lines and planes with all their points in it
+    void AddBoxed(const SceneData& sceneData, const std::vector<uint8_t>& inside);
+    // a line or plane was erased, the ones after it moved down by one
+    void OnErased(EntityKind kind, int index);
+
+    // Every point the selection moves: the picked points plus the points of the picked lines and planes, once each
+    void CollectPoints(const SceneData& sceneData, std::vector<int>& points) const;
+    bool GetCentroid(const SceneData& sceneData, float centroid[3]) const;
+
+    // Guizmo drags: the start coordinates are copied once when the drag begins, every frame after that
+    // is one pass of start + delta over contiguous floats and a scatter back into the points.
+    void BeginTransform(const SceneData& sceneData);
+    void ApplyTranslation(SceneData& sceneData, const float delta[3]);
+    void EndTransform() { m_transforming = false; }
+    bool IsTransforming() const { return m_transforming; }
+    const std::vector<int>& GetTransformPoints() const { return m_transformPoints; }
+
+    void Recolor(SceneData& sceneData, const float color[3]) const;
+
+private:
+    std::vector<int> m_items[3];
+    std::vector<uint8_t> m_flags[3]; // 1 for selected indices, grows on demand
+
+    bool m_transforming = false;
+    std::vector<int> m_transformPoints;
+    std::vector<float> m_startX, m_startY, m_startZ; // d, a, c when the drag began
+    std::vector<float> m_x, m_y, m_z;
+};
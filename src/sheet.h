@@ -0,0 +1,49 @@
+// sheet.h
+#pragma once
+
+#include <imgui.h>
+#include <cmath>
+
+// Anything the dihedral sheet can be drawn into: the ImGui window, an SVG file, a PDF file...
+// Coordinates are in canvas units (pixels on screen, points on paper), y pointing down.
+class SheetCanvas {
+public:
+    virtual ~SheetCanvas() = default;
+
+    virtual void Line(const ImVec2& p1, const ImVec2& p2, ImU32 color, float thickness) = 0;
+    virtual void Circle(const ImVec2& center, float radius, ImU32 color) = 0;
+    virtual void Text(const ImVec2& pos, ImU32 color, const char* text) = 0; // pos is the top left corner
+
+    // default dashes are emitted as separate segments, vector canvases override this with a real dash pattern
+    virtual void DashedLine(const ImVec2& p1, const ImVec2& p2, ImU32 color, float thickness,
+                            float dashLength, float gapLength) {
+        ImVec2 dir(p2.x - p1.x, p2.y - p1.y);
+        float length = sqrtf(dir.x * dir.x + dir.y * dir.y);
+        if (length < 0.0001f) return;
+        dir.x /= length;
+        dir.y /= length;
+
+        for (float i = 0; i < length; i += dashLength + gapLength) {
+            float end = i + dashLength < length ? i + dashLength : length;
+            Line(ImVec2(p1.x + dir.x * i, p1.y + dir.y * i), ImVec2(p1.x + dir.x * end, p1.y + dir.y * end), color, thickness);
+        }
+    }
+};
+
+class ImGuiSheetCanvas : public SheetCanvas {
+public:
+    explicit ImGuiSheetCanvas(ImDrawList* drawList) : m_drawList(drawList) {}
+
+    void Line(const ImVec2& p1, const ImVec2& p2, ImU32 color, float thickness) override {
+        m_drawList->AddLine(p1, p2, color, thickness);
+    }
+    void Circle(const ImVec2& center, float radius, ImU32 color) override {
+        m_drawList->AddCircleFilled(center, radius, color);
+    }
+    void Text(const ImVec2& pos, ImU32 color, const char* text) override {
+        m_drawList->AddText(pos, color, text);
+    }
+
+private:
+    ImDrawList* m_drawList;
+};
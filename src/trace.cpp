@@ -0,0 +1,145 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+    // a few minutes of frames, past this recording keeps going but new events are dropped
+    constexpr size_t MAX_EVENTS = 4 * 1024 * 1024;
+
+    struct Event {
+        const char* name;
+        uint32_t thread;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    struct ThreadName {
+        uint32_t thread;
+        std::string name;
+    };
+
+    // Every thread records into a buffer of its own, the lock on it is only ever contended while saving or
+    // starting over. Buffers outlive their threads (job workers come and go), the list keeps them.
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Event> events;
+    };
+
+    std::mutex g_mutex; // the buffer list and the thread names
+    std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+    std::vector<ThreadName> g_threadNames;
+    std::atomic<size_t> g_eventCount{ 0 }; // across all buffers, for MAX_EVENTS
+    std::atomic<uint32_t> g_nextThread{ 1 };
+
+    uint32_t ThreadId() {
+        thread_local uint32_t id = g_nextThread.fetch_add(1);
+        return id;
+    }
+
+    ThreadBuffer& LocalBuffer() {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+            auto created = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_buffers.push_back(created);
+            return created;
+        }();
+        return *buffer;
+    }
+
+    void WriteEscaped(FILE* file, const char* text) {
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') fputc('\\', file);
+            fputc(*text, file);
+        }
+    }
+}
+
+namespace Trace {
+    namespace detail {
+        std::atomic<bool> recording{ false };
+    }
+
+    void Start() {
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            for (auto& buffer : g_buffers) {
+                std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+                buffer->events.clear();
+            }
+            g_eventCount.store(0);
+        }
+        detail::recording.store(true);
+    }
+
+    void Stop() {
+        detail::recording.store(false);
+    }
+
+    size_t GetEventCount() {
+        return std::min(g_eventCount.load(), MAX_EVENTS);
+    }
+
+    void SetThreadName(const char* name) {
+        const uint32_t thread = ThreadId();
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (auto& entry : g_threadNames) {
+            if (entry.thread == thread) {
+                entry.name = name;
+                return;
+            }
+        }
+        g_threadNames.push_back({ thread, name });
+    }
+
+    uint64_t Now() {
+        static const auto start = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void Record(const char* name, uint64_t start, uint64_t end) {
+        if (g_eventCount.fetch_add(1, std::memory_order_relaxed) >= MAX_EVENTS) return;
+        const uint32_t thread = ThreadId();
+        ThreadBuffer& buffer = LocalBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events.push_back({ name, thread, start, end - start });
+    }
+
+    bool Save(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) {
+            std::cerr << "Failed to open trace file for writing: " << path << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(g_mutex);
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Sistema Diedrico\"}}");
+        for (const auto& entry : g_threadNames) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", entry.thread);
+            WriteEscaped(file, entry.name.c_str());
+            fprintf(file, "\"}}");
+        }
+        // complete events ("X"), one per marker with its start and duration, a thread at a time
+        for (auto& buffer : g_buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            for (const auto& event : buffer->events) {
+                fprintf(file, ",\n{\"name\":\"");
+                WriteEscaped(file, event.name);
+                fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu}", event.thread,
+                        static_cast<unsigned long long>(event.start), static_cast<unsigned long long>(event.duration));
+            }
+        }
+        fprintf(file, "\n]}\n");
+
+        const bool written = !ferror(file);
+        fclose(file);
+        if (!written) std::cerr << "Failed to write trace file: " << path << std::endl;
+        return written;
+    }
+}
@@ -0,0 +1,52 @@
+// trace.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped timing markers, saved as Chrome trace events to open in Perfetto (ui.perfetto.dev) or chrome://tracing.
+// The macros only exist in builds with DIEDRICO_TRACING (the ENABLE_TRACING cmake option, on by default in debug
+// builds), everywhere else they expand to nothing. Compiled in but not recording, a marker is one relaxed load.
+//
+//     TRACE_SCOPE("Renderer::Render"); // until the end of the enclosing block
+//
+// Names have to be string literals, only the pointer is kept.
+namespace Trace {
+    namespace detail {
+        extern std::atomic<bool> recording;
+    }
+
+    inline bool IsRecording() { return detail::recording.load(std::memory_order_relaxed); }
+    void Start(); // drops whatever an earlier recording left
+    void Stop();
+    size_t GetEventCount();
+    bool Save(const std::string& path); // {"traceEvents": [...]}, false if the file can't be written
+
+    void SetThreadName(const char* name); // the row label of the calling thread
+    uint64_t Now();                       // microseconds since the first call
+    void Record(const char* name, uint64_t start, uint64_t end);
+
+    class Scope {
+    public:
+        explicit Scope(const char* name) : m_name(IsRecording() ? name : nullptr), m_start(m_name ? Now() : 0) {}
+        ~Scope() { if (m_name) Record(m_name, m_start, Now()); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* m_name;
+        uint64_t m_start;
+    };
+}
+
+#ifdef DIEDRICO_TRACING
+    #define TRACE_CONCAT_INNER(a, b) a##b
+    #define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+    #define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+    #define TRACE_THREAD(name) Trace::SetThreadName(name)
+#else
+    #define TRACE_SCOPE(name) ((void)0)
+    #define TRACE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,282 @@
+#include "traces.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // components smaller than this (relative to the normal length) count as zero
+    constexpr double RELATIVE_EPSILON = 1e-6;
+
+    constexpr size_t PARALLEL_GRAIN = 2048; // traces per job, fewer than this in total aren't worth a job
+
+    // compute(i) for every i in [0, count), on the job system when there is one. Only for full recomputes,
+    // the pending lists can name the same index twice
+    template <typename Compute>
+    void ComputeAll(JobSystem* jobs, size_t count, const Compute& compute) {
+        if (!jobs) {
+            for (size_t i = 0; i < count; ++i) compute(i);
+            return;
+        }
+        jobs->ParallelFor(count, PARALLEL_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) compute(i);
+        });
+    }
+
+    // Clips the infinite 2D line nx*x + ny*y + offset = 0 against the bounds (Liang-Barsky)
+    bool ClipLine(double nx, double ny, double offset,
+                  float minX, float maxX, float minY, float maxY, TraceSegment& segment) {
+        double lengthSq = nx * nx + ny * ny;
+        if (lengthSq <= 0.0) return false;
+
+        // closest point to the origin and the direction along the line
+        double px = -offset * nx / lengthSq;
+        double py = -offset * ny / lengthSq;
+        double dx = -ny;
+        double dy = nx;
+
+        double tMin = -HUGE_VAL, tMax = HUGE_VAL;
+        const double p[4] = { -dx, dx, -dy, dy };
+        const double q[4] = { px - minX, maxX - px, py - minY, maxY - py };
+
+        for (int i = 0; i < 4; ++i) {
+            if (p[i] == 0.0) {
+                if (q[i] < 0.0) return false; // parallel and outside
+                continue;
+            }
+            double t = q[i] / p[i];
+            if (p[i] < 0.0) {
+                if (t > tMin) tMin = t;
+            } else {
+                if (t < tMax) tMax = t;
+            }
+        }
+        if (tMin > tMax) return false;
+
+        segment.x1 = static_cast<float>(px + tMin * dx);
+        segment.y1 = static_cast<float>(py + tMin * dy);
+        segment.x2 = static_cast<float>(px + tMax * dx);
+        segment.y2 = static_cast<float>(py + tMax * dy);
+        return true;
+    }
+}
+
+void TraceEngine::SetBounds(float minD, float maxD, float minHeight, float maxHeight) {
+    if (m_bounds[0] == minD && m_bounds[1] == maxD && m_bounds[2] == minHeight && m_bounds[3] == maxHeight) return;
+
+    m_bounds[0] = minD;
+    m_bounds[1] = maxD;
+    m_bounds[2] = minHeight;
+    m_bounds[3] = maxHeight;
+    m_boundsChanged = true;
+}
+
+const std::vector<PlaneTraces>& TraceEngine::UpdatePlanes(const SceneData& sceneData) {
+    auto compute = [&](size_t i) {
+        const auto& plane = sceneData.planes[i];
+        m_planeTraces[i] = ComputePlaneTraces(sceneData.points[plane.point1index].coords,
+                                              sceneData.points[plane.point2index].coords,
+                                              sceneData.points[plane.point3index].coords,
+                                              m_bounds[0], m_bounds[1], m_bounds[2], m_bounds[3]);
+    };
+
+    // planes appended at the end get computed on their own, fewer means the indices moved
+    const size_t count = sceneData.planes.size();
+    const size_t known = m_planeTraces.size();
+    if (m_boundsChanged || known > count) {
+        m_planeTraces.resize(count);
+        ComputeAll(m_jobs, count, compute);
+    } else {
+        m_planeTraces.resize(count);
+        for (int i : m_pendingPlanes) {
+            if (i >= 0 && static_cast<size_t>(i) < known) compute(i);
+        }
+        for (size_t i = known; i < count; ++i) compute(i);
+    }
+
+    m_pendingPlanes.clear();
+    m_boundsChanged = false;
+    return m_planeTraces;
+}
+
+PlaneTraces TraceEngine::ComputePlaneTraces(const float p1[3], const float p2[3], const float p3[3],
+                                            float minD, float maxD, float minHeight, float maxHeight) {
+    PlaneTraces traces;
+
+    // double precision, coordinates can be large and nearly collinear points are common while dragging
+    double v1[3] = { (double)p2[0] - p1[0], (double)p2[1] - p1[1], (double)p2[2] - p1[2] };
+    double v2[3] = { (double)p3[0] - p1[0], (double)p3[1] - p1[1], (double)p3[2] - p1[2] };
+
+    double n[3] = {
+        v1[1] * v2[2] - v1[2] * v2[1],
+        v1[2] * v2[0] - v1[0] * v2[2],
+        v1[0] * v2[1] - v1[1] * v2[0]
+    };
+    double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    double v1Length = std::sqrt(v1[0] * v1[0] + v1[1] * v1[1] + v1[2] * v1[2]);
+    double v2Length = std::sqrt(v2[0] * v2[0] + v2[1] * v2[1] + v2[2] * v2[2]);
+
+    // |v1 x v2| = |v1||v2|sin(angle), so this is a threshold on the angle, not on the size of the scene
+    if (length <= RELATIVE_EPSILON * v1Length * v2Length || length == 0.0) {
+        traces.position = PlanePosition::Degenerate;
+        return traces;
+    }
+
+    double A = n[0] / length; // d
+    double B = n[1] / length; // a
+    double C = n[2] / length; // c
+    double D = -(A * p1[0] + B * p1[1] + C * p1[2]);
+
+    // the offset is compared against the size of the points so far away planes are not misclassified
+    double extent = 1.0;
+    for (int i = 0; i < 3; ++i) {
+        extent = std::fmax(extent, std::fabs(p1[i]));
+        extent = std::fmax(extent, std::fabs(p2[i]));
+        extent = std::fmax(extent, std::fabs(p3[i]));
+    }
+
+    bool zeroA = std::fabs(A) <= RELATIVE_EPSILON;
+    bool zeroB = std::fabs(B) <= RELATIVE_EPSILON;
+    bool zeroC = std::fabs(C) <= RELATIVE_EPSILON;
+    bool zeroD = std::fabs(D) <= RELATIVE_EPSILON * extent;
+    if (zeroA) A = 0.0;
+    if (zeroB) B = 0.0;
+    if (zeroC) C = 0.0;
+    if (zeroD) D = 0.0;
+
+    traces.normal[0] = A;
+    traces.normal[1] = B;
+    traces.normal[2] = C;
+    traces.offset = D;
+
+    if (zeroA && zeroB) traces.position = PlanePosition::Horizontal;
+    else if (zeroA && zeroC) traces.position = PlanePosition::Frontal;
+    else if (zeroB && zeroC) traces.position = PlanePosition::Profile;
+    else if (zeroA) traces.position = zeroD ? PlanePosition::ThroughGroundLine : PlanePosition::ParallelToGroundLine;
+    else if (zeroC) traces.position = PlanePosition::HorizontalProjecting;
+    else if (zeroB) traces.position = PlanePosition::VerticalProjecting;
+    else traces.position = PlanePosition::Oblique;
+
+    // horizontal trace, on c = 0: A*d + B*a + D = 0
+    // (a horizontal plane has none, unless it is the horizontal plane itself, where it is the whole plane)
+    if (!(zeroA && zeroB)) {
+        traces.hasHorizontal = ClipLine(A, B, D, minD, maxD, minHeight, maxHeight, traces.horizontal);
+    }
+
+    // vertical trace, on a = 0: A*d + C*c + D = 0
+    if (!(zeroA && zeroC)) {
+        traces.hasVertical = ClipLine(A, C, D, minD, maxD, minHeight, maxHeight, traces.vertical);
+    }
+
+    // every plane with A != 0 crosses the ground line exactly once
+    if (!zeroA) {
+        traces.meetsGroundLine = true;
+        traces.groundLineD = static_cast<float>(-D / A);
+    }
+
+    return traces;
+}
+
+const std::vector<LineTraces>& TraceEngine::UpdateLines(const SceneData& sceneData) {
+    auto compute = [&](size_t i) {
+        const auto& line = sceneData.lines[i];
+        m_lineTraces[i] = ComputeLineTraces(sceneData.points[line.point1index].coords,
+                                            sceneData.points[line.point2index].coords);
+    };
+
+    const size_t count = sceneData.lines.size();
+    const size_t known = m_lineTraces.size();
+    if (known > count) {
+        m_lineTraces.resize(count);
+        ComputeAll(m_jobs, count, compute);
+    } else {
+        m_lineTraces.resize(count); // appended lines as with the planes
+        for (int i : m_pendingLines) {
+            if (i >= 0 && static_cast<size_t>(i) < known) compute(i);
+        }
+        for (size_t i = known; i < count; ++i) compute(i);
+    }
+
+    m_pendingLines.clear();
+    return m_lineTraces;
+}
+
+LineTraces TraceEngine::ComputeLineTraces(const float p1[3], const float p2[3]) {
+    LineTraces traces;
+
+    double dir[3] = { (double)p2[0] - p1[0], (double)p2[1] - p1[1], (double)p2[2] - p1[2] };
+    double length = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+    if (length == 0.0) return traces;
+    traces.degenerate = false;
+
+    double extent = 1.0;
+    for (int i = 0; i < 3; ++i) {
+        extent = std::fmax(extent, std::fabs(p1[i]));
+        extent = std::fmax(extent, std::fabs(p2[i]));
+    }
+    const double positionEpsilon = RELATIVE_EPSILON * extent;
+
+    // the line only crosses a projection plane if it isn't parallel to it
+    double breaks[2];
+    int breakCount = 0;
+
+    if (std::fabs(dir[2]) > RELATIVE_EPSILON * length) {
+        double t = -p1[2] / dir[2];
+        traces.hasHorizontal = true;
+        traces.horizontalT = static_cast<float>(t);
+        traces.horizontal[0] = static_cast<float>(p1[0] + t * dir[0]);
+        traces.horizontal[1] = static_cast<float>(p1[1] + t * dir[1]);
+        traces.horizontal[2] = 0.0f;
+        breaks[breakCount++] = t;
+    }
+
+    if (std::fabs(dir[1]) > RELATIVE_EPSILON * length) {
+        double t = -p1[1] / dir[1];
+        traces.hasVertical = true;
+        traces.verticalT = static_cast<float>(t);
+        traces.vertical[0] = static_cast<float>(p1[0] + t * dir[0]);
+        traces.vertical[1] = 0.0f;
+        traces.vertical[2] = static_cast<float>(p1[2] + t * dir[2]);
+
+        // both traces on the same spot means the line crosses the ground line
+        if (breakCount == 0 || std::fabs(breaks[0] - t) * length > positionEpsilon) breaks[breakCount++] = t;
+    }
+
+    if (breakCount == 2 && breaks[0] > breaks[1]) std::swap(breaks[0], breaks[1]);
+
+    // pieces between consecutive trace points, each one stays inside a single quadrant
+    double bounds[4];
+    int boundCount = 0;
+    bounds[boundCount++] = -HUGE_VAL;
+    for (int i = 0; i < breakCount; ++i) bounds[boundCount++] = breaks[i];
+    bounds[boundCount++] = HUGE_VAL;
+
+    for (int i = 0; i + 1 < boundCount; ++i) {
+        double t0 = bounds[i], t1 = bounds[i + 1];
+
+        // any parameter strictly inside the piece tells its quadrant
+        double sample;
+        if (std::isinf(t0) && std::isinf(t1)) sample = 0.5;
+        else if (std::isinf(t0)) sample = t1 - 1.0;
+        else if (std::isinf(t1)) sample = t0 + 1.0;
+        else sample = (t0 + t1) * 0.5;
+
+        double a = p1[1] + sample * dir[1];
+        double c = p1[2] + sample * dir[2];
+
+        LineInterval& interval = traces.intervals[traces.intervalCount++];
+        interval.t0 = static_cast<float>(t0);
+        interval.t1 = static_cast<float>(t1);
+
+        bool onVertical = std::fabs(a) <= positionEpsilon;
+        bool onHorizontal = std::fabs(c) <= positionEpsilon;
+        if (onVertical || onHorizontal) interval.quadrant = 0;
+        else if (c > 0.0) interval.quadrant = a > 0.0 ? 1 : 2;
+        else interval.quadrant = a > 0.0 ? 4 : 3;
+
+        interval.visible = a >= -positionEpsilon && c >= -positionEpsilon;
+        if (interval.quadrant) traces.quadrants |= 1 << (interval.quadrant - 1);
+    }
+
+    return traces;
+}
@@ -0,0 +1,105 @@
+// traces.h
+#pragma once
+
+#include <vector>
+
+#include "scene.h"
+
+class JobSystem;
+
+// Special positions of a plane relative to the projection planes
+enum class PlanePosition {
+    Oblique,              // cuts both projection planes and the ground line
+    Horizontal,           // parallel to the horizontal plane (c = const)
+    Frontal,              // parallel to the vertical plane (a = const)
+    Profile,              // perpendicular to the ground line (d = const)
+    HorizontalProjecting, // perpendicular to the horizontal plane, vertical trace is perpendicular to the ground line
+    VerticalProjecting,   // perpendicular to the vertical plane, horizontal trace is perpendicular to the ground line
+    ParallelToGroundLine, // both traces parallel to the ground line
+    ThroughGroundLine,    // contains the ground line, both traces are the ground line itself
+    Degenerate            // the three points are collinear (or repeated), there is no plane
+};
+
+// 2D segment on one of the projection planes, in model units:
+// x is always d, y is a on the horizontal plane and c on the vertical plane
+struct TraceSegment {
+    float x1 = 0.0f, y1 = 0.0f;
+    float x2 = 0.0f, y2 = 0.0f;
+};
+
+struct PlaneTraces {
+    PlanePosition position = PlanePosition::Degenerate;
+
+    // plane equation A*d + B*a + C*c + D = 0, normalized
+    double normal[3] = {0.0, 0.0, 0.0};
+    double offset = 0.0;
+
+    bool hasHorizontal = false; // false when the plane is (or is parallel to) the horizontal plane
+    bool hasVertical = false;
+    TraceSegment horizontal; // clipped to the engine bounds
+    TraceSegment vertical;
+
+    bool meetsGroundLine = false; // both traces cross the ground line at d = groundLineD
+    float groundLineD = 0.0f;
+};
+
+// Piece of a line between two consecutive trace points
+struct LineInterval {
+    float t0 = 0.0f, t1 = 0.0f; // along p1 + t * (p2 - p1), open ends are -inf / inf
+    int quadrant = 0;           // 1 to 4, 0 when the piece lies on a projection plane
+    bool visible = false;       // only what is in the first quadrant (or on its boundary) is seen
+};
+
+struct LineTraces {
+    bool degenerate = true; // both points are the same
+
+    bool hasHorizontal = false; // where the line meets the horizontal plane (c = 0)
+    bool hasVertical = false;   // where the line meets the vertical plane (a = 0)
+    float horizontal[3] = {0.0f, 0.0f, 0.0f}; // (d, a, c)
+    float vertical[3] = {0.0f, 0.0f, 0.0f};
+    float horizontalT = 0.0f;
+    float verticalT = 0.0f;
+
+    unsigned char quadrants = 0; // bit (quadrant - 1) for every quadrant the line goes through
+
+    // a line crosses at most two traces, so there are never more than three pieces
+    LineInterval intervals[3];
+    int intervalCount = 0;
+};
+
+// Computes plane and line traces once per change and keeps them around until the inputs (or the bounds) change again.
+// It never touches GL or ImGui, positions are in model units.
+class TraceEngine {
+public:
+    // Region the trace segments get clipped to, in model units (d range, and a/c range)
+    void SetBounds(float minD, float maxD, float minHeight, float maxHeight);
+    void SetJobSystem(JobSystem* jobs) { m_jobs = jobs; } // full recomputes of big scenes are split into jobs
+
+    // Planes and lines to recompute on the next update (the dependency graph knows which ones changed)
+    void InvalidatePlane(int index) { m_pendingPlanes.push_back(index); }
+    void InvalidateLine(int index) { m_pendingLines.push_back(index); }
+
+    // Recomputes the invalidated planes (all of them when the count or the bounds changed), one entry per plane
+    const std::vector<PlaneTraces>& UpdatePlanes(const SceneData& sceneData);
+    const std::vector<PlaneTraces>& GetPlaneTraces() const { return m_planeTraces; }
+
+    static PlaneTraces ComputePlaneTraces(const float p1[3], const float p2[3], const float p3[3],
+                                          float minD, float maxD, float minHeight, float maxHeight);
+
+    // Same for lines, they don't depend on the bounds
+    const std::vector<LineTraces>& UpdateLines(const SceneData& sceneData);
+    const std::vector<LineTraces>& GetLineTraces() const { return m_lineTraces; }
+
+    static LineTraces ComputeLineTraces(const float p1[3], const float p2[3]);
+
+private:
+    std::vector<PlaneTraces> m_planeTraces;
+    std::vector<LineTraces> m_lineTraces;
+
+    std::vector<int> m_pendingPlanes;
+    std::vector<int> m_pendingLines;
+
+    float m_bounds[4] = {-100.0f, 100.0f, -100.0f, 100.0f};
+    bool m_boundsChanged = true;
+    JobSystem* m_jobs = nullptr;
+};
@@ -1,15 +1,81 @@
 #include "ui.h"
 #include "app.h"
+#include "trace.h"
+#include "alloctrack.h"
 
 #include <algorithm>
 #include <string>
 #include <string>
 #include <sstream>
+#include <string_view>
+#include <cctype>
 
 #include "style.h"
 
 #define PROGRAM_VERSION "0.16.8"
 
+namespace {
+    constexpr int TABLE_VISIBLE_ROWS = 12; // entity tables scroll past this many rows
+
+    float TableHeight(size_t rows) {
+        float rowHeight = ImGui::GetFrameHeight() + ImGui::GetStyle().CellPadding.y * 2.0f;
+        return rowHeight * (std::min<size_t>(rows, TABLE_VISIBLE_ROWS) + 1.5f); // + header
+    }
+
+    // Sorts table rows by the clicked headers in order, compareColumn(column, a, b) returns <0, 0 or >0
+    template <typename Compare>
+    void SortRows(std::vector<int>& rows, const ImGuiTableSortSpecs* specs, const Compare& compareColumn) {
+        if (!specs || specs->SpecsCount == 0) return;
+
+        std::sort(rows.begin(), rows.end(), [&](int a, int b) {
+            for (int n = 0; n < specs->SpecsCount; ++n) {
+                const ImGuiTableColumnSortSpecs& spec = specs->Specs[n];
+                int result = compareColumn(spec.ColumnIndex, a, b);
+                if (result != 0) return spec.SortDirection == ImGuiSortDirection_Ascending ? result < 0 : result > 0;
+            }
+            return a < b; // creation order otherwise
+        });
+    }
+
+    bool SortsByColumn(const ImGuiTableSortSpecs* specs, int column) {
+        for (int n = 0; specs && n < specs->SpecsCount; ++n) {
+            if (specs->Specs[n].ColumnIndex == column) return true;
+        }
+        return false;
+    }
+
+    // "A, B, C" names of the points an entity is built on, for its points column and filter
+    std::string JoinPointNames(const SceneData& sceneData, std::initializer_list<int> indices) {
+        std::string names;
+        for (int index : indices) {
+            if (!names.empty()) names += ", ";
+            if (index >= 0 && index < static_cast<int>(sceneData.points.size())) names += sceneData.points[index].name;
+        }
+        return names;
+    }
+
+    CowVector<Point>& EntitiesOf(SceneData& sceneData, const Point&) { return sceneData.points; }
+    CowVector<Line>& EntitiesOf(SceneData& sceneData, const Line&) { return sceneData.lines; }
+    CowVector<Plane>& EntitiesOf(SceneData& sceneData, const Plane&) { return sceneData.planes; }
+
+    // Runs a widget on a copy of one entity and records what it changed as an undo step. The copy only goes back
+    // into the scene when the widget changed it, so drawing a row never un-shares a chunk a snapshot still holds.
+    // Drags and pickers report a change every frame, those fold into one step until the widget is let go.
+    template <typename Entity, typename Widget>
+    bool EditEntity(History& history, SceneData& sceneData, int index, Entity& entity, const Widget& widget) {
+        const Entity before = entity;
+        const bool changed = widget();
+        if (changed) {
+            history.Begin(sceneData, ImGui::GetItemID());
+            history.Touch(index, before);
+            EntitiesOf(sceneData, entity)[index] = entity;
+            history.Commit(sceneData);
+        }
+        if (ImGui::IsItemDeactivated()) history.Seal();
+        return changed;
+    }
+}
+
 #if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
     #include "ImGuiFileDialog.h"
     #include "ImGuiFileDialogConfig.h"
@@ -162,6 +228,8 @@ void UI::ShutdownImGui() {
 }
 
 void UI::DrawUI(App& app) {
+    TRACE_SCOPE("UI::DrawUI");
+    ALLOC_SCOPE("UI");
     app.UpdateWindowTitle(std::string(" - ") + PROGRAM_VERSION);
 
     int width = app.GetWindowWidth();
@@ -171,10 +239,134 @@ void UI::DrawUI(App& app) {
     windowPositions.tabs = ImVec2(60, 305);
     windowPositions.presets = ImVec2(60, height - 60 - ImGui::GetTextLineHeightWithSpacing() * 10);
 
+    // undo and redo, unless a text field has the keyboard
+    const ImGuiIO& io = ImGui::GetIO();
+    if (io.KeyCtrl && !io.WantTextInput) {
+        if (ImGui::IsKeyPressed(ImGuiKey_Z, false)) {
+            if (io.KeyShift) app.Redo();
+            else app.Undo();
+        }
+        if (ImGui::IsKeyPressed(ImGuiKey_Y, false)) app.Redo();
+    }
+
+    if (!io.WantTextInput && ImGui::IsKeyPressed(ImGuiKey_F3, false)) showPerfHud = !showPerfHud;
+
     DrawMenuBar(app);
     DrawSettingsWindow(app);
     DrawPresetWindow(app);
+    DrawSelectionGuizmo(app);
     DrawTabsWindow(app);
+    if (showPerfHud) DrawPerfHud(app);
+}
+
+void UI::DrawPerfHud(App& app) {
+    const ImGuiIO& io = ImGui::GetIO();
+    ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 12.0f, ImGui::GetFrameHeight() + 12.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.75f);
+    if (!ImGui::Begin("##perfhud", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+            ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav)) {
+        ImGui::End();
+        return;
+    }
+
+    // CPU: percentiles over the last few seconds, the tail is where stutters show up
+    const FrameTimeStats& frameTimes = app.GetFrameTimes();
+    const FrameTimeStats& cpuTimes = app.GetCpuTimes();
+    if (ImGui::BeginTable("##perfcpu", 6, ImGuiTableFlags_SizingFixedFit)) {
+        const char* columns[] = { "", "avg", "p50", "p95", "p99", "max" };
+        for (const char* column : columns) ImGui::TableSetupColumn(column);
+        ImGui::TableHeadersRow();
+
+        auto row = [](const std::string& label, const FrameTimeStats& times) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(label.c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", times.GetMean());
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", times.GetPercentile(50.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", times.GetPercentile(95.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", times.GetPercentile(99.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", times.GetMax());
+        };
+        row(SetText("perf_frame", currentLanguage), frameTimes);
+        row(SetText("perf_cpu", currentLanguage), cpuTimes);
+        ImGui::EndTable();
+    }
+    frameTimes.CopyOrdered(perfHudPlot);
+    ImGui::PlotLines("##perfplot", perfHudPlot.data(), static_cast<int>(perfHudPlot.size()), 0, nullptr, 0.0f,
+        std::max(33.4f, frameTimes.GetMax()), ImVec2(0.0f, 40.0f));
+
+    // GPU: timer queries, a few frames behind
+    ImGui::Separator();
+    Renderer& renderer = app.GetRenderer();
+    GpuTimer& gpuTimer = renderer.GetGpuTimer();
+    if (gpuTimer.IsAvailable()) {
+        const std::string passes[] = {
+            SetText("perf_pass_axes", currentLanguage), SetText("perf_pass_dihedral", currentLanguage),
+            SetText("multi_points", currentLanguage), SetText("multi_lines", currentLanguage),
+            SetText("multi_planes", currentLanguage), SetText("perf_pass_markers", currentLanguage), "ImGui"
+        };
+        ImGui::Text("%s: %.2f", SetText("perf_gpu", currentLanguage).c_str(), gpuTimer.GetTotalMilliseconds());
+        for (int pass = 0; pass < static_cast<int>(GpuPass::Count); ++pass) {
+            ImGui::BulletText("%s: %.3f", passes[pass].c_str(), gpuTimer.GetMilliseconds(static_cast<GpuPass>(pass)));
+        }
+    } else {
+        ImGui::TextDisabled("%s", SetText("perf_gpu_unavailable", currentLanguage).c_str());
+    }
+
+    // what the renderer asked GL for last frame
+    ImGui::Separator();
+    const RenderStats& stats = renderer.GetFrameStats();
+    ImGui::Text("%s: %u", SetText("perf_draw_calls", currentLanguage).c_str(), stats.drawCalls);
+    ImGui::Text("%s: %u (%.1f KB)", SetText("perf_uploads", currentLanguage).c_str(), stats.bufferUploads, stats.uploadBytes / 1024.0);
+    ImGui::Text("%s: %u", SetText("perf_uniforms", currentLanguage).c_str(), stats.uniformUpdates);
+    ImGui::Text("%s: %u (%u %s)", SetText("perf_state_changes", currentLanguage).c_str(), stats.stateChanges, stats.skippedCalls,
+        SetText("perf_skipped", currentLanguage).c_str());
+    ImGui::Text("%s: %u", SetText("perf_labels", currentLanguage).c_str(), stats.labels);
+    ImGui::Text("ImGui: %d windows, %d vertices", io.MetricsRenderWindows, io.MetricsRenderVertices);
+
+    // heap allocations of the last frame per subsystem, only in builds with ENABLE_ALLOC_TRACKING
+    if (AllocTracker::IsEnabled()) {
+        ImGui::Separator();
+        const AllocTracker::Counters total = AllocTracker::GetFrameTotal();
+        const bool overBudget = AllocTracker::HasBudget() && total.allocations > AllocTracker::GetBudget();
+        const ImVec4 color = overBudget ? ImVec4(1.0f, 0.4f, 0.3f, 1.0f) : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+        ImGui::TextColored(color, "%s: %llu (%.1f KB), %s %.1f MB", SetText("perf_allocations", currentLanguage).c_str(),
+            static_cast<unsigned long long>(total.allocations), total.bytes / 1024.0,
+            SetText("perf_alloc_live", currentLanguage).c_str(), AllocTracker::GetLiveBytes() / (1024.0 * 1024.0));
+
+        if (ImGui::BeginTable("##perfalloc", 4, ImGuiTableFlags_SizingFixedFit)) {
+            for (int tag = 0; tag < AllocTracker::GetTagCount(); ++tag) {
+                const AllocTracker::Counters counters = AllocTracker::GetFrameCounters(tag);
+                if (counters.allocations == 0 && counters.frees == 0) continue;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(AllocTracker::GetTagName(tag));
+                ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(counters.allocations));
+                ImGui::TableNextColumn(); ImGui::Text("%.1f KB", counters.bytes / 1024.0);
+                ImGui::TableNextColumn(); ImGui::Text("-%llu", static_cast<unsigned long long>(counters.frees));
+            }
+            ImGui::EndTable();
+        }
+
+        bool hasBudget = AllocTracker::HasBudget();
+        int budget = static_cast<int>(AllocTracker::GetBudget());
+        bool budgetChanged = ImGui::Checkbox(SetText("perf_alloc_budget", currentLanguage).c_str(), &hasBudget);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(90.0f);
+        budgetChanged |= ImGui::InputInt("##allocbudget", &budget);
+        if (budgetChanged) AllocTracker::SetBudget(static_cast<uint64_t>(std::max(budget, 0)), hasBudget);
+        if (hasBudget) {
+            ImGui::SameLine();
+            ImGui::Text("%s: %llu", SetText("perf_alloc_over", currentLanguage).c_str(),
+                static_cast<unsigned long long>(AllocTracker::GetFramesOverBudget()));
+        }
+
+        bool logging = AllocTracker::IsLogging();
+        if (ImGui::Checkbox(SetText("perf_alloc_log", currentLanguage).c_str(), &logging)) {
+            if (logging) AllocTracker::StartLog("alloc_log.csv");
+            else AllocTracker::StopLog();
+        }
+    }
+
+    ImGui::End();
 }
 
 void OpenURL(const std::string& url) {
@@ -215,6 +407,69 @@ void UI::SaveFileDialog(App& app) {
 #endif
 }
 
+void UI::ExportSheetDialog(App& app, bool pdf) {
+    exportAsPDF = pdf;
+#if defined(__EMSCRIPTEN__)
+    ExportSheet(app, pdf ? "/sheet.pdf" : "/sheet.svg", pdf);
+#elif defined(_WIN32)
+    // the filter has embedded nulls, so keep its full length
+    static const char svgFilter[] = "SVG files (*.svg)\0*.svg\0All files (*.*)\0*.*\0";
+    static const char pdfFilter[] = "PDF files (*.pdf)\0*.pdf\0All files (*.*)\0*.*\0";
+    std::string path = pdf ? app.GetJsonHandler().SaveFileDialog(std::string(pdfFilter, sizeof(pdfFilter)))
+                           : app.GetJsonHandler().SaveFileDialog(std::string(svgFilter, sizeof(svgFilter)));
+    if (!path.empty()) {
+        ExportSheet(app, path, pdf);
+    }
+#else
+    const char* filters = pdf ? "PDF files (*.pdf){.pdf},.*" : "SVG files (*.svg){.svg},.*";
+
+    IGFD::FileDialogConfig config;
+    config.flags = ImGuiFileDialogFlags_Default;
+    ImGuiFileDialog::Instance()->OpenDialog("ExportSheetDlgKey", "Export Sheet", filters, config);
+#endif
+}
+
+void UI::ExportSheet(App& app, std::string path, bool pdf) {
+    const std::string extension = pdf ? ".pdf" : ".svg";
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.substr(dot) != extension) {
+        if (dot != std::string::npos && path.substr(dot) == ".json") path = path.substr(0, dot); // windows dialog default
+        path += extension;
+    }
+
+    app.ExportSheet(path, pdf);
+}
+
+void UI::ExportImageDialog(App& app) {
+#if defined(__EMSCRIPTEN__)
+    ExportImage(app, "/render.png");
+#elif defined(_WIN32)
+    static const char filter[] = "PNG images (*.png)\0*.png\0All files (*.*)\0*.*\0";
+    std::string path = app.GetJsonHandler().SaveFileDialog(std::string(filter, sizeof(filter)));
+    if (!path.empty()) {
+        ExportImage(app, path);
+    }
+#else
+    const char* filters = "PNG images (*.png){.png},.*";
+
+    IGFD::FileDialogConfig config;
+    config.flags = ImGuiFileDialogFlags_Default;
+    ImGuiFileDialog::Instance()->OpenDialog("ExportImageDlgKey", "Export Image", filters, config);
+#endif
+}
+
+void UI::ExportImage(App& app, std::string path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.substr(dot) != ".png") {
+        if (dot != std::string::npos && path.substr(dot) == ".json") path = path.substr(0, dot); // windows dialog default
+        path += ".png";
+    }
+
+    // the actual render happens during the next frame, see App::Frame
+    app.RequestImageExport(path, exportImageSize[0], exportImageSize[1]);
+    std::cout << "Exporting image: " << path << " (" << exportImageSize[0] << "x" << exportImageSize[1] << ")" << std::endl;
+}
+
 void UI::SetIcon(const std::string& iconName) {
     ImGuiIO& io = ImGui::GetIO();
     ImFont* iconFont = io.Fonts->Fonts.back(); // Get the last font, which should be the icon font
@@ -238,13 +493,7 @@ void UI::DrawMenuBar(App& app) {
                     JsonHandler* handler = JsonHandlerInstance();
                     handler->OpenFileDialog();
                 #elif _WIN32
-                    std::string path = app.GetJsonHandler().OpenFileDialog();
-                    std::vector<nlohmann::json> data = app.GetJsonHandler().Load(path);
-                    if (!data.empty()) {
-                        std::string fileName = path.substr(path.find_last_of('\\') + 1);
-                        sceneData.settings.loadedFileName = fileName;
-                        app.LoadProject(data);
-                    }
+                    app.OpenProject(app.GetJsonHandler().OpenFileDialog());
                 #else
                     OpenFileDialog(app);
                 #endif
@@ -259,11 +508,37 @@ void UI::DrawMenuBar(App& app) {
             if (ImGui::MenuItem(SetText("menu_save", currentLanguage).c_str(), "Ctrl+S")) {
             #if defined(__EMSCRIPTEN__) || defined(_WIN32)
                 std::string path = app.GetJsonHandler().SaveFileDialog();
-                app.GetJsonHandler().Save(path, app.GetSceneData());
+                app.SaveProject(path);
             #else
                 SaveFileDialog(app);
             #endif
             }
+
+            ImGui::Separator();
+            SetIcon(u8"\uE3F4"); // image icon
+            if (ImGui::MenuItem(SetText("menu_export_svg", currentLanguage).c_str())) {
+                ExportSheetDialog(app, false);
+            }
+            SetIcon(u8"\uE415"); // pdf icon
+            if (ImGui::MenuItem(SetText("menu_export_pdf", currentLanguage).c_str())) {
+                ExportSheetDialog(app, true);
+            }
+            SetIcon(u8"\uE412"); // camera icon
+            if (ImGui::MenuItem(SetText("menu_export_image", currentLanguage).c_str())) {
+                openExportImagePopup = true; // popups can't be opened from inside the menu's id stack
+            }
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu(SetText("menu_edit", currentLanguage).c_str())) {
+            SetIcon(u8"\uE166");
+            if (ImGui::MenuItem(SetText("menu_undo", currentLanguage).c_str(), "Ctrl+Z", false, app.GetHistory().CanUndo())) {
+                app.Undo();
+            }
+            SetIcon(u8"\uE15A");
+            if (ImGui::MenuItem(SetText("menu_redo", currentLanguage).c_str(), "Ctrl+Y", false, app.GetHistory().CanRedo())) {
+                app.Redo();
+            }
             ImGui::EndMenu();
         }
 
@@ -288,9 +563,17 @@ void UI::DrawMenuBar(App& app) {
             SetIcon(u8"\uEFE9"); 
             if (ImGui::MenuItem(SetText("menu_clear_scene", currentLanguage).c_str())) {
                 app.GetCamera().ResetPosition();
+
+                // one undo step brings everything back, the settings stay reset
+                auto& history = app.GetHistory();
+                history.Begin(sceneData);
+                for (int i = static_cast<int>(sceneData.planes.size()) - 1; i >= 0; --i) history.Erasing(sceneData, EntityKind::Plane, i);
+                for (int i = static_cast<int>(sceneData.lines.size()) - 1; i >= 0; --i) history.Erasing(sceneData, EntityKind::Line, i);
+                for (int i = static_cast<int>(sceneData.points.size()) - 1; i >= 0; --i) history.Erasing(sceneData, EntityKind::Point, i);
                 sceneData.points.clear();
                 sceneData.lines.clear();
                 sceneData.planes.clear();
+                history.Commit(sceneData);
                 sceneData.settings = SceneData::Settings();
             }
             SetIcon(u8"\uE04B"); 
@@ -301,6 +584,26 @@ void UI::DrawMenuBar(App& app) {
             if (ImGui::MenuItem(SetText("menu_reset_settings", currentLanguage).c_str())) {
                 sceneData.settings = SceneData::Settings();
             }
+
+            SetIcon(u8"\uE9E4");
+            if (ImGui::MenuItem(SetText("menu_perf_hud", currentLanguage).c_str(), "F3", showPerfHud)) {
+                showPerfHud = !showPerfHud;
+            }
+
+            #ifdef DIEDRICO_TRACING
+            // frame profiling, the saved file opens in ui.perfetto.dev
+            ImGui::Separator();
+            SetIcon(u8"\uE922");
+            if (ImGui::MenuItem(SetText("menu_trace_record", currentLanguage).c_str(), nullptr, Trace::IsRecording())) {
+                if (Trace::IsRecording()) Trace::Stop();
+                else Trace::Start();
+            }
+            SetIcon(u8"\uE161");
+            if (ImGui::MenuItem(SetText("menu_trace_save", currentLanguage).c_str(), nullptr, false, Trace::GetEventCount() > 0)) {
+                Trace::Stop();
+                if (Trace::Save("diedrico_trace.json")) OfferDownload("diedrico_trace.json", "application/json");
+            }
+            #endif
             
             #ifndef __EMSCRIPTEN__
             ImGui::Separator();
@@ -343,19 +646,34 @@ void UI::DrawMenuBar(App& app) {
         ImGui::EndMainMenuBar();
     }
 
+    if (openExportImagePopup) {
+        ImGui::OpenPopup("Export Image");
+        openExportImagePopup = false;
+    }
+
+    if (ImGui::BeginPopupModal("Export Image", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+        ImGui::InputInt2(SetText("export_image_size", currentLanguage).c_str(), exportImageSize);
+        exportImageSize[0] = std::clamp(exportImageSize[0], 16, 16384);
+        exportImageSize[1] = std::clamp(exportImageSize[1], 16, 16384);
+
+        ImGui::Separator();
+        if (ImGui::Button(SetText("export_image_export", currentLanguage).c_str())) {
+            ImGui::CloseCurrentPopup();
+            ExportImageDialog(app);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button(SetText("multi_close", currentLanguage).c_str())) {
+            ImGui::CloseCurrentPopup();
+        }
+        ImGui::EndPopup();
+    }
+
 #if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
     // Open file dialog
     ImGui::SetNextWindowSize(ImVec2(900, 750), ImGuiCond_FirstUseEver);
     if (ImGuiFileDialog::Instance()->Display("ChooseFileDlgKey")) {
         if (ImGuiFileDialog::Instance()->IsOk()) {
-            std::string filePath = ImGuiFileDialog::Instance()->GetFilePathName();
-            std::vector<nlohmann::json> data = app.GetJsonHandler().Load(filePath);
-            std::cout << "Loaded file: " << filePath << std::endl;
-            if (!data.empty()) {
-                std::string fileName = filePath.substr(filePath.find_last_of('/') + 1);
-                sceneData.settings.loadedFileName = fileName;
-                app.LoadProject(data);
-            }
+            app.OpenProject(ImGuiFileDialog::Instance()->GetFilePathName());
         }
         ImGuiFileDialog::Instance()->Close();
     }
@@ -366,7 +684,25 @@ void UI::DrawMenuBar(App& app) {
         if (ImGuiFileDialog::Instance()->IsOk()) {
             std::string filePath = ImGuiFileDialog::Instance()->GetFilePathName();
             std::cout << "Saving file: " << filePath << std::endl;
-            app.GetJsonHandler().Save(filePath, app.GetSceneData());
+            app.SaveProject(filePath);
+        }
+        ImGuiFileDialog::Instance()->Close();
+    }
+
+    // Export sheet dialog
+    ImGui::SetNextWindowSize(ImVec2(900, 750), ImGuiCond_FirstUseEver);
+    if (ImGuiFileDialog::Instance()->Display("ExportSheetDlgKey")) {
+        if (ImGuiFileDialog::Instance()->IsOk()) {
+            ExportSheet(app, ImGuiFileDialog::Instance()->GetFilePathName(), exportAsPDF);
+        }
+        ImGuiFileDialog::Instance()->Close();
+    }
+
+    // Export image dialog
+    ImGui::SetNextWindowSize(ImVec2(900, 750), ImGuiCond_FirstUseEver);
+    if (ImGuiFileDialog::Instance()->Display("ExportImageDlgKey")) {
+        if (ImGuiFileDialog::Instance()->IsOk()) {
+            ExportImage(app, ImGuiFileDialog::Instance()->GetFilePathName());
         }
         ImGuiFileDialog::Instance()->Close();
     }
@@ -486,6 +822,8 @@ void UI::DrawTabsWindow(App& app) {
     ImGui::Begin(SetText("tabs_title", currentLanguage).c_str(), nullptr, ImGuiWindowFlags_AlwaysAutoResize);
 
 
+    DrawSelectionBar(app);
+
     if (ImGui::BeginTabBar("Tabs")) {
         if (ImGui::BeginTabItem(SetText("multi_points", currentLanguage).c_str())) {
             DrawPointsTab(app);
@@ -505,10 +843,93 @@ void UI::DrawTabsWindow(App& app) {
     ImGui::End();
 }
 
+void UI::DrawSelectionGuizmo(App& app) {
+    auto& sceneData = app.GetSceneData();
+    auto& selection = app.GetSelection();
+    auto& renderer = app.GetRenderer();
+
+    auto& history = app.GetHistory();
+
+    // a drag is one undo step however many frames it lasts
+    auto finishDrag = [&]() {
+        selection.EndTransform();
+        if (!selectionDragging) return;
+        history.Commit(sceneData);
+        selectionDragging = false;
+    };
+
+    float centroid[3];
+    if (!selection.GetCentroid(sceneData, centroid)) {
+        finishDrag();
+        return;
+    }
+
+    // between drags the guizmo follows the centroid, so edits from the tables move it too
+    if (!selection.IsTransforming()) {
+        std::copy(centroid, centroid + 3, selectionPivot);
+        renderer.SetInitialGuizmoPosition(glm::vec3(centroid[0], centroid[2], centroid[1]));
+    }
+
+    // a lone point snaps to the others, a group keeps its shape
+    const auto& selectedPoints = selection.Get(EntityKind::Point);
+    int draggedPoint = (selection.Count() == 1 && selectedPoints.size() == 1) ? selectedPoints[0] : -1;
+    glm::vec3 position = renderer.SetPositionWithGuizmo(app.GetCamera(), draggedPoint);
+
+    if (!ImGuizmo::IsUsing()) {
+        finishDrag();
+        return;
+    }
+    if (!selectionDragging) {
+        history.Begin(sceneData);
+        selectionDragging = true;
+    }
+    if (!selection.IsTransforming()) {
+        selection.BeginTransform(sceneData);
+        for (int index : selection.GetTransformPoints()) history.Touch(sceneData, EntityKind::Point, index);
+    }
+
+    const float delta[3] = { position.x - selectionPivot[0], position.y - selectionPivot[1], position.z - selectionPivot[2] };
+    selection.ApplyTranslation(sceneData, delta);
+}
+
+void UI::DrawSelectionBar(App& app) {
+    auto& sceneData = app.GetSceneData();
+    auto& selection = app.GetSelection();
+
+    // the delete key works from the 3D and 2D views too, as long as nothing is being typed
+    if (!selection.Empty() && !ImGui::GetIO().WantTextInput && ImGui::IsKeyPressed(ImGuiKey_Delete, false)) {
+        app.DeleteSelection();
+    }
+    if (selection.Empty()) return;
+
+    ImGui::Text("%s: %zu", SetText("selection_count", currentLanguage).c_str(), selection.Count());
+    ImGui::SameLine();
+    auto& history = app.GetHistory();
+    if (ImGui::ColorEdit3("##BulkColor", bulkColor, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel)) {
+        history.Begin(sceneData, ImGui::GetItemID());
+        for (EntityKind kind : { EntityKind::Point, EntityKind::Line, EntityKind::Plane }) {
+            for (int index : selection.Get(kind)) history.Touch(sceneData, kind, index);
+        }
+        selection.Recolor(sceneData, bulkColor);
+        history.Commit(sceneData);
+    }
+    if (ImGui::IsItemDeactivated()) history.Seal();
+    if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", SetText("selection_recolor", currentLanguage).c_str());
+    ImGui::SameLine();
+    if (ImGui::Button(SetText("selection_delete", currentLanguage).c_str())) {
+        app.DeleteSelection();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button(SetText("selection_clear", currentLanguage).c_str())) {
+        selection.Clear();
+    }
+    ImGui::Separator();
+}
+
 void UI::DrawPointsTab(App& app) {
     auto& sceneData = app.GetSceneData();
+    const SceneData& scene = sceneData; // reads go through this, indexing sceneData un-shares chunks
     auto& renderer = app.GetRenderer();
-    auto& camera = app.GetCamera();
 
     static char pointName[128] = "";
     static float pointCoords[3] = {0.0f, 0.0f, 0.0f};
@@ -531,13 +952,15 @@ void UI::DrawPointsTab(App& app) {
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Name required");
         } 
-        else if (std::any_of(sceneData.points.begin(), sceneData.points.end(), 
+        else if (std::any_of(scene.points.begin(), scene.points.end(), 
                             [&](const Point& p) { return p.name == name; })) {
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Name already exists");
         } 
         else {
+            app.GetHistory().Begin(sceneData);
             sceneData.points.push_back({name, {pointCoords[0], pointCoords[1], pointCoords[2]}, false, true});
+            app.GetHistory().Commit(sceneData);
             pointName[0] = '\0';
             memset(pointCoords, 0, sizeof(pointCoords));
         }
@@ -549,87 +972,150 @@ void UI::DrawPointsTab(App& app) {
 
     ImGui::DragFloat(SetText("tabs_point_size", currentLanguage).c_str(), &sceneData.settings.pointSize, 0.1f, 0.1f, 100.0f);
 
+    ImGui::Checkbox(SetText("tabs_snap", currentLanguage).c_str(), &sceneData.settings.snapToPoints);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100.0f);
+    ImGui::DragFloat(SetText("tabs_snap_radius", currentLanguage).c_str(), &sceneData.settings.snapRadius, 0.05f, 0.1f, 25.0f);
+
+    // filter by name and by quadrant, projection plane or bisector, nothing checked shows every point
+    const auto& pointClasses = app.GetPointClasses().GetClasses();
+    const char* filterLabels[8] = { "I", "II", "III", "IV", "H", "V", "B1", "B2" };
+    const char* filterTooltips[8] = { "filter_quadrant", "filter_quadrant", "filter_quadrant", "filter_quadrant",
+                                      "filter_horizontal", "filter_vertical", "filter_first_bisector", "filter_second_bisector" };
+
+    if (pointNameFilter.Draw((SetText("tabs_filter_name", currentLanguage) + "##PointNameFilter").c_str(), 150.0f)) pointRows.dirty = true;
+
+    ImGui::TextUnformatted(SetText("tabs_filter", currentLanguage).c_str());
+    for (int bit = 0; bit < 8; ++bit) {
+        ImGui::SameLine();
+        bool enabled = (pointFilter & (1 << bit)) != 0;
+        if (ImGui::Checkbox(filterLabels[bit], &enabled)) {
+            pointFilter ^= static_cast<uint8_t>(1 << bit);
+            pointRows.dirty = true;
+        }
+        if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", SetText(filterTooltips[bit], currentLanguage).c_str());
+    }
+
+    // the classes lag a frame behind points added this frame, those show up unfiltered until then
+    auto passesFilter = [&](size_t index) {
+        if (pointFilter != 0 && index < pointClasses.size() && (pointClasses[index] & pointFilter) == 0) return false;
+        return pointNameFilter.PassFilter(scene.points[index].name.c_str());
+    };
+
+    if (pointRows.indices.size() != pointRows.unfiltered) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%zu / %zu", pointRows.indices.size(), pointRows.unfiltered);
+    }
+
     ImGui::Separator();
     
     // Draw point list with better styling
     ImGui::PushStyleVar(ImGuiStyleVar_CellPadding, ImVec2(4, 4));
-    static int selectedPointIndex = -1; // Track selected point index
-    static int lastSelectedPointIndex = -1; // Track last selected point index
-    if (ImGui::BeginTable("PointTable", 4, ImGuiTableFlags_NoHostExtendX                
-                                     | ImGuiTableFlags_RowBg  
-                                     | ImGuiTableFlags_Resizable )) {
+    auto& selection = app.GetSelection();
+    auto& history = app.GetHistory();
+    const bool additive = ImGui::GetIO().KeyShift || ImGui::GetIO().KeyCtrl;
+
+    if (ImGui::BeginTable("PointTable", 4, ImGuiTableFlags_RowBg
+                                     | ImGuiTableFlags_Resizable
+                                     | ImGuiTableFlags_ScrollY
+                                     | ImGuiTableFlags_Sortable
+                                     | ImGuiTableFlags_SortMulti
+                                     | ImGuiTableFlags_SortTristate,
+                                     ImVec2(0.0f, TableHeight(pointRows.indices.size())))) {
+        ImGui::TableSetupScrollFreeze(0, 1);
         ImGui::TableSetupColumn(" Name", ImGuiTableColumnFlags_WidthFixed, 40.0f);
         ImGui::TableSetupColumn("Coords", ImGuiTableColumnFlags_WidthStretch, 0.0f);
-        ImGui::TableSetupColumn("Color", ImGuiTableColumnFlags_WidthFixed, 40.0f);
-        ImGui::TableSetupColumn("Delete", ImGuiTableColumnFlags_WidthFixed, 40.0f);
+        ImGui::TableSetupColumn("Color", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 40.0f);
+        ImGui::TableSetupColumn("Delete", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 40.0f);
         ImGui::TableHeadersRow();
 
-        for (size_t i = 0; i < sceneData.points.size(); ++i) {
-            if (sceneData.points[i].hidden) continue;
-            auto& point = sceneData.points[i];
-            ImVec4 color(point.color[0], point.color[1], point.color[2], 1.0f);
+        ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+        if (sortSpecs && sortSpecs->SpecsDirty) {
+            pointRows.dirty = true;
+            sortSpecs->SpecsDirty = false;
+        }
 
-            ImGui::PushID(static_cast<int>(i));
-            ImGui::TableNextRow();
+        // the coords sort and the class filter change while points move, names and hiding don't
+        const uint64_t pointRevision = pointFilter != 0 || SortsByColumn(sortSpecs, 1) ? app.GetSceneRevision() : app.GetListRevision();
+        if (pointRows.NeedsRebuild(pointRevision, sceneData.points.size())) {
+            pointRows.indices.clear();
+            pointRows.unfiltered = 0;
+            for (size_t i = 0; i < sceneData.points.size(); ++i) {
+                if (scene.points[i].hidden) continue;
+                pointRows.unfiltered++;
+                if (passesFilter(i)) pointRows.indices.push_back(static_cast<int>(i));
+            }
 
-            ImGui::TableSetColumnIndex(0);
-            ImVec2 cellMin = ImGui::GetCursorScreenPos();
-            ImVec2 cellMax = ImVec2(cellMin.x + ImGui::GetColumnWidth(), cellMin.y + ImGui::GetTextLineHeightWithSpacing());
-            ImVec2 buttonSize = ImVec2(cellMax.x - cellMin.x, cellMax.y - cellMin.y);
-
-            if (ImGui::InvisibleButton("##select", buttonSize)) {
-                if (selectedPointIndex != static_cast<int>(i)) {
-                    selectedPointIndex = static_cast<int>(i);
-                    // Reset guizmo position to the new point's position
-                    auto& point = sceneData.points[i];
-                    renderer.SetInitialGuizmoPosition(glm::vec3(point.coords[0], point.coords[2], point.coords[1]));
+            SortRows(pointRows.indices, sortSpecs, [&](int column, int a, int b) {
+                const auto& pa = scene.points[a];
+                const auto& pb = scene.points[b];
+                if (column == 0) return pa.name.compare(pb.name);
+                for (int k = 0; k < 3; ++k) { // coords sort by d, then a, then c
+                    if (pa.coords[k] != pb.coords[k]) return pa.coords[k] < pb.coords[k] ? -1 : 1;
                 }
-                else {
-                    selectedPointIndex = -1;
+                return 0;
+            });
+            pointRows.Built(pointRevision, sceneData.points.size());
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(pointRows.indices.size()));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                const int i = pointRows.indices[row];
+                Point point = scene.points[i]; // EditEntity writes it back when a widget changes it
+                ImVec4 color(point.color[0], point.color[1], point.color[2], 1.0f);
+
+                ImGui::PushID(i);
+                ImGui::TableNextRow();
+
+                ImGui::TableSetColumnIndex(0);
+                ImVec2 cellMin = ImGui::GetCursorScreenPos();
+                ImVec2 cellMax = ImVec2(cellMin.x + ImGui::GetColumnWidth(), cellMin.y + ImGui::GetTextLineHeightWithSpacing());
+                ImVec2 buttonSize = ImVec2(cellMax.x - cellMin.x, cellMax.y - cellMin.y);
+
+                // shift or ctrl adds to the selection, the guizmo moves to the new centroid next frame
+                if (ImGui::InvisibleButton("##select", buttonSize)) {
+                    selection.Click(EntityKind::Point, i, additive);
                 }
-            }
 
-            // In the rendering of selected point:
-            if (static_cast<int>(i) == selectedPointIndex) {
-                ImU32 highlightColor = ImGui::GetColorU32(ImGuiCol_Header);
-                ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, highlightColor);
+                if (selection.IsSelected(EntityKind::Point, i)) {
+                    ImU32 highlightColor = ImGui::GetColorU32(ImGuiCol_Header);
+                    ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, highlightColor);
+                }
 
-                // Get updated position from guizmo
-                glm::vec3 pos = renderer.SetPositionWithGuizmo(camera);
-                point.coords[0] = pos.x;
-                point.coords[1] = pos.y;
-                point.coords[2] = pos.z;
-            }
+                // Draw the visible name text
+                ImGui::SetCursorScreenPos(cellMin);
+                ImGui::Text("  %s", point.name.c_str());
 
-            // Draw the visible name text
-            ImGui::SetCursorScreenPos(cellMin);
-            ImGui::Text("  %s", point.name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::PushID(i);
+                ImGui::SetNextItemWidth(-FLT_MIN); // Use all available width in the cell
 
-            ImGui::TableSetColumnIndex(1);
-            ImGui::PushID(static_cast<int>(i));
-            ImGui::SetNextItemWidth(-FLT_MIN); // Use all available width in the cell
+                // the table scrolls in a child window, focus is checked on the whole tabs window
+                if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) && !selection.IsSelected(EntityKind::Point, i)) { // fix this later
+                    EditEntity(history, sceneData, i, point, [&]() { return ImGui::DragFloat3("", point.coords, 0.1f); });
+                }
+                else {
+                    ImGui::Text("%.2f, %.2f, %.2f", point.coords[0], point.coords[1], point.coords[2]);
+                }
+                ImGui::PopID();
 
-            if (ImGui::IsWindowFocused() && selectedPointIndex != static_cast<int>(i)) { // fix this later
-                ImGui::DragFloat3("", point.coords, 0.1f);
-            }
-            else {
-                ImGui::Text("%.2f, %.2f, %.2f", point.coords[0], point.coords[1], point.coords[2]);
-            }
-            ImGui::PopID();
-
-            ImGui::TableSetColumnIndex(2);
-            if (ImGui::ColorEdit4("##Color", (float*)&color,
-                ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel)) {
-                point.color[0] = color.x;
-                point.color[1] = color.y;
-                point.color[2] = color.z;
-            }
+                ImGui::TableSetColumnIndex(2);
+                EditEntity(history, sceneData, i, point, [&]() {
+                    if (!ImGui::ColorEdit4("##Color", (float*)&color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel)) return false;
+                    point.color[0] = color.x;
+                    point.color[1] = color.y;
+                    point.color[2] = color.z;
+                    return true;
+                });
 
-            ImGui::TableSetColumnIndex(3);
+                ImGui::TableSetColumnIndex(3);
                 if (ImGui::Button("X")) {
-                app.DeletePoint(point);
+                    app.DeletePoint(i);
+                }
+                ImGui::PopID();
             }
-            ImGui::PopID();
         }
         ImGui::EndTable();
     }
@@ -639,8 +1125,8 @@ void UI::DrawPointsTab(App& app) {
 
 void UI::DrawLinesTab(App& app) {
     auto& sceneData = app.GetSceneData();
+    const SceneData& scene = sceneData; // reads go through this, indexing sceneData un-shares chunks
     auto& renderer = app.GetRenderer();
-    auto& camera = app.GetCamera();
 
     static char lineName[128] = "";
     ImGui::InputText(SetText("multi_name", currentLanguage).c_str(), lineName, sizeof(lineName), ImGuiInputTextFlags_CallbackCharFilter,
@@ -654,33 +1140,8 @@ void UI::DrawLinesTab(App& app) {
     static int selectedPoint1 = -1;
     static int selectedPoint2 = -1;
 
-    // filtered list of visible points
-    std::vector<int> visiblePointIndices;
-    std::vector<const char*> visiblePointNames;
-    for (size_t i = 0; i < sceneData.points.size(); ++i) {
-        if (!sceneData.points[i].hidden) {
-            visiblePointIndices.push_back(static_cast<int>(i));
-            visiblePointNames.push_back(sceneData.points[i].name.c_str());
-        }
-    }
-
-    auto getOriginalIndex = [&](int selected) -> int {
-        if (selected >= 0 && selected < static_cast<int>(visiblePointIndices.size()))
-            return visiblePointIndices[selected];
-        return -1;
-    };
-
-    int selectedIdx1 = -1, selectedIdx2 = -1;
-    for (size_t i = 0; i < visiblePointIndices.size(); ++i) {
-        if (visiblePointIndices[i] == selectedPoint1) selectedIdx1 = static_cast<int>(i);
-        if (visiblePointIndices[i] == selectedPoint2) selectedIdx2 = static_cast<int>(i);
-    }
-
-    ImGui::Combo((SetText("multi_point", currentLanguage) + " 1").c_str(), &selectedIdx1, visiblePointNames.data(), static_cast<int>(visiblePointNames.size()));
-    ImGui::Combo((SetText("multi_point", currentLanguage) + " 2").c_str(), &selectedIdx2, visiblePointNames.data(), static_cast<int>(visiblePointNames.size()));
-
-    selectedPoint1 = getOriginalIndex(selectedIdx1);
-    selectedPoint2 = getOriginalIndex(selectedIdx2);
+    PointPicker(app, (SetText("multi_point", currentLanguage) + " 1").c_str(), selectedPoint1);
+    PointPicker(app, (SetText("multi_point", currentLanguage) + " 2").c_str(), selectedPoint2);
 
     ImGui::DragFloat((SetText("tabs_thickness", currentLanguage) + "##Thickness").c_str(), &sceneData.settings.lineThickness, 0.1f, 0.1f, 100.0f);
 
@@ -698,15 +1159,17 @@ void UI::DrawLinesTab(App& app) {
             if (name.empty()) {
                 ImGui::SameLine();
                 ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Name required");
-            } else if (std::any_of(sceneData.lines.begin(), sceneData.lines.end(),
+            } else if (std::any_of(scene.lines.begin(), scene.lines.end(),
                 [&](const Line& l) { return l.name == name; })) {
                 ImGui::SameLine();
                 ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Name already exists");
-            } else if (sceneData.points[selectedPoint1].coords == sceneData.points[selectedPoint2].coords) {
+            } else if (scene.points[selectedPoint1].coords == scene.points[selectedPoint2].coords) {
                 ImGui::SameLine();
                 ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Points are the same");
             } else {
+                app.GetHistory().Begin(sceneData);
                 sceneData.lines.push_back({ lineName, selectedPoint1, selectedPoint2 });
+                app.GetHistory().Commit(sceneData);
                 lineName[0] = '\0';
             }
         }
@@ -716,195 +1179,173 @@ void UI::DrawLinesTab(App& app) {
     ImGui::Checkbox(SetText("tabs_cuts", currentLanguage).c_str(), &sceneData.settings.showCutLines);
     renderer.SetCutLineVisible(sceneData.settings.showCutLines);
 
+    if (lineNameFilter.Draw((SetText("tabs_filter_name", currentLanguage) + "##LineNameFilter").c_str(), 150.0f)) lineRows.dirty = true;
+    ImGui::SameLine();
+    if (linePointFilter.Draw((SetText("tabs_filter_points", currentLanguage) + "##LinePointFilter").c_str(), 150.0f)) lineRows.dirty = true;
+
     ImGui::Separator();
     // Draw line list with better styling and selection
     ImGui::PushStyleVar(ImGuiStyleVar_CellPadding, ImVec2(4, 4));
-    static int selectedLineIndex = -1; // Track selected line index
-    if (ImGui::BeginTable("LineTable", 5, 
-        ImGuiTableFlags_NoHostExtendX | 
+    auto& selection = app.GetSelection();
+    auto& history = app.GetHistory();
+    const bool additive = ImGui::GetIO().KeyShift || ImGui::GetIO().KeyCtrl;
+
+    auto validLine = [&](const Line& line) {
+        return line.point1index >= 0 && line.point1index < static_cast<int>(sceneData.points.size()) &&
+               line.point2index >= 0 && line.point2index < static_cast<int>(sceneData.points.size());
+    };
+
+    int deleteLineIndex = -1; // erased after the table, the rows point into sceneData.lines
+    if (ImGui::BeginTable("LineTable", 6, 
         ImGuiTableFlags_RowBg | 
         ImGuiTableFlags_Resizable | 
-        ImGuiTableFlags_SizingStretchSame)) {
+        ImGuiTableFlags_SizingStretchSame |
+        ImGuiTableFlags_ScrollY |
+        ImGuiTableFlags_Sortable |
+        ImGuiTableFlags_SortMulti |
+        ImGuiTableFlags_SortTristate,
+        ImVec2(0.0f, TableHeight(lineRows.indices.size())))) {
         
         // Set column widths - first column stretches, others fixed
+        ImGui::TableSetupScrollFreeze(0, 1);
         ImGui::TableSetupColumn(" Name", ImGuiTableColumnFlags_WidthStretch);
-        ImGui::TableSetupColumn("Hide Points", ImGuiTableColumnFlags_WidthFixed, 65.0f);
+        ImGui::TableSetupColumn("Points", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Hide Points", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 65.0f);
         ImGui::TableSetupColumn("Visibility**", ImGuiTableColumnFlags_WidthFixed, 105.0f);
-        ImGui::TableSetupColumn("Color", ImGuiTableColumnFlags_WidthFixed, 40.0f);
-        ImGui::TableSetupColumn("Delete", ImGuiTableColumnFlags_WidthFixed, 40.0f);
+        ImGui::TableSetupColumn("Color", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 40.0f);
+        ImGui::TableSetupColumn("Delete", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 40.0f);
         ImGui::TableHeadersRow();
 
-        // Move these static maps outside the loop so they persist across frames
-        static std::unordered_map<size_t, glm::vec3> initialMidMap;
-        static std::unordered_map<size_t, std::pair<glm::vec3, glm::vec3>> initialPMap;
-
-        for (size_t i = 0; i < sceneData.lines.size(); ++i) {
-            auto& line = sceneData.lines[i];
-            ImVec4 color(line.color[0], line.color[1], line.color[2], 1.0f);
-
-            ImGui::PushID(static_cast<int>(i)); // Unique ID scope for widgets
-
-            ImGui::TableNextRow();
-
-            // Highlight entire row if selected
-            if (static_cast<int>(i) == selectedLineIndex) {
-                ImU32 highlightColor = ImGui::GetColorU32(ImGuiCol_Header);
-                ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, highlightColor);
-
-                if (line.point1index >= 0 && line.point1index < static_cast<int>(sceneData.points.size()) &&
-                    line.point2index >= 0 && line.point2index < static_cast<int>(sceneData.points.size())) {
-                    auto& p1 = sceneData.points[line.point1index];
-                    auto& p2 = sceneData.points[line.point2index];
-
-                    glm::vec3 mid{
-                        (p1.coords[0] + p2.coords[0]) * 0.5f,
-                        (p1.coords[1] + p2.coords[1]) * 0.5f,
-                        (p1.coords[2] + p2.coords[2]) * 0.5f
-                    };
-
-                    // Only set initial values if just selected (not every frame)
-                    if (initialMidMap.find(i) == initialMidMap.end()) {
-                        renderer.SetInitialGuizmoPosition(mid);
-                        initialMidMap[i] = mid;
-                        initialPMap[i] = { glm::vec3(p1.coords[0], p1.coords[1], p1.coords[2]),
-                                           glm::vec3(p2.coords[0], p2.coords[1], p2.coords[2]) };
-                    }
+        ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+        if (sortSpecs && sortSpecs->SpecsDirty) {
+            lineRows.dirty = true;
+            sortSpecs->SpecsDirty = false;
+        }
 
-                    glm::vec3 newMid = renderer.SetPositionWithGuizmo(camera);
-
-                    // Only update if guizmo moved
-                    if (newMid != initialMidMap[i]) {
-                        glm::vec3 delta = newMid - initialMidMap[i];
-                        glm::vec3 p1new = initialPMap[i].first + delta;
-                        glm::vec3 p2new = initialPMap[i].second + delta;
-                        p1.coords[0] = p1new.x;
-                        p1.coords[1] = p1new.y;
-                        p1.coords[2] = p1new.z;
-                        p2.coords[0] = p2new.x;
-                        p2.coords[1] = p2new.y;
-                        p2.coords[2] = p2new.z;
-                    }
+        // nothing here depends on coordinates
+        if (lineRows.NeedsRebuild(app.GetListRevision(), sceneData.lines.size())) {
+            auto& pointNames = lineRows.pointNames;
+            pointNames.clear();
+            if (linePointFilter.IsActive() || SortsByColumn(sortSpecs, 1)) {
+                for (size_t i = 0; i < sceneData.lines.size(); ++i) {
+                    const auto& line = scene.lines[i];
+                    pointNames.push_back(JoinPointNames(sceneData, { line.point1index, line.point2index }));
                 }
-            } else {
-                // Clear guizmo state if not selected
-                initialMidMap.erase(i);
-                initialPMap.erase(i);
             }
 
-            ImGui::TableSetColumnIndex(0);
-            ImVec2 cellMin = ImGui::GetCursorScreenPos();
-            ImVec2 cellMax = ImVec2(cellMin.x + ImGui::GetColumnWidth(), cellMin.y + ImGui::GetTextLineHeightWithSpacing());
-            ImVec2 buttonSize = ImVec2(cellMax.x - cellMin.x, cellMax.y - cellMin.y);
-
-            // Click area (invisible button)
-            if (ImGui::InvisibleButton("##select", buttonSize)) {
-                if (selectedLineIndex == static_cast<int>(i)) {
-                    selectedLineIndex = -1; // Unselect
-                } else {
-                    selectedLineIndex = static_cast<int>(i); // Select
-                    // Set guizmo to midpoint and only set initial maps if not already present
-                    if (line.point1index >= 0 && line.point1index < static_cast<int>(sceneData.points.size()) &&
-                        line.point2index >= 0 && line.point2index < static_cast<int>(sceneData.points.size())) {
-                        auto& p1 = sceneData.points[line.point1index];
-                        auto& p2 = sceneData.points[line.point2index];
-                        glm::vec3 mid{
-                            (p1.coords[0] + p2.coords[0]) * 0.5f,
-                            (p1.coords[1] + p2.coords[1]) * 0.5f,
-                            (p1.coords[2] + p2.coords[2]) * 0.5f
-                        };
-                        renderer.SetInitialGuizmoPosition(mid);
-                        if (initialMidMap.find(i) == initialMidMap.end()) {
-                            initialMidMap[i] = mid;
-                            initialPMap[i] = { glm::vec3(p1.coords[0], p1.coords[1], p1.coords[2]),
-                                               glm::vec3(p2.coords[0], p2.coords[1], p2.coords[2]) };
-                        }
-                    }
-                }
+            lineRows.indices.clear();
+            lineRows.unfiltered = sceneData.lines.size();
+            for (size_t i = 0; i < sceneData.lines.size(); ++i) {
+                if (!lineNameFilter.PassFilter(scene.lines[i].name.c_str())) continue;
+                if (linePointFilter.IsActive() && !linePointFilter.PassFilter(pointNames[i].c_str())) continue;
+                lineRows.indices.push_back(static_cast<int>(i));
             }
 
-            // Draw the visible name text
-            ImGui::SetCursorScreenPos(cellMin);
-            ImGui::Text("%s", line.name.c_str());
-
-            ImGui::TableSetColumnIndex(1);
-            if (line.point1index >= 0 && line.point1index < static_cast<int>(sceneData.points.size()) &&
-                line.point2index >= 0 && line.point2index < static_cast<int>(sceneData.points.size())) {
-                bool pointsHidden = sceneData.points[line.point1index].hidden;
-                if (ImGui::Checkbox("##Hide", &pointsHidden)) {
-                    sceneData.points[line.point1index].hidden = pointsHidden;
-                    sceneData.points[line.point2index].hidden = pointsHidden;
-                }
-                ImGui::SameLine();
-                ImGui::Text("Hide");
-            }
+            SortRows(lineRows.indices, sortSpecs, [&](int column, int a, int b) {
+                const auto& la = scene.lines[a];
+                const auto& lb = scene.lines[b];
+                if (column == 0) return la.name.compare(lb.name);
+                if (column == 1) return pointNames[a].compare(pointNames[b]);
+                if (column == 3) return static_cast<int>(la.showVisibility) - static_cast<int>(lb.showVisibility);
+                return 0;
+            });
+            lineRows.Built(app.GetListRevision(), sceneData.lines.size());
+        }
 
-            ImGui::TableSetColumnIndex(2);
-            ImGui::Checkbox("##Visibility", &line.showVisibility);
-            ImGui::SameLine();
-            ImGui::Text("Visibility Study");
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(lineRows.indices.size()));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                const size_t i = static_cast<size_t>(lineRows.indices[row]);
+                Line line = scene.lines[i]; // EditEntity writes it back when a widget changes it
+                ImVec4 color(line.color[0], line.color[1], line.color[2], 1.0f);
 
-            ImGui::TableSetColumnIndex(3);
-            if (ImGui::ColorEdit3("##Color", (float*)&color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel)) {
-                line.color[0] = color.x;
-                line.color[1] = color.y;
-                line.color[2] = color.z;
-            }
+                ImGui::PushID(static_cast<int>(i)); // Unique ID scope for widgets
 
-            ImGui::TableSetColumnIndex(4);
-            if (ImGui::Button("X", ImVec2(-FLT_MIN, 0))) {
-                int p1 = line.point1index;
-                int p2 = line.point2index;
+                ImGui::TableNextRow();
 
-                bool p1User = (p1 >= 0 && p1 < static_cast<int>(sceneData.points.size())) ?
-                    sceneData.points[p1].userCreated : false;
-                bool p2User = (p2 >= 0 && p2 < static_cast<int>(sceneData.points.size())) ?
-                    sceneData.points[p2].userCreated : false;
+                // Highlight entire row if selected
+                if (selection.IsSelected(EntityKind::Line, static_cast<int>(i))) {
+                    ImU32 highlightColor = ImGui::GetColorU32(ImGuiCol_Header);
+                    ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, highlightColor);
+                }
 
-                sceneData.lines.erase(sceneData.lines.begin() + i);
+                ImGui::TableSetColumnIndex(0);
+                ImVec2 cellMin = ImGui::GetCursorScreenPos();
+                ImVec2 cellMax = ImVec2(cellMin.x + ImGui::GetColumnWidth(), cellMin.y + ImGui::GetTextLineHeightWithSpacing());
+                ImVec2 buttonSize = ImVec2(cellMax.x - cellMin.x, cellMax.y - cellMin.y);
 
-                if (p1 >= 0 && p1 < static_cast<int>(sceneData.points.size())) {
-                    if (!p1User) {
-                        sceneData.points[p1].hidden = true;
-                        sceneData.points[p1].name = "deleted";
-                    } else {
-                        sceneData.points[p1].hidden = false;
-                    }
+                // Click area (invisible button)
+                if (ImGui::InvisibleButton("##select", buttonSize)) {
+                    selection.Click(EntityKind::Line, static_cast<int>(i), additive); // the guizmo picks it up next frame
                 }
-                if (p2 >= 0 && p2 < static_cast<int>(sceneData.points.size())) {
-                    if (!p2User) {
-                        sceneData.points[p2].hidden = true;
-                        sceneData.points[p2].name = "deleted";
-                    } else {
-                        sceneData.points[p2].hidden = false;
+
+                // Draw the visible name text
+                ImGui::SetCursorScreenPos(cellMin);
+                ImGui::Text("%s", line.name.c_str());
+
+                ImGui::TableSetColumnIndex(1);
+                ImGui::TextUnformatted(JoinPointNames(sceneData, { line.point1index, line.point2index }).c_str());
+
+                ImGui::TableSetColumnIndex(2);
+                if (validLine(line)) {
+                    bool pointsHidden = scene.points[line.point1index].hidden;
+                    if (ImGui::Checkbox("##Hide", &pointsHidden)) {
+                        history.Begin(sceneData);
+                        history.Touch(sceneData, EntityKind::Point, line.point1index);
+                        history.Touch(sceneData, EntityKind::Point, line.point2index);
+                        sceneData.points[line.point1index].hidden = pointsHidden;
+                        sceneData.points[line.point2index].hidden = pointsHidden;
+                        history.Commit(sceneData);
+                        app.MarkSceneChanged();
                     }
+                    ImGui::SameLine();
+                    ImGui::Text("Hide");
+                }
+
+                ImGui::TableSetColumnIndex(3);
+                if (EditEntity(history, sceneData, static_cast<int>(i), line, [&]() { return ImGui::Checkbox("##Visibility", &line.showVisibility); })) {
+                    app.MarkSceneChanged();
+                }
+                ImGui::SameLine();
+                ImGui::Text("Visibility Study");
+
+                ImGui::TableSetColumnIndex(4);
+                EditEntity(history, sceneData, static_cast<int>(i), line, [&]() {
+                    if (!ImGui::ColorEdit3("##Color", (float*)&color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel)) return false;
+                    line.color[0] = color.x;
+                    line.color[1] = color.y;
+                    line.color[2] = color.z;
+                    return true;
+                });
+
+                ImGui::TableSetColumnIndex(5);
+                if (ImGui::Button("X", ImVec2(-FLT_MIN, 0))) {
+                    deleteLineIndex = static_cast<int>(i);
                 }
-                // Clean up guizmo state for this line
-                static std::unordered_map<size_t, glm::vec3> initialMidMap;
-                static std::unordered_map<size_t, std::pair<glm::vec3, glm::vec3>> initialPMap;
-                initialMidMap.erase(i);
-                initialPMap.erase(i);
 
-                --i; // Re-adjust index
                 ImGui::PopID();
-                continue;
             }
-
-            ImGui::PopID();
         }
 
         ImGui::EndTable();
     }
 
-    // Show coordinate editing for selected line
-    if (selectedLineIndex >= 0 && selectedLineIndex < static_cast<int>(sceneData.lines.size())) {
-        auto& line = sceneData.lines[selectedLineIndex];
+    if (deleteLineIndex >= 0) {
+        app.DeleteLine(deleteLineIndex);
+    }
+
+    // Show coordinate editing when a single line is selected
+    const auto& selectedLines = selection.Get(EntityKind::Line);
+    if (selection.Count() == 1 && selectedLines.size() == 1) {
+        const auto& line = scene.lines[selectedLines[0]];
         if (line.point1index >= 0 && line.point1index < static_cast<int>(sceneData.points.size()) &&
             line.point2index >= 0 && line.point2index < static_cast<int>(sceneData.points.size())) {
-            auto& p1 = sceneData.points[line.point1index];
-            auto& p2 = sceneData.points[line.point2index];
+            Point p1 = scene.points[line.point1index];
+            Point p2 = scene.points[line.point2index];
 
-            ImGui::InputFloat3("P1", p1.coords);
-            ImGui::InputFloat3("P2", p2.coords);
+            EditEntity(history, sceneData, line.point1index, p1, [&]() { return ImGui::InputFloat3("P1", p1.coords); });
+            EditEntity(history, sceneData, line.point2index, p2, [&]() { return ImGui::InputFloat3("P2", p2.coords); });
         }
     }
 
@@ -914,10 +1355,12 @@ void UI::DrawLinesTab(App& app) {
 
 void UI::DrawPlanesTab(App& app) {
     auto& sceneData = app.GetSceneData();
+    const SceneData& scene = sceneData; // reads go through this, indexing sceneData un-shares chunks
     
     static char planeName[128] = "";
     ImGui::InputText(SetText("multi_name", currentLanguage).c_str(), planeName, sizeof(planeName));
     ImGui::DragFloat(SetText("tabs_opacity", currentLanguage).c_str(), &sceneData.settings.planeOpacity, 0.01f, 0.1f, 1.0f);
+    ImGui::Checkbox(SetText("tabs_intersections", currentLanguage).c_str(), &sceneData.settings.showIntersections);
 
     // tabs to create point with coords or select existing points
     if (ImGui::BeginTabBar("PlaneTabs")) {
@@ -926,36 +1369,9 @@ void UI::DrawPlanesTab(App& app) {
             static int selectedPoint2 = -1;
             static int selectedPoint3 = -1;
 
-            // filtered list of visible points
-            std::vector<int> visiblePointIndices;
-            std::vector<const char*> visiblePointNames;
-            for (size_t i = 0; i < sceneData.points.size(); ++i) {
-                if (!sceneData.points[i].hidden) {
-                    visiblePointIndices.push_back(static_cast<int>(i));
-                    visiblePointNames.push_back(sceneData.points[i].name.c_str());
-                }
-            }
-
-            auto getOriginalIndex = [&](int selected) -> int {
-                if (selected >= 0 && selected < static_cast<int>(visiblePointIndices.size()))
-                    return visiblePointIndices[selected];
-                return -1;
-            };
-
-            int selectedIdx1 = -1, selectedIdx2 = -1, selectedIdx3 = -1;
-            for (size_t i = 0; i < visiblePointIndices.size(); ++i) {
-                if (visiblePointIndices[i] == selectedPoint1) selectedIdx1 = static_cast<int>(i);
-                if (visiblePointIndices[i] == selectedPoint2) selectedIdx2 = static_cast<int>(i);
-                if (visiblePointIndices[i] == selectedPoint3) selectedIdx3 = static_cast<int>(i);
-            }
-
-            ImGui::Combo((SetText("multi_point", currentLanguage) + " 1").c_str(), &selectedIdx1, visiblePointNames.data(), static_cast<int>(visiblePointNames.size()));
-            ImGui::Combo((SetText("multi_point", currentLanguage) + " 2").c_str(), &selectedIdx2, visiblePointNames.data(), static_cast<int>(visiblePointNames.size()));
-            ImGui::Combo((SetText("multi_point", currentLanguage) + " 3").c_str(), &selectedIdx3, visiblePointNames.data(), static_cast<int>(visiblePointNames.size()));
-
-            selectedPoint1 = getOriginalIndex(selectedIdx1);
-            selectedPoint2 = getOriginalIndex(selectedIdx2);
-            selectedPoint3 = getOriginalIndex(selectedIdx3);
+            PointPicker(app, (SetText("multi_point", currentLanguage) + " 1").c_str(), selectedPoint1);
+            PointPicker(app, (SetText("multi_point", currentLanguage) + " 2").c_str(), selectedPoint2);
+            PointPicker(app, (SetText("multi_point", currentLanguage) + " 3").c_str(), selectedPoint3);
 
             if (ImGui::Button("Add Plane")) {
                 if (selectedPoint1 != selectedPoint2 && selectedPoint1 != selectedPoint3 && selectedPoint2 != selectedPoint3) {
@@ -966,12 +1382,14 @@ void UI::DrawPlanesTab(App& app) {
                     if (name.empty()) {
                         ImGui::SameLine();
                         ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Name required");
-                    } else if (std::any_of(sceneData.planes.begin(), sceneData.planes.end(),
+                    } else if (std::any_of(scene.planes.begin(), scene.planes.end(),
                         [&](const Plane& p) { return p.name == name; })) {
                         ImGui::SameLine();
                         ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Name already exists");
                     } else {
+                        app.GetHistory().Begin(sceneData);
                         sceneData.planes.push_back({ planeName, selectedPoint1, selectedPoint2, selectedPoint3 });
+                        app.GetHistory().Commit(sceneData);
                         planeName[0] = '\0';
                     }
                 }
@@ -991,12 +1409,13 @@ void UI::DrawPlanesTab(App& app) {
                 if (name.empty()) {
                     ImGui::SameLine();
                     ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Name required");
-                } else if (std::any_of(sceneData.planes.begin(), sceneData.planes.end(),
+                } else if (std::any_of(scene.planes.begin(), scene.planes.end(),
                     [&](const Plane& p) { return p.name == name; })) {
                     ImGui::SameLine();
                     ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Name already exists");
                 } else {
                     // we add the 3 points
+                    app.GetHistory().Begin(sceneData);
                     sceneData.points.push_back({ name + "1", { planeCoords[0], 0.0f, 0.0f }, true });
                     sceneData.points.push_back({ name + "2", { 0.0f, planeCoords[1], 0.0f }, true });
                     sceneData.points.push_back({ name + "3", { 0.0f, 0.0f, planeCoords[2] }, true });
@@ -1004,6 +1423,7 @@ void UI::DrawPlanesTab(App& app) {
                     sceneData.planes.push_back({ name, static_cast<int>(sceneData.points.size() - 3), 
                                                 static_cast<int>(sceneData.points.size() - 2), 
                                                 static_cast<int>(sceneData.points.size() - 1) });
+                    app.GetHistory().Commit(sceneData);
                     planeName[0] = '\0';
                 }
             }
@@ -1013,210 +1433,254 @@ void UI::DrawPlanesTab(App& app) {
         ImGui::EndTabBar();
     }
 
+    if (planeNameFilter.Draw((SetText("tabs_filter_name", currentLanguage) + "##PlaneNameFilter").c_str(), 150.0f)) planeRows.dirty = true;
+    ImGui::SameLine();
+    if (planePointFilter.Draw((SetText("tabs_filter_points", currentLanguage) + "##PlanePointFilter").c_str(), 150.0f)) planeRows.dirty = true;
+
     ImGui::Separator();
 
     ImGui::PushStyleVar(ImGuiStyleVar_CellPadding, ImVec2(4, 4));
-    static int selectedPlaneIndex = -1;
-    // For guizmo-like movement: store initial midpoint and initial positions for each plane
-    static std::unordered_map<size_t, glm::vec3> initialMidMap;
-    static std::unordered_map<size_t, std::tuple<glm::vec3, glm::vec3, glm::vec3>> initialPMap;
+    auto& selection = app.GetSelection();
+    auto& history = app.GetHistory();
+    const bool additive = ImGui::GetIO().KeyShift || ImGui::GetIO().KeyCtrl;
+
+    auto validPlane = [&](const Plane& plane) {
+        return plane.point1index >= 0 && plane.point1index < static_cast<int>(sceneData.points.size()) &&
+               plane.point2index >= 0 && plane.point2index < static_cast<int>(sceneData.points.size()) &&
+               plane.point3index >= 0 && plane.point3index < static_cast<int>(sceneData.points.size());
+    };
 
-    if (ImGui::BeginTable("PlaneTable", 5,
-        ImGuiTableFlags_NoHostExtendX |
+    int deletePlaneIndex = -1; // erased after the table, the rows point into sceneData.planes
+    if (ImGui::BeginTable("PlaneTable", 6,
         ImGuiTableFlags_RowBg |
         ImGuiTableFlags_Resizable |
-        ImGuiTableFlags_SizingStretchSame)) {
-
+        ImGuiTableFlags_SizingStretchSame |
+        ImGuiTableFlags_ScrollY |
+        ImGuiTableFlags_Sortable |
+        ImGuiTableFlags_SortMulti |
+        ImGuiTableFlags_SortTristate,
+        ImVec2(0.0f, TableHeight(planeRows.indices.size())))) {
+
+        ImGui::TableSetupScrollFreeze(0, 1);
         ImGui::TableSetupColumn(" Name", ImGuiTableColumnFlags_WidthStretch, 0.3f);
-        ImGui::TableSetupColumn("Hide Points", ImGuiTableColumnFlags_WidthFixed, 65.0f);
+        ImGui::TableSetupColumn("Points", ImGuiTableColumnFlags_WidthStretch, 0.3f);
+        ImGui::TableSetupColumn("Hide Points", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 65.0f);
         ImGui::TableSetupColumn("Expand", ImGuiTableColumnFlags_WidthFixed, 40.0f);
-        ImGui::TableSetupColumn("Color", ImGuiTableColumnFlags_WidthFixed, 40.0f);
-        ImGui::TableSetupColumn("Delete", ImGuiTableColumnFlags_WidthFixed, 40.0f);
+        ImGui::TableSetupColumn("Color", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 40.0f);
+        ImGui::TableSetupColumn("Delete", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 40.0f);
         ImGui::TableHeadersRow();
 
-        for (size_t i = 0; i < sceneData.planes.size(); ++i) {
-            auto& plane = sceneData.planes[i];
-            ImVec4 color(plane.color[0], plane.color[1], plane.color[2], 1.0f);
-
-            ImGui::PushID(static_cast<int>(i));
-            ImGui::TableNextRow();
-
-            // Highlight row if selected
-            if (static_cast<int>(i) == selectedPlaneIndex) {
-                ImU32 highlightColor = ImGui::GetColorU32(ImGuiCol_Header);
-                ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, highlightColor);
-
-                if (plane.point1index >= 0 && plane.point1index < static_cast<int>(sceneData.points.size()) &&
-                    plane.point2index >= 0 && plane.point2index < static_cast<int>(sceneData.points.size()) &&
-                    plane.point3index >= 0 && plane.point3index < static_cast<int>(sceneData.points.size())) {
-                    auto& p1 = sceneData.points[plane.point1index];
-                    auto& p2 = sceneData.points[plane.point2index];
-                    auto& p3 = sceneData.points[plane.point3index];
-
-                    glm::vec3 mid{
-                        (p1.coords[0] + p2.coords[0] + p3.coords[0]) / 3.0f,
-                        (p1.coords[1] + p2.coords[1] + p3.coords[1]) / 3.0f,
-                        (p1.coords[2] + p2.coords[2] + p3.coords[2]) / 3.0f
-                    };
-
-                    // Set initial guizmo position if just selected
-                    if (initialMidMap.find(i) == initialMidMap.end()) {
-                        // Set guizmo to midpoint
-                        app.GetRenderer().SetInitialGuizmoPosition(mid);
-                        initialMidMap[i] = mid;
-                        initialPMap[i] = std::make_tuple(
-                            glm::vec3(p1.coords[0], p1.coords[1], p1.coords[2]),
-                            glm::vec3(p2.coords[0], p2.coords[1], p2.coords[2]),
-                            glm::vec3(p3.coords[0], p3.coords[1], p3.coords[2])
-                        );
-                    }
+        ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+        if (sortSpecs && sortSpecs->SpecsDirty) {
+            planeRows.dirty = true;
+            sortSpecs->SpecsDirty = false;
+        }
 
-                    glm::vec3 newMid = app.GetRenderer().SetPositionWithGuizmo(app.GetCamera());
-                    if (newMid != initialMidMap[i]) {
-                        glm::vec3 delta = newMid - initialMidMap[i];
-                        auto [p1init, p2init, p3init] = initialPMap[i];
-                        glm::vec3 p1new = p1init + delta;
-                        glm::vec3 p2new = p2init + delta;
-                        glm::vec3 p3new = p3init + delta;
-                        p1.coords[0] = p1new.x; p1.coords[1] = p1new.y; p1.coords[2] = p1new.z;
-                        p2.coords[0] = p2new.x; p2.coords[1] = p2new.y; p2.coords[2] = p2new.z;
-                        p3.coords[0] = p3new.x; p3.coords[1] = p3new.y; p3.coords[2] = p3new.z;
-                    }
+        // nothing here depends on coordinates
+        if (planeRows.NeedsRebuild(app.GetListRevision(), sceneData.planes.size())) {
+            auto& pointNames = planeRows.pointNames;
+            pointNames.clear();
+            if (planePointFilter.IsActive() || SortsByColumn(sortSpecs, 1)) {
+                for (size_t i = 0; i < sceneData.planes.size(); ++i) {
+                    const auto& plane = scene.planes[i];
+                    pointNames.push_back(JoinPointNames(sceneData, { plane.point1index, plane.point2index, plane.point3index }));
                 }
-            } else {
-                // Clear guizmo state if not selected
-                initialMidMap.erase(i);
-                initialPMap.erase(i);
             }
 
-            ImGui::TableSetColumnIndex(0);
-            ImVec2 cellMin = ImGui::GetCursorScreenPos();
-            ImVec2 cellMax = ImVec2(cellMin.x + ImGui::GetColumnWidth(), cellMin.y + ImGui::GetTextLineHeightWithSpacing());
-            ImVec2 buttonSize = ImVec2(cellMax.x - cellMin.x, cellMax.y - cellMin.y);
-
-            // Click area (invisible button)
-            if (ImGui::InvisibleButton("##select", buttonSize)) {
-                if (selectedPlaneIndex == static_cast<int>(i)) {
-                    selectedPlaneIndex = -1;
-                } else {
-                    selectedPlaneIndex = static_cast<int>(i);
-                    // Set guizmo to midpoint
-                    if (plane.point1index >= 0 && plane.point1index < static_cast<int>(sceneData.points.size()) &&
-                        plane.point2index >= 0 && plane.point2index < static_cast<int>(sceneData.points.size()) &&
-                        plane.point3index >= 0 && plane.point3index < static_cast<int>(sceneData.points.size())) {
-                        auto& p1 = sceneData.points[plane.point1index];
-                        auto& p2 = sceneData.points[plane.point2index];
-                        auto& p3 = sceneData.points[plane.point3index];
-                        glm::vec3 mid{
-                            (p1.coords[0] + p2.coords[0] + p3.coords[0]) / 3.0f,
-                            (p1.coords[1] + p2.coords[1] + p3.coords[1]) / 3.0f,
-                            (p1.coords[2] + p2.coords[2] + p3.coords[2]) / 3.0f
-                        };
-                        app.GetRenderer().SetInitialGuizmoPosition(mid);
-                        initialMidMap[i] = mid;
-                        initialPMap[i] = std::make_tuple(
-                            glm::vec3(p1.coords[0], p1.coords[1], p1.coords[2]),
-                            glm::vec3(p2.coords[0], p2.coords[1], p2.coords[2]),
-                            glm::vec3(p3.coords[0], p3.coords[1], p3.coords[2])
-                        );
-                    }
-                }
-            }
-            ImGui::SetCursorScreenPos(cellMin);
-            ImGui::Text("  %s", plane.name.c_str());
-
-            ImGui::TableSetColumnIndex(1);
-            bool pointsHidden = false;
-            if (plane.point1index >= 0 && plane.point1index < static_cast<int>(sceneData.points.size()) &&
-                plane.point2index >= 0 && plane.point2index < static_cast<int>(sceneData.points.size()) &&
-                plane.point3index >= 0 && plane.point3index < static_cast<int>(sceneData.points.size())) {
-                pointsHidden = sceneData.points[plane.point1index].hidden;
-                if (ImGui::Checkbox("##Hide", &pointsHidden)) {
-                    sceneData.points[plane.point1index].hidden = pointsHidden;
-                    sceneData.points[plane.point2index].hidden = pointsHidden;
-                    sceneData.points[plane.point3index].hidden = pointsHidden;
-                }
+            planeRows.indices.clear();
+            planeRows.unfiltered = sceneData.planes.size();
+            for (size_t i = 0; i < sceneData.planes.size(); ++i) {
+                if (!planeNameFilter.PassFilter(scene.planes[i].name.c_str())) continue;
+                if (planePointFilter.IsActive() && !planePointFilter.PassFilter(pointNames[i].c_str())) continue;
+                planeRows.indices.push_back(static_cast<int>(i));
             }
 
-            ImGui::TableSetColumnIndex(2);
-            ImGui::Checkbox("##Expand", &plane.expand);
+            SortRows(planeRows.indices, sortSpecs, [&](int column, int a, int b) {
+                const auto& pa = scene.planes[a];
+                const auto& pb = scene.planes[b];
+                if (column == 0) return pa.name.compare(pb.name);
+                if (column == 1) return pointNames[a].compare(pointNames[b]);
+                if (column == 3) return static_cast<int>(pa.expand) - static_cast<int>(pb.expand);
+                return 0;
+            });
+            planeRows.Built(app.GetListRevision(), sceneData.planes.size());
+        }
 
-            ImGui::TableSetColumnIndex(3);
-            if (ImGui::ColorEdit3("##Color", (float*)&color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel)) {
-                plane.color[0] = color.x;
-                plane.color[1] = color.y;
-                plane.color[2] = color.z;
-            }
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(planeRows.indices.size()));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                const size_t i = static_cast<size_t>(planeRows.indices[row]);
+                Plane plane = scene.planes[i]; // EditEntity writes it back when a widget changes it
+                ImVec4 color(plane.color[0], plane.color[1], plane.color[2], 1.0f);
+
+                ImGui::PushID(static_cast<int>(i));
+                ImGui::TableNextRow();
+
+                // Highlight row if selected
+                if (selection.IsSelected(EntityKind::Plane, static_cast<int>(i))) {
+                    ImU32 highlightColor = ImGui::GetColorU32(ImGuiCol_Header);
+                    ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, highlightColor);
+                }
 
-            ImGui::TableSetColumnIndex(4);
-            if (ImGui::Button("X")) {
-                int p1 = plane.point1index;
-                int p2 = plane.point2index;
-                int p3 = plane.point3index;
-
-                bool p1User = (p1 >= 0 && p1 < static_cast<int>(sceneData.points.size())) ?
-                    sceneData.points[p1].userCreated : false;
-                bool p2User = (p2 >= 0 && p2 < static_cast<int>(sceneData.points.size())) ?
-                    sceneData.points[p2].userCreated : false;
-                bool p3User = (p3 >= 0 && p3 < static_cast<int>(sceneData.points.size())) ?
-                    sceneData.points[p3].userCreated : false;
-                sceneData.planes.erase(sceneData.planes.begin() + i);
-                if (p1 >= 0 && p1 < static_cast<int>(sceneData.points.size())) {
-                    if (!p1User) {
-                        sceneData.points[p1].hidden = true;
-                        sceneData.points[p1].name = "deleted";
-                    } else {
-                        sceneData.points[p1].hidden = false;
-                    }
+                ImGui::TableSetColumnIndex(0);
+                ImVec2 cellMin = ImGui::GetCursorScreenPos();
+                ImVec2 cellMax = ImVec2(cellMin.x + ImGui::GetColumnWidth(), cellMin.y + ImGui::GetTextLineHeightWithSpacing());
+                ImVec2 buttonSize = ImVec2(cellMax.x - cellMin.x, cellMax.y - cellMin.y);
+
+                // Click area (invisible button)
+                if (ImGui::InvisibleButton("##select", buttonSize)) {
+                    selection.Click(EntityKind::Plane, static_cast<int>(i), additive); // the guizmo moves to the centroid next frame
                 }
-                if (p2 >= 0 && p2 < static_cast<int>(sceneData.points.size())) {
-                    if (!p2User) {
-                        sceneData.points[p2].hidden = true;
-                        sceneData.points[p2].name = "deleted";
-                    } else {
-                        sceneData.points[p2].hidden = false;
+                ImGui::SetCursorScreenPos(cellMin);
+                ImGui::Text("  %s", plane.name.c_str());
+
+                ImGui::TableSetColumnIndex(1);
+                ImGui::TextUnformatted(JoinPointNames(sceneData, { plane.point1index, plane.point2index, plane.point3index }).c_str());
+
+                ImGui::TableSetColumnIndex(2);
+                bool pointsHidden = false;
+                if (validPlane(plane)) {
+                    pointsHidden = scene.points[plane.point1index].hidden;
+                    if (ImGui::Checkbox("##Hide", &pointsHidden)) {
+                        history.Begin(sceneData);
+                        for (int p : { plane.point1index, plane.point2index, plane.point3index }) history.Touch(sceneData, EntityKind::Point, p);
+                        sceneData.points[plane.point1index].hidden = pointsHidden;
+                        sceneData.points[plane.point2index].hidden = pointsHidden;
+                        sceneData.points[plane.point3index].hidden = pointsHidden;
+                        history.Commit(sceneData);
+                        app.MarkSceneChanged();
                     }
                 }
-                if (p3 >= 0 && p3 < static_cast<int>(sceneData.points.size())) {
-                    if (!p3User) {
-                        sceneData.points[p3].hidden = true;
-                        sceneData.points[p3].name = "deleted";
-                    } else {
-                        sceneData.points[p3].hidden = false;
-                    }
+
+                ImGui::TableSetColumnIndex(3);
+                if (EditEntity(history, sceneData, static_cast<int>(i), plane, [&]() { return ImGui::Checkbox("##Expand", &plane.expand); })) {
+                    app.MarkSceneChanged(); // the table can be sorted by it
+                }
+
+                ImGui::TableSetColumnIndex(4);
+                EditEntity(history, sceneData, static_cast<int>(i), plane, [&]() {
+                    if (!ImGui::ColorEdit3("##Color", (float*)&color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel)) return false;
+                    plane.color[0] = color.x;
+                    plane.color[1] = color.y;
+                    plane.color[2] = color.z;
+                    return true;
+                });
+
+                ImGui::TableSetColumnIndex(5);
+                if (ImGui::Button("X")) {
+                    deletePlaneIndex = static_cast<int>(i);
                 }
-                initialMidMap.erase(i);
-                initialPMap.erase(i);
+
                 ImGui::PopID();
-                --i;
-                continue;
             }
-
-            ImGui::PopID();
         }
 
         ImGui::EndTable();
     }
 
-    // Show coordinate editing for selected plane
-    if (selectedPlaneIndex >= 0 && selectedPlaneIndex < static_cast<int>(sceneData.planes.size())) {
-        auto& plane = sceneData.planes[selectedPlaneIndex];
+    if (deletePlaneIndex >= 0) {
+        app.DeletePlane(deletePlaneIndex);
+    }
+
+    // Show coordinate editing when a single plane is selected
+    const auto& selectedPlanes = selection.Get(EntityKind::Plane);
+    if (selection.Count() == 1 && selectedPlanes.size() == 1) {
+        const auto& plane = scene.planes[selectedPlanes[0]];
         if (plane.point1index >= 0 && plane.point1index < static_cast<int>(sceneData.points.size()) &&
             plane.point2index >= 0 && plane.point2index < static_cast<int>(sceneData.points.size()) &&
             plane.point3index >= 0 && plane.point3index < static_cast<int>(sceneData.points.size())) {
-            auto& p1 = sceneData.points[plane.point1index];
-            auto& p2 = sceneData.points[plane.point2index];
-            auto& p3 = sceneData.points[plane.point3index];
+            Point p1 = scene.points[plane.point1index];
+            Point p2 = scene.points[plane.point2index];
+            Point p3 = scene.points[plane.point3index];
 
             ImGui::Separator();
-            ImGui::InputFloat3("P1", p1.coords);
-            ImGui::InputFloat3("P2", p2.coords);
-            ImGui::InputFloat3("P3", p3.coords);
+            EditEntity(history, sceneData, plane.point1index, p1, [&]() { return ImGui::InputFloat3("P1", p1.coords); });
+            EditEntity(history, sceneData, plane.point2index, p2, [&]() { return ImGui::InputFloat3("P2", p2.coords); });
+            EditEntity(history, sceneData, plane.point3index, p3, [&]() { return ImGui::InputFloat3("P3", p3.coords); });
         }
     }
     ImGui::PopStyleVar();
 }
 
+bool UI::PointPicker(const App& app, const char* label, int& selected) {
+    const auto& sceneData = app.GetSceneData();
+    auto& rows = pointPicker.rows;
+    auto& keys = pointPicker.keys;
+
+    if (rows.NeedsRebuild(app.GetListRevision(), sceneData.points.size())) {
+        std::vector<std::pair<std::string, int>> entries;
+        for (size_t i = 0; i < sceneData.points.size(); ++i) {
+            if (sceneData.points[i].hidden) continue;
+            std::string key = sceneData.points[i].name;
+            std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            entries.emplace_back(std::move(key), static_cast<int>(i));
+        }
+        std::sort(entries.begin(), entries.end());
+
+        rows.indices.clear();
+        keys.clear();
+        for (auto& entry : entries) {
+            keys.push_back(std::move(entry.first));
+            rows.indices.push_back(entry.second);
+        }
+        rows.Built(app.GetListRevision(), sceneData.points.size());
+    }
+
+    if (selected >= static_cast<int>(sceneData.points.size()) || (selected >= 0 && sceneData.points[selected].hidden)) selected = -1;
+
+    bool changed = false;
+    const char* preview = selected >= 0 ? sceneData.points[selected].name.c_str() : "";
+    if (ImGui::BeginCombo(label, preview, ImGuiComboFlags_HeightLarge)) {
+        if (ImGui::IsWindowAppearing()) {
+            pointPickerSearch[0] = '\0';
+            ImGui::SetKeyboardFocusHere();
+        }
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        bool pickFirst = ImGui::InputTextWithHint("##Search", SetText("picker_search", currentLanguage).c_str(),
+                                                  pointPickerSearch, sizeof(pointPickerSearch), ImGuiInputTextFlags_EnterReturnsTrue);
+
+        // lowercase the typed prefix, the names starting with it are one range of the sorted keys
+        char prefixBuffer[sizeof(pointPickerSearch)];
+        size_t length = 0;
+        for (; pointPickerSearch[length] != '\0'; ++length) {
+            prefixBuffer[length] = static_cast<char>(std::tolower(static_cast<unsigned char>(pointPickerSearch[length])));
+        }
+        std::string_view prefix(prefixBuffer, length);
+
+        auto first = std::lower_bound(keys.begin(), keys.end(), prefix,
+            [](const std::string& key, std::string_view value) { return std::string_view(key) < value; });
+        auto last = std::upper_bound(first, keys.end(), prefix,
+            [](std::string_view value, const std::string& key) { return value < std::string_view(key).substr(0, value.size()); });
+        const int begin = static_cast<int>(first - keys.begin());
+        const int count = static_cast<int>(last - first);
+
+        if (pickFirst && count > 0) {
+            selected = rows.indices[begin];
+            changed = true;
+            ImGui::CloseCurrentPopup();
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin(count);
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                const int index = rows.indices[begin + row];
+                ImGui::PushID(index);
+                if (ImGui::Selectable(sceneData.points[index].name.c_str(), index == selected)) {
+                    selected = index;
+                    changed = true;
+                }
+                ImGui::PopID();
+            }
+        }
+
+        ImGui::EndCombo();
+    }
+
+    return changed;
+}
+
 void UI::DrawPresetWindow(App& app) {
     auto& sceneData = app.GetSceneData();
 
@@ -1254,6 +1718,7 @@ void UI::DrawPresetWindow(App& app) {
             for (const auto& preset : pointPresets) {
                 std::string label = preset["name"].get<std::string>() + " - " + preset["description"].get<std::string>();
                 if (ImGui::Button(label.c_str())) {
+                    app.GetHistory().Begin(sceneData);
                     sceneData.points.push_back({
                         preset["name"],
                         {
@@ -1262,6 +1727,7 @@ void UI::DrawPresetWindow(App& app) {
                             preset["coords"]["c"].get<float>()
                         }
                     });
+                    app.GetHistory().Commit(sceneData);
                     ImGui::CloseCurrentPopup();
                 }
             }
@@ -1292,6 +1758,7 @@ void UI::DrawPresetWindow(App& app) {
             for (const auto& preset : linePresets) {
                 std::string label = preset["name"].get<std::string>() + " - " + preset["description"].get<std::string>();
                 if (ImGui::Button(label.c_str())) {
+                    app.GetHistory().Begin(sceneData);
                     sceneData.lines.push_back({
                         preset["name"],
                         static_cast<int>(sceneData.points.size()),
@@ -1316,6 +1783,7 @@ void UI::DrawPresetWindow(App& app) {
                         },
                         true
                     });
+                    app.GetHistory().Commit(sceneData);
                     ImGui::CloseCurrentPopup();
                 }
             }
@@ -1346,6 +1814,7 @@ void UI::DrawPresetWindow(App& app) {
             for (const auto& preset : planePresets) {
                 std::string label = preset["name"].get<std::string>() + " - " + preset["description"].get<std::string>();
                 if (ImGui::Button(label.c_str())) {
+                    app.GetHistory().Begin(sceneData);
                     sceneData.planes.push_back({
                         preset["name"],
                         static_cast<int>(sceneData.points.size()),
@@ -1390,6 +1859,7 @@ void UI::DrawPresetWindow(App& app) {
                         sceneData.planes.back().color[2] = preset["color"]["b"].get<float>();
                     }
 
+                    app.GetHistory().Commit(sceneData);
                     ImGui::CloseCurrentPopup();
                 }
             }
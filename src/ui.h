@@ -8,6 +8,7 @@ class App;
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <imgui_internal.h>
+#include <cstdint>
 #include <string>
 
 #include <unordered_map>
@@ -47,9 +48,61 @@ private:
     void DrawLinesTab(App& app);
     void DrawPlanesTab(App& app);
 
+    // One guizmo for the whole selection, at the centroid of every point it moves
+    void DrawSelectionGuizmo(App& app);
+    void DrawSelectionBar(App& app); // count, bulk recolor and delete, above the tabs
+
+    void DrawPerfHud(App& app); // frame time percentiles, GPU time per pass and renderer counters (F3)
+    bool showPerfHud = false;
+    std::vector<float> perfHudPlot;
+    float selectionPivot[3] = { 0.0f, 0.0f, 0.0f }; // where the guizmo was when the drag started (d, a, c)
+    bool selectionDragging = false; // the guizmo drag has an undo step open
+    float bulkColor[3] = { 1.0f, 1.0f, 1.0f };
+
+    // Rows of a virtualized table: scene indices after filtering and sorting. They are only rebuilt when
+    // the scene, the filters or the sort order change, and only the rows on screen get submitted.
+    // Tables whose filters and sort don't look at coordinates pass the list revision instead of the scene one.
+    struct TableRows {
+        std::vector<int> indices;
+        std::vector<std::string> pointNames; // joined point names per entity, filled when the filter or sort needs them
+        size_t unfiltered = 0; // rows there would be without the filters
+        uint64_t revision = 0;
+        size_t count = 0;
+        bool dirty = true;
+
+        bool NeedsRebuild(uint64_t sceneRevision, size_t entityCount) const {
+            return dirty || revision != sceneRevision || count != entityCount;
+        }
+        void Built(uint64_t sceneRevision, size_t entityCount) {
+            revision = sceneRevision;
+            count = entityCount;
+            dirty = false;
+        }
+    };
+    TableRows pointRows, lineRows, planeRows;
+
+    // Type-ahead combo over the visible points, returns true when the selection changed.
+    // All pickers share one index: visible points sorted by lowercase name, rebuilt when the list revision
+    // changes (never while points are only moving), so a typed prefix is a binary search for a contiguous range and nothing is allocated per frame.
+    bool PointPicker(const App& app, const char* label, int& selected);
+    struct PointPickerIndex {
+        TableRows rows;                // visible point indices sorted by name
+        std::vector<std::string> keys; // their lowercase names, same order
+    } pointPicker;
+    char pointPickerSearch[64] = ""; // only one combo is open at a time
+    ImGuiTextFilter pointNameFilter, lineNameFilter, linePointFilter, planeNameFilter, planePointFilter;
+    uint8_t pointFilter = 0; // PointClass bits, 0 shows every point
+
     // File dialogs
     void OpenFileDialog(App& app);
     void SaveFileDialog(App& app);
+    void ExportSheetDialog(App& app, bool pdf);
+    void ExportSheet(App& app, std::string path, bool pdf);
+    bool exportAsPDF = false;
+    void ExportImageDialog(App& app);
+    void ExportImage(App& app, std::string path);
+    bool openExportImagePopup = false;
+    int exportImageSize[2] = { 8192, 8192 };
 
     // TRANSLATION ------------------
     void loadTranslations(const std::string& path);
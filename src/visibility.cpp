@@ -0,0 +1,279 @@
+#include "visibility.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr double RELATIVE_EPSILON = 1e-6;
+
+    struct Span {
+        double t0, t1;
+    };
+
+    // which coordinate is x, y and depth on each projection, coords are (d, a, c)
+    struct ViewAxes {
+        int x, y, depth;
+    };
+    constexpr ViewAxes VERTICAL_VIEW = { 0, 2, 1 };   // front view, looking along -a
+    constexpr ViewAxes HORIZONTAL_VIEW = { 0, 1, 2 }; // top view, looking along -c
+
+    double Dot(const double a[3], const double b[3]) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    void Cross(const double a[3], const double b[3], double out[3]) {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    // keeps the part of a convex polygon where coords[axis] * sign <= limit * sign
+    void ClipPolygon(std::vector<double>& polygon, int axis, double limit, double sign) {
+        std::vector<double> clipped;
+        size_t count = polygon.size() / 3;
+        for (size_t i = 0; i < count; ++i) {
+            const double* a = &polygon[i * 3];
+            const double* b = &polygon[((i + 1) % count) * 3];
+            double da = (a[axis] - limit) * sign;
+            double db = (b[axis] - limit) * sign;
+
+            if (da <= 0.0) clipped.insert(clipped.end(), a, a + 3);
+            if ((da < 0.0 && db > 0.0) || (da > 0.0 && db < 0.0)) {
+                double t = da / (da - db);
+                for (int k = 0; k < 3; ++k) clipped.push_back(a[k] + (b[k] - a[k]) * t);
+            }
+        }
+        polygon.swap(clipped);
+    }
+}
+
+void VisibilitySolver::SetVolume(float halfSize) {
+    if (halfSize == m_halfSize) return;
+    m_halfSize = halfSize;
+    m_occludersDirty = true;
+}
+
+void VisibilitySolver::InvalidateLine(int index) {
+    if (index >= 0 && index < static_cast<int>(m_solved.size())) m_solved[index] = 0;
+}
+
+const std::vector<LineVisibility>& VisibilitySolver::Update(const SceneData& sceneData, const std::vector<LineTraces>& traces) {
+    if (m_lines.size() > sceneData.lines.size()) {
+        // lines were erased and the indices moved, solve everything again
+        m_lines.assign(sceneData.lines.size(), LineVisibility());
+        m_solved.assign(sceneData.lines.size(), 0);
+    } else {
+        // appended lines start out unsolved
+        m_lines.resize(sceneData.lines.size());
+        m_solved.resize(sceneData.lines.size(), 0);
+    }
+
+    if (m_occludersDirty) {
+        BuildOccluders(sceneData);
+        std::fill(m_solved.begin(), m_solved.end(), 0);
+        m_occludersDirty = false;
+    }
+
+    // lines without showVisibility stay unsolved until they get it turned on
+    for (size_t i = 0; i < sceneData.lines.size() && i < traces.size(); ++i) {
+        const auto& line = sceneData.lines[i];
+        if (!line.showVisibility || m_solved[i]) continue;
+
+        const float* p1 = sceneData.points[line.point1index].coords;
+        const float* p2 = sceneData.points[line.point2index].coords;
+        Solve(p1, p2, traces[i], true, m_lines[i].vertical);
+        Solve(p1, p2, traces[i], false, m_lines[i].horizontal);
+        m_solved[i] = 1;
+    }
+
+    return m_lines;
+}
+
+void VisibilitySolver::BuildOccluders(const SceneData& sceneData) {
+    m_occluders.clear();
+    m_occluders.reserve(sceneData.planes.size());
+
+    const double h = m_halfSize;
+    for (const auto& plane : sceneData.planes) {
+        const float* c1 = sceneData.points[plane.point1index].coords;
+        const float* c2 = sceneData.points[plane.point2index].coords;
+        const float* c3 = sceneData.points[plane.point3index].coords;
+
+        double p1[3] = { c1[0], c1[1], c1[2] };
+        double e1[3] = { c2[0] - p1[0], c2[1] - p1[1], c2[2] - p1[2] };
+        double e2[3] = { c3[0] - p1[0], c3[1] - p1[1], c3[2] - p1[2] };
+
+        Occluder occluder;
+        Cross(e1, e2, occluder.normal);
+        double length = std::sqrt(Dot(occluder.normal, occluder.normal));
+        if (length <= RELATIVE_EPSILON * std::max(Dot(e1, e1), Dot(e2, e2))) continue; // collinear points
+
+        for (double& n : occluder.normal) n /= length;
+        occluder.offset = -Dot(occluder.normal, p1);
+
+        if (!plane.expand) {
+            occluder.polygon = { p1[0], p1[1], p1[2], (double)c2[0], (double)c2[1], (double)c2[2],
+                                 (double)c3[0], (double)c3[1], (double)c3[2] };
+        }
+        else {
+            // a square on the plane that covers the whole volume, cut down to the first quadrant part
+            const double* n = occluder.normal;
+            double center[3] = { -occluder.offset * n[0], -occluder.offset * n[1], -occluder.offset * n[2] };
+            double axis[3] = { 0.0, 0.0, 0.0 };
+            axis[std::fabs(n[0]) < 0.9 ? 0 : 1] = 1.0;
+
+            double u[3], v[3];
+            Cross(n, axis, u);
+            double uLength = std::sqrt(Dot(u, u));
+            for (double& x : u) x /= uLength;
+            Cross(n, u, v);
+
+            const double r = h * 4.0;
+            const double corners[4][2] = { { -r, -r }, { r, -r }, { r, r }, { -r, r } };
+            for (const auto& corner : corners) {
+                for (int k = 0; k < 3; ++k) occluder.polygon.push_back(center[k] + u[k] * corner[0] + v[k] * corner[1]);
+            }
+
+            ClipPolygon(occluder.polygon, 0, h, 1.0);
+            ClipPolygon(occluder.polygon, 0, -h, -1.0);
+            ClipPolygon(occluder.polygon, 1, h, 1.0);
+            ClipPolygon(occluder.polygon, 1, 0.0, -1.0);
+            ClipPolygon(occluder.polygon, 2, h, 1.0);
+            ClipPolygon(occluder.polygon, 2, 0.0, -1.0);
+        }
+
+        if (occluder.polygon.size() >= 9) m_occluders.push_back(std::move(occluder));
+    }
+
+    // one tree per projection over the projected boxes, planes seen edge on can't hide anything
+    std::vector<AABB> verticalBoxes(m_occluders.size()), horizontalBoxes(m_occluders.size());
+    for (size_t i = 0; i < m_occluders.size(); ++i) {
+        const auto& occluder = m_occluders[i];
+        for (size_t v = 0; v < occluder.polygon.size(); v += 3) {
+            const double* p = &occluder.polygon[v];
+            if (std::fabs(occluder.normal[VERTICAL_VIEW.depth]) > RELATIVE_EPSILON) {
+                float point[3] = { (float)p[VERTICAL_VIEW.x], (float)p[VERTICAL_VIEW.y], 0.0f };
+                verticalBoxes[i].Grow(point);
+            }
+            if (std::fabs(occluder.normal[HORIZONTAL_VIEW.depth]) > RELATIVE_EPSILON) {
+                float point[3] = { (float)p[HORIZONTAL_VIEW.x], (float)p[HORIZONTAL_VIEW.y], 0.0f };
+                horizontalBoxes[i].Grow(point);
+            }
+        }
+    }
+    m_verticalTree.Build(verticalBoxes);
+    m_horizontalTree.Build(horizontalBoxes);
+}
+
+void VisibilitySolver::Solve(const float p1[3], const float p2[3], const LineTraces& traces, bool vertical,
+                             std::vector<VisibilityInterval>& out) const {
+    out.clear();
+    if (traces.degenerate) return;
+
+    const ViewAxes view = vertical ? VERTICAL_VIEW : HORIZONTAL_VIEW;
+    const BVH& tree = vertical ? m_verticalTree : m_horizontalTree;
+
+    double dir[3] = { (double)p2[0] - p1[0], (double)p2[1] - p1[1], (double)p2[2] - p1[2] };
+    double ox = p1[view.x], oy = p1[view.y];
+    double dx = dir[view.x], dy = dir[view.y];
+    double scale = std::max(1.0, (double)m_halfSize);
+
+    // gather the stretches of t where a plane covers the line and is closer to the observer
+    std::vector<Span> hidden;
+    bool projectsToPoint = std::fabs(dx) + std::fabs(dy) <= RELATIVE_EPSILON * scale;
+    if (!projectsToPoint) {
+        std::vector<int> candidates;
+        float origin[3] = { (float)ox, (float)oy, 0.0f };
+        float direction[3] = { (float)dx, (float)dy, 0.0f };
+        tree.QueryLine(origin, direction, candidates);
+
+        for (int index : candidates) {
+            const auto& occluder = m_occluders[index];
+            const auto& polygon = occluder.polygon;
+            size_t count = polygon.size() / 3;
+
+            double area = 0.0;
+            for (size_t i = 0; i < count; ++i) {
+                const double* a = &polygon[i * 3];
+                const double* b = &polygon[((i + 1) % count) * 3];
+                area += a[view.x] * b[view.y] - b[view.x] * a[view.y];
+            }
+            double winding = area < 0.0 ? -1.0 : 1.0;
+
+            // inside every edge of the projected polygon, each edge test is linear in t
+            double t0 = -HUGE_VAL, t1 = HUGE_VAL;
+            for (size_t i = 0; i < count && t0 < t1; ++i) {
+                const double* a = &polygon[i * 3];
+                const double* b = &polygon[((i + 1) % count) * 3];
+                double ex = b[view.x] - a[view.x], ey = b[view.y] - a[view.y];
+                double base = winding * (ex * (oy - a[view.y]) - ey * (ox - a[view.x]));
+                double slope = winding * (ex * dy - ey * dx);
+
+                if (std::fabs(slope) <= 1e-12) {
+                    if (base < 0.0) t1 = t0;
+                    continue;
+                }
+                double t = -base / slope;
+                if (slope > 0.0) t0 = std::max(t0, t);
+                else t1 = std::min(t1, t);
+            }
+            if (t0 >= t1) continue;
+
+            // how far in front of the line the plane is, also linear in t (zero where the line pierces it)
+            const double* n = occluder.normal;
+            auto gap = [&](double t) {
+                double x = ox + dx * t, y = oy + dy * t;
+                double planeDepth = -(n[view.x] * x + n[view.y] * y + occluder.offset) / n[view.depth];
+                return planeDepth - (p1[view.depth] + dir[view.depth] * t);
+            };
+            double g0 = gap(0.0);
+            double g1 = gap(1.0) - g0;
+            double eps = RELATIVE_EPSILON * scale;
+
+            if (std::fabs(g1) <= 1e-12) {
+                if (g0 <= eps) continue;
+            }
+            else {
+                double crossing = (eps - g0) / g1;
+                if (g1 > 0.0) t0 = std::max(t0, crossing);
+                else t1 = std::min(t1, crossing);
+            }
+            if (t0 < t1) hidden.push_back({ t0, t1 });
+        }
+    }
+
+    // sweep: sort by start and merge the overlapping ones
+    std::sort(hidden.begin(), hidden.end(), [](const Span& a, const Span& b) { return a.t0 < b.t0; });
+    std::vector<Span> merged;
+    for (const auto& span : hidden) {
+        if (!merged.empty() && span.t0 <= merged.back().t1) merged.back().t1 = std::max(merged.back().t1, span.t1);
+        else merged.push_back(span);
+    }
+
+    auto emit = [&](double t0, double t1, bool visible) {
+        if (t0 >= t1) return;
+        if (!out.empty() && out.back().visible == visible) out.back().t1 = (float)t1;
+        else out.push_back({ (float)t0, (float)t1, visible });
+    };
+
+    // the quadrant pieces stay as they are, only the seen ones get cut by the planes in front of them
+    size_t next = 0;
+    for (int i = 0; i < traces.intervalCount; ++i) {
+        const auto& interval = traces.intervals[i];
+        if (!interval.visible) {
+            emit(interval.t0, interval.t1, false);
+            continue;
+        }
+
+        double t = interval.t0;
+        while (next < merged.size() && merged[next].t1 <= t) ++next;
+        for (size_t j = next; j < merged.size() && merged[j].t0 < interval.t1; ++j) {
+            double start = std::max(t, merged[j].t0);
+            double end = std::min((double)interval.t1, merged[j].t1);
+            emit(t, start, true);
+            emit(start, end, false);
+            t = std::max(t, end);
+        }
+        emit(t, interval.t1, true);
+    }
+}
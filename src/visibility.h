@@ -0,0 +1,53 @@
+// visibility.h
+#pragma once
+
+#include <vector>
+
+#include "bvh.h"
+#include "scene.h"
+#include "traces.h"
+
+struct VisibilityInterval {
+    float t0, t1;  // along p1 + t * (p2 - p1) of the line, open ends are -inf / inf
+    bool visible;
+};
+
+struct LineVisibility {
+    std::vector<VisibilityInterval> vertical;   // vertical projection, seen from the front (a -> +inf)
+    std::vector<VisibilityInterval> horizontal; // horizontal projection, seen from above (c -> +inf)
+};
+
+// Splits the projections of lines into seen and hidden parts. A part is hidden when it is outside the
+// first quadrant or when a plane lies between it and the observer of that projection.
+// Planes hide what the 3D view shows of them: their triangle, or their first quadrant part when expanded.
+class VisibilitySolver {
+public:
+    void SetVolume(float halfSize); // expanded planes are limited to this cube (model units)
+
+    void InvalidateLine(int index);
+    void InvalidatePlanes() { m_occludersDirty = true; } // any plane change can hide or reveal every line
+
+    // Solves the lines that have showVisibility on and aren't up to date, one entry per line
+    const std::vector<LineVisibility>& Update(const SceneData& sceneData, const std::vector<LineTraces>& traces);
+
+private:
+    struct Occluder {
+        std::vector<double> polygon; // 3D corners (d, a, c), convex
+        double normal[3];
+        double offset;
+    };
+
+    void BuildOccluders(const SceneData& sceneData);
+    void Solve(const float p1[3], const float p2[3], const LineTraces& traces, bool vertical,
+               std::vector<VisibilityInterval>& out) const;
+
+    float m_halfSize = 50.0f;
+    bool m_occludersDirty = true;
+
+    std::vector<Occluder> m_occluders;
+    BVH m_verticalTree;   // occluder boxes projected on (d, c)
+    BVH m_horizontalTree; // occluder boxes projected on (d, a)
+
+    std::vector<LineVisibility> m_lines;
+    std::vector<char> m_solved;
+};